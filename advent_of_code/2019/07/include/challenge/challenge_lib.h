@@ -9,10 +9,34 @@
 #define INCLUDE_CHALLENGE_LIB_H
 
 #include "challenge/intcode.h"
+#include "challenge/intcode_scheduler.h"
 #include "stdlib.h"
 
+/*Amplifiers connected in a feedback loop, reused for every phase permutation.*/
+typedef struct
+{
+    size_t num_amplifiers;
+    intcode_t** amplifiers;
+    intcode_io_ring_t** rings;
+    intcode_scheduler_t* scheduler;
+} amplifier_chain_t;
+
 int** create_permutations(const size_t k, size_t* const num_perms);
 int** create_permutations_with_offset(const size_t k, const size_t offset, size_t* const num_perms);
 void destroy_permutations(int** const perms, const size_t num_perms);
 
+amplifier_chain_t* create_amplifier_chain(const size_t num_amplifiers);
+void destroy_amplifier_chain(amplifier_chain_t* const chain);
+int run_amplifier_chain(amplifier_chain_t* const chain,
+                        const intcode_t* const prog,
+                        const int* const phases,
+                        int64_t* const output);
+int find_max_output(const intcode_t* const prog,
+                    int** const perms,
+                    const size_t num_perms,
+                    const size_t num_amplifiers,
+                    const size_t num_workers,
+                    int64_t* const max_output,
+                    size_t* const max_index);
+
 #endif /* ifndef INCLUDE_CHALLENGE_LIB_H */
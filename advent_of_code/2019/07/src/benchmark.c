@@ -0,0 +1,109 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *  Date: 2019-12-09
+ *
+ */
+
+#include "challenge/challenge_lib.h"
+#include "challenge/intcode.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "time.h"
+#include "unistd.h"
+
+#define DEFAULT_ITERATIONS (100)
+
+static double now_ms()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000.0) + (now.tv_nsec / 1000000.0);
+}
+
+/*Average time of one search over all permutations, negative if the search failed.*/
+static double time_search(const intcode_t* const prog,
+                          int** const perms,
+                          const size_t num_perms,
+                          const size_t num_amplifiers,
+                          const size_t num_workers,
+                          const size_t iterations)
+{
+    int64_t max_output = 0;
+    size_t max_index   = 0;
+    double start       = now_ms();
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        if (!find_max_output(
+                prog, perms, num_perms, num_amplifiers, num_workers, &max_output, &max_index))
+        {
+            return -1.0;
+        }
+    }
+    return (now_ms() - start) / iterations;
+}
+
+int main(int argc, char* argv[])
+{
+    if ((argc != 2) && (argc != 3))
+    {
+        printf("This executabel takes one or two arguments.\n");
+        printf("Usage: aoc2019_07_benchmark FILE_PATH [ITERATIONS].\n");
+        return 0;
+    }
+
+    size_t num_amplifiers = 5;
+    size_t offset         = 5;
+    size_t iterations     = (argc == 3) ? strtoul(argv[2], NULL, 10) : DEFAULT_ITERATIONS;
+    long num_cores        = sysconf(_SC_NPROCESSORS_ONLN);
+    if (iterations == 0)
+    {
+        iterations = 1;
+    }
+
+    intcode_t* prog = read_intcode(argv[1]);
+    if (prog == NULL)
+    {
+        return 0;
+    }
+    set_engine(prog, INT_CODE_ENGINE_THREADED);
+
+    size_t num_perms = 0;
+    int** perms      = create_permutations_with_offset(num_amplifiers, offset, &num_perms);
+    if (perms == NULL)
+    {
+        destroy_intcode(prog);
+        return 0;
+    }
+
+    /*One worker is the serial loop on the calling thread.*/
+    double serial = time_search(prog, perms, num_perms, num_amplifiers, 1, iterations);
+    printf("Cores: %ld, iterations: %zu\n", num_cores, iterations);
+    printf("%8s %12s %10s %12s\n", "workers", "ms/search", "speedup", "efficiency");
+    for (size_t num_workers = 1; (num_workers <= 2 * num_cores) || (num_workers <= 4);
+         num_workers *= 2)
+    {
+        double time = (num_workers == 1) ? serial
+                                         : time_search(prog,
+                                                       perms,
+                                                       num_perms,
+                                                       num_amplifiers,
+                                                       num_workers,
+                                                       iterations);
+        if (time < 0.0)
+        {
+            printf("Programm did not halt as expected.\n");
+            break;
+        }
+        double speedup = serial / time;
+        printf("%8zu %12.3f %10.2f %11.0f%%\n",
+               num_workers,
+               time,
+               speedup,
+               (100.0 * speedup) / num_workers);
+    }
+
+    destroy_permutations(perms, num_perms);
+    destroy_intcode(prog);
+    return 0;
+}
@@ -6,13 +6,53 @@
  */
 
 #include "challenge/challenge_lib.h"
+#include "stdatomic.h"
+#include "stdint.h"
 #include "stdio.h"
 
+/*Every amplifier reads its phase and one signal before it answers, so small rings are enough.*/
+#define AMPLIFIER_RING_CAPACITY (16)
+
+/*Range of permutation indices owned by a search worker, begin in the upper and end in the lower*/
+/*32 bits, so the owner and thieves can update both with a single compare and swap.*/
+typedef struct
+{
+    _Alignas(64) atomic_uint_least64_t range;
+} search_queue_t;
+
+typedef struct search search_t;
+
+typedef struct
+{
+    search_t* search;
+    size_t id;
+    amplifier_chain_t* chain;
+    int found;
+    int failed;
+    int64_t max_output;
+    size_t max_index;
+} search_worker_t;
+
+struct search
+{
+    intcode_t* image;
+    int** perms;
+    size_t num_perms;
+    size_t num_workers;
+    search_queue_t* queues;
+    search_worker_t* workers;
+};
+
 static void fill_block(
     size_t* used, size_t num_used, size_t k, size_t col, size_t rows, size_t offset, int** perms);
 static int get_smallest_unused_value(const size_t* const used, const size_t length, size_t* val);
 static int find_max(const size_t* const numbers, const size_t amount);
 static void init_with_zeroes(int* const numbers, const size_t amount);
+static void* search_func(void* args);
+static int next_permutation(search_t* const search, const size_t id, size_t* const index);
+static int take_permutation(search_queue_t* const queue, size_t* const index);
+static int steal_permutations(search_t* const search, const size_t thief);
+static uint64_t pack_range(const uint64_t begin, const uint64_t end);
 
 int** create_permutations(const size_t k, size_t* const num_perms)
 {
@@ -91,8 +131,9 @@ static int get_smallest_unused_value(const size_t* const used, const size_t leng
         }
         size_t max      = find_max(used, length);
         size_t solution = 0;
-        int found[max + 1];
-        init_with_zeroes(found, max + 1);
+        /*One more slot than needed, so the search below stops if 0..max are all used.*/
+        int found[max + 2];
+        init_with_zeroes(found, max + 2);
         for (size_t i = 0; i < length; ++i)
         {
             size_t num = used[i];
@@ -176,3 +217,285 @@ static void init_with_zeroes(int* const numbers, const size_t amount)
         numbers[i] = 0;
     }
 }
+
+amplifier_chain_t* create_amplifier_chain(const size_t num_amplifiers)
+{
+    amplifier_chain_t* chain = NULL;
+    if (num_amplifiers > 0)
+    {
+        chain = (amplifier_chain_t*) malloc(sizeof(amplifier_chain_t));
+        if (chain != NULL)
+        {
+            size_t ring_size      = sizeof(intcode_io_ring_t*);
+            chain->num_amplifiers = num_amplifiers;
+            chain->amplifiers     = (intcode_t**) calloc(num_amplifiers, sizeof(intcode_t*));
+            chain->rings          = (intcode_io_ring_t**) calloc(num_amplifiers, ring_size);
+            chain->scheduler      = create_scheduler(0);
+            int success           = (chain->amplifiers != NULL) && (chain->rings != NULL) &&
+                          (chain->scheduler != NULL);
+            for (size_t i = 0; success && (i < num_amplifiers); ++i)
+            {
+                chain->rings[i] = create_io_ring(AMPLIFIER_RING_CAPACITY);
+                success         = (chain->rings[i] != NULL);
+            }
+            if (!success)
+            {
+                destroy_amplifier_chain(chain);
+                chain = NULL;
+            }
+        }
+    }
+    return chain;
+}
+
+void destroy_amplifier_chain(amplifier_chain_t* const chain)
+{
+    if (chain != NULL)
+    {
+        destroy_scheduler(chain->scheduler);
+        for (size_t i = 0; i < chain->num_amplifiers; ++i)
+        {
+            if (chain->amplifiers != NULL)
+            {
+                destroy_intcode(chain->amplifiers[i]);
+            }
+            if (chain->rings != NULL)
+            {
+                destroy_io_ring(chain->rings[i]);
+            }
+        }
+        free(chain->amplifiers);
+        free(chain->rings);
+        free(chain);
+    }
+}
+
+int run_amplifier_chain(amplifier_chain_t* const chain,
+                        const intcode_t* const prog,
+                        const int* const phases,
+                        int64_t* const output)
+{
+    int ret = INT_CODE_ERROR;
+    if ((chain == NULL) || (prog == NULL) || (phases == NULL) || (output == NULL))
+    {
+        return ret;
+    }
+
+    /*Leftovers of the previous permutation are dropped, only the machines are replaced.*/
+    clear_scheduler(chain->scheduler);
+    for (size_t i = 0; i < chain->num_amplifiers; ++i)
+    {
+        int64_t value = 0;
+        while (io_ring_try_read(chain->rings[i], &value, 1) == 1)
+        {
+        }
+        value = phases[i];
+        io_ring_try_write(chain->rings[i], &value, 1);
+    }
+
+    /*Every amplifier feeds the next one, the last one feeds the first.*/
+    for (size_t i = 0; i < chain->num_amplifiers; ++i)
+    {
+        destroy_intcode(chain->amplifiers[i]);
+        intcode_t* amplifier = fork_intcode(prog);
+        chain->amplifiers[i] = amplifier;
+        if (amplifier == NULL)
+        {
+            return ret;
+        }
+        set_io_mode(amplifier, INT_CODE_RING_IO);
+        set_ring_io_in(amplifier, chain->rings[i]);
+        set_ring_io_out(amplifier, chain->rings[(i + 1) % chain->num_amplifiers]);
+        schedule_intcode(chain->scheduler, amplifier);
+    }
+
+    int64_t signal = 0;
+    io_ring_try_write(chain->rings[0], &signal, 1);
+    ret = run_scheduler(chain->scheduler);
+    if (ret == INT_CODE_HALT)
+    {
+        /*The last signal of the final amplifier is never read by the first one.*/
+        ret = INT_CODE_ERROR;
+        while (io_ring_try_read(chain->rings[0], &signal, 1) == 1)
+        {
+            *output = signal;
+            ret     = INT_CODE_HALT;
+        }
+    }
+    return ret;
+}
+
+int find_max_output(const intcode_t* const prog,
+                    int** const perms,
+                    const size_t num_perms,
+                    const size_t num_amplifiers,
+                    const size_t num_workers,
+                    int64_t* const max_output,
+                    size_t* const max_index)
+{
+    int success = 0;
+    if ((prog == NULL) || (perms == NULL) || (max_output == NULL) || (max_index == NULL) ||
+        (num_perms == 0) || (num_perms > UINT32_MAX))
+    {
+        return success;
+    }
+
+    /*Forking shares and decodes the pages of the image once, so that the workers can fork it*/
+    /*concurrently without modifying it. The calling thread is worker 0.*/
+    search_t search;
+    search.image       = fork_intcode(prog);
+    search.perms       = perms;
+    search.num_perms   = num_perms;
+    search.num_workers = (num_workers > 0) ? num_workers : 1;
+    search.queues      = (search_queue_t*) aligned_alloc(
+        _Alignof(search_queue_t), sizeof(search_queue_t) * search.num_workers);
+    search.workers = (search_worker_t*) calloc(search.num_workers, sizeof(search_worker_t));
+    pthread_t* threads = (pthread_t*) calloc(search.num_workers, sizeof(pthread_t));
+
+    if ((search.image != NULL) && (search.queues != NULL) && (search.workers != NULL) &&
+        (threads != NULL))
+    {
+        /*Every worker starts with an equal share, idle workers steal half of a busy one.*/
+        for (size_t i = 0; i < search.num_workers; ++i)
+        {
+            size_t begin = (num_perms * i) / search.num_workers;
+            size_t end   = (num_perms * (i + 1)) / search.num_workers;
+            atomic_init(&search.queues[i].range, pack_range(begin, end));
+            search.workers[i].search = &search;
+            search.workers[i].id     = i;
+            search.workers[i].chain  = create_amplifier_chain(num_amplifiers);
+            search.workers[i].failed = (search.workers[i].chain == NULL);
+        }
+
+        size_t num_threads = 1;
+        while (num_threads < search.num_workers)
+        {
+            search_worker_t* worker = &search.workers[num_threads];
+            if (pthread_create(&threads[num_threads], NULL, search_func, worker) != 0)
+            {
+                break;
+            }
+            num_threads++;
+        }
+        search_func(&search.workers[0]);
+        for (size_t i = 1; i < num_threads; ++i)
+        {
+            pthread_join(threads[i], NULL);
+        }
+
+        /*Workers that failed to start leave their permutations for the others to steal.*/
+        success = 1;
+        int found = 0;
+        for (size_t i = 0; i < search.num_workers; ++i)
+        {
+            search_worker_t* worker = &search.workers[i];
+            success                 = success && !worker->failed;
+            if (worker->found &&
+                (!found || (worker->max_output > *max_output) ||
+                 ((worker->max_output == *max_output) && (worker->max_index < *max_index))))
+            {
+                *max_output = worker->max_output;
+                *max_index  = worker->max_index;
+                found       = 1;
+            }
+            destroy_amplifier_chain(worker->chain);
+        }
+        success = success && found;
+    }
+
+    destroy_intcode(search.image);
+    free(search.queues);
+    free(search.workers);
+    free(threads);
+    return success;
+}
+
+static void* search_func(void* args)
+{
+    search_worker_t* worker = (search_worker_t*) args;
+    search_t* search        = worker->search;
+    if (worker->chain == NULL)
+    {
+        return NULL;
+    }
+
+    size_t index = 0;
+    while (next_permutation(search, worker->id, &index))
+    {
+        int64_t output = 0;
+        int* phases    = search->perms[index];
+        int ret        = run_amplifier_chain(worker->chain, search->image, phases, &output);
+        if (ret != INT_CODE_HALT)
+        {
+            worker->failed = 1;
+        }
+        else if (!worker->found || (output > worker->max_output) ||
+                 ((output == worker->max_output) && (index < worker->max_index)))
+        {
+            worker->max_output = output;
+            worker->max_index  = index;
+            worker->found      = 1;
+        }
+    }
+    return NULL;
+}
+
+static int next_permutation(search_t* const search, const size_t id, size_t* const index)
+{
+    /*Someone might steal from us between stealing and taking, then we steal again.*/
+    while (!take_permutation(&search->queues[id], index))
+    {
+        if (!steal_permutations(search, id))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int take_permutation(search_queue_t* const queue, size_t* const index)
+{
+    uint64_t range = atomic_load(&queue->range);
+    uint64_t begin = range >> 32;
+    uint64_t end   = range & UINT32_MAX;
+    while (begin < end)
+    {
+        if (atomic_compare_exchange_weak(&queue->range, &range, pack_range(begin + 1, end)))
+        {
+            *index = begin;
+            return 1;
+        }
+        begin = range >> 32;
+        end   = range & UINT32_MAX;
+    }
+    return 0;
+}
+
+static int steal_permutations(search_t* const search, const size_t thief)
+{
+    for (size_t i = 1; i < search->num_workers; ++i)
+    {
+        search_queue_t* victim = &search->queues[(thief + i) % search->num_workers];
+        uint64_t range         = atomic_load(&victim->range);
+        uint64_t begin         = range >> 32;
+        uint64_t end           = range & UINT32_MAX;
+        while (begin < end)
+        {
+            /*The thief takes the upper half, the victim keeps working from the bottom.*/
+            uint64_t middle = begin + ((end - begin) / 2);
+            if (atomic_compare_exchange_weak(&victim->range, &range, pack_range(begin, middle)))
+            {
+                atomic_store(&search->queues[thief].range, pack_range(middle, end));
+                return 1;
+            }
+            begin = range >> 32;
+            end   = range & UINT32_MAX;
+        }
+    }
+    return 0;
+}
+
+static uint64_t pack_range(const uint64_t begin, const uint64_t end)
+{
+    return (begin << 32) | end;
+}
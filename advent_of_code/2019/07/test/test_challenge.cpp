@@ -6,6 +6,8 @@
 
 #include "gtest/gtest.h"
 
+#include <vector>
+
 extern "C" {
 #include "challenge/challenge_lib.h"
 }
@@ -27,3 +29,80 @@ TEST_F(challenge_test, pos_test_01)
     bool ret = true;
     ASSERT_TRUE(ret);
 }
+
+TEST_F(challenge_test, permutations_01)
+{
+    size_t num_perms = 0;
+    int** perms      = create_permutations_with_offset(5, 5, &num_perms);
+    ASSERT_EQ(num_perms, 120);
+    for (size_t i = 0; i < num_perms; ++i)
+    {
+        int seen = 0;
+        for (size_t j = 0; j < 5; ++j)
+        {
+            seen |= 1 << (perms[i][j] - 5);
+        }
+        ASSERT_EQ(seen, 31);
+    }
+    destroy_permutations(perms, num_perms);
+}
+
+class amplifier_test : public ::testing::TestWithParam<size_t>
+{
+  protected:
+    void SetUp() override {}
+
+    void TearDown() override {}
+
+    /*create_intcode takes ownership of the memory, so it has to be on the heap.*/
+    static intcode_t* create(const std::vector<int64_t>& content)
+    {
+        int64_t* memory = (int64_t*) malloc(sizeof(int64_t) * content.size());
+        for (size_t i = 0; i < content.size(); ++i)
+        {
+            memory[i] = content[i];
+        }
+        return create_intcode(memory, content.size());
+    }
+};
+
+TEST_P(amplifier_test, feedback_loop_01)
+{
+    intcode_t* prog = create({3,  26, 1001, 26, -4, 26, 3,    27, 1002, 27, 2,  27, 1, 27, 26,
+                              27, 4,  27,   1001, 28, -1, 28, 1005, 28, 6, 99, 0,  0, 5});
+    int phases[]    = {9, 8, 7, 6, 5};
+    int64_t output  = 0;
+
+    amplifier_chain_t* chain = create_amplifier_chain(5);
+    ASSERT_EQ(run_amplifier_chain(chain, prog, phases, &output), INT_CODE_HALT);
+    ASSERT_EQ(output, 139629729);
+
+    /*The chain is reused for the next permutation.*/
+    output = 0;
+    ASSERT_EQ(run_amplifier_chain(chain, prog, phases, &output), INT_CODE_HALT);
+    ASSERT_EQ(output, 139629729);
+    destroy_amplifier_chain(chain);
+    destroy_intcode(prog);
+}
+
+TEST_P(amplifier_test, find_max_output_01)
+{
+    intcode_t* prog = create({3,  52, 1001, 52, -5,   52, 3,    53, 1,  52, 56, 54, 1007, 54, 5,
+                              55, 1005, 55, 26, 1001, 54, -5, 54, 1105, 1,  12, 1,  53,   54, 53,
+                              1008, 54, 0,  55, 1001, 55, 1,  55, 2,  53, 55, 53, 4,    53, 1001,
+                              56, -1, 56, 1005, 56, 6,  99, 0,  0,  0,  0,  10});
+    size_t num_perms = 0;
+    int** perms      = create_permutations_with_offset(5, 5, &num_perms);
+
+    int64_t max_output = 0;
+    size_t max_index   = 0;
+    ASSERT_TRUE(find_max_output(prog, perms, num_perms, 5, GetParam(), &max_output, &max_index));
+    ASSERT_EQ(max_output, 18216);
+    std::vector<int> phases(perms[max_index], perms[max_index] + 5);
+    ASSERT_EQ(phases, std::vector<int>({9, 7, 8, 5, 6}));
+
+    destroy_permutations(perms, num_perms);
+    destroy_intcode(prog);
+}
+
+INSTANTIATE_TEST_SUITE_P(workers, amplifier_test, ::testing::Values(1, 2, 7));
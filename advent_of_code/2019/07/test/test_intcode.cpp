@@ -7,305 +7,1074 @@
 
 #include "gtest/gtest.h"
 
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
 extern "C" {
-#include "challenge/challenge_lib.h"
+#include "challenge/intcode.h"
 }
 
-class intcode_test : public ::testing::Test
+class intcode_test : public ::testing::TestWithParam<intcode_engine_t>
 {
   protected:
-    void SetUp() override
+    void SetUp() override {}
+
+    void TearDown() override {}
+
+    /*create_intcode takes ownership of the memory, so it has to be on the heap.*/
+    intcode_t* create(const int64_t* content, size_t nums)
     {
+        int64_t* memory = (int64_t*) malloc(sizeof(int64_t) * nums);
+        for (size_t i = 0; i < nums; ++i)
+        {
+            memory[i] = content[i];
+        }
+        intcode_t* prog = create_intcode(memory, nums);
+        set_engine(prog, GetParam());
+        return prog;
     }
 
-    void TearDown() override
+    static std::string run_with_input(intcode_t* prog, const std::string& file_path)
     {
+        FILE* input = fopen(file_path.c_str(), "r");
+        EXPECT_TRUE(input != NULL);
+        set_std_io_in(prog, input);
+
+        testing::internal::CaptureStdout();
+        int ret            = execute(prog);
+        std::string output = testing::internal::GetCapturedStdout();
+        EXPECT_EQ(ret, INT_CODE_HALT);
+
+        if (input != NULL)
+        {
+            fclose(input);
+        }
+        return output;
     }
 };
 
-TEST_F(intcode_test, add_test_01)
+TEST_P(intcode_test, add_test_01)
 {
-    size_t nums = 4;
-    int memory[nums];
-    memory[0] = 1;
-    memory[1] = 10;
-    memory[2] = 20;
-    memory[3] = 40;
+    int64_t memory[]      = {1, 10, 20, 40};
+    int64_t parameters[3] = {10, 20, 3};
+    int solution          = 30;
+
+    intcode_t* prog = create(memory, 4);
+    add_op(prog, parameters);
+
+    ASSERT_EQ(get_mem_value(prog, parameters[2]), solution);
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, multiply_test_01)
+{
+    int64_t memory[]      = {1, 10, 20, 40};
+    int64_t parameters[3] = {10, 20, 3};
+    int solution          = 200;
+
+    intcode_t* prog = create(memory, 4);
+    multiply_op(prog, parameters);
 
-    int parameters[3] = {10, 20, 3};
-    int solution      = 30;
+    ASSERT_EQ(get_mem_value(prog, parameters[2]), solution);
+    destroy_intcode(prog);
+}
 
-    intcode_t prog;
-    prog.memory      = memory;
-    prog.head        = 0;
-    prog.memory_size = nums;
+TEST_P(intcode_test, execute_test_01)
+{
+    int64_t memory[]   = {1, 0, 0, 0, 99};
+    int64_t solution[] = {2, 0, 0, 0, 99};
 
-    add_op(&prog, parameters);
+    intcode_t* prog = create(memory, 5);
+    int ret         = execute(prog);
 
-    ASSERT_EQ(prog.memory[parameters[2]], solution);
+    ASSERT_EQ(ret, INT_CODE_HALT);
+    for (int i = 0; i < 5; ++i)
+    {
+        ASSERT_EQ(get_mem_value(prog, i), solution[i]);
+    }
+    destroy_intcode(prog);
 }
 
-TEST_F(intcode_test, multiply_test_01)
+TEST_P(intcode_test, execute_test_02)
 {
-    size_t nums = 4;
-    int memory[nums];
-    memory[0] = 1;
-    memory[1] = 10;
-    memory[2] = 20;
-    memory[3] = 40;
+    int64_t memory[]   = {2, 3, 0, 3, 99};
+    int64_t solution[] = {2, 3, 0, 6, 99};
 
-    int parameters[3] = {10, 20, 3};
-    int solution      = 200;
+    intcode_t* prog = create(memory, 5);
+    int ret         = execute(prog);
 
-    intcode_t prog;
-    prog.memory      = memory;
-    prog.head        = 0;
-    prog.memory_size = nums;
+    ASSERT_EQ(ret, INT_CODE_HALT);
+    for (int i = 0; i < 5; ++i)
+    {
+        ASSERT_EQ(get_mem_value(prog, i), solution[i]);
+    }
+    destroy_intcode(prog);
+}
 
-    multiply_op(&prog, parameters);
+TEST_P(intcode_test, execute_test_03)
+{
+    int64_t memory[]   = {2, 4, 4, 5, 99, 0};
+    int64_t solution[] = {2, 4, 4, 5, 99, 9801};
+
+    intcode_t* prog = create(memory, 6);
+    int ret         = execute(prog);
 
-    ASSERT_EQ(prog.memory[parameters[2]], solution);
+    ASSERT_EQ(ret, INT_CODE_HALT);
+    for (int i = 0; i < 6; ++i)
+    {
+        ASSERT_EQ(get_mem_value(prog, i), solution[i]);
+    }
+    destroy_intcode(prog);
 }
 
-TEST_F(intcode_test, execute_test_01)
+TEST_P(intcode_test, execute_test_04)
 {
-    size_t nums = 5;
-    int memory[nums];
-    memory[0] = 1;
-    memory[1] = 0;
-    memory[2] = 0;
-    memory[3] = 0;
-    memory[4] = 99;
+    int64_t memory[]   = {1, 1, 1, 4, 99, 5, 6, 0, 99};
+    int64_t solution[] = {30, 1, 1, 4, 2, 5, 6, 0, 99};
+
+    intcode_t* prog = create(memory, 9);
+    int ret         = execute(prog);
 
-    int solution[nums];
-    solution[0] = 2;
-    solution[1] = 0;
-    solution[2] = 0;
-    solution[3] = 0;
-    solution[4] = 99;
+    ASSERT_EQ(ret, INT_CODE_HALT);
+    for (int i = 0; i < 9; ++i)
+    {
+        ASSERT_EQ(get_mem_value(prog, i), solution[i]);
+    }
+    destroy_intcode(prog);
+}
 
-    intcode_t prog;
-    prog.memory      = memory;
-    prog.head        = 0;
-    prog.memory_size = nums;
+TEST_P(intcode_test, execute_test_05)
+{
+    int64_t memory[]   = {1001, 0, 1, 0, 99};
+    int64_t solution[] = {1002, 0, 1, 0, 99};
 
-    int ret = execute(&prog);
+    intcode_t* prog = create(memory, 5);
+    int ret         = execute(prog);
 
-    ASSERT_EQ(ret, 1);
-    for (int i = 0; i < nums; ++i)
+    ASSERT_EQ(ret, INT_CODE_HALT);
+    for (int i = 0; i < 5; ++i)
     {
-        ASSERT_EQ(prog.memory[i], solution[i]);
+        ASSERT_EQ(get_mem_value(prog, i), solution[i]);
     }
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_test_prog_01_01)
+{
+    // consider whether the input is equal to 8;
+    // output 1 (if it is) or 0 (if it is not).
+    int64_t memory[] = {3, 9, 8, 9, 10, 9, 4, 9, 99, -1, 8};
+    intcode_t* prog  = create(memory, 11);
+    ASSERT_TRUE(prog != NULL);
+
+    ASSERT_EQ(run_with_input(prog, "test/test_input_1.txt"), "0\n");
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_test_prog_01_02)
+{
+    int64_t memory[] = {3, 9, 8, 9, 10, 9, 4, 9, 99, -1, 8};
+    intcode_t* prog  = create(memory, 11);
+    ASSERT_TRUE(prog != NULL);
+
+    ASSERT_EQ(run_with_input(prog, "test/test_input_8.txt"), "1\n");
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_test_prog_01_03)
+{
+    int64_t memory[] = {3, 9, 8, 9, 10, 9, 4, 9, 99, -1, 8};
+    intcode_t* prog  = create(memory, 11);
+    ASSERT_TRUE(prog != NULL);
+
+    ASSERT_EQ(run_with_input(prog, "test/test_input_10.txt"), "0\n");
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_output_large_number_01)
+{
+    // Output large number
+    int64_t memory[] = {104, 1125899906842624, 99};
+    intcode_t* prog  = create(memory, 3);
+
+    testing::internal::CaptureStdout();
+    int ret            = execute(prog);
+    std::string output = testing::internal::GetCapturedStdout();
+
+    ASSERT_EQ(ret, INT_CODE_HALT);
+    ASSERT_EQ(output, "1125899906842624\n");
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_output_large_number_02)
+{
+    // Output large number (34915192 ** 2)
+    int64_t memory[] = {1102, 34915192, 34915192, 7, 4, 7, 99, 0};
+    intcode_t* prog  = create(memory, 8);
+
+    testing::internal::CaptureStdout();
+    int ret            = execute(prog);
+    std::string output = testing::internal::GetCapturedStdout();
+
+    ASSERT_EQ(ret, INT_CODE_HALT);
+    ASSERT_EQ(output, "1219070632396864\n");
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_larger_memory_01)
+{
+    // Outputs itself
+    int64_t memory[] = {109, 1, 204, -1, 1001, 100, 1, 100, 1008, 100, 16, 101, 1006, 101, 0, 99};
+    intcode_t* prog  = create(memory, 16);
+
+    testing::internal::CaptureStdout();
+    int ret            = execute(prog);
+    std::string output = testing::internal::GetCapturedStdout();
+
+    ASSERT_EQ(ret, INT_CODE_HALT);
+    ASSERT_EQ(output, "109\n1\n204\n-1\n1001\n100\n1\n100\n1008\n100\n16\n101\n1006\n101\n0\n99\n");
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_invalid_opcode_01)
+{
+    int64_t memory[] = {1101, 1, 2, 5, 99, 0};
+    intcode_t* prog  = create(memory, 6);
+
+    /*Overwrites the halt instruction with an invalid opcode.*/
+    set_mem_value(prog, 4, 42);
+    int ret = execute(prog);
+
+    ASSERT_EQ(ret, INT_CODE_ERROR);
+    ASSERT_EQ(get_mem_value(prog, 5), 3);
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_self_modifying_01)
+{
+    // Output 1, overwrite the output instruction with a halt and jump back to it.
+    int64_t memory[] = {104, 1, 1101, 0, 99, 0, 1105, 1, 0};
+    intcode_t* prog  = create(memory, 9);
+
+    testing::internal::CaptureStdout();
+    int ret            = execute(prog);
+    std::string output = testing::internal::GetCapturedStdout();
+
+    ASSERT_EQ(ret, INT_CODE_HALT);
+    ASSERT_EQ(output, "1\n");
+    ASSERT_EQ(get_mem_value(prog, 0), 99);
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_self_modifying_02)
+{
+    // Copies the counter into the immediate operand of the next instruction, five times.
+    int64_t memory[] = {1001, 30, 1, 30, 1001, 30, 0, 10, 1101, 0, 0, 31, 1007, 30, 5, 32,
+                        1005, 32, 0,  4,  31,   99, 0, 0,  0,    0, 0, 0,  0,    0, 0, 0, 0};
+    intcode_t* prog  = create(memory, 33);
+
+    testing::internal::CaptureStdout();
+    int ret            = execute(prog);
+    std::string output = testing::internal::GetCapturedStdout();
+
+    ASSERT_EQ(ret, INT_CODE_HALT);
+    ASSERT_EQ(output, "5\n");
+    ASSERT_EQ(get_mem_value(prog, 10), 5);
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_self_modifying_03)
+{
+    /*The comparison overwrites the condition operand of the jump after it, then the counter*/
+    /*the target of the jump after it. Both jumps have to see the new values.*/
+    int64_t memory[] = {1107, 2,  1,    5, 1005, 5,  8,   99, 1001, 14,
+                        1,    14, 1105, 1, 15,   99, 104, 1,  99};
+    intcode_t* prog  = create(memory, 19);
+
+    testing::internal::CaptureStdout();
+    int ret            = execute(prog);
+    std::string output = testing::internal::GetCapturedStdout();
+
+    ASSERT_EQ(ret, INT_CODE_HALT);
+    ASSERT_EQ(output, "1\n");
+    ASSERT_EQ(get_mem_value(prog, 5), 0);
+    ASSERT_EQ(get_mem_value(prog, 14), 16);
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_self_modifying_04)
+{
+    /*The store overwrites the adjustment of the relative base right after it, which the*/
+    /*compiled engine folds into the following closures.*/
+    int64_t memory[] = {1101, 0, 7, 5, 109, 1, 204, 2, 99, 42};
+    intcode_t* prog  = create(memory, 10);
+
+    testing::internal::CaptureStdout();
+    int ret            = execute(prog);
+    std::string output = testing::internal::GetCapturedStdout();
+
+    ASSERT_EQ(ret, INT_CODE_HALT);
+    ASSERT_EQ(output, "42\n");
+    ASSERT_EQ(prog->relative_base, 7);
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_head_block_01)
+{
+    int64_t memory[] = {1002, 4, 3, 4, 33};
+    intcode_t* prog  = create(memory, 5);
+    int op_code      = 0;
+
+    ASSERT_EQ(execute_head_block(prog, &op_code), INT_CODE_CONTINUE);
+    ASSERT_EQ(op_code, 2);
+    ASSERT_EQ(execute_head_block(prog, &op_code), INT_CODE_HALT);
+    ASSERT_EQ(op_code, 99);
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_invalid_parameter_mode_01)
+{
+    int64_t memory[] = {30001, 0, 0, 0, 99};
+    intcode_t* prog  = create(memory, 5);
+
+    ASSERT_EQ(execute(prog), INT_CODE_ERROR);
+    ASSERT_EQ(prog->head, 0);
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_relative_base_01)
+{
+    // Relative base is kept across instructions and written back on halt.
+    int64_t memory[] = {109, 7, 21101, 2, 3, 0, 99, 0};
+    intcode_t* prog  = create(memory, 8);
+
+    ASSERT_EQ(execute(prog), INT_CODE_HALT);
+    ASSERT_EQ(prog->relative_base, 7);
+    ASSERT_EQ(prog->head, 6);
+    ASSERT_EQ(get_mem_value(prog, 7), 5);
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_sparse_memory_01)
+{
+    // Store 5 far outside of the program image and read it back.
+    int64_t memory[] = {1101, 2, 3, 1000000000, 4, 1000000000, 99};
+    intcode_t* prog  = create(memory, 7);
+
+    testing::internal::CaptureStdout();
+    int ret            = execute(prog);
+    std::string output = testing::internal::GetCapturedStdout();
+
+    ASSERT_EQ(ret, INT_CODE_HALT);
+    ASSERT_EQ(output, "5\n");
+    ASSERT_EQ(get_mem_value(prog, 1000000000), 5);
+    ASSERT_EQ(get_mem_value(prog, 999999999), 0);
+    ASSERT_EQ(prog->memory_size, 1000000001u);
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_negative_address_01)
+{
+    // Relative base of -5 turns the read address negative.
+    int64_t memory[] = {109, -5, 204, 0, 99};
+    intcode_t* prog  = create(memory, 5);
+
+    ASSERT_EQ(execute(prog), INT_CODE_ERROR);
+    ASSERT_EQ(prog->head, 2);
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, execute_negative_address_02)
+{
+    // Immediate mode store to a negative address.
+    int64_t memory[] = {11101, 7, 8, -3, 99};
+    intcode_t* prog  = create(memory, 5);
+
+    ASSERT_EQ(execute(prog), INT_CODE_ERROR);
+    ASSERT_EQ(prog->head, 0);
+    ASSERT_EQ(prog->memory_size, 5u);
+    ASSERT_FALSE(set_mem_value(prog, (size_t) -1, 1));
+    ASSERT_FALSE(set_mem_value(prog, (size_t) INT64_MAX, 1));
+    ASSERT_EQ(prog->memory_size, 5u);
+    destroy_intcode(prog);
+}
+
+TEST_P(intcode_test, fork_copy_on_write_01)
+{
+    // Counts cell 12 up to 3, the fork continues from the parent's state.
+    int64_t memory[] = {1001, 12, 1, 12, 1007, 12, 3, 13, 1005, 13, 0, 99, 0, 0};
+    intcode_t* prog  = create(memory, 14);
+    int op_code      = 0;
+
+    ASSERT_EQ(execute_head_block(prog, &op_code), INT_CODE_CONTINUE);
+    ASSERT_EQ(get_mem_value(prog, 12), 1);
+
+    intcode_t* fork = fork_intcode(prog);
+    ASSERT_TRUE(fork != NULL);
+    ASSERT_EQ(fork->head, prog->head);
+    ASSERT_EQ(fork->engine, prog->engine);
+
+    /*Writes of the parent are not visible in the fork and vice versa.*/
+    set_mem_value(prog, 12, 100);
+    ASSERT_EQ(get_mem_value(fork, 12), 1);
+    set_mem_value(fork, 3, 11);
+    ASSERT_EQ(get_mem_value(prog, 3), 12);
+    set_mem_value(fork, 3, 12);
+
+    destroy_intcode(prog);
+    ASSERT_EQ(execute(fork), INT_CODE_HALT);
+    ASSERT_EQ(get_mem_value(fork, 12), 3);
+    destroy_intcode(fork);
+}
+
+TEST_P(intcode_test, fork_self_modifying_01)
+{
+    // Forks share the decode cache of the parent until they overwrite code.
+    int64_t memory[]  = {104, 1, 1101, 0, 99, 0, 1105, 1, 0};
+    intcode_t* parent = create(memory, 9);
+    intcode_t* first  = fork_intcode(parent);
+    intcode_t* second = fork_intcode(parent);
+
+    testing::internal::CaptureStdout();
+    ASSERT_EQ(execute(first), INT_CODE_HALT);
+    ASSERT_EQ(execute(second), INT_CODE_HALT);
+    std::string output = testing::internal::GetCapturedStdout();
+
+    ASSERT_EQ(output, "1\n1\n");
+    ASSERT_EQ(get_mem_value(parent, 0), 104);
+    destroy_intcode(first);
+    destroy_intcode(second);
+    destroy_intcode(parent);
 }
 
-TEST_F(intcode_test, execute_test_02)
+TEST_P(intcode_test, fork_while_running_01)
 {
-    size_t nums = 5;
-    int memory[nums];
-    memory[0] = 2;
-    memory[1] = 3;
-    memory[2] = 0;
-    memory[3] = 3;
-    memory[4] = 99;
+    // Counts cell 20 up once per input, until the input is 0.
+    int64_t memory[]          = {1001, 20, 1, 20, 3, 21, 1005, 21, 0, 99, 0, 0, 0, 0, 0,
+                                 0,    0,  0, 0,  0, 0, 0};
+    intcode_t* prog           = create(memory, 22);
+    intcode_io_ring_t* input  = create_io_ring(4);
+    intcode_io_ring_t* output = create_io_ring(4);
+    set_io_mode(prog, INT_CODE_RING_IO);
+    set_io_yield(prog, 1);
+    set_ring_io_in(prog, input);
+    set_ring_io_out(prog, output);
 
-    int solution[nums];
-    solution[0] = 2;
-    solution[1] = 3;
-    solution[2] = 0;
-    solution[3] = 6;
-    solution[4] = 99;
+    int64_t value = 1;
+    io_ring_try_write(input, &value, 1);
+    ASSERT_EQ(execute(prog), INT_CODE_BLOCKED);
+    ASSERT_EQ(get_mem_value(prog, 20), 2);
 
-    intcode_t prog;
-    prog.memory      = memory;
-    prog.head        = 0;
-    prog.memory_size = nums;
+    /*The parent keeps running on pages it now shares with the fork.*/
+    intcode_t* fork             = fork_intcode(prog);
+    intcode_io_ring_t* fork_in  = create_io_ring(4);
+    intcode_io_ring_t* fork_out = create_io_ring(4);
+    set_ring_io_in(fork, fork_in);
+    set_ring_io_out(fork, fork_out);
+    int64_t values[] = {1, 0};
+    io_ring_try_write(input, values, 2);
+    ASSERT_EQ(execute(prog), INT_CODE_HALT);
+    ASSERT_EQ(get_mem_value(prog, 20), 3);
+    ASSERT_EQ(get_mem_value(fork, 20), 2);
 
-    int ret = execute(&prog);
+    io_ring_try_write(fork_in, &values[1], 1);
+    ASSERT_EQ(execute(fork), INT_CODE_HALT);
+    ASSERT_EQ(get_mem_value(fork, 20), 2);
+    destroy_intcode(prog);
+    destroy_intcode(fork);
+    destroy_io_ring(input);
+    destroy_io_ring(output);
+    destroy_io_ring(fork_in);
+    destroy_io_ring(fork_out);
+}
+
+TEST_P(intcode_test, copy_intcode_01)
+{
+    int64_t memory[] = {109, 7, 21101, 2, 3, 0, 99, 0};
+    intcode_t* prog  = create(memory, 8);
+    ASSERT_EQ(execute(prog), INT_CODE_HALT);
+
+    /*A copy has the same memory but starts from the beginning.*/
+    intcode_t* copy = copy_intcode(prog);
+    ASSERT_EQ(copy->head, 0);
+    ASSERT_EQ(copy->relative_base, 0);
+    ASSERT_EQ(copy->memory_size, prog->memory_size);
+    ASSERT_EQ(get_mem_value(copy, 7), 5);
+    destroy_intcode(prog);
+    destroy_intcode(copy);
+}
+
+TEST_P(intcode_test, snapshot_restore_01)
+{
+    // Counts cell 12 up to 3, the machine is taken back to the first count.
+    int64_t memory[] = {1001, 12, 1, 12, 1007, 12, 3, 13, 1005, 13, 0, 99, 0, 0};
+    intcode_t* prog  = create(memory, 14);
+    int op_code      = 0;
+
+    ASSERT_EQ(execute_head_block(prog, &op_code), INT_CODE_CONTINUE);
+    intcode_snapshot_t* snapshot = snapshot_intcode(prog);
+    ASSERT_TRUE(snapshot != NULL);
+    size_t head = prog->head;
+
+    ASSERT_EQ(execute(prog), INT_CODE_HALT);
+    ASSERT_EQ(get_mem_value(prog, 12), 3);
+
+    ASSERT_TRUE(restore_intcode(prog, snapshot));
+    ASSERT_EQ(prog->head, head);
+    ASSERT_EQ(get_mem_value(prog, 12), 1);
+    ASSERT_EQ(execute(prog), INT_CODE_HALT);
+    ASSERT_EQ(get_mem_value(prog, 12), 3);
+
+    /*The snapshot is not affected by the machines restored from it.*/
+    intcode_t* clone = clone_snapshot(snapshot);
+    ASSERT_EQ(get_mem_value(clone, 12), 1);
+    ASSERT_EQ(execute(clone), INT_CODE_HALT);
+    ASSERT_EQ(get_mem_value(clone, 12), 3);
+
+    destroy_snapshot(snapshot);
+    destroy_intcode(prog);
+    destroy_intcode(clone);
+}
 
-    ASSERT_EQ(ret, 1);
-    for (int i = 0; i < nums; ++i)
+TEST_P(intcode_test, snapshot_hash_01)
+{
+    int64_t memory[] = {1001, 12, 1, 12, 1007, 12, 3, 13, 1005, 13, 0, 99, 0, 0};
+    intcode_t* prog  = create(memory, 14);
+    intcode_t* other = fork_intcode(prog);
+    ASSERT_EQ(execute(prog), INT_CODE_HALT);
+
+    /*The same state reached by writes instead of running.*/
+    set_mem_value(other, 12, 3);
+    set_mem_value(other, 13, 0);
+    other->head = prog->head;
+    ASSERT_EQ(hash_intcode(other), hash_intcode(prog));
+
+    /*Zeros written far away read like untouched memory.*/
+    set_mem_value(other, 1u << 30, 0);
+    intcode_snapshot_t* first  = snapshot_intcode(prog);
+    intcode_snapshot_t* second = snapshot_intcode(other);
+    ASSERT_EQ(get_snapshot_hash(first), hash_intcode(prog));
+    ASSERT_EQ(get_snapshot_hash(first), get_snapshot_hash(second));
+    ASSERT_TRUE(snapshots_equal(first, second));
+    destroy_snapshot(second);
+
+    set_mem_value(other, 1u << 30, 1);
+    second = snapshot_intcode(other);
+    ASSERT_NE(get_snapshot_hash(first), get_snapshot_hash(second));
+    ASSERT_FALSE(snapshots_equal(first, second));
+    destroy_snapshot(second);
+
+    set_mem_value(other, 1u << 30, 0);
+    other->relative_base = 1;
+    second = snapshot_intcode(other);
+    ASSERT_FALSE(snapshots_equal(first, second));
+
+    destroy_snapshot(first);
+    destroy_snapshot(second);
+    destroy_intcode(prog);
+    destroy_intcode(other);
+}
+
+TEST_P(intcode_test, execute_ring_io_01)
+{
+    /*Reads a count, then doubles that many values.*/
+    int64_t memory[] = {3,   100,  1006, 100, 20, 3,   101,  1002, 101, 2, 101,
+                        4,   101,  1001, 100, -1, 100, 1105, 1,    2,   99};
+    const size_t num_values        = 1000;
+    intcode_t* prog                = create(memory, 21);
+    intcode_io_ring_t* input_ring  = create_io_ring(8);
+    intcode_io_ring_t* output_ring = create_io_ring(8);
+    set_io_mode(prog, INT_CODE_RING_IO);
+    set_ring_io_in(prog, input_ring);
+    set_ring_io_out(prog, output_ring);
+
+    int ret = INT_CODE_ERROR;
+    std::thread machine([&]() { ret = execute(prog); });
+
+    /*Both rings are much smaller than the stream, so both sides have to block.*/
+    std::vector<int64_t> input(num_values + 1);
+    input[0] = num_values;
+    for (size_t i = 1; i <= num_values; ++i)
     {
-        ASSERT_EQ(prog.memory[i], solution[i]);
+        input[i] = i;
     }
+    std::vector<int64_t> output(num_values);
+    std::thread host([&]() { io_ring_write(input_ring, input.data(), input.size()); });
+    ASSERT_EQ(io_ring_read(output_ring, output.data(), num_values), num_values);
+    host.join();
+    machine.join();
+
+    ASSERT_EQ(ret, INT_CODE_HALT);
+    for (size_t i = 0; i < num_values; ++i)
+    {
+        ASSERT_EQ(output[i], 2 * (i + 1));
+    }
+    destroy_intcode(prog);
+    destroy_io_ring(input_ring);
+    destroy_io_ring(output_ring);
 }
 
-TEST_F(intcode_test, execute_test_03)
+TEST_P(intcode_test, execute_ring_io_closed_01)
 {
-    size_t nums = 6;
-    int memory[nums];
-    memory[0] = 2;
-    memory[1] = 4;
-    memory[2] = 4;
-    memory[3] = 5;
-    memory[4] = 99;
-    memory[5] = 0;
-
-    int solution[nums];
-    solution[0] = 2;
-    solution[1] = 4;
-    solution[2] = 4;
-    solution[3] = 5;
-    solution[4] = 99;
-    solution[5] = 9801;
+    int64_t memory[]              = {3, 5, 4, 5, 99, 0};
+    intcode_t* prog               = create(memory, 6);
+    intcode_io_ring_t* input_ring = create_io_ring(4);
+    set_io_mode(prog, INT_CODE_RING_IO);
+    set_ring_io_in(prog, input_ring);
 
-    intcode_t prog;
-    prog.memory      = memory;
-    prog.head        = 0;
-    prog.memory_size = nums;
+    /*Reading from a closed and empty ring fails instead of blocking forever.*/
+    close_io_ring(input_ring);
+    ASSERT_EQ(execute(prog), INT_CODE_ERROR);
+    ASSERT_EQ(prog->head, 0);
+    destroy_intcode(prog);
+    destroy_io_ring(input_ring);
+}
 
-    int ret = execute(&prog);
+TEST(intcode_io_ring_test, batch_wrap_around_01)
+{
+    int64_t values[]        = {1, 2, 3, 4, 5, 6};
+    int64_t read[6]         = {0};
+    intcode_io_ring_t* ring = create_io_ring(3);
 
-    ASSERT_EQ(ret, 1);
-    for (int i = 0; i < nums; ++i)
+    /*The capacity is rounded up to 4.*/
+    ASSERT_EQ(io_ring_try_write(ring, values, 6), 4);
+    ASSERT_EQ(io_ring_size(ring), 4);
+    ASSERT_EQ(io_ring_try_read(ring, read, 3), 3);
+    ASSERT_EQ(io_ring_try_write(ring, values + 4, 2), 2);
+    ASSERT_EQ(io_ring_try_read(ring, read + 3, 6), 3);
+    for (size_t i = 0; i < 6; ++i)
     {
-        ASSERT_EQ(prog.memory[i], solution[i]);
+        ASSERT_EQ(read[i], values[i]);
     }
+    ASSERT_EQ(io_ring_try_read(ring, read, 1), 0);
+
+    /*Remaining values can be read after closing, then reads return nothing.*/
+    io_ring_try_write(ring, values, 2);
+    close_io_ring(ring);
+    ASSERT_EQ(io_ring_read(ring, read, 4), 2);
+    ASSERT_EQ(io_ring_read(ring, read, 1), 0);
+    destroy_io_ring(ring);
 }
 
-TEST_F(intcode_test, execute_test_04)
-{
-    size_t nums = 9;
-    int memory[nums];
-    memory[0] = 1;
-    memory[1] = 1;
-    memory[2] = 1;
-    memory[3] = 4;
-    memory[4] = 99;
-    memory[5] = 5;
-    memory[6] = 6;
-    memory[7] = 0;
-    memory[8] = 99;
-
-    int solution[nums];
-    solution[0] = 30;
-    solution[1] = 1;
-    solution[2] = 1;
-    solution[3] = 4;
-    solution[4] = 2;
-    solution[5] = 5;
-    solution[6] = 6;
-    solution[7] = 0;
-    solution[8] = 99;
-
-    intcode_t prog;
-    prog.memory      = memory;
-    prog.head        = 0;
-    prog.memory_size = nums;
-
-    int ret = execute(&prog);
-
-    ASSERT_EQ(ret, 1);
-    for (int i = 0; i < nums; ++i)
+TEST_P(intcode_test, profile_01)
+{
+    /*Counts down from 3 in a loop, then writes beyond the end of memory and halts.*/
+    int64_t memory[] = {1101, 0, 3, 20, 1001, 20, -1, 20, 1005, 20, 4, 1101, 0, 7, 5000, 99};
+    intcode_t* prog  = create(memory, 16);
+    FILE* report     = tmpfile();
+    ASSERT_TRUE(enable_profiling(prog, report));
+    ASSERT_EQ(execute(prog), INT_CODE_HALT);
+
+    const intcode_profile_t* profile = get_profile(prog);
+    ASSERT_TRUE(profile != NULL);
+    ASSERT_EQ(profile->instructions, 9);
+    ASSERT_EQ(profile->op_counts[1], 5);
+    ASSERT_EQ(profile->op_counts[5], 3);
+    ASSERT_EQ(profile->op_counts[99], 1);
+    ASSERT_EQ(profile->address_counts[0], 1);
+    ASSERT_EQ(profile->address_counts[4], 3);
+    ASSERT_EQ(profile->address_counts[8], 3);
+
+    /*Cell 20 and cell 5000 are both new, only the second needs another page.*/
+    ASSERT_EQ(profile->memory_growths, 2);
+    ASSERT_EQ(profile->page_allocations, 1);
+
+    /*The report is written at halt, the loop is the hottest part.*/
+    char line[128];
+    rewind(report);
+    ASSERT_TRUE(fgets(line, sizeof(line), report) != NULL);
+    ASSERT_STREQ(line, "Intcode profile\n");
+    std::string text;
+    while (fgets(line, sizeof(line), report) != NULL)
     {
-        ASSERT_EQ(prog.memory[i], solution[i]);
+        text += line;
     }
+    ASSERT_NE(text.find("9 instructions"), std::string::npos);
+    ASSERT_NE(text.find("       4              3"), std::string::npos);
+    fclose(report);
+    destroy_intcode(prog);
 }
 
-TEST_F(intcode_test, execute_test_05)
+TEST_P(intcode_test, profile_io_01)
 {
-    size_t nums = 5;
-    int memory[nums];
-    memory[0] = 1001;
-    memory[1] = 0;
-    memory[2] = 1;
-    memory[3] = 0;
-    memory[4] = 99;
+    int64_t memory[]          = {3, 9, 1002, 9, 2, 9, 4, 9, 99, 0};
+    intcode_t* prog           = create(memory, 10);
+    intcode_io_ring_t* input  = create_io_ring(2);
+    intcode_io_ring_t* output = create_io_ring(2);
+    set_io_mode(prog, INT_CODE_RING_IO);
+    set_ring_io_in(prog, input);
+    set_ring_io_out(prog, output);
+    set_io_yield(prog, 1);
+    ASSERT_TRUE(enable_profiling(prog, NULL));
+
+    /*The blocked input is not counted as executed.*/
+    ASSERT_EQ(execute(prog), INT_CODE_BLOCKED);
+    ASSERT_EQ(get_profile(prog)->instructions, 0);
+    ASSERT_EQ(get_profile(prog)->num_blocked, 1);
+
+    int64_t value = 4;
+    io_ring_try_write(input, &value, 1);
+    ASSERT_EQ(execute(prog), INT_CODE_HALT);
+    ASSERT_EQ(get_profile(prog)->instructions, 4);
+    ASSERT_EQ(get_profile(prog)->op_counts[3], 1);
+    ASSERT_EQ(get_profile(prog)->op_counts[4], 1);
+    ASSERT_GT(get_profile(prog)->input_ns, 0);
+    ASSERT_EQ(io_ring_try_read(output, &value, 1), 1);
+    ASSERT_EQ(value, 8);
+
+    /*Forks start without a profile.*/
+    intcode_t* fork = fork_intcode(prog);
+    ASSERT_TRUE(get_profile(fork) == NULL);
+    destroy_intcode(fork);
+    destroy_intcode(prog);
+    destroy_io_ring(input);
+    destroy_io_ring(output);
+}
 
-    int solution[nums];
-    solution[0] = 1002;
-    solution[1] = 0;
-    solution[2] = 1;
-    solution[3] = 0;
-    solution[4] = 99;
+TEST_P(intcode_test, fusion_stats_01)
+{
+    /*Counts down from 5 until the counter is below 3, with a call frame set up on the way.*/
+    /*The counter is at 60, the call frame at 50 and 51.*/
+    int64_t memory[64] = {109, 50,   1101, 0,  5,    60, 21101, 7,  0,    0,   109, 1,    21201, -1,
+                          3,   0,    109,  -1, 1007, 60, 3,     61, 1005, 61,  35,  1001, 60,    -1,
+                          60,  1006, 60,   35, 1105, 1,  6,     4,  60,   204, 1,   99};
+    intcode_t* prog    = create(memory, 64);
+    ASSERT_TRUE(get_fusion_stats(prog) == NULL);
+    ASSERT_TRUE(enable_fusion_stats(prog));
 
-    intcode_t prog;
-    prog.memory      = memory;
-    prog.head        = 0;
-    prog.memory_size = nums;
+    testing::internal::CaptureStdout();
+    int ret            = execute(prog);
+    std::string output = testing::internal::GetCapturedStdout();
+    ASSERT_EQ(ret, INT_CODE_HALT);
+    ASSERT_EQ(output, "2\n10\n");
+    ASSERT_EQ(prog->relative_base, 50);
 
-    int ret = execute(&prog);
+    /*Only the compiled engine fuses instructions.*/
+    const intcode_fusion_stats_t* stats = get_fusion_stats(prog);
+    ASSERT_TRUE(stats != NULL);
+    int compiled = (GetParam() == INT_CODE_ENGINE_COMPILED);
+    ASSERT_EQ(stats->fired[INT_CODE_FUSION_REL_BASE], compiled ? 9u : 0u);
+    ASSERT_EQ(stats->fired[INT_CODE_FUSION_COMPARE_JUMP], compiled ? 4u : 0u);
+    ASSERT_EQ(stats->fired[INT_CODE_FUSION_COUNTER_JUMP], compiled ? 3u : 0u);
 
-    ASSERT_EQ(ret, 1);
-    for (int i = 0; i < nums; ++i)
+    FILE* report = tmpfile();
+    print_fusion_stats(prog, report);
+    char line[128];
+    rewind(report);
+    ASSERT_TRUE(fgets(line, sizeof(line), report) != NULL);
+    ASSERT_STREQ(line, "Intcode fusions\n");
+    std::string text;
+    while (fgets(line, sizeof(line), report) != NULL)
     {
-        ASSERT_EQ(prog.memory[i], solution[i]);
+        text += line;
     }
+    ASSERT_NE(text.find(compiled ? "16 dispatches saved" : "0 dispatches saved"),
+              std::string::npos);
+    fclose(report);
+
+    /*Forks start without fusion stats.*/
+    intcode_t* fork = fork_intcode(prog);
+    ASSERT_TRUE(get_fusion_stats(fork) == NULL);
+    destroy_intcode(fork);
+    destroy_intcode(prog);
 }
 
-TEST_F(intcode_test, execute_test_prog_01_01)
+TEST_P(intcode_test, record_replay_01)
 {
-    size_t nums = 11;
+    /*Reads a count, then doubles that many values.*/
+    int64_t memory[] = {3,   100,  1006, 100, 20, 3,   101,  1002, 101, 2, 101,
+                        4,   101,  1001, 100, -1, 100, 1105, 1,    2,   99};
+    int64_t input[]  = {5, 1, 2, 3, 4, 5};
+    char path[]      = "/tmp/intcode_recording_XXXXXX";
+    int fd           = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
 
-    // consider whether the input is equal to 8;
-    // output 1 (if it is) or 0 (if it is not).
-    int memory[nums]      = {3, 9, 8, 9, 10, 9, 4, 9, 99, -1, 8};
-    intcode_t prog;
-    prog.memory      = memory;
-    prog.head        = 0;
-    prog.memory_size = nums;
+    /*Every machine gets its input up front, so nothing blocks.*/
+    auto start = [&](intcode_t* prog, intcode_io_ring_t* in, intcode_io_ring_t* out) {
+        io_ring_try_write(in, input, 6);
+        set_io_mode(prog, INT_CODE_RING_IO);
+        set_ring_io_in(prog, in);
+        set_ring_io_out(prog, out);
+    };
+    intcode_t* prog                = create(memory, 21);
+    intcode_io_ring_t* input_ring  = create_io_ring(8);
+    intcode_io_ring_t* output_ring = create_io_ring(8);
+    start(prog, input_ring, output_ring);
+    ASSERT_TRUE(start_recording(prog, path, 7));
+    ASSERT_EQ(execute(prog), INT_CODE_HALT);
+    uint64_t total = get_instruction_count(prog);
+    ASSERT_TRUE(stop_recording(prog));
+    ASSERT_EQ(total, 32);
 
-    std::string file_path = "test/test_input_1.txt";
-    std::string solution = "Input: Output: 0\n";
+    intcode_recording_t* recording = load_recording(path);
+    unlink(path);
+    ASSERT_TRUE(recording != NULL);
+    size_t num_events                = 0;
+    const intcode_io_event_t* events = get_recorded_events(recording, &num_events);
+    ASSERT_EQ(num_events, 11);
+    ASSERT_EQ(events[0].instruction, 0);
+    ASSERT_EQ(events[0].value, 5);
+    for (size_t i = 1; i < num_events; ++i)
+    {
+        ASSERT_EQ(events[i].is_output, (i % 2) == 0);
+        ASSERT_EQ(events[i].value, (i % 2) ? input[(i + 1) / 2] : 2 * input[i / 2]);
+        ASSERT_GT(events[i].instruction, events[i - 1].instruction);
+    }
 
-    testing::internal::CaptureStdout();
-    if (freopen(file_path.c_str(), "r", stdin) != NULL)
+    /*Seeking to an instruction gives the same machine as stepping there from the start.*/
+    for (uint64_t instruction : {0, 6, 7, 13, 20, 32})
     {
-        int ret            = execute(&prog);
-        std::string output = testing::internal::GetCapturedStdout();
+        intcode_t* replay = replay_intcode(recording, instruction);
+        ASSERT_TRUE(replay != NULL);
+        ASSERT_EQ(get_instruction_count(replay), instruction);
+
+        intcode_t* reference             = create(memory, 21);
+        intcode_io_ring_t* reference_in  = create_io_ring(8);
+        intcode_io_ring_t* reference_out = create_io_ring(8);
+        start(reference, reference_in, reference_out);
+        for (uint64_t i = 0; i < instruction; ++i)
+        {
+            int op_code = 0;
+            ASSERT_EQ(execute_head_block(reference, &op_code), INT_CODE_CONTINUE);
+        }
+        ASSERT_EQ(replay->head, reference->head);
+        ASSERT_EQ(replay->relative_base, reference->relative_base);
+        for (size_t address = 0; address < 128; ++address)
+        {
+            ASSERT_EQ(get_mem_value(replay, address), get_mem_value(reference, address));
+        }
 
-        ASSERT_EQ(ret, 1);
-        ASSERT_EQ(output, solution);
+        /*The rest of the session is replayed without any ring or thread.*/
+        ASSERT_EQ(execute(replay), INT_CODE_HALT);
+        ASSERT_EQ(get_instruction_count(replay), total);
+        destroy_intcode(replay);
+        destroy_intcode(reference);
+        destroy_io_ring(reference_in);
+        destroy_io_ring(reference_out);
     }
+    destroy_recording(recording);
+    destroy_intcode(prog);
+    destroy_io_ring(input_ring);
+    destroy_io_ring(output_ring);
 }
 
-TEST_F(intcode_test, execute_test_prog_01_02)
+TEST_P(intcode_test, record_replay_end_01)
 {
-    size_t nums = 11;
+    /*Echoes every input.*/
+    int64_t memory[] = {3, 100, 4, 100, 1105, 1, 0};
+    int64_t input[]  = {7, 8, 9};
+    char path[]      = "/tmp/intcode_recording_XXXXXX";
+    int fd           = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
 
-    // consider whether the input is equal to 8;
-    // output 1 (if it is) or 0 (if it is not).
-    int memory[nums]      = {3, 9, 8, 9, 10, 9, 4, 9, 99, -1, 8};
-    intcode_t prog;
-    prog.memory      = memory;
-    prog.head        = 0;
-    prog.memory_size = nums;
+    intcode_t* prog                = create(memory, 7);
+    intcode_io_ring_t* input_ring  = create_io_ring(4);
+    intcode_io_ring_t* output_ring = create_io_ring(4);
+    set_io_mode(prog, INT_CODE_RING_IO);
+    set_io_yield(prog, 1);
+    set_ring_io_in(prog, input_ring);
+    set_ring_io_out(prog, output_ring);
+    ASSERT_TRUE(start_recording(prog, path, 0));
+    io_ring_try_write(input_ring, input, 3);
+    ASSERT_EQ(execute(prog), INT_CODE_BLOCKED);
+    ASSERT_TRUE(stop_recording(prog));
 
-    std::string file_path = "test/test_input_8.txt";
-    std::string solution = "Input: Output: 1\n";
+    intcode_recording_t* recording = load_recording(path);
+    ASSERT_TRUE(recording != NULL);
+    intcode_t* replay = replay_intcode(recording, UINT64_MAX);
+    ASSERT_TRUE(replay != NULL);
+    ASSERT_EQ(get_instruction_count(replay), 9);
+    ASSERT_EQ(replay->head, 0);
 
-    testing::internal::CaptureStdout();
-    if (freopen(file_path.c_str(), "r", stdin) != NULL)
+    /*Past the end of the recording only a yielding machine can go on, with another IO mode.*/
+    ASSERT_EQ(execute(replay), INT_CODE_ERROR);
+    set_io_yield(replay, 1);
+    ASSERT_EQ(execute(replay), INT_CODE_BLOCKED);
+    int64_t value = 42;
+    io_ring_try_write(input_ring, &value, 1);
+    set_io_mode(replay, INT_CODE_RING_IO);
+    set_ring_io_in(replay, input_ring);
+    set_ring_io_out(replay, output_ring);
+    int64_t output[4] = {0};
+    ASSERT_EQ(io_ring_try_read(output_ring, output, 4), 3);
+    ASSERT_EQ(execute(replay), INT_CODE_BLOCKED);
+    ASSERT_EQ(io_ring_try_read(output_ring, output, 4), 1);
+    ASSERT_EQ(output[0], 42);
+    destroy_intcode(replay);
+    destroy_recording(recording);
+
+    /*A recording that was cut off within a record loses only that record.*/
+    struct stat info;
+    ASSERT_EQ(stat(path, &info), 0);
+    ASSERT_EQ(truncate(path, info.st_size - 5), 0);
+    recording = load_recording(path);
+    unlink(path);
+    ASSERT_TRUE(recording != NULL);
+    size_t num_events = 0;
+    get_recorded_events(recording, &num_events);
+    ASSERT_EQ(num_events, 5);
+    destroy_recording(recording);
+    destroy_intcode(prog);
+    destroy_io_ring(input_ring);
+    destroy_io_ring(output_ring);
+}
+
+TEST_P(intcode_test, batch_divergent_io_01)
+{
+    /*Reads a count, then doubles that many values.*/
+    int64_t memory[] = {3,   100,  1006, 100, 20, 3,   101,  1002, 101, 2, 101,
+                        4,   101,  1001, 100, -1, 100, 1105, 1,    2,   99};
+    const size_t num_lanes = 10;
+    intcode_t* prog        = create(memory, 21);
+    intcode_batch_t* batch = create_intcode_batch(prog, num_lanes, 4);
+    ASSERT_TRUE(batch != NULL);
+
+    /*Every lane loops a different number of times and needs more values than its queue holds.*/
+    for (int run = 0; run < 2; ++run)
     {
-        int ret            = execute(&prog);
-        std::string output = testing::internal::GetCapturedStdout();
+        reset_intcode_batch(batch, num_lanes);
+        std::vector<std::vector<int64_t>> input(num_lanes);
+        std::vector<std::vector<int64_t>> output(num_lanes);
+        std::vector<size_t> fed(num_lanes, 0);
+        for (size_t lane = 0; lane < num_lanes; ++lane)
+        {
+            size_t count = lane + (run * 3);
+            input[lane].push_back(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                input[lane].push_back((lane * 100) + i);
+            }
+        }
+        int ret = INT_CODE_BLOCKED;
+        for (int round = 0; (round < 100) && (ret == INT_CODE_BLOCKED); ++round)
+        {
+            for (size_t lane = 0; lane < num_lanes; ++lane)
+            {
+                fed[lane] += intcode_batch_write(batch,
+                                                 lane,
+                                                 input[lane].data() + fed[lane],
+                                                 input[lane].size() - fed[lane]);
+            }
+            ret = execute_intcode_batch(batch);
+            for (size_t lane = 0; lane < num_lanes; ++lane)
+            {
+                int64_t value = 0;
+                while (intcode_batch_read(batch, lane, &value, 1) == 1)
+                {
+                    output[lane].push_back(value);
+                }
+            }
+        }
 
-        ASSERT_EQ(ret, 1);
-        ASSERT_EQ(output, solution);
+        ASSERT_EQ(ret, INT_CODE_HALT);
+        for (size_t lane = 0; lane < num_lanes; ++lane)
+        {
+            ASSERT_EQ(intcode_batch_status(batch, lane), INT_CODE_HALT);
+            ASSERT_EQ(output[lane].size(), input[lane].size() - 1);
+            for (size_t i = 0; i < output[lane].size(); ++i)
+            {
+                ASSERT_EQ(output[lane][i], 2 * input[lane][i + 1]);
+            }
+        }
     }
+    /*The program the batch started from is not touched.*/
+    ASSERT_EQ(get_mem_value(prog, 100), 0);
+    destroy_intcode_batch(batch);
+    destroy_intcode(prog);
 }
 
-TEST_F(intcode_test, execute_test_prog_01_03)
+TEST_P(intcode_test, batch_self_modifying_01)
 {
-    size_t nums = 11;
+    /*Reads the op code and an operand of the instruction at 4, then prints its result.*/
+    int64_t memory[]       = {3, 4, 3, 6, 0, 5, 0, 11, 4, 11, 99, 0};
+    const size_t num_lanes = 7;
+    intcode_t* prog        = create(memory, 12);
+    intcode_batch_t* batch = create_intcode_batch(prog, num_lanes, 2);
+    ASSERT_TRUE(batch != NULL);
 
-    // consider whether the input is equal to 8;
-    // output 1 (if it is) or 0 (if it is not).
-    int memory[nums]      = {3, 9, 8, 9, 10, 9, 4, 9, 99, -1, 8};
-    intcode_t prog;
-    prog.memory      = memory;
-    prog.head        = 0;
-    prog.memory_size = nums;
+    /*Lanes add, multiply or run an invalid op code, each with an operand of its own.*/
+    const int64_t op_codes[] = {1101, 1102, 55};
+    for (size_t lane = 0; lane < num_lanes; ++lane)
+    {
+        int64_t values[] = {op_codes[lane % 3], (int64_t) lane};
+        ASSERT_EQ(intcode_batch_write(batch, lane, values, 2), 2);
+    }
+    ASSERT_EQ(execute_intcode_batch(batch), INT_CODE_ERROR);
+    for (size_t lane = 0; lane < num_lanes; ++lane)
+    {
+        int64_t value = 0;
+        if ((lane % 3) == 2)
+        {
+            ASSERT_EQ(intcode_batch_status(batch, lane), INT_CODE_ERROR);
+            ASSERT_EQ(intcode_batch_read(batch, lane, &value, 1), 0);
+            continue;
+        }
+        ASSERT_EQ(intcode_batch_status(batch, lane), INT_CODE_HALT);
+        ASSERT_EQ(intcode_batch_read(batch, lane, &value, 1), 1);
+        ASSERT_EQ(value, ((lane % 3) == 0) ? (5 + (int64_t) lane) : (5 * (int64_t) lane));
+    }
+    destroy_intcode_batch(batch);
+    destroy_intcode(prog);
+}
 
-    std::string file_path = "test/test_input_10.txt";
-    std::string solution = "Input: Output: 0\n";
+TEST(intcode_loader_test, parse_intcode_01)
+{
+    const std::string text = " 1, -2,3 ,\n9223372036854775807,-9223372036854775808,\n";
+    intcode_t* prog        = parse_intcode(text.c_str(), text.size());
+    ASSERT_TRUE(prog != NULL);
+    ASSERT_EQ(prog->memory_size, 5);
+    ASSERT_EQ(get_mem_value(prog, 0), 1);
+    ASSERT_EQ(get_mem_value(prog, 1), -2);
+    ASSERT_EQ(get_mem_value(prog, 2), 3);
+    ASSERT_EQ(get_mem_value(prog, 3), INT64_MAX);
+    ASSERT_EQ(get_mem_value(prog, 4), INT64_MIN);
+    destroy_intcode(prog);
 
-    testing::internal::CaptureStdout();
-    if (freopen(file_path.c_str(), "r", stdin) != NULL)
+    /*Anything that is not a list of integers is rejected.*/
+    for (const std::string invalid :
+         {"", "\n", "1,,2", "1 2", "1,a", "-", "9223372036854775808", "-9223372036854775809"})
     {
-        int ret            = execute(&prog);
-        std::string output = testing::internal::GetCapturedStdout();
+        ASSERT_TRUE(parse_intcode(invalid.c_str(), invalid.size()) == NULL) << invalid;
+    }
+}
+
+TEST(intcode_loader_test, write_intcode_01)
+{
+    /*More than one page, so the image is copied page by page.*/
+    std::string text;
+    for (int i = 0; i < 1500; ++i)
+    {
+        text += std::to_string((i * 7919) - 5000) + ",";
+    }
+    intcode_t* prog = parse_intcode(text.c_str(), text.size());
+    ASSERT_TRUE(prog != NULL);
 
-        ASSERT_EQ(ret, 1);
-        ASSERT_EQ(output, solution);
+    char path[] = "/tmp/intcode_image_XXXXXX";
+    int fd      = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    ASSERT_TRUE(write_intcode(prog, path));
+
+    intcode_t* loaded = read_intcode(path);
+    unlink(path);
+    ASSERT_TRUE(loaded != NULL);
+    ASSERT_EQ(loaded->memory_size, 1500);
+    for (size_t i = 0; i < 1500; ++i)
+    {
+        ASSERT_EQ(get_mem_value(loaded, i), get_mem_value(prog, i));
     }
+    destroy_intcode(loaded);
+    destroy_intcode(prog);
 }
+
+INSTANTIATE_TEST_SUITE_P(engines,
+                         intcode_test,
+                         ::testing::Values(INT_CODE_ENGINE_STEP,
+                                           INT_CODE_ENGINE_THREADED,
+                                           INT_CODE_ENGINE_COMPILED));
@@ -9,6 +9,7 @@
 #define INCLUDE_CHALLENGE_LIB_H
 
 #include "challenge/intcode.h"
+#include "challenge/intcode_scheduler.h"
 
 typedef enum
 {
@@ -28,6 +29,7 @@ typedef struct
 typedef struct
 {
     intcode_t* brain;
+    intcode_scheduler_t* scheduler;
     Position pos;
     Direction direction;
     int finished;
@@ -48,8 +50,6 @@ void resize_overview(Overview* const overview, const Direction dir);
 void print_overview(const Overview* const overview);
 int count_painted_fields(const Overview* const overview);
 
-/*Thread functions*/
-void* robot_func(void* args);
-void* control_func(void* args);
+void run_robot(Overview* const overview);
 
 #endif /* ifndef INCLUDE_CHALLENGE_LIB_H */
@@ -12,41 +12,21 @@
 #define COLOR_MASK 1
 #define PAINTED_MASK 2
 
-static void provide_input(const Robot* const robot, const int value);
-static int read_output(const Robot* const robot);
-
-void* robot_func(void* args)
-{
-    if (args == NULL)
-    {
-        return NULL;
-    }
-    Robot* robot = (Robot*) args;
-    int ret      = execute(robot->brain);
-    if (ret != INT_CODE_HALT)
-    {
-        printf("Programm did not halt as expected. Err code: %d\n", ret);
-    }
-    else
-    {
-        /*Only writing access*/
-        robot->finished = 1;
-    }
-    return NULL;
-}
-
-void* control_func(void* args)
+/*Runs the brain on the calling thread, it waits for the next color after every move.*/
+void run_robot(Overview* const overview)
 {
-    if (args == NULL)
+    if ((overview == NULL) || (overview->robot == NULL))
     {
-        return NULL;
+        return;
     }
-    Overview* overview = (Overview*) args;
+    Robot* robot = overview->robot;
+    assert(robot->brain != NULL);
+    assert(robot->brain->ring_io_in != NULL);
+    assert(robot->brain->ring_io_out != NULL);
 
-    /*Only reading access*/
-    while (!overview->robot->finished)
+    while (!robot->finished)
     {
-        Position current_pos = overview->robot->pos;
+        Position current_pos = robot->pos;
         if ((current_pos.x < 0) || (current_pos.x >= overview->width) || (current_pos.y < 0) ||
             (current_pos.y >= overview->height))
         {
@@ -64,38 +44,42 @@ void* control_func(void* args)
             {
                 dir = UP;
             }
-            else if (current_pos.y >= overview->height)
+            else
             {
                 dir = DOWN;
             }
             resize_overview(overview, dir);
+            current_pos = robot->pos;
         }
 
-        Direction current_dir = overview->robot->direction;
-        int pos_index         = (current_pos.y * overview->width) + current_pos.x;
-        int color             = overview->hull[pos_index] & COLOR_MASK;
-
-        /*Provide color as input*/
-        provide_input(overview->robot, color);
+        int pos_index = (current_pos.y * overview->width) + current_pos.x;
+        int64_t color = overview->hull[pos_index] & COLOR_MASK;
 
-        /*Read first ouput (color value): 0: black, 1: white, -1: finished*/
-        int new_color = read_output(overview->robot);
-        /*Read second ouput (turn value): 0: turn left, 1: turn_right*/
-        int turn_right = read_output(overview->robot);
+        /*Provide color as input and run the brain until it waits for the next one.*/
+        io_ring_try_write(robot->brain->ring_io_in, &color, 1);
+        int ret = run_scheduler(robot->scheduler);
+        if (ret != INT_CODE_BLOCKED)
+        {
+            if (ret != INT_CODE_HALT)
+            {
+                printf("Programm did not halt as expected. Err code: %d\n", ret);
+            }
+            robot->finished = 1;
+        }
 
-        if (!overview->robot->finished)
+        /*First ouput is the color value (0: black, 1: white), second the turn (0: left, 1: right)*/
+        /*The last move before halting is painted as well.*/
+        int64_t values[2];
+        if (io_ring_try_read(robot->brain->ring_io_out, values, 2) == 2)
         {
             /*Paint current field in the new color*/
-            overview->hull[pos_index] = new_color | PAINTED_MASK;
+            overview->hull[pos_index] = (int) values[0] | PAINTED_MASK;
 
             /*Turn robot into new direction and move one field.*/
-            Direction new_dir          = turn(current_dir, turn_right);
-            overview->robot->direction = new_dir;
-            move(overview->robot);
+            robot->direction = turn(robot->direction, (int) values[1]);
+            move(robot);
         }
     }
-
-    return NULL;
 }
 
 Direction turn(const Direction current, const int command)
@@ -200,48 +184,3 @@ void print_overview(const Overview* const overview)
         }
     }
 }
-
-static void provide_input(const Robot* const robot, const int value)
-{
-    assert(robot != NULL);
-    assert(robot->brain != NULL);
-    assert(robot->brain->mem_io_in != NULL);
-
-    intcode_io_mem_t* input = robot->brain->mem_io_in;
-    pthread_mutex_lock(&input->mut);
-    while (!input->consumed && !robot->finished)
-    {
-        pthread_cond_wait(&input->cond, &input->mut);
-    }
-    input->value    = value;
-    input->consumed = 0;
-    pthread_cond_signal(&input->cond);
-    pthread_mutex_unlock(&input->mut);
-}
-
-static int read_output(const Robot* const robot)
-{
-    assert(robot != NULL);
-    assert(robot->brain != NULL);
-    assert(robot->brain->mem_io_out != NULL);
-
-    int read_value = -1;
-
-    intcode_io_mem_t* output = robot->brain->mem_io_out;
-    pthread_mutex_lock(&output->mut);
-    while (output->consumed && !robot->finished)
-    {
-        pthread_cond_wait(&output->cond, &output->mut);
-    }
-
-    if (!robot->finished)
-    {
-        read_value       = output->value;
-        output->consumed = 1;
-    }
-    pthread_cond_signal(&output->cond);
-    pthread_mutex_unlock(&output->mut);
-
-
-    return read_value;
-}
@@ -7,7 +7,6 @@
 
 #include "challenge/challenge_lib.h"
 #include "challenge/intcode.h"
-#include "pthread.h"
 #include "stdbool.h"
 #include "stdio.h"
 #include "stdlib.h"
@@ -16,6 +15,8 @@
 /*Hull area is resized dynamically*/
 #define INITIAL_HEIGHT 25
 #define INITIAL_WIDTH 25
+/*The brain reads one color and answers with a color and a turn before it reads again.*/
+#define IO_CAPACITY 16
 
 
 int main(int argc, char* argv[])
@@ -27,20 +28,22 @@ int main(int argc, char* argv[])
         return 0;
     }
 
-    /*Initialize the program with IO memory.*/
-    intcode_t* prog          = read_intcode(argv[1]);
-    intcode_io_mem_t* io_in  = create_io_mem();
-    intcode_io_mem_t* io_out = create_io_mem();
-    set_io_mode(prog, INT_CODE_MEM_IO);
-    set_mem_io_in(prog, io_in);
-    set_mem_io_out(prog, io_out);
-
-    if ((prog == NULL) || (io_in == NULL) || (io_out == NULL))
+    /*Initialize the program with IO rings, the robot is run on this thread.*/
+    intcode_t* prog                = read_intcode(argv[1]);
+    intcode_io_ring_t* io_in       = create_io_ring(IO_CAPACITY);
+    intcode_io_ring_t* io_out      = create_io_ring(IO_CAPACITY);
+    intcode_scheduler_t* scheduler = create_scheduler(0);
+    if ((prog == NULL) || (io_in == NULL) || (io_out == NULL) || (scheduler == NULL))
     {
         printf("Error reading programm or allocating IO memory\n");
         return 0;
     }
 
+    set_io_mode(prog, INT_CODE_RING_IO);
+    set_ring_io_in(prog, io_in);
+    set_ring_io_out(prog, io_out);
+    schedule_intcode(scheduler, prog);
+
     /*Setup area, overview and robot with intial size and values.*/
     int* hull          = (int*) calloc(INITIAL_HEIGHT, INITIAL_WIDTH * sizeof(int));
     Robot* robot       = (Robot*) malloc(sizeof(Robot));
@@ -55,6 +58,7 @@ int main(int argc, char* argv[])
     robot->direction      = UP;
     robot->finished       = 0;
     robot->brain          = prog;
+    robot->scheduler      = scheduler;
     robot->pos            = starting_pos;
 
     /*Make starting position white (for Part 2)*/
@@ -65,17 +69,7 @@ int main(int argc, char* argv[])
     overview->hull   = hull;
     overview->robot  = robot;
 
-    /*Start robot and control threads*/
-    pthread_t robot_thread;
-    pthread_create(&robot_thread, NULL, robot_func, robot);
-
-    pthread_t control_thread;
-    pthread_create(&control_thread, NULL, control_func, overview);
-
-
-    /*Wait for threads to finish.*/
-    pthread_join(robot_thread, NULL);
-    pthread_join(control_thread, NULL);
+    run_robot(overview);
 
     /*Print results*/
     int total_painted_once = count_painted_fields(overview);
@@ -85,9 +79,10 @@ int main(int argc, char* argv[])
 
 
     /*Clean up*/
-    destroy_io_mem(io_in);
-    destroy_io_mem(io_out);
+    destroy_scheduler(scheduler);
     destroy_intcode(prog);
+    destroy_io_ring(io_in);
+    destroy_io_ring(io_out);
     if (robot != NULL)
     {
         free(robot);
@@ -9,6 +9,7 @@
 #define INCLUDE_CHALLENGE_LIB_H
 
 #include "challenge/intcode.h"
+#include "challenge/intcode_scheduler.h"
 
 typedef enum
 {
@@ -38,6 +39,7 @@ typedef struct
 typedef struct
 {
     intcode_t* brain;
+    intcode_scheduler_t* scheduler;
     int finished;
 } Engine;
 
@@ -50,9 +52,7 @@ typedef struct
     int score;
 } Game;
 
-/*Thread functions*/
-void* engine_func(void* args);
-void* game_func(void* args);
+void run_game(Game* const game);
 
 Game* create_game(const int height, const int width);
 void destroy_game(Game* const game);
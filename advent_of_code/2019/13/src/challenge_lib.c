@@ -9,86 +9,71 @@
 #include "assert.h"
 #include "stdio.h"
 #include "stdlib.h"
-#include "unistd.h"
 
 #ifdef NCURSES
 #include "ncurses.h"
 #endif
 
 static void resize_game(Game* const game, const Direction dir);
-static void read_tile(const Engine* const engine, Tile* const tile);
-static int read_output(const Engine* const engine);
 static char type_to_char(const TileType type);
 static void send_control_cmd(const Game* const game);
 static int get_x_coord(const Game* const game, const TileType type);
 
 
-void* engine_func(void* args)
+/*Runs the engine on the calling thread and steers the paddle whenever it waits for input.*/
+void run_game(Game* const game)
 {
-    if (args == NULL)
+    if ((game == NULL) || (game->engine == NULL))
     {
-        return NULL;
-    }
-    Engine* engine = (Engine*) args;
-    int ret        = execute(engine->brain);
-    if (ret != INT_CODE_HALT)
-    {
-        printf("Programm did not halt as expected. Err code: %d\n", ret);
-    }
-    else
-    {
-        /*Give game thread time to parse remaining output.*/
-        usleep(1000);
-
-        /*End the game*/
-        engine->finished = 1;
-
-        /*Wake up potentially waiting game thread.*/
-        pthread_cond_signal(&engine->brain->mem_io_out->cond);
-    }
-    return NULL;
-}
-
-void* game_func(void* args)
-{
-    if (args == NULL)
-    {
-        return NULL;
+        return;
     }
-    Game* game = (Game*) args;
+    Engine* engine = game->engine;
+    assert(engine->brain != NULL);
+    assert(engine->brain->ring_io_out != NULL);
 
 #ifdef NCURSES
     initscr();
     curs_set(0);
 #endif
 
-    while (!game->engine->finished)
+    while (!engine->finished)
     {
-        /*Send input if required*/
-        send_control_cmd(game);
-
-        /*Read output*/
-        Tile tile;
-        read_tile(game->engine, &tile);
-        if ((tile.x == -1) && (tile.y == 0))
+        /*Either the engine waits for input, the output ring is full or the game is over.*/
+        int ret = run_scheduler(engine->scheduler);
+        if (ret != INT_CODE_BLOCKED)
         {
-            game->score = tile.type;
+            if (ret != INT_CODE_HALT)
+            {
+                printf("Programm did not halt as expected. Err code: %d\n", ret);
+            }
+            engine->finished = 1;
         }
-        else
+
+        /*Every tile is three values, the remaining outputs are read after halting as well.*/
+        intcode_io_ring_t* output = engine->brain->ring_io_out;
+        while (io_ring_size(output) >= 3)
         {
-            add_tile(game, &tile);
+            int64_t values[3];
+            io_ring_try_read(output, values, 3);
+            Tile tile = {.x = (int) values[0], .y = (int) values[1], .type = (int) values[2]};
+            if ((tile.x == -1) && (tile.y == 0))
+            {
+                game->score = tile.type;
+            }
+            else
+            {
+                add_tile(game, &tile);
+            }
         }
         display_game(game);
 
-        /*This cycle is somewhat finicky to timing.*/
-        /*Adding the sleep helps to prevent dead-lock.*/
-        usleep(1);
+        /*Send input if required*/
+        send_control_cmd(game);
     }
 
 #ifdef NCURSES
     endwin();
 #endif
-    return NULL;
 }
 
 Game* create_game(const int height, const int width)
@@ -222,55 +207,6 @@ static void resize_game(Game* const game, const Direction dir)
     }
 }
 
-static void read_tile(const Engine* const engine, Tile* const tile)
-{
-    assert(engine != NULL);
-    assert(tile != NULL);
-
-    int value = read_output(engine);
-    if (value != -10)
-    {
-        tile->x = value;
-    }
-
-    value = read_output(engine);
-    if (value != -10)
-    {
-        tile->y = value;
-    }
-
-    value = read_output(engine);
-    if (value != -10)
-    {
-        tile->type = value;
-    }
-}
-
-static int read_output(const Engine* const engine)
-{
-    assert(engine != NULL);
-    assert(engine->brain != NULL);
-    assert(engine->brain->mem_io_out != NULL);
-
-    int read_value = -10;
-
-    intcode_io_mem_t* output = engine->brain->mem_io_out;
-    pthread_mutex_lock(&output->mut);
-    while (output->consumed && !engine->finished)
-    {
-        pthread_cond_wait(&output->cond, &output->mut);
-    }
-
-    if (!engine->finished)
-    {
-        read_value       = output->value;
-        output->consumed = 1;
-    }
-    pthread_cond_signal(&output->cond);
-    pthread_mutex_unlock(&output->mut);
-    return read_value;
-}
-
 static int get_x_coord(const Game* const game, const TileType type)
 {
     for (int i = 0; i < game->height; ++i)
@@ -291,27 +227,19 @@ static void send_control_cmd(const Game* const game)
     assert(game != NULL);
     assert(game->engine != NULL);
     assert(game->engine->brain != NULL);
-    assert(game->engine->brain->mem_io_in != NULL);
+    assert(game->engine->brain->ring_io_in != NULL);
 
-    if (waiting_for_input(game->engine->brain))
+    /*The engine only reads a joystick position after the previous frame was drawn.*/
+    if (waiting_for_input(game->engine->brain) && !game->engine->finished)
     {
-        intcode_io_mem_t* input = game->engine->brain->mem_io_in;
-
-        int ball_x   = get_x_coord(game, BALL);
-        int paddle_x = get_x_coord(game, PADDLE);
-        int value    = 0;
+        int ball_x    = get_x_coord(game, BALL);
+        int paddle_x  = get_x_coord(game, PADDLE);
+        int64_t value = 0;
         if ((ball_x != -1) && (paddle_x != -1))
         {
             value = (ball_x > paddle_x) ? 1 : (ball_x < paddle_x) ? -1 : 0;
         }
-
-        /*Just always sent the current input.*/
-        /*Don't care about whether the old one was consumed.*/
-        pthread_mutex_lock(&input->mut);
-        input->value    = value;
-        input->consumed = 0;
-        pthread_cond_signal(&input->cond);
-        pthread_mutex_unlock(&input->mut);
+        io_ring_try_write(game->engine->brain->ring_io_in, &value, 1);
     }
 }
 
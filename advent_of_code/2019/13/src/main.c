@@ -7,7 +7,6 @@
 
 #include "challenge/challenge_lib.h"
 #include "challenge/intcode.h"
-#include "pthread.h"
 #include "stdbool.h"
 #include "stdio.h"
 #include "stdlib.h"
@@ -16,6 +15,11 @@
 /*will be resized dynamically*/
 #define INITIAL_HEIGHT 25
 #define INITIAL_WIDTH 25
+/*The first frame is drawn with about a thousand tiles, each of them three values.*/
+#define IO_IN_CAPACITY 16
+#define IO_OUT_CAPACITY 4096
+/*A whole game takes less than a million instructions, seeking steps a tenth of it.*/
+#define RECORD_CHECKPOINT_INTERVAL (100000)
 
 
 int main(int argc, char* argv[])
@@ -27,21 +31,30 @@ int main(int argc, char* argv[])
         return 0;
     }
 
-    /*Initialize the program with IO memory.*/
-    intcode_t* prog          = read_intcode(argv[1]);
-    intcode_io_mem_t* io_in  = create_io_mem();
-    intcode_io_mem_t* io_out = create_io_mem();
-    set_io_mode(prog, INT_CODE_MEM_IO);
-    set_mem_io_in(prog, io_in);
-    set_mem_io_out(prog, io_out);
+    /*Initialize the program with IO rings, the engine is run on this thread.*/
+    intcode_t* prog                = read_intcode(argv[1]);
+    intcode_io_ring_t* io_in       = create_io_ring(IO_IN_CAPACITY);
+    intcode_io_ring_t* io_out      = create_io_ring(IO_OUT_CAPACITY);
+    intcode_scheduler_t* scheduler = create_scheduler(0);
+    if ((prog == NULL) || (io_in == NULL) || (io_out == NULL) || (scheduler == NULL))
+    {
+        printf("Error reading programm or allocating IO memory\n");
+        return 0;
+    }
 
     /*Part 2: add quarters*/
-    prog->memory[0] = 2;
+    set_mem_value(prog, 0, 2);
+
+    set_io_mode(prog, INT_CODE_RING_IO);
+    set_ring_io_in(prog, io_in);
+    set_ring_io_out(prog, io_out);
+    schedule_intcode(scheduler, prog);
 
-    if ((prog == NULL) || (io_in == NULL) || (io_out == NULL))
+    /*The game can be recorded to reproduce it later, see start_recording.*/
+    const char* record_file = getenv("INTCODE_RECORD");
+    if ((record_file != NULL) && !start_recording(prog, record_file, RECORD_CHECKPOINT_INTERVAL))
     {
-        printf("Error reading programm or allocating IO memory\n");
-        return 0;
+        printf("Error starting to record to %s\n", record_file);
     }
 
     /*Setup area with intial size and values.*/
@@ -54,21 +67,12 @@ int main(int argc, char* argv[])
 
     /*Setup engine*/
     Engine engine;
-    engine.brain    = prog;
-    engine.finished = 0;
-    game->engine    = &engine;
-
-    /*Start engine and game threads*/
-    pthread_t engine_thread;
-    pthread_create(&engine_thread, NULL, engine_func, &engine);
-
-    pthread_t game_thread;
-    pthread_create(&game_thread, NULL, game_func, game);
+    engine.brain     = prog;
+    engine.scheduler = scheduler;
+    engine.finished  = 0;
+    game->engine     = &engine;
 
-
-    /*Wait for threads to finish.*/
-    pthread_join(engine_thread, NULL);
-    pthread_join(game_thread, NULL);
+    run_game(game);
 
     /*Print results*/
     int total_blocks = count_tiles(game, BLOCK);
@@ -76,9 +80,14 @@ int main(int argc, char* argv[])
     printf("Game Score: %d\n", game->score);
 
     /*Clean up*/
-    destroy_io_mem(io_in);
-    destroy_io_mem(io_out);
+    if ((record_file != NULL) && !stop_recording(prog))
+    {
+        printf("Error writing the recording to %s\n", record_file);
+    }
+    destroy_scheduler(scheduler);
     destroy_intcode(prog);
+    destroy_io_ring(io_in);
+    destroy_io_ring(io_out);
     destroy_game(game);
     return 0;
 }
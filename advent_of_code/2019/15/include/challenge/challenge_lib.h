@@ -9,6 +9,7 @@
 #define INCLUDE_CHALLENGE_LIB_H
 
 #include "challenge/intcode.h"
+#include "challenge/intcode_scheduler.h"
 
 typedef enum
 {
@@ -28,6 +29,7 @@ typedef struct
 typedef struct
 {
     intcode_t* brain;
+    intcode_scheduler_t* scheduler;
     Position pos;
     Direction direction;
     int finished;
@@ -47,8 +49,10 @@ typedef struct
 
 void print_overview(const Overview* const overview);
 
-/*Thread functions*/
-void* robot_func(void* args);
-void* control_func(void* args);
+/*Explores the area by moving the droid around, it is run on the calling thread.*/
+void run_robot(Overview* const overview);
+
+/*Breadth first search over the states of the droid's program instead of moving a robot.*/
+int search_oxygen(const intcode_t* prog, int* oxygen_distance, int* fill_time);
 
 #endif /* ifndef INCLUDE_CHALLENGE_LIB_H */
@@ -22,6 +22,8 @@
 #define TILE_OFFSET 0
 #define TILE_MASK 3
 #define RESIZE_AMOUNT 10
+#define SEARCH_RING_CAPACITY 4
+#define STATE_SET_INITIAL_CAPACITY 1024
 
 /*Forward declare*/
 struct Planner;
@@ -51,9 +53,25 @@ typedef struct Planner
     int has_been_seeded;
 } Planner;
 
+/*The program remembers the last command, so there can be more than one state per position.*/
+typedef struct
+{
+    intcode_snapshot_t* state;
+    Position pos;
+    int distance;
+} SearchNode;
+
+/*Open addressing set of the visited states of the droid, owns the snapshots.*/
+typedef struct
+{
+    intcode_snapshot_t** states;
+    size_t capacity;
+    size_t count;
+} StateSet;
+
 
-static void provide_input(const Robot* const robot, const int value);
-static int read_output(const Robot* const robot);
+static void provide_input(const Robot* const robot, const int64_t value);
+static int read_output(Robot* const robot);
 static void update(Overview* const overview, const Direction dir, const int value);
 static Response step(Overview* const overview, const Direction dir);
 static Position move_pos(Overview* const overview, const Position pos, const Direction dir);
@@ -79,33 +97,22 @@ static int16_t get_visited(Overview* const overview, const Position pos);
 static void set_tile(Overview* const overview, const Position pos, const Tile tile);
 static Tile get_tile(Overview* const overview, const Position pos);
 
-void* robot_func(void* args)
-{
-    if (args == NULL)
-    {
-        return NULL;
-    }
-    Robot* robot = (Robot*) args;
-    int ret      = execute(robot->brain);
-    if (ret != INT_CODE_HALT)
-    {
-        printf("Programm did not halt as expected. Err code: %d\n", ret);
-    }
-    else
-    {
-        /*Only writing access*/
-        robot->finished = 1;
-    }
-    return NULL;
-}
-
-void* control_func(void* args)
+static int search_states(intcode_t* const droid,
+                         intcode_snapshot_t* const start,
+                         StateSet* const visited,
+                         intcode_snapshot_t** oxygen_state,
+                         int* oxygen_distance,
+                         int* max_distance);
+static int compare_nodes(const void* first, const void* second);
+static int insert_state(StateSet* const set, intcode_snapshot_t* const state);
+static void clear_states(StateSet* const set);
+
+void run_robot(Overview* const overview)
 {
-    if (args == NULL)
+    if ((overview == NULL) || (overview->robot == NULL))
     {
-        return NULL;
+        return;
     }
-    Overview* overview    = (Overview*) args;
     Direction current_dir = UP;
 
     Planner planner = {.has_been_seeded = 0,
@@ -119,7 +126,7 @@ void* control_func(void* args)
 #endif
 
     /*Only reading access*/
-    while (!overview->oxygen_found)
+    while (!overview->oxygen_found && !overview->robot->finished)
     {
         /*First Exploration*/
 
@@ -147,16 +154,58 @@ void* control_func(void* args)
     endwin();
 #endif
 
-    if (!overview->robot->finished)
-    {
-        /*Send invalid input to terminate robot program.*/
-        provide_input(overview->robot, 0);
-    }
-
+    /*The droid is not resumed anymore, there is no need to terminate its program.*/
     printf("Distance from Oxygen to Starting point: %d\n", distance_to_oxygen);
     printf("Max. Distance from Oxygen: %d\n", max_distance);
     print_overview(overview);
-    return NULL;
+}
+
+int search_oxygen(const intcode_t* const prog, int* oxygen_distance, int* fill_time)
+{
+    if ((prog == NULL) || (oxygen_distance == NULL) || (fill_time == NULL))
+    {
+        return 0;
+    }
+
+    /*A single droid is taken back to the state it is expanded from for every direction.*/
+    intcode_t* droid          = fork_intcode(prog);
+    intcode_io_ring_t* input  = create_io_ring(SEARCH_RING_CAPACITY);
+    intcode_io_ring_t* output = create_io_ring(SEARCH_RING_CAPACITY);
+    StateSet from_start       = {.states = NULL, .capacity = 0, .count = 0};
+    StateSet from_oxygen      = {.states = NULL, .capacity = 0, .count = 0};
+    int success               = 0;
+    if ((droid != NULL) && (input != NULL) && (output != NULL))
+    {
+        set_engine(droid, INT_CODE_ENGINE_THREADED);
+        set_io_mode(droid, INT_CODE_RING_IO);
+        set_io_yield(droid, 1);
+        set_ring_io_in(droid, input);
+        set_ring_io_out(droid, output);
+
+        /*Part 1, the first state reporting the oxygen system is the closest one.*/
+        intcode_snapshot_t* oxygen = NULL;
+        intcode_snapshot_t* start  = snapshot_intcode(droid);
+        int max_distance           = 0;
+        success = search_states(droid, start, &from_start, &oxygen, oxygen_distance, &max_distance);
+
+        /*Part 2, the oxygen reaches the state farthest away from the system last.*/
+        if (success && (oxygen != NULL) && restore_intcode(droid, oxygen))
+        {
+            start   = snapshot_intcode(droid);
+            success = search_states(droid, start, &from_oxygen, NULL, NULL, fill_time);
+        }
+        else
+        {
+            success = 0;
+        }
+    }
+
+    clear_states(&from_start);
+    clear_states(&from_oxygen);
+    destroy_intcode(droid);
+    destroy_io_ring(input);
+    destroy_io_ring(output);
+    return success;
 }
 
 void print_overview(const Overview* const overview)
@@ -521,49 +570,38 @@ static void display_overview(const Overview* const overview)
 #endif
 }
 
-static void provide_input(const Robot* const robot, const int value)
+static void provide_input(const Robot* const robot, const int64_t value)
 {
     assert(robot != NULL);
     assert(robot->brain != NULL);
-    assert(robot->brain->mem_io_in != NULL);
+    assert(robot->brain->ring_io_in != NULL);
 
-    intcode_io_mem_t* input = robot->brain->mem_io_in;
-    pthread_mutex_lock(&input->mut);
-    while (!input->consumed && !robot->finished)
-    {
-        pthread_cond_wait(&input->cond, &input->mut);
-    }
-    input->value    = value;
-    input->consumed = 0;
-    pthread_cond_signal(&input->cond);
-    pthread_mutex_unlock(&input->mut);
+    io_ring_try_write(robot->brain->ring_io_in, &value, 1);
 }
 
-static int read_output(const Robot* const robot)
+/*The droid answers every direction with a single status before it waits for the next one.*/
+static int read_output(Robot* const robot)
 {
     assert(robot != NULL);
     assert(robot->brain != NULL);
-    assert(robot->brain->mem_io_out != NULL);
-
-    int read_value = -1;
-
-    intcode_io_mem_t* output = robot->brain->mem_io_out;
-    pthread_mutex_lock(&output->mut);
-    while (output->consumed && !robot->finished)
-    {
-        pthread_cond_wait(&output->cond, &output->mut);
-    }
+    assert(robot->brain->ring_io_out != NULL);
 
     if (!robot->finished)
     {
-        read_value       = output->value;
-        output->consumed = 1;
+        int ret = run_scheduler(robot->scheduler);
+        if (ret != INT_CODE_BLOCKED)
+        {
+            if (ret != INT_CODE_HALT)
+            {
+                printf("Programm did not halt as expected. Err code: %d\n", ret);
+            }
+            robot->finished = 1;
+        }
     }
-    pthread_cond_signal(&output->cond);
-    pthread_mutex_unlock(&output->mut);
-
 
-    return read_value;
+    int64_t read_value = -1;
+    io_ring_try_read(robot->brain->ring_io_out, &read_value, 1);
+    return (int) read_value;
 }
 
 static char tile_to_char(const Tile tile)
@@ -682,3 +720,202 @@ static int16_t get_visited(Overview* const overview, const Position pos)
 
     return (overview->area[index] & VISITED_MASK) >> VISITED_OFFSET;
 }
+
+static int search_states(intcode_t* const droid,
+                         intcode_snapshot_t* const start,
+                         StateSet* const visited,
+                         intcode_snapshot_t** oxygen_state,
+                         int* oxygen_distance,
+                         int* max_distance)
+{
+    assert(droid != NULL);
+    assert(visited != NULL);
+    assert(max_distance != NULL);
+
+    if (insert_state(visited, start) != 1)
+    {
+        destroy_snapshot(start);
+        return 0;
+    }
+
+    /*Every state is queued once, so the queue grows like the set.*/
+    size_t queue_capacity = STATE_SET_INITIAL_CAPACITY;
+    SearchNode* queue     = (SearchNode*) malloc(sizeof(SearchNode) * queue_capacity);
+    if (queue == NULL)
+    {
+        return 0;
+    }
+    size_t queue_head  = 0;
+    size_t queue_count = 1;
+    queue[0].state     = start;
+    queue[0].pos.x     = 0;
+    queue[0].pos.y     = 0;
+    queue[0].distance  = 0;
+
+    int success = 1;
+    while (success && (queue_head < queue_count))
+    {
+        SearchNode node = queue[queue_head++];
+        for (int d = 0; (d < NUM_OF_DIRECTIONS) && success; ++d)
+        {
+            int64_t command  = d + 1;
+            int64_t response = HIT_WALL;
+            if (!restore_intcode(droid, node.state) ||
+                (io_ring_try_write(droid->ring_io_in, &command, 1) != 1) ||
+                (execute(droid) != INT_CODE_BLOCKED) ||
+                (io_ring_try_read(droid->ring_io_out, &response, 1) != 1))
+            {
+                success = 0;
+                continue;
+            }
+            if (response == HIT_WALL)
+            {
+                continue;
+            }
+
+            /*Moving back and forth leads to a state that has been seen already.*/
+            intcode_snapshot_t* state = snapshot_intcode(droid);
+            int inserted              = insert_state(visited, state);
+            if (inserted != 1)
+            {
+                destroy_snapshot(state);
+                success = (inserted == 0);
+                continue;
+            }
+
+            if ((response == FOUND) && (oxygen_state != NULL) && (*oxygen_state == NULL))
+            {
+                *oxygen_state    = state;
+                *oxygen_distance = node.distance + 1;
+            }
+            if (queue_count == queue_capacity)
+            {
+                SearchNode* grown =
+                    (SearchNode*) realloc(queue, sizeof(SearchNode) * 2 * queue_capacity);
+                if (grown == NULL)
+                {
+                    success = 0;
+                    continue;
+                }
+                queue = grown;
+                queue_capacity *= 2;
+            }
+            queue[queue_count].state    = state;
+            queue[queue_count].pos      = node.pos;
+            queue[queue_count].distance = node.distance + 1;
+            switch (d)
+            {
+                case UP:
+                    queue[queue_count].pos.y -= 1;
+                    break;
+                case DOWN:
+                    queue[queue_count].pos.y += 1;
+                    break;
+                case RIGHT:
+                    queue[queue_count].pos.x += 1;
+                    break;
+                case LEFT:
+                    queue[queue_count].pos.x -= 1;
+                    break;
+            }
+            queue_count++;
+        }
+    }
+
+    /*The farthest position is the one with the largest distance of its closest state.*/
+    qsort(queue, queue_count, sizeof(SearchNode), compare_nodes);
+    *max_distance = 0;
+    for (size_t i = 0; i < queue_count; ++i)
+    {
+        if ((i == 0) || (queue[i].pos.x != queue[i - 1].pos.x) ||
+            (queue[i].pos.y != queue[i - 1].pos.y))
+        {
+            if (queue[i].distance > *max_distance)
+            {
+                *max_distance = queue[i].distance;
+            }
+        }
+    }
+    free(queue);
+    return success;
+}
+
+/*Orders nodes by position, the closest state of a position comes first.*/
+static int compare_nodes(const void* first, const void* second)
+{
+    const SearchNode* a = (const SearchNode*) first;
+    const SearchNode* b = (const SearchNode*) second;
+    if (a->pos.x != b->pos.x)
+    {
+        return (a->pos.x < b->pos.x) ? -1 : 1;
+    }
+    if (a->pos.y != b->pos.y)
+    {
+        return (a->pos.y < b->pos.y) ? -1 : 1;
+    }
+    return a->distance - b->distance;
+}
+
+/*Returns 1 if the state was added, 0 if an equal one is in the set already and -1 on errors.*/
+static int insert_state(StateSet* const set, intcode_snapshot_t* const state)
+{
+    assert(set != NULL);
+    if (state == NULL)
+    {
+        return -1;
+    }
+
+    /*Keep the load factor below 1/2 so probing sequences stay short.*/
+    if (2 * (set->count + 1) > set->capacity)
+    {
+        size_t capacity = (set->capacity == 0) ? STATE_SET_INITIAL_CAPACITY : (2 * set->capacity);
+        intcode_snapshot_t** states =
+            (intcode_snapshot_t**) calloc(capacity, sizeof(intcode_snapshot_t*));
+        if (states == NULL)
+        {
+            return -1;
+        }
+        for (size_t i = 0; i < set->capacity; ++i)
+        {
+            if (set->states[i] != NULL)
+            {
+                size_t slot = get_snapshot_hash(set->states[i]) & (capacity - 1);
+                while (states[slot] != NULL)
+                {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                states[slot] = set->states[i];
+            }
+        }
+        free(set->states);
+        set->states   = states;
+        set->capacity = capacity;
+    }
+
+    size_t mask = set->capacity - 1;
+    size_t slot = get_snapshot_hash(state) & mask;
+    while (set->states[slot] != NULL)
+    {
+        /*Equal hashes are compared cell by cell, a collision must not prune the search.*/
+        if (snapshots_equal(set->states[slot], state))
+        {
+            return 0;
+        }
+        slot = (slot + 1) & mask;
+    }
+    set->states[slot] = state;
+    set->count++;
+    return 1;
+}
+
+static void clear_states(StateSet* const set)
+{
+    for (size_t i = 0; i < set->capacity; ++i)
+    {
+        destroy_snapshot(set->states[i]);
+    }
+    free(set->states);
+    set->states   = NULL;
+    set->capacity = 0;
+    set->count    = 0;
+}
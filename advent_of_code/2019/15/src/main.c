@@ -7,40 +7,72 @@
 
 #include "challenge/challenge_lib.h"
 #include "challenge/intcode.h"
-#include "pthread.h"
 #include "stdbool.h"
 #include "stdio.h"
 #include "stdlib.h"
+#include "string.h"
 
 /*Give the robot a starting area*/
 /*area is resized dynamically*/
 #define INITIAL_HEIGHT 25
 #define INITIAL_WIDTH 25
+/*The droid reads one direction and answers with one status before it reads again.*/
+#define IO_CAPACITY 16
+/*Walking the whole area takes a few hundred thousand instructions.*/
+#define RECORD_CHECKPOINT_INTERVAL (25000)
 
 
 int main(int argc, char* argv[])
 {
-    if (argc != 2)
+    if ((argc != 2) && ((argc != 3) || (strcmp(argv[2], "walk") != 0)))
     {
-        printf("This executabel takes exactly one argument.\n");
-        printf("Usage: aoc2019_15 FILE_PATH.\n");
+        printf("This executabel takes one or two arguments.\n");
+        printf("Usage: aoc2019_15 FILE_PATH [walk].\n");
+        printf("With walk the droid explores the area by moving around instead of searching.\n");
         return 0;
     }
 
-    /*Initialize the program with IO memory.*/
-    intcode_t* prog          = read_intcode(argv[1]);
-    intcode_io_mem_t* io_in  = create_io_mem();
-    intcode_io_mem_t* io_out = create_io_mem();
-    set_io_mode(prog, INT_CODE_MEM_IO);
-    set_mem_io_in(prog, io_in);
-    set_mem_io_out(prog, io_out);
+    intcode_t* prog = read_intcode(argv[1]);
+    if (argc == 2)
+    {
+        /*Search the states of the program, no robot has to walk back and forth.*/
+        int oxygen_distance = 0;
+        int fill_time       = 0;
+        if (search_oxygen(prog, &oxygen_distance, &fill_time))
+        {
+            printf("Distance from Oxygen to Starting point: %d\n", oxygen_distance);
+            printf("Max. Distance from Oxygen: %d\n", fill_time);
+        }
+        else
+        {
+            printf("Error searching the states of the programm.\n");
+        }
+        destroy_intcode(prog);
+        return 0;
+    }
 
-    if ((prog == NULL) || (io_in == NULL) || (io_out == NULL))
+    /*Initialize the program with IO rings, the robot is run on this thread.*/
+    intcode_io_ring_t* io_in       = create_io_ring(IO_CAPACITY);
+    intcode_io_ring_t* io_out      = create_io_ring(IO_CAPACITY);
+    intcode_scheduler_t* scheduler = create_scheduler(0);
+    if ((prog == NULL) || (io_in == NULL) || (io_out == NULL) || (scheduler == NULL))
     {
         printf("Error reading programm or allocating IO memory\n");
         return 0;
     }
 
+    set_io_mode(prog, INT_CODE_RING_IO);
+    set_ring_io_in(prog, io_in);
+    set_ring_io_out(prog, io_out);
+    schedule_intcode(scheduler, prog);
+
+    /*The walk can be recorded to reproduce it later, see start_recording.*/
+    const char* record_file = getenv("INTCODE_RECORD");
+    if ((record_file != NULL) && !start_recording(prog, record_file, RECORD_CHECKPOINT_INTERVAL))
+    {
+        printf("Error starting to record to %s\n", record_file);
+    }
+
     /*Setup area, overview and robot with intial size and values.*/
     int* area          = (int*) calloc(INITIAL_HEIGHT, INITIAL_WIDTH * sizeof(int));
     Robot* robot       = (Robot*) malloc(sizeof(Robot));
@@ -55,6 +87,7 @@ int main(int argc, char* argv[])
     robot->direction      = UP;
     robot->finished       = 0;
     robot->brain          = prog;
+    robot->scheduler      = scheduler;
     robot->pos            = starting_pos;
 
     overview->height       = INITIAL_HEIGHT;
@@ -64,17 +97,7 @@ int main(int argc, char* argv[])
     overview->robot_start  = starting_pos;
     overview->oxygen_found = 0;
 
-    /*Start robot and control threads*/
-    pthread_t robot_thread;
-    pthread_create(&robot_thread, NULL, robot_func, robot);
-
-    pthread_t control_thread;
-    pthread_create(&control_thread, NULL, control_func, overview);
-
-
-    /*Wait for threads to finish.*/
-    pthread_join(control_thread, NULL);
-    pthread_join(robot_thread, NULL);
+    run_robot(overview);
 
     /*Print results*/
     printf("Oxygen found: %d, Robot finished: %d\n",
@@ -89,9 +112,14 @@ int main(int argc, char* argv[])
 
 
     /*Clean up*/
-    destroy_io_mem(io_in);
-    destroy_io_mem(io_out);
+    if ((record_file != NULL) && !stop_recording(prog))
+    {
+        printf("Error writing the recording to %s\n", record_file);
+    }
+    destroy_scheduler(scheduler);
     destroy_intcode(prog);
+    destroy_io_ring(io_in);
+    destroy_io_ring(io_out);
     if (robot != NULL)
     {
         free(robot);
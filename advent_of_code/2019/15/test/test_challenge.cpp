@@ -8,6 +8,7 @@
 
 extern "C" {
 #include "challenge/challenge_lib.h"
+#include "challenge/intcode.h"
 }
 
 class challenge_test : public ::testing::Test
@@ -27,3 +28,19 @@ TEST_F(challenge_test, pos_test_01)
     bool ret = true;
     ASSERT_TRUE(ret);
 }
+
+TEST_F(challenge_test, search_oxygen_01)
+{
+    intcode_t* prog = read_intcode("input.txt");
+    ASSERT_TRUE(prog != NULL);
+
+    int oxygen_distance = 0;
+    int fill_time       = 0;
+    ASSERT_TRUE(search_oxygen(prog, &oxygen_distance, &fill_time));
+    ASSERT_EQ(oxygen_distance, 232);
+    ASSERT_EQ(fill_time, 320);
+
+    /*The search works on a fork, the program itself is not run.*/
+    ASSERT_EQ(prog->head, 0);
+    destroy_intcode(prog);
+}
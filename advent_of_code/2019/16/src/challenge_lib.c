@@ -8,22 +8,20 @@
 
 #include "challenge/challenge_lib.h"
 #include "assert.h"
+#include "stdint.h"
 #include "stdio.h"
 #include "stdlib.h"
 
-typedef enum
-{
-    SKIP,
-    ADD,
-    SUB,
-} Mode;
-
 
 static int count_chars(const char* const file_path);
-static int add(const Sequence* const seq, const int start, const int end);
-static int sub(const Sequence* const seq, const int start, const int end);
-static void calculate_result(const Sequence* const input, const int row, Sequence* const output);
-static void run_phase(const Sequence* const input, Sequence* const output, int skip_first_half);
+static void calculate_result(const int64_t* const prefix,
+                             const int size,
+                             const int row,
+                             Sequence* const output);
+static void run_phase(const Sequence* const input,
+                      Sequence* const output,
+                      int64_t* const prefix,
+                      int skip_first_half);
 
 
 Sequence* read_sequence(const char* const file_path)
@@ -230,28 +228,47 @@ Sequence* run_phases(const Sequence* const input, const int amount, int skip_fir
     Sequence* output = NULL;
     if (input != NULL && (input->numbers != NULL) && (input->size > 0))
     {
+        /*Two sequences take turns as input and output, the prefix sums are rebuilt every phase.*/
         output              = create_sequence(input->size);
         Sequence* new_input = copy_sequence(input);
+        int64_t* prefix     = NULL;
+        if (!skip_first_half)
+        {
+            prefix = (int64_t*) malloc(sizeof(int64_t) * (input->size + 1));
+        }
+        if ((output == NULL) || (new_input == NULL) || (!skip_first_half && (prefix == NULL)))
+        {
+            destroy_sequence(output);
+            destroy_sequence(new_input);
+            free(prefix);
+            return NULL;
+        }
+
         for (int i = 0; i < amount; ++i)
         {
-            run_phase(new_input, output, skip_first_half);
+            run_phase(new_input, output, prefix, skip_first_half);
             if (i < (amount - 1))
             {
-                destroy_sequence(new_input);
-                new_input = copy_sequence(output);
+                Sequence* swap = new_input;
+                new_input      = output;
+                output         = swap;
             }
         }
         destroy_sequence(new_input);
+        free(prefix);
     }
     return output;
 }
 
-static void run_phase(const Sequence* const input, Sequence* const output, int skip_first_half)
+static void run_phase(const Sequence* const input,
+                      Sequence* const output,
+                      int64_t* const prefix,
+                      int skip_first_half)
 {
     if ((input != NULL) && (input->numbers != NULL) && (output != NULL) &&
         (output->numbers != NULL))
     {
-        /*I will just assume that the input size is always a multiple of 4 (or the num of modes).*/
+        /*From the half on the pattern is zeros followed by ones, a sum from the end will do.*/
         int half_size = input->size / 2;
         int tmp       = 0;
         for (int i = input->size - 1; i >= half_size; i--)
@@ -262,82 +279,45 @@ static void run_phase(const Sequence* const input, Sequence* const output, int s
 
         if (!skip_first_half)
         {
-            for (int i = 0; i < half_size; ++i)
+            prefix[0] = 0;
+            for (int i = 0; i < input->size; ++i)
             {
-                calculate_result(input, i, output);
+                prefix[i + 1] = prefix[i] + input->numbers[i];
             }
-        }
-    }
-}
-
-static void calculate_result(const Sequence* const input, const int row, Sequence* const output)
-{
-    if ((input != NULL) && (input->numbers != NULL) && (output != NULL) &&
-        (output->numbers != NULL))
-    {
-        int k         = 1;
-        int processed = 0;
-        int mode_idx  = 0;
-        int result    = 0;
-        Mode modes[4] = {SKIP, ADD, SKIP, SUB};
-        while (processed < input->size)
-        {
-            int n  = row + 1 - k;
-            Mode m = modes[mode_idx];
-
-            if (n > 0)
+            for (int i = 0; i < half_size; ++i)
             {
-                /*Determine how many numbers to process.*/
-                if (n > (input->size - processed))
-                {
-                    n = input->size - processed;
-                }
-
-                if (m == ADD)
-                {
-                    result += add(input, processed, processed + n);
-                }
-                else if (m == SUB)
-                {
-                    result += sub(input, processed, processed + n);
-                }
+                calculate_result(prefix, input->size, i, output);
             }
-
-            /*Increase index and handle other variables.*/
-            k        = 0;
-            mode_idx = (mode_idx + 1) % 4;
-            processed += n;
         }
-        output->numbers[row] = abs(result) % 10;
     }
 }
 
-static int add(const Sequence* const seq, const int start, const int end)
+/*The pattern of a row repeats every 4 * (row + 1) numbers: skip, add, skip, subtract.*/
+/*Every run of ones or minus ones is the difference of two prefix sums, so a row takes*/
+/*size / (row + 1) steps and all rows together size * log(size).*/
+static void calculate_result(const int64_t* const prefix,
+                             const int size,
+                             const int row,
+                             Sequence* const output)
 {
-    assert(seq != NULL);
-    assert(seq->numbers != NULL);
+    assert(prefix != NULL);
+    assert(output != NULL);
 
-    int res = 0;
-    for (int i = start; i < end; ++i)
+    int64_t result = 0;
+    int k          = row + 1;
+    for (int start = row; start < size; start += 4 * k)
     {
-        res += seq->numbers[i];
-    }
-
-    return res;
-}
-
-static int sub(const Sequence* const seq, const int start, const int end)
-{
-    assert(seq != NULL);
-    assert(seq->numbers != NULL);
+        int end = (start + k < size) ? (start + k) : size;
+        result += prefix[end] - prefix[start];
 
-    int res = 0;
-    for (int i = start; i < end; ++i)
-    {
-        res -= seq->numbers[i];
+        int neg_start = start + (2 * k);
+        if (neg_start < size)
+        {
+            int neg_end = (neg_start + k < size) ? (neg_start + k) : size;
+            result -= prefix[neg_end] - prefix[neg_start];
+        }
     }
-
-    return res;
+    output->numbers[row] = (int) (llabs(result) % 10);
 }
 
 static int count_chars(const char* const file_path)
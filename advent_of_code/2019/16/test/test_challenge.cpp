@@ -27,3 +27,57 @@ TEST_F(challenge_test, pos_test_01)
     bool ret = true;
     ASSERT_TRUE(ret);
 }
+
+static int first_digits(const Sequence* const seq, const int start)
+{
+    Sequence* digits = get_subsequence(seq, start, 8);
+    int value        = get_value(digits);
+    destroy_sequence(digits);
+    return value;
+}
+
+TEST_F(challenge_test, run_phases_01)
+{
+    Sequence* seq = read_sequence("test_input_01.txt");
+    ASSERT_TRUE(seq != NULL);
+    Sequence* result = run_phases(seq, 4, 0);
+    ASSERT_TRUE(result != NULL);
+    ASSERT_EQ(first_digits(result, 0), 1029498);
+    destroy_sequence(result);
+    destroy_sequence(seq);
+
+    const char* files[] = {"test_input_02.txt", "test_input_03.txt", "test_input_04.txt"};
+    const int expected[] = {24176176, 73745418, 52432133};
+    for (int i = 0; i < 3; ++i)
+    {
+        seq = read_sequence(files[i]);
+        ASSERT_TRUE(seq != NULL);
+        result = run_phases(seq, 100, 0);
+        ASSERT_TRUE(result != NULL);
+        ASSERT_EQ(first_digits(result, 0), expected[i]);
+        destroy_sequence(result);
+        destroy_sequence(seq);
+    }
+}
+
+TEST_F(challenge_test, full_signal_01)
+{
+    /*The whole repeated signal, not only the half behind the offset.*/
+    Sequence* seq = read_sequence("test_input_05.txt");
+    ASSERT_TRUE(seq != NULL);
+    Sequence* offset = get_subsequence(seq, 0, 7);
+    int offset_value = get_value(offset);
+    destroy_sequence(offset);
+
+    Sequence* repeated = repeat_sequence(seq, 10000);
+    Sequence* full     = run_phases(repeated, 100, 0);
+    Sequence* skipped  = run_phases(repeated, 100, 1);
+    ASSERT_TRUE((full != NULL) && (skipped != NULL));
+    ASSERT_EQ(first_digits(full, offset_value), 84462026);
+    ASSERT_EQ(first_digits(skipped, offset_value), 84462026);
+
+    destroy_sequence(full);
+    destroy_sequence(skipped);
+    destroy_sequence(repeated);
+    destroy_sequence(seq);
+}
@@ -9,6 +9,7 @@
 #define INCLUDE_CHALLENGE_LIB_H
 
 #include "challenge/intcode.h"
+#include "challenge/intcode_scheduler.h"
 
 typedef enum
 {
@@ -34,6 +35,7 @@ typedef struct
 typedef struct
 {
     intcode_t* brain;
+    intcode_scheduler_t* scheduler;
     int finished;
 } ASCII;
 
@@ -51,8 +53,6 @@ typedef struct
 
 void print_overview(const Overview* const overview);
 
-/*Thread functions*/
-void* system_func(void* args);
-void* control_func(void* args);
+void run_control(Overview* const overview);
 
 #endif /* ifndef INCLUDE_CHALLENGE_LIB_H */
@@ -9,7 +9,6 @@
 #include "assert.h"
 #include "stdio.h"
 #include "string.h"
-#include "unistd.h"
 
 #ifdef NCURSES
 #include "ncurses.h"
@@ -17,8 +16,10 @@
 
 #define RESIZE_AMOUNT 10
 
-static void provide_input(const ASCII* const system, const int value);
-static int64_t read_output(const ASCII* const system);
+static void run_system(ASCII* const system);
+static void provide_input(const ASCII* const system, const int64_t value);
+static int read_output(ASCII* const system, int64_t* const value);
+static void skip_output(ASCII* const system);
 static void update(Overview* const overview, const int64_t value);
 static void resize_overview(Overview* const overview, const Direction dir);
 static void display_overview(const Overview* const overview);
@@ -32,54 +33,27 @@ static void provide_function_B(const ASCII* const system);
 static void provide_function_C(const ASCII* const system);
 static void provide_line(const ASCII* const system, const char* const line);
 
-void* system_func(void* args)
+/*Runs the system on the calling thread, it yields whenever it waits for the next line.*/
+void run_control(Overview* const overview)
 {
-    if (args == NULL)
+    if ((overview == NULL) || (overview->system == NULL))
     {
-        return NULL;
+        return;
     }
-    ASCII* system = (ASCII*) args;
-    int ret       = execute(system->brain);
-    if (ret != INT_CODE_HALT)
-    {
-        printf("Programm did not halt as expected. Err code: %d\n", ret);
-    }
-    else
-    {
-        /*Only writing access*/
-        usleep(1000);
-        system->finished = 1;
-    }
-    return NULL;
-}
-
-void* control_func(void* args)
-{
-    if (args == NULL)
-    {
-        return NULL;
-    }
-    Overview* overview    = (Overview*) args;
-    Direction current_dir = UP;
 
 #ifdef NCURSES
     initscr();
     curs_set(0);
 #endif
 
-    /*Give robot some time to setup.*/
-    usleep(3000);
-
-    /*Only reading access*/
-    while (!waiting_for_input(overview->system->brain) && !overview->system->finished)
+    /*Read the camera image until the system asks for the movement routines or halts.*/
+    int64_t resp = 0;
+    while (read_output(overview->system, &resp))
     {
-        /*Read Response*/
-        int64_t resp = read_output(overview->system);
         update(overview, resp);
 #ifdef NCURSES
         display_overview(overview);
 #endif
-        usleep(10);
     }
 
     /*The area should be initialized now.*/
@@ -117,42 +91,18 @@ void* control_func(void* args)
     else
     {
         /*Robot is expecting input. Indicating Part 02.*/
-        while (!waiting_for_input(overview->system->brain))
-        {
-            int64_t resp = read_output(overview->system);
-            usleep(10);
-        }
-
-        /*Provide functions (hard coded, solved in python)*/
+        /*Provide functions (hard coded, solved in python), skipping the prompts.*/
         provide_main_routine(overview->system);
-        while (!waiting_for_input(overview->system->brain))
-        {
-            int64_t resp = read_output(overview->system);
-            usleep(10);
-        }
+        skip_output(overview->system);
         provide_function_A(overview->system);
-        while (!waiting_for_input(overview->system->brain))
-        {
-            int64_t resp = read_output(overview->system);
-            usleep(10);
-        }
+        skip_output(overview->system);
         provide_function_B(overview->system);
-        while (!waiting_for_input(overview->system->brain))
-        {
-            int64_t resp = read_output(overview->system);
-            usleep(10);
-        }
+        skip_output(overview->system);
         provide_function_C(overview->system);
-        while (!waiting_for_input(overview->system->brain))
-        {
-            int64_t resp = read_output(overview->system);
-            usleep(10);
-        }
+        skip_output(overview->system);
 
         provide_line(overview->system, "n\n");
 
-        usleep(100);
-
         int64_t final_output = -1;
 
         /*Robot sends two lines before drawing map*/
@@ -160,10 +110,8 @@ void* control_func(void* args)
         /*Skip those.*/
         int recvd_headline = 0;
 
-        while (final_output == -1 && !overview->system->finished)
+        while ((final_output == -1) && read_output(overview->system, &resp))
         {
-            /*Read Response*/
-            int64_t resp = read_output(overview->system);
             if (recvd_headline != 2 && (char) resp == '\n')
             {
                 recvd_headline++;
@@ -179,14 +127,12 @@ void* control_func(void* args)
                 display_overview(overview);
 #endif
             }
-            usleep(10);
         }
 #ifdef NCURSES
         endwin();
 #endif
         printf("Final output: %ld\n", final_output);
     }
-    return NULL;
 }
 
 void print_overview(const Overview* const overview)
@@ -339,50 +285,61 @@ static void display_overview(const Overview* const overview)
 #endif
 }
 
-static void provide_input(const ASCII* const system, const int value)
+static void run_system(ASCII* const system)
 {
     assert(system != NULL);
     assert(system->brain != NULL);
-    assert(system->brain->mem_io_in != NULL);
 
-    intcode_io_mem_t* input = system->brain->mem_io_in;
-    pthread_mutex_lock(&input->mut);
-    while (!input->consumed && !system->finished)
+    /*Either the system waits for input, the output ring is full or it halted.*/
+    int ret = run_scheduler(system->scheduler);
+    if (ret != INT_CODE_BLOCKED)
     {
-        pthread_cond_wait(&input->cond, &input->mut);
+        if (ret != INT_CODE_HALT)
+        {
+            printf("Programm did not halt as expected. Err code: %d\n", ret);
+        }
+        system->finished = 1;
     }
-    input->value    = value;
-    input->consumed = 0;
-    pthread_cond_signal(&input->cond);
-    pthread_mutex_unlock(&input->mut);
-    usleep(10);
 }
 
-static int64_t read_output(const ASCII* const system)
+static void provide_input(const ASCII* const system, const int64_t value)
 {
-    assert(robot != NULL);
-    assert(robot->brain != NULL);
-    assert(robot->brain->mem_io_out != NULL);
+    assert(system != NULL);
+    assert(system->brain != NULL);
+    assert(system->brain->ring_io_in != NULL);
+
+    /*A line always fits into the input ring, see IO_IN_CAPACITY.*/
+    size_t written = io_ring_try_write(system->brain->ring_io_in, &value, 1);
+    assert(written == 1);
+    (void) written;
+}
 
-    int64_t read_value = -1;
+/*Reads the next output and runs the system while there is none.*/
+/*Returns 0 once the system halted or waits for input and all output has been read.*/
+static int read_output(ASCII* const system, int64_t* const value)
+{
+    assert(system != NULL);
+    assert(system->brain != NULL);
+    assert(system->brain->ring_io_out != NULL);
 
-    intcode_io_mem_t* output = system->brain->mem_io_out;
-    pthread_mutex_lock(&output->mut);
-    while (output->consumed && !system->finished)
+    while (io_ring_try_read(system->brain->ring_io_out, value, 1) == 0)
     {
-        pthread_cond_wait(&output->cond, &output->mut);
+        if (system->finished ||
+            (waiting_for_input(system->brain) && (io_ring_size(system->brain->ring_io_in) == 0)))
+        {
+            return 0;
+        }
+        run_system(system);
     }
+    return 1;
+}
 
-    if (!system->finished)
+static void skip_output(ASCII* const system)
+{
+    int64_t value = 0;
+    while (read_output(system, &value))
     {
-        read_value       = output->value;
-        output->consumed = 1;
     }
-    pthread_cond_signal(&output->cond);
-    pthread_mutex_unlock(&output->mut);
-
-
-    return read_value;
 }
 
 static Position* find_scaff_intersections(const Overview* const overview,
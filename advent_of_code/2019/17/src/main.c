@@ -7,7 +7,6 @@
 
 #include "challenge/challenge_lib.h"
 #include "challenge/intcode.h"
-#include "pthread.h"
 #include "stdbool.h"
 #include "stdio.h"
 #include "stdlib.h"
@@ -16,6 +15,9 @@
 /*area is resized dynamically*/
 #define INITIAL_HEIGHT 25
 #define INITIAL_WIDTH 25
+/*A movement routine has at most 20 characters, the camera image is read in chunks.*/
+#define IO_IN_CAPACITY 32
+#define IO_OUT_CAPACITY 1024
 
 
 int main(int argc, char* argv[])
@@ -27,20 +29,22 @@ int main(int argc, char* argv[])
         return 0;
     }
 
-    /*Initialize the program with IO memory.*/
-    intcode_t* prog          = read_intcode(argv[1]);
-    intcode_io_mem_t* io_in  = create_io_mem();
-    intcode_io_mem_t* io_out = create_io_mem();
-    set_io_mode(prog, INT_CODE_MEM_IO);
-    set_mem_io_in(prog, io_in);
-    set_mem_io_out(prog, io_out);
-
-    if ((prog == NULL) || (io_in == NULL) || (io_out == NULL))
+    /*Initialize the program with IO rings, the system is run on this thread.*/
+    intcode_t* prog                = read_intcode(argv[1]);
+    intcode_io_ring_t* io_in       = create_io_ring(IO_IN_CAPACITY);
+    intcode_io_ring_t* io_out      = create_io_ring(IO_OUT_CAPACITY);
+    intcode_scheduler_t* scheduler = create_scheduler(0);
+    if ((prog == NULL) || (io_in == NULL) || (io_out == NULL) || (scheduler == NULL))
     {
         printf("Error reading programm or allocating IO memory\n");
         return 0;
     }
 
+    set_io_mode(prog, INT_CODE_RING_IO);
+    set_ring_io_in(prog, io_in);
+    set_ring_io_out(prog, io_out);
+    schedule_intcode(scheduler, prog);
+
     /*Setup area, overview and robot with intial size and values.*/
     int* area          = (int*) calloc(INITIAL_HEIGHT, INITIAL_WIDTH * sizeof(int));
     Robot* robot       = (Robot*) malloc(sizeof(Robot));
@@ -53,9 +57,10 @@ int main(int argc, char* argv[])
     }
 
     /*Initialize everything*/
-    prog->memory[0]  = 2; /*For Part 2*/
-    system->brain    = prog;
-    system->finished = 0;
+    set_mem_value(prog, 0, 2); /*For Part 2*/
+    system->brain     = prog;
+    system->scheduler = scheduler;
+    system->finished  = 0;
 
     overview->height      = INITIAL_HEIGHT;
     overview->width       = INITIAL_WIDTH;
@@ -65,24 +70,15 @@ int main(int argc, char* argv[])
     overview->output_pos  = (Position){.x = 0, .y = 0};
     overview->initialized = 0;
 
-    /*Start robot and control threads*/
-    pthread_t system_thread;
-    pthread_create(&system_thread, NULL, system_func, system);
-
-    pthread_t control_thread;
-    pthread_create(&control_thread, NULL, control_func, overview);
-
-
-    /*Wait for threads to finish.*/
-    pthread_join(control_thread, NULL);
-    pthread_join(system_thread, NULL);
+    run_control(overview);
 
     /*Print results*/
 
     /*Clean up*/
-    destroy_io_mem(io_in);
-    destroy_io_mem(io_out);
+    destroy_scheduler(scheduler);
     destroy_intcode(prog);
+    destroy_io_ring(io_in);
+    destroy_io_ring(io_out);
     if (robot != NULL)
     {
         free(robot);
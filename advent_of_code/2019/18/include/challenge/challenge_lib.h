@@ -10,6 +10,9 @@
 
 #include "stdlib.h"
 
+/*Part two splits the entrance into four, one robot starts at each.*/
+#define MAX_ENTRANCES 4
+
 typedef struct
 {
     int x;
@@ -44,6 +47,8 @@ typedef struct
     Door** doors;
     Key** keys;
     Position entrance;
+    Position entrances[MAX_ENTRANCES];
+    int num_entrances;
     int num_keys;
     int num_doors;
 } Overview;
@@ -56,6 +61,7 @@ Overview* read_input(const char* const file_path,
                      const int num_doors);
 void destroy_overview(Overview* const overview);
 void print_map(const Map* const map);
+int split_entrance(Overview* const overview);
 
 int minimal_steps(const Overview* const overview);
 
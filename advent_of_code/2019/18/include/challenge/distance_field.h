@@ -0,0 +1,49 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *  Date: 2020-06-27
+ *
+ */
+
+#ifndef INCLUDE_DISTANCE_FIELD_H
+#define INCLUDE_DISTANCE_FIELD_H
+
+#include "stdint.h"
+
+#include "challenge/challenge_lib.h"
+
+/*A sweep tracks every source by one bit of the cells.*/
+#define MAX_SWEEP_SOURCES 32
+
+/*Buffers of breadth first searches over the cells of a map, allocated once and reused.*/
+typedef struct
+{
+    int width;
+    int height;
+    /*Steps from the source to every cell, -1 for cells not reached.*/
+    int* distance;
+    int* queue;
+    int* next_queue;
+    /*Sweep only: the sources that reached a cell so far and in the last and next level.*/
+    uint32_t* seen;
+    uint32_t* frontier;
+    uint32_t* reached;
+    int* source_at;
+} DistanceField;
+
+DistanceField* create_distance_field(const int width, const int height);
+void destroy_distance_field(DistanceField* const field);
+int fill_distances(DistanceField* const field,
+                   const Map* const map,
+                   const Position start,
+                   const uint32_t open_doors);
+/*All-pairs distances between up to MAX_SWEEP_SOURCES sources, without doors or keys per path.*/
+int sweep_distances(DistanceField* const field,
+                    const Map* const map,
+                    const Position* const sources,
+                    const int num_sources,
+                    const uint32_t open_doors,
+                    int* const distances);
+
+
+#endif /* ifndef INCLUDE_DISTANCE_FIELD_H */
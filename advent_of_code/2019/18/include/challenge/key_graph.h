@@ -0,0 +1,41 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *  Date: 2020-06-14
+ *
+ */
+
+#ifndef INCLUDE_KEY_GRAPH_H
+#define INCLUDE_KEY_GRAPH_H
+
+#include "stdint.h"
+
+#include "challenge/challenge_lib.h"
+
+/*Keys are identified by a bit of their letter, a door requires the bit of its key.*/
+#define KEY_BIT(id) (1u << ((id) - 'a'))
+
+/*Shortest paths between the nodes of a vault, the entrances come first and the keys follow.*/
+typedef struct
+{
+    int num_nodes;
+    /*Every entrance is the start node of one robot.*/
+    int num_robots;
+    /*Bit of the key at every node, 0 for the entrances.*/
+    uint32_t* node_keys;
+    /*Matrices of num_nodes x num_nodes, a distance of -1 marks unreachable nodes.*/
+    int* distances;
+    /*Keys of the doors on the path.*/
+    uint32_t* doors;
+    /*Keys passed on the path, without the ones at both ends.*/
+    uint32_t* passed;
+    uint32_t all_keys;
+} KeyGraph;
+
+KeyGraph* build_key_graph(const Overview* const overview);
+void destroy_key_graph(KeyGraph* const graph);
+int collect_all_keys(const KeyGraph* const graph);
+int independent_regions(const KeyGraph* const graph, uint32_t* const region_keys);
+
+
+#endif /* ifndef INCLUDE_KEY_GRAPH_H */
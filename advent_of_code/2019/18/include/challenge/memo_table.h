@@ -0,0 +1,32 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *  Date: 2020-06-20
+ *
+ */
+
+#ifndef INCLUDE_MEMO_TABLE_H
+#define INCLUDE_MEMO_TABLE_H
+
+#include "stdint.h"
+#include "stdlib.h"
+
+/*Keys of a search state: the collected keys as bitmask above a position.*/
+#define MEMO_KEY(keys, position) (((uint64_t) (keys) << 32) | (uint32_t) (position))
+
+/*Map of 64-bit keys to values. Entries live in an arena and never move, so values can be*/
+/*updated through the returned pointers until the table is cleared.*/
+typedef struct MemoTable MemoTable;
+
+MemoTable* create_memo_table(const size_t expected_entries);
+void destroy_memo_table(MemoTable* const table);
+void clear_memo_table(MemoTable* const table);
+int64_t* find_memo(const MemoTable* const table, const uint64_t key);
+int64_t* insert_memo(MemoTable* const table,
+                     const uint64_t key,
+                     const int64_t value,
+                     int* const inserted);
+size_t get_memo_size(const MemoTable* const table);
+
+
+#endif /* ifndef INCLUDE_MEMO_TABLE_H */
@@ -1,3 +1,4 @@
 #!/usr/bin/env bash
 
-./build/aoc2019_18 input.txt 81 81 26
+./build/aoc2019_18 input.txt 81 81 26 26
+./build/aoc2019_18 input.txt 81 81 26 26 split
@@ -6,24 +6,19 @@
  */
 
 #include "challenge/challenge_lib.h"
+#include "challenge/distance_field.h"
+#include "challenge/key_graph.h"
+#include "challenge/memo_table.h"
 #include "assert.h"
 #include "ctype.h"
 #include "stdio.h"
 #include "stdlib.h"
 #include "string.h"
 
-typedef enum
-{
-    UP    = 0,
-    DOWN  = 1,
-    RIGHT = 2,
-    LEFT  = 3,
-} Direction;
-#define NUM_OF_DIRECTIONS 4
-
 #define EMPTY '.'
 #define WALL '#'
 #define ENTRANCE '@'
+#define STORAGE_INITIAL_CAPACITY 1024
 
 
 typedef struct
@@ -33,41 +28,20 @@ typedef struct
     int steps;
 } Solution;
 
-typedef struct
-{
-    Solution** solutions;
-    int num_solutions;
-    int capacity;
-} SolutionStorage;
-
 static Overview* create_overview(const int width,
                                  const int height,
                                  const int num_keys,
                                  const int num_doors);
 void destroy_overview(Overview* const overview);
-static SolutionStorage* create_storage();
 static Map* create_map(const int width, const int height);
 static void destroy_map(Map* const map);
 static void pickup(Key* const key);
-static int* distance_map(const Map* const map,
-                         const Position pos,
-                         Door** const doors,
-                         const int num_doors);
-static void build_distance_map_rec(const Map* const map,
-                                   Door** const doors,
-                                   const int num_doors,
-                                   const Position pos,
-                                   const int distance,
-                                   const int incoming_from,
-                                   int* const distance_map);
-static Position move_pos(const Position pos, const Direction dir);
-static char get_value(const Map* const map, const Position pos);
-static int is_locked(Door** const doors, const int num_doors, const Position pos);
-static Direction reverse_direction(const Direction dir);
+static uint32_t get_open_doors(Door** const doors, const int num_doors);
 static int is_reachable(const int* dist_map, const int width, const int height, const Position pos);
 static int minimal_steps_rec(const Map* const map,
                              const Position pos,
-                             SolutionStorage* const storage,
+                             DistanceField* const field,
+                             MemoTable* const storage,
                              Solution* const current_solution,
                              Key** const keys,
                              Door** const doors,
@@ -79,13 +53,11 @@ static Key** copy_keys(Key** const keys,
                        Door** const doors,
                        const int num_keys,
                        const int num_doors);
-static SolutionStorage* create_storage();
 static Solution* create_solution(const int num_keys, const int steps, Key* const next);
-static void store_solution(SolutionStorage* const storage, Solution* solution);
-static int load_solution_value(const SolutionStorage* const storage,
-                               const Solution* const solution);
+static uint64_t get_solution_key(const Solution* const solution);
+static void store_solution(MemoTable* const storage, const Solution* const solution);
+static int load_solution_value(const MemoTable* const storage, const Solution* const solution);
 static void destroy_solution(Solution* const solution);
-static void destroy_storage(SolutionStorage* const storage);
 static void set_keys_of_solution(Solution* const solution, Key** const keys, const int num_keys);
 static Solution* remove_key_from_solution(const Solution* const solution,
                                           const Key* const key,
@@ -157,9 +129,14 @@ Overview* read_input(const char* const file_path,
                     overview->keys[key_index++] = k;
                 }
             }
-            else if (c == ENTRANCE)
+            else if ((c == ENTRANCE) && (overview->num_entrances < MAX_ENTRANCES))
             {
-                overview->entrance = (Position){.x = x, .y = y};
+                Position pos = (Position){.x = x, .y = y};
+                if (overview->num_entrances == 0)
+                {
+                    overview->entrance = pos;
+                }
+                overview->entrances[overview->num_entrances++] = pos;
             }
             /*Save value in data. (maybe transform it)*/
 
@@ -222,17 +199,71 @@ void destroy_overview(Overview* const overview)
     }
 }
 
+int split_entrance(Overview* const overview)
+{
+    if ((overview == NULL) || (overview->map == NULL) || (overview->num_entrances != 1))
+    {
+        return 0;
+    }
+
+    /*  ...      @#@
+     *  .@.  ->  ###
+     *  ...      @#@  */
+    Map* map     = overview->map;
+    Position pos = overview->entrance;
+    if ((pos.x < 1) || (pos.y < 1) || (pos.x + 1 >= map->width) || (pos.y + 1 >= map->height))
+    {
+        return 0;
+    }
+    for (int dy = -1; dy <= 1; ++dy)
+    {
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+            char c = map->data[((pos.y + dy) * map->width) + pos.x + dx];
+            if ((c != EMPTY) && !((dx == 0) && (dy == 0)))
+            {
+                return 0;
+            }
+        }
+    }
+
+    overview->num_entrances = 0;
+    for (int dy = -1; dy <= 1; ++dy)
+    {
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+            int index = ((pos.y + dy) * map->width) + pos.x + dx;
+            if ((dx != 0) && (dy != 0))
+            {
+                map->data[index] = ENTRANCE;
+                overview->entrances[overview->num_entrances++] =
+                    (Position){.x = pos.x + dx, .y = pos.y + dy};
+            }
+            else
+            {
+                map->data[index] = WALL;
+            }
+        }
+    }
+    overview->entrance = overview->entrances[0];
+    return 1;
+}
+
 int minimal_steps(const Overview* const overview)
 {
     int step_count = 0;
     if ((overview != NULL) && (overview->map != NULL) && (overview->doors != NULL) &&
         (overview->keys != NULL))
     {
-        SolutionStorage* storage = create_storage();
-        Solution* solution       = create_solution(overview->num_keys, -1, NULL);
+        /*Solutions are stored by the set of remaining keys and the next key.*/
+        MemoTable* storage = create_memo_table(STORAGE_INITIAL_CAPACITY);
+        Solution* solution = create_solution(overview->num_keys, -1, NULL);
+        /*One distance field serves all steps of the recursion.*/
+        DistanceField* field = create_distance_field(overview->map->width, overview->map->height);
         set_keys_of_solution(solution, overview->keys, overview->num_keys);
         step_count = minimal_steps_rec(overview->map,
                                        overview->entrance,
+                                       field,
                                        storage,
                                        solution,
                                        overview->keys,
@@ -240,14 +271,17 @@ int minimal_steps(const Overview* const overview)
                                        0,
                                        overview->num_keys,
                                        overview->num_doors);
-        destroy_storage(storage);
+        destroy_memo_table(storage);
+        destroy_solution(solution);
+        destroy_distance_field(field);
     }
     return step_count;
 }
 
 static int minimal_steps_rec(const Map* const map,
                              const Position pos,
-                             SolutionStorage* const storage,
+                             DistanceField* const field,
+                             MemoTable* const storage,
                              Solution* const current_solution,
                              Key** const keys,
                              Door** const doors,
@@ -259,18 +293,20 @@ static int minimal_steps_rec(const Map* const map,
     int step_count             = 0;
     int distance_to_next       = 0;
     int distances[num_keys];
-    int* dist_map       = distance_map(map, pos, doors, num_doors);
     int reachable_count = 0;
+    if (!fill_distances(field, map, pos, get_open_doors(doors, num_doors)))
+    {
+        return 0;
+    }
     for (int i = 0; i < num_keys; ++i)
     {
         Key* k       = keys[i];
-        distances[i] = dist_map[(k->pos.y * map->width) + k->pos.x];
+        distances[i] = field->distance[(k->pos.y * map->width) + k->pos.x];
         if (distances[i] != -1 && !k->picked_up)
         {
             reachable_count++;
         }
     }
-    free(dist_map);
 
     if (reachable_count > 0)
     {
@@ -321,6 +357,7 @@ static int minimal_steps_rec(const Map* const map,
                      * starting at the position of the picked up key.*/
                     solution_steps = minimal_steps_rec(map,
                                                        keys[i]->pos,
+                                                       field,
                                                        storage,
                                                        new_solution,
                                                        key_cpys,
@@ -331,6 +368,7 @@ static int minimal_steps_rec(const Map* const map,
                     total_steps    = solution_steps + distances[i];
 
                     /*Clean up*/
+                    destroy_solution(new_solution);
                     for (int j = 0; j < num_doors; ++j)
                     {
                         free(door_cpys[j]);
@@ -457,11 +495,12 @@ static Overview* create_overview(const int width,
     Door** doors = (Door**) malloc(sizeof(Door*) * num_doors);
     Key** keys   = (Key**) malloc(sizeof(Key*) * num_keys);
 
-    overview->map       = map;
-    overview->doors     = doors;
-    overview->keys      = keys;
-    overview->num_keys  = num_keys;
-    overview->num_doors = num_doors;
+    overview->map           = map;
+    overview->doors         = doors;
+    overview->keys          = keys;
+    overview->num_entrances = 0;
+    overview->num_keys      = num_keys;
+    overview->num_doors     = num_doors;
     return overview;
 }
 
@@ -502,172 +541,17 @@ static void pickup(Key* const key)
     }
 }
 
-static int* distance_map(const Map* const map,
-                         const Position pos,
-                         Door** const doors,
-                         const int num_doors)
-{
-    assert(map != NULL);
-
-    int* dist_map = (int*) malloc(sizeof(int) * map->height * map->width);
-
-    if (dist_map != NULL)
-    {
-        /*Initialize distance map with -1.*/
-        for (int i = 0; i < map->height; ++i)
-        {
-            for (int j = 0; j < map->width; ++j)
-            {
-                dist_map[(i * map->width) + j] = -1;
-            }
-        }
-        build_distance_map_rec(map, doors, num_doors, pos, 0, -1, dist_map);
-    }
-    return dist_map;
-}
-
-static int is_locked(Door** const doors, const int num_doors, const Position pos)
+static uint32_t get_open_doors(Door** const doors, const int num_doors)
 {
-    int is_locked = 0;
+    uint32_t open_doors = 0;
     for (int i = 0; i < num_doors; ++i)
     {
-        Door* d = doors[i];
-        if ((!d->opened) && (d->pos.x == pos.x) && (d->pos.y == pos.y))
+        if (doors[i]->opened)
         {
-            is_locked = 1;
-            break;
+            open_doors |= KEY_BIT(doors[i]->id);
         }
     }
-    return is_locked;
-}
-
-static void build_distance_map_rec(const Map* const map,
-                                   Door** const doors,
-                                   const int num_doors,
-                                   const Position pos,
-                                   const int distance,
-                                   const int incoming_from,
-                                   int* const distance_map)
-{
-    int dist = distance;
-
-    /*Short discovery*/
-    for (int d = 0; d < NUM_OF_DIRECTIONS; ++d)
-    {
-        if (d == incoming_from)
-        {
-            continue;
-        }
-        Position p = move_pos(pos, d);
-        char c     = get_value(map, p);
-        if ((c == '#') || (is_locked(doors, num_doors, p)))
-        {
-            continue;
-        }
-        else if (c != -1)
-        {
-            int p_dist = distance_map[(p.y * map->width) + p.x];
-            if ((p_dist != -1) && ((p_dist + 1) < dist))
-            {
-                dist = p_dist + 1;
-            }
-        }
-    }
-
-    /*Update distance value for this field.*/
-    distance_map[(pos.y * map->width) + pos.x] = dist;
-
-    /*Propagate distance*/
-    for (int d = 0; d < NUM_OF_DIRECTIONS; ++d)
-    {
-        Position p = move_pos(pos, d);
-        if (d == incoming_from)
-        {
-            if (dist < distance)
-            {
-                /*distance has been updated, backpropagate.*/
-                build_distance_map_rec(map,
-                                       doors,
-                                       num_doors,
-                                       p,
-                                       dist + 1,
-                                       reverse_direction(d),
-                                       distance_map);
-            }
-            continue;
-        }
-        char c = get_value(map, p);
-        if (c != WALL)
-        {
-            if ((c == EMPTY) || (c == ENTRANCE) || (!is_locked(doors, num_doors, p)))
-            {
-                int p_dist = distance_map[(p.y * map->width) + p.x];
-                if ((p_dist == -1) || (p_dist > (dist + 1)))
-                {
-                    build_distance_map_rec(map,
-                                           doors,
-                                           num_doors,
-                                           p,
-                                           dist + 1,
-                                           reverse_direction(d),
-                                           distance_map);
-                }
-            }
-        }
-    }
-}
-
-static Position move_pos(const Position pos, const Direction dir)
-{
-    Position new_pos;
-    new_pos.x = pos.x;
-    new_pos.y = pos.y;
-    switch (dir)
-    {
-        case UP:
-            new_pos.y -= 1;
-            break;
-        case RIGHT:
-            new_pos.x += 1;
-            break;
-        case DOWN:
-            new_pos.y += 1;
-            break;
-        case LEFT:
-            new_pos.x -= 1;
-            break;
-        default:
-            break;
-    }
-    return new_pos;
-}
-
-static char get_value(const Map* const map, const Position pos)
-{
-    char val = -1;
-    if (map != NULL)
-    {
-        if ((pos.x < map->width) && (pos.x >= 0) && (pos.y < map->height) && (pos.y >= 0))
-        {
-            val = map->data[(pos.y * map->width) + pos.x];
-        }
-    }
-    return val;
-}
-
-static Direction reverse_direction(const Direction dir)
-{
-    switch (dir)
-    {
-        case UP:
-            return DOWN;
-        case DOWN:
-            return UP;
-        case LEFT:
-            return RIGHT;
-        case RIGHT:
-            return LEFT;
-    }
+    return open_doors;
 }
 
 void print_map(const Map* const map)
@@ -685,18 +569,6 @@ void print_map(const Map* const map)
     }
 }
 
-static SolutionStorage* create_storage()
-{
-    SolutionStorage* storage = (SolutionStorage*) malloc(sizeof(SolutionStorage));
-    if (storage != NULL)
-    {
-        storage->num_solutions = 0;
-        storage->capacity      = 10;
-        storage->solutions     = (Solution**) malloc(sizeof(Solution*) * 10);
-    }
-    return storage;
-}
-
 static Solution* create_solution(const int num_keys, const int steps, Key* const next)
 {
     Solution* solution = (Solution*) malloc(sizeof(Solution));
@@ -753,67 +625,43 @@ static Solution* remove_key_from_solution(const Solution* const solution,
     return removed;
 }
 
-static void store_solution(SolutionStorage* const storage, Solution* solution)
+/*The order of the remaining keys does not matter, only which keys remain.*/
+static uint64_t get_solution_key(const Solution* const solution)
 {
-    assert(storage != NULL);
-    assert(storage->solutions != NULL);
-    assert(solution != NULL);
-
-    storage->solutions[storage->num_solutions++] = solution;
+    assert(solution->id != NULL);
+    assert(solution->next != NULL);
 
-    if (storage->num_solutions == storage->capacity)
+    uint32_t remaining = 0;
+    for (const char* c = solution->id; *c != '\0'; ++c)
     {
-        storage->capacity *= 2;
-        storage->solutions =
-            (Solution**) realloc(storage->solutions, sizeof(Solution*) * storage->capacity);
+        remaining |= 1u << (*c - 'a');
     }
+    return MEMO_KEY(remaining, solution->next->id);
 }
 
-static int char_compare(const void* a, const void* b)
+static void store_solution(MemoTable* const storage, const Solution* const solution)
 {
-    return (const char*) a - (const char*) b;
+    assert(storage != NULL);
+    assert(solution != NULL);
+
+    int inserted   = 0;
+    int64_t* steps = insert_memo(storage, get_solution_key(solution), solution->steps, &inserted);
+    if ((steps != NULL) && !inserted)
+    {
+        *steps = solution->steps;
+    }
 }
 
-static int load_solution_value(const SolutionStorage* const storage, const Solution* const solution)
+static int load_solution_value(const MemoTable* const storage, const Solution* const solution)
 {
     assert(storage != NULL);
-    assert(storage->solutions != NULL);
 
-    if (solution != NULL)
+    if ((solution != NULL) && (solution->next != NULL))
     {
-        /*1. check if next key is valid*/
-        if (solution->next != NULL)
+        const int64_t* steps = find_memo(storage, get_solution_key(solution));
+        if (steps != NULL)
         {
-            assert(solution->id != NULL);
-            /*printf("Trying to load value for solution %s with next %c\n", solution->id,
-             * solution->next->id);*/
-            /*2. copy id and sort it.*/
-            char provided_id[strlen(solution->id) + 1];
-            strcpy(provided_id, solution->id);
-
-            /*TODO might want to move sorting to creating solutions*/
-            qsort(provided_id, strlen(provided_id), sizeof(const char), char_compare);
-
-            for (int i = 0; i < storage->num_solutions; ++i)
-            {
-                assert(storage->solutions[i] != NULL);
-                assert(storage->solutions[i]->next != NULL);
-                assert(storage->solutions[i]->id != NULL);
-                /*3. check if stored next key is equal to provided next key*/
-                if (solution->next->id == storage->solutions[i]->next->id)
-                {
-                    /*4. copy stored id and sort it.*/
-                    char stored_id[strlen(storage->solutions[i]->id) + 1];
-                    strcpy(stored_id, storage->solutions[i]->id);
-                    qsort(stored_id, strlen(stored_id), sizeof(const char*), char_compare);
-
-                    /*5. Compare provided id and stored id*/
-                    if (strcmp(provided_id, stored_id) == 0)
-                    {
-                        return storage->solutions[i]->steps;
-                    }
-                }
-            }
+            return (int) *steps;
         }
     }
     return -1;
@@ -830,19 +678,3 @@ static void destroy_solution(Solution* const solution)
         free(solution);
     }
 }
-
-static void destroy_storage(SolutionStorage* const storage)
-{
-    if (storage != NULL)
-    {
-        if (storage->solutions != NULL)
-        {
-            for (int i = 0; i < storage->num_solutions; ++i)
-            {
-                destroy_solution(storage->solutions[i]);
-            }
-            free(storage->solutions);
-        }
-        free(storage);
-    }
-}
@@ -0,0 +1,257 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *  Date: 2020-06-27
+ *
+ */
+
+#include "challenge/distance_field.h"
+#include "challenge/key_graph.h"
+#include "ctype.h"
+#include "stdlib.h"
+#include "string.h"
+
+#define WALL '#'
+
+static int get_neighbours(const DistanceField* const field,
+                          const Map* const map,
+                          const int cell,
+                          const uint32_t open_doors,
+                          int* const neighbours);
+
+DistanceField* create_distance_field(const int width, const int height)
+{
+    if ((width <= 0) || (height <= 0))
+    {
+        return NULL;
+    }
+    DistanceField* field = (DistanceField*) malloc(sizeof(DistanceField));
+    if (field == NULL)
+    {
+        return NULL;
+    }
+
+    size_t num_cells  = (size_t) width * height;
+    field->width      = width;
+    field->height     = height;
+    field->distance   = (int*) malloc(sizeof(int) * num_cells);
+    field->queue      = (int*) malloc(sizeof(int) * num_cells);
+    field->next_queue = (int*) malloc(sizeof(int) * num_cells);
+    field->seen       = (uint32_t*) malloc(sizeof(uint32_t) * num_cells);
+    field->frontier   = (uint32_t*) malloc(sizeof(uint32_t) * num_cells);
+    field->reached    = (uint32_t*) malloc(sizeof(uint32_t) * num_cells);
+    field->source_at  = (int*) malloc(sizeof(int) * num_cells);
+    if ((field->distance == NULL) || (field->queue == NULL) || (field->next_queue == NULL) ||
+        (field->seen == NULL) || (field->frontier == NULL) || (field->reached == NULL) ||
+        (field->source_at == NULL))
+    {
+        destroy_distance_field(field);
+        field = NULL;
+    }
+    return field;
+}
+
+void destroy_distance_field(DistanceField* const field)
+{
+    if (field != NULL)
+    {
+        free(field->distance);
+        free(field->queue);
+        free(field->next_queue);
+        free(field->seen);
+        free(field->frontier);
+        free(field->reached);
+        free(field->source_at);
+        free(field);
+    }
+}
+
+/*Breadth first search from start, walls and doors without their key in open_doors block.*/
+/*Returns the number of cells reached, their distances are left in field->distance.*/
+int fill_distances(DistanceField* const field,
+                   const Map* const map,
+                   const Position start,
+                   const uint32_t open_doors)
+{
+    if ((field == NULL) || (map == NULL) || (map->width != field->width) ||
+        (map->height != field->height) || (start.x < 0) || (start.x >= map->width) ||
+        (start.y < 0) || (start.y >= map->height))
+    {
+        return 0;
+    }
+
+    int num_cells = map->width * map->height;
+    for (int i = 0; i < num_cells; ++i)
+    {
+        field->distance[i] = -1;
+    }
+
+    int head               = 0;
+    int tail               = 0;
+    int first              = (start.y * map->width) + start.x;
+    field->distance[first] = 0;
+    field->queue[tail++]   = first;
+    while (head < tail)
+    {
+        int cell = field->queue[head++];
+        int neighbours[4];
+        int count = get_neighbours(field, map, cell, open_doors, neighbours);
+        for (int i = 0; i < count; ++i)
+        {
+            int next = neighbours[i];
+            if (field->distance[next] < 0)
+            {
+                field->distance[next] = field->distance[cell] + 1;
+                field->queue[tail++]  = next;
+            }
+        }
+    }
+    return tail;
+}
+
+/*Distances between all sources in one breadth first search. Every cell holds a bit per source,*/
+/*a level moves the bits that are new to a cell on to its neighbours. The matrix of*/
+/*num_sources x num_sources distances gets -1 for sources that do not reach each other.*/
+int sweep_distances(DistanceField* const field,
+                    const Map* const map,
+                    const Position* const sources,
+                    const int num_sources,
+                    const uint32_t open_doors,
+                    int* const distances)
+{
+    if ((field == NULL) || (map == NULL) || (sources == NULL) || (distances == NULL) ||
+        (num_sources < 1) || (num_sources > MAX_SWEEP_SOURCES) || (map->width != field->width) ||
+        (map->height != field->height))
+    {
+        return 0;
+    }
+
+    int num_cells = map->width * map->height;
+    memset(field->seen, 0, sizeof(uint32_t) * num_cells);
+    memset(field->frontier, 0, sizeof(uint32_t) * num_cells);
+    memset(field->reached, 0, sizeof(uint32_t) * num_cells);
+    for (int i = 0; i < num_cells; ++i)
+    {
+        field->source_at[i] = -1;
+    }
+    for (int i = 0; i < num_sources * num_sources; ++i)
+    {
+        distances[i] = -1;
+    }
+
+    int size = 0;
+    for (int s = 0; s < num_sources; ++s)
+    {
+        Position pos = sources[s];
+        if ((pos.x < 0) || (pos.x >= map->width) || (pos.y < 0) || (pos.y >= map->height))
+        {
+            return 0;
+        }
+        int cell = (pos.y * map->width) + pos.x;
+        if (field->frontier[cell] == 0)
+        {
+            field->queue[size++] = cell;
+        }
+        field->seen[cell] |= 1u << s;
+        field->frontier[cell] |= 1u << s;
+        field->source_at[cell]           = s;
+        distances[(s * num_sources) + s] = 0;
+    }
+
+    int* queue      = field->queue;
+    int* next_queue = field->next_queue;
+    for (int level = 1; size > 0; ++level)
+    {
+        int next_size = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            int cell      = queue[i];
+            uint32_t bits = field->frontier[cell];
+            int neighbours[4];
+            int count = get_neighbours(field, map, cell, open_doors, neighbours);
+            for (int n = 0; n < count; ++n)
+            {
+                int next         = neighbours[n];
+                uint32_t arrived = bits & ~field->seen[next];
+                if (arrived == 0)
+                {
+                    continue;
+                }
+                if (field->reached[next] == 0)
+                {
+                    next_queue[next_size++] = next;
+                }
+                field->reached[next] |= arrived;
+            }
+        }
+        for (int i = 0; i < size; ++i)
+        {
+            field->frontier[queue[i]] = 0;
+        }
+
+        /*The sources arrive at the cells of the next level now, a source cell records them.*/
+        for (int i = 0; i < next_size; ++i)
+        {
+            int cell              = next_queue[i];
+            uint32_t bits         = field->reached[cell];
+            int target            = field->source_at[cell];
+            field->frontier[cell] = bits;
+            field->reached[cell]  = 0;
+            field->seen[cell] |= bits;
+            for (int s = 0; (target >= 0) && (s < num_sources); ++s)
+            {
+                if (bits & (1u << s))
+                {
+                    distances[(s * num_sources) + target] = level;
+                }
+            }
+        }
+
+        int* swap  = queue;
+        queue      = next_queue;
+        next_queue = swap;
+        size       = next_size;
+    }
+    return 1;
+}
+
+/*Neighbours of a cell that can be entered, returns their number.*/
+static int get_neighbours(const DistanceField* const field,
+                          const Map* const map,
+                          const int cell,
+                          const uint32_t open_doors,
+                          int* const neighbours)
+{
+    int x     = cell % field->width;
+    int y     = cell / field->width;
+    int count = 0;
+    int candidates[4];
+    int num_candidates = 0;
+    if (y > 0)
+    {
+        candidates[num_candidates++] = cell - field->width;
+    }
+    if (y + 1 < field->height)
+    {
+        candidates[num_candidates++] = cell + field->width;
+    }
+    if (x + 1 < field->width)
+    {
+        candidates[num_candidates++] = cell + 1;
+    }
+    if (x > 0)
+    {
+        candidates[num_candidates++] = cell - 1;
+    }
+
+    for (int i = 0; i < num_candidates; ++i)
+    {
+        char c = map->data[candidates[i]];
+        if ((c == WALL) || (isupper(c) && !(open_doors & KEY_BIT(tolower(c)))))
+        {
+            continue;
+        }
+        neighbours[count++] = candidates[i];
+    }
+    return count;
+}
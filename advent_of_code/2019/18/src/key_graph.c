@@ -0,0 +1,516 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *  Date: 2020-06-14
+ *
+ */
+
+#include "challenge/key_graph.h"
+#include "challenge/distance_field.h"
+#include "challenge/memo_table.h"
+#include "assert.h"
+#include "ctype.h"
+#include "pthread.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+#define WALL '#'
+#define HEAP_INITIAL_CAPACITY 1024
+#define STATES_INITIAL_CAPACITY 1024
+
+#define MAX_NODES 32
+/*The nodes of all robots are packed into the position of a state.*/
+#define ROBOT_BITS 8
+#define ROBOT_MASK ((1u << ROBOT_BITS) - 1u)
+
+/*Entry of the Dijkstra queue, a state is the current node and the collected keys.*/
+typedef struct
+{
+    int steps;
+    uint64_t state;
+} QueueEntry;
+
+typedef struct
+{
+    QueueEntry* entries;
+    int size;
+    int capacity;
+} Heap;
+
+/*One robot collecting the keys of its region, the other keys count as collected.*/
+typedef struct
+{
+    const KeyGraph* graph;
+    int robot;
+    uint32_t collected;
+    int steps;
+    pthread_t thread;
+} RegionSearch;
+
+static void search_from(KeyGraph* const graph,
+                        const Map* const map,
+                        const int source,
+                        const Position pos,
+                        const int* const node_at,
+                        int* const queue,
+                        int* const distance,
+                        uint32_t* const doors,
+                        uint32_t* const passed);
+static int search_keys(const KeyGraph* const graph,
+                       const int* const robots,
+                       const int num_robots,
+                       const uint32_t collected);
+static void* search_region(void* arg);
+static int push_entry(Heap* const heap, const int steps, const uint64_t state);
+static QueueEntry pop_entry(Heap* const heap);
+static int update_steps(MemoTable* const table, const uint64_t state, const int steps);
+
+KeyGraph* build_key_graph(const Overview* const overview)
+{
+    if ((overview == NULL) || (overview->map == NULL) || (overview->keys == NULL) ||
+        (overview->num_entrances < 1) ||
+        (overview->num_entrances + overview->num_keys > MAX_NODES))
+    {
+        return NULL;
+    }
+
+    const Map* map = overview->map;
+    int num_robots = overview->num_entrances;
+    int num_nodes  = num_robots + overview->num_keys;
+    int num_cells  = map->width * map->height;
+    size_t edges   = (size_t) num_nodes * num_nodes;
+
+    KeyGraph* graph = (KeyGraph*) malloc(sizeof(KeyGraph));
+    if (graph == NULL)
+    {
+        return NULL;
+    }
+    graph->num_nodes  = num_nodes;
+    graph->num_robots = num_robots;
+    graph->all_keys   = 0;
+    graph->node_keys = (uint32_t*) calloc(num_nodes, sizeof(uint32_t));
+    graph->distances = (int*) malloc(sizeof(int) * edges);
+    graph->doors     = (uint32_t*) calloc(edges, sizeof(uint32_t));
+    graph->passed    = (uint32_t*) calloc(edges, sizeof(uint32_t));
+
+    /*Buffers of the searches, shared by all nodes.*/
+    DistanceField* field = create_distance_field(map->width, map->height);
+    int* node_at         = (int*) malloc(sizeof(int) * num_cells);
+    uint32_t* doors      = (uint32_t*) malloc(sizeof(uint32_t) * num_cells);
+    uint32_t* passed     = (uint32_t*) malloc(sizeof(uint32_t) * num_cells);
+    Position* node_pos   = (Position*) malloc(sizeof(Position) * num_nodes);
+    if ((graph->node_keys == NULL) || (graph->distances == NULL) || (graph->doors == NULL) ||
+        (graph->passed == NULL) || (field == NULL) || (node_at == NULL) || (doors == NULL) ||
+        (passed == NULL) || (node_pos == NULL))
+    {
+        destroy_key_graph(graph);
+        graph = NULL;
+    }
+    else
+    {
+        for (int i = 0; i < num_cells; ++i)
+        {
+            node_at[i] = -1;
+        }
+        for (int i = 0; i < num_robots; ++i)
+        {
+            node_pos[i] = overview->entrances[i];
+        }
+        for (int i = 0; i < overview->num_keys; ++i)
+        {
+            Key* k                           = overview->keys[i];
+            node_pos[num_robots + i]         = k->pos;
+            graph->node_keys[num_robots + i] = KEY_BIT(k->id);
+            graph->all_keys |= KEY_BIT(k->id);
+        }
+        for (int i = 0; i < num_nodes; ++i)
+        {
+            node_at[(node_pos[i].y * map->width) + node_pos[i].x] = i;
+        }
+        for (int i = 0; i < num_nodes; ++i)
+        {
+            search_from(graph,
+                        map,
+                        i,
+                        node_pos[i],
+                        node_at,
+                        field->queue,
+                        field->distance,
+                        doors,
+                        passed);
+        }
+    }
+
+    destroy_distance_field(field);
+    free(node_at);
+    free(doors);
+    free(passed);
+    free(node_pos);
+    return graph;
+}
+
+void destroy_key_graph(KeyGraph* const graph)
+{
+    if (graph != NULL)
+    {
+        free(graph->node_keys);
+        free(graph->distances);
+        free(graph->doors);
+        free(graph->passed);
+        free(graph);
+    }
+}
+
+int collect_all_keys(const KeyGraph* const graph)
+{
+    if (graph == NULL)
+    {
+        return -1;
+    }
+
+    int robots[MAX_ENTRANCES];
+    for (int i = 0; i < graph->num_robots; ++i)
+    {
+        robots[i] = i;
+    }
+    uint32_t region_keys[MAX_ENTRANCES];
+    if ((graph->num_robots == 1) || !independent_regions(graph, region_keys))
+    {
+        /*Doors couple the robots, every state holds the nodes of all of them.*/
+        return search_keys(graph, robots, graph->num_robots, 0);
+    }
+
+    /*The first region is searched on the calling thread.*/
+    RegionSearch searches[MAX_ENTRANCES];
+    int started[MAX_ENTRANCES] = {0};
+    for (int i = 0; i < graph->num_robots; ++i)
+    {
+        searches[i].graph     = graph;
+        searches[i].robot     = i;
+        searches[i].collected = graph->all_keys & ~region_keys[i];
+        searches[i].steps     = -1;
+    }
+    for (int i = 1; i < graph->num_robots; ++i)
+    {
+        started[i] = (pthread_create(&searches[i].thread, NULL, search_region, &searches[i]) == 0);
+    }
+    search_region(&searches[0]);
+
+    int result = 0;
+    for (int i = 0; i < graph->num_robots; ++i)
+    {
+        if (started[i])
+        {
+            pthread_join(searches[i].thread, NULL);
+        }
+        else if (i > 0)
+        {
+            search_region(&searches[i]);
+        }
+        result = ((result < 0) || (searches[i].steps < 0)) ? -1 : (result + searches[i].steps);
+    }
+    return result;
+}
+
+int independent_regions(const KeyGraph* const graph, uint32_t* const region_keys)
+{
+    if ((graph == NULL) || (region_keys == NULL))
+    {
+        return 0;
+    }
+
+    /*The keys reachable from an entrance form the region of its robot.*/
+    int num_nodes    = graph->num_nodes;
+    uint32_t claimed = 0;
+    for (int r = 0; r < graph->num_robots; ++r)
+    {
+        region_keys[r] = 0;
+        for (int node = graph->num_robots; node < num_nodes; ++node)
+        {
+            if (graph->distances[(r * num_nodes) + node] >= 0)
+            {
+                region_keys[r] |= graph->node_keys[node];
+            }
+        }
+        if (region_keys[r] & claimed)
+        {
+            return 0;
+        }
+        claimed |= region_keys[r];
+    }
+
+    /*A door of a key from another region makes a robot wait for the others.*/
+    for (int r = 0; r < graph->num_robots; ++r)
+    {
+        for (int from = 0; from < num_nodes; ++from)
+        {
+            if ((from != r) && !(graph->node_keys[from] & region_keys[r]))
+            {
+                continue;
+            }
+            for (int to = graph->num_robots; to < num_nodes; ++to)
+            {
+                size_t edge = ((size_t) from * num_nodes) + to;
+                if ((graph->node_keys[to] & region_keys[r]) &&
+                    (graph->doors[edge] & ~region_keys[r]))
+                {
+                    return 0;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+/*Dijkstra over the nodes of the robots and the collected keys, until all keys are collected.*/
+static int search_keys(const KeyGraph* const graph,
+                       const int* const robots,
+                       const int num_robots,
+                       const uint32_t collected)
+{
+    uint32_t start_nodes = 0;
+    for (int i = 0; i < num_robots; ++i)
+    {
+        start_nodes |= (uint32_t) robots[i] << (ROBOT_BITS * i);
+    }
+
+    /*The fewest steps found so far for every state.*/
+    MemoTable* table = create_memo_table(STATES_INITIAL_CAPACITY);
+    Heap heap        = {.entries = NULL, .size = 0, .capacity = 0};
+    int result       = -1;
+    int failed       = 0;
+    uint64_t start   = MEMO_KEY(collected, start_nodes);
+    int num_nodes    = graph->num_nodes;
+    if ((update_steps(table, start, 0) != 1) || !push_entry(&heap, 0, start))
+    {
+        heap.size = 0;
+    }
+
+    while ((heap.size > 0) && !failed)
+    {
+        QueueEntry entry = pop_entry(&heap);
+        uint32_t nodes   = (uint32_t) (entry.state & UINT32_MAX);
+        uint32_t keys    = (uint32_t) (entry.state >> 32);
+        int64_t* best    = find_memo(table, entry.state);
+        if ((best != NULL) && (*best < entry.steps))
+        {
+            /*Outdated entry, the state has been reached with fewer steps since.*/
+            continue;
+        }
+        if (keys == graph->all_keys)
+        {
+            result = entry.steps;
+            break;
+        }
+
+        for (int i = 0; (i < num_robots) && !failed; ++i)
+        {
+            int shift = ROBOT_BITS * i;
+            int node  = (int) ((nodes >> shift) & ROBOT_MASK);
+            for (int next = graph->num_robots; next < num_nodes; ++next)
+            {
+                size_t edge  = ((size_t) node * num_nodes) + next;
+                uint32_t key = graph->node_keys[next];
+                int distance = graph->distances[edge];
+                if ((keys & key) || (distance < 0) || (graph->doors[edge] & ~keys))
+                {
+                    continue;
+                }
+                /*A key on the way is collected first, the path through it is just as long.*/
+                if (graph->passed[edge] & ~keys)
+                {
+                    continue;
+                }
+
+                uint32_t moved = (nodes & ~(ROBOT_MASK << shift)) | ((uint32_t) next << shift);
+                uint64_t state = MEMO_KEY(keys | key, moved);
+                int steps      = entry.steps + distance;
+                int updated    = update_steps(table, state, steps);
+                if ((updated < 0) || ((updated > 0) && !push_entry(&heap, steps, state)))
+                {
+                    failed = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    free(heap.entries);
+    destroy_memo_table(table);
+    return result;
+}
+
+static void* search_region(void* arg)
+{
+    RegionSearch* search = (RegionSearch*) arg;
+    search->steps        = search_keys(search->graph, &search->robot, 1, search->collected);
+    return NULL;
+}
+
+/*Breadth first search from a node, records the path to every other node.*/
+static void search_from(KeyGraph* const graph,
+                        const Map* const map,
+                        const int source,
+                        const Position pos,
+                        const int* const node_at,
+                        int* const queue,
+                        int* const distance,
+                        uint32_t* const doors,
+                        uint32_t* const passed)
+{
+    int num_cells = map->width * map->height;
+    int num_nodes = graph->num_nodes;
+    for (int i = 0; i < num_cells; ++i)
+    {
+        distance[i] = -1;
+    }
+    for (int i = 0; i < num_nodes; ++i)
+    {
+        graph->distances[(source * num_nodes) + i] = -1;
+    }
+
+    const int dx[] = {0, 0, 1, -1};
+    const int dy[] = {-1, 1, 0, 0};
+
+    int head        = 0;
+    int tail        = 0;
+    int start       = (pos.y * map->width) + pos.x;
+    distance[start] = 0;
+    doors[start]    = 0;
+    passed[start]   = 0;
+    queue[tail++]   = start;
+
+    while (head < tail)
+    {
+        int cell = queue[head++];
+        int node = node_at[cell];
+        if (node >= 0)
+        {
+            size_t edge            = ((size_t) source * num_nodes) + node;
+            graph->distances[edge] = distance[cell];
+            graph->doors[edge]     = doors[cell];
+            graph->passed[edge]    = passed[cell];
+        }
+
+        /*Paths leading on from here pass the key of this cell.*/
+        uint32_t passed_here = passed[cell];
+        if ((node >= 0) && (node != source))
+        {
+            passed_here |= graph->node_keys[node];
+        }
+
+        int x = cell % map->width;
+        int y = cell / map->width;
+        for (int d = 0; d < 4; ++d)
+        {
+            int nx = x + dx[d];
+            int ny = y + dy[d];
+            if ((nx < 0) || (nx >= map->width) || (ny < 0) || (ny >= map->height))
+            {
+                continue;
+            }
+            int next = (ny * map->width) + nx;
+            char c   = map->data[next];
+            if ((c == WALL) || (distance[next] >= 0))
+            {
+                continue;
+            }
+            distance[next] = distance[cell] + 1;
+            doors[next]    = doors[cell];
+            passed[next]   = passed_here;
+            if (isupper(c))
+            {
+                doors[next] |= KEY_BIT(tolower(c));
+            }
+            queue[tail++] = next;
+        }
+    }
+}
+
+static int push_entry(Heap* const heap, const int steps, const uint64_t state)
+{
+    if (heap->size == heap->capacity)
+    {
+        int capacity = (heap->capacity == 0) ? HEAP_INITIAL_CAPACITY : (2 * heap->capacity);
+        QueueEntry* entries =
+            (QueueEntry*) realloc(heap->entries, sizeof(QueueEntry) * capacity);
+        if (entries == NULL)
+        {
+            return 0;
+        }
+        heap->entries  = entries;
+        heap->capacity = capacity;
+    }
+
+    /*Sift up*/
+    int index = heap->size++;
+    while (index > 0)
+    {
+        int parent = (index - 1) / 2;
+        if (heap->entries[parent].steps <= steps)
+        {
+            break;
+        }
+        heap->entries[index] = heap->entries[parent];
+        index                = parent;
+    }
+    heap->entries[index].steps = steps;
+    heap->entries[index].state = state;
+    return 1;
+}
+
+static QueueEntry pop_entry(Heap* const heap)
+{
+    assert(heap->size > 0);
+    QueueEntry top  = heap->entries[0];
+    QueueEntry last = heap->entries[--heap->size];
+
+    /*Sift down*/
+    int index = 0;
+    while (1)
+    {
+        int child = (2 * index) + 1;
+        if (child >= heap->size)
+        {
+            break;
+        }
+        if ((child + 1 < heap->size) &&
+            (heap->entries[child + 1].steps < heap->entries[child].steps))
+        {
+            child++;
+        }
+        if (last.steps <= heap->entries[child].steps)
+        {
+            break;
+        }
+        heap->entries[index] = heap->entries[child];
+        index                = child;
+    }
+    if (heap->size > 0)
+    {
+        heap->entries[index] = last;
+    }
+    return top;
+}
+
+/*Returns 1 if the state got fewer steps, 0 if it is reached with fewer already, -1 on errors.*/
+static int update_steps(MemoTable* const table, const uint64_t state, const int steps)
+{
+    int inserted  = 0;
+    int64_t* best = insert_memo(table, state, steps, &inserted);
+    if (best == NULL)
+    {
+        return -1;
+    }
+    if (inserted)
+    {
+        return 1;
+    }
+    if (*best <= steps)
+    {
+        return 0;
+    }
+    *best = steps;
+    return 1;
+}
@@ -6,9 +6,11 @@
  */
 
 #include "challenge/challenge_lib.h"
+#include "challenge/key_graph.h"
 #include "stdbool.h"
 #include "stdio.h"
 #include "stdlib.h"
+#include "string.h"
 
 void read_input_numbers(const int argc, char** argv, int* input)
 {
@@ -20,14 +22,15 @@ void read_input_numbers(const int argc, char** argv, int* input)
 
 int main(int argc, char* argv[])
 {
-    if (argc != 6)
+    if ((argc != 6) && ((argc != 7) || (strcmp(argv[6], "split") != 0)))
     {
-        printf("This executabel takes exactly 4 arguments.\n");
-        printf("Usage: aoc2019_18 FILE_PATH HEIGHT WIDTH NUM_KEYS NUM_DOORS.\n");
+        printf("This executabel takes five or six arguments.\n");
+        printf("Usage: aoc2019_18 FILE_PATH HEIGHT WIDTH NUM_KEYS NUM_DOORS [split].\n");
+        printf("With split the entrance is split into four, with one robot each.\n");
         return 0;
     }
 
-    int amount_of_numbers = argc - 2;
+    int amount_of_numbers = 4;
     int numbers[amount_of_numbers];
     read_input_numbers(amount_of_numbers, argv + 2, numbers);
 
@@ -36,6 +39,12 @@ int main(int argc, char* argv[])
     {
         return 0;
     }
+    if ((argc == 7) && !split_entrance(overview))
+    {
+        printf("The entrance can not be split.\n");
+        destroy_overview(overview);
+        return 0;
+    }
     printf("Overview size: %d, %d. Keys: %d\n",
            overview->map->width,
            overview->map->height,
@@ -43,8 +52,11 @@ int main(int argc, char* argv[])
 
     print_map(overview->map);
 
-    int step_count = minimal_steps(overview);
+    /*The recursive minimal_steps takes minutes for larger vaults, a graph of the keys does not.*/
+    KeyGraph* graph = build_key_graph(overview);
+    int step_count  = collect_all_keys(graph);
     printf("Minimal step count for all keys: %d\n", step_count);
+    destroy_key_graph(graph);
 
     destroy_overview(overview);
     return 0;
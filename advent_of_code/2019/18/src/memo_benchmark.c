@@ -0,0 +1,107 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *  Date: 2020-06-20
+ *
+ */
+
+#include "challenge/memo_table.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "time.h"
+
+#define DEFAULT_ENTRIES (1u << 21)
+#define DEFAULT_ROUNDS (5)
+#define NUM_POSITIONS (81 * 81)
+
+static double now_ms()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000.0) + (now.tv_nsec / 1000000.0);
+}
+
+/*Keys like the ones of a search: 26 key bits above a cell of the input.*/
+static uint64_t make_key(const size_t i)
+{
+    uint64_t mixed = (uint64_t) i * 0x9E3779B97F4A7C15ull;
+    return MEMO_KEY((uint32_t) (mixed >> 38), (uint32_t) (i % NUM_POSITIONS));
+}
+
+static void report(const char* name, const size_t operations, const double ms, const int64_t sum)
+{
+    printf("%-8s %10zu %10.2f %10.2f %20lld\n",
+           name,
+           operations,
+           ms,
+           (ms > 0.0) ? (operations / (ms * 1000.0)) : 0.0,
+           (long long) sum);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 3)
+    {
+        printf("This executabel takes up to two arguments.\n");
+        printf("Usage: aoc2019_18_memo_benchmark [ENTRIES] [ROUNDS].\n");
+        return 0;
+    }
+
+    size_t num_entries = (argc >= 2) ? strtoul(argv[1], NULL, 10) : DEFAULT_ENTRIES;
+    size_t rounds      = (argc == 3) ? strtoul(argv[2], NULL, 10) : DEFAULT_ROUNDS;
+    if ((num_entries == 0) || (rounds == 0))
+    {
+        return 0;
+    }
+
+    /*Starts small, so growing the table is part of the measurement.*/
+    MemoTable* table = create_memo_table(0);
+    if (table == NULL)
+    {
+        printf("Error allocating the table.\n");
+        return 1;
+    }
+
+    printf("Entries: %zu, rounds: %zu\n", num_entries, rounds);
+    printf("%-8s %10s %10s %10s %20s\n", "phase", "ops", "ms", "M ops/s", "checksum");
+
+    double start = now_ms();
+    for (size_t i = 0; i < num_entries; ++i)
+    {
+        if (insert_memo(table, make_key(i), (int64_t) i, NULL) == NULL)
+        {
+            printf("Error inserting entry %zu.\n", i);
+            destroy_memo_table(table);
+            return 1;
+        }
+    }
+    report("insert", num_entries, now_ms() - start, (int64_t) get_memo_size(table));
+
+    /*Hits in a different order than inserted, so the probes do not follow the arena.*/
+    int64_t sum = 0;
+    start       = now_ms();
+    for (size_t r = 0; r < rounds; ++r)
+    {
+        for (size_t i = 0; i < num_entries; ++i)
+        {
+            size_t index         = (i * 7919u) % num_entries;
+            const int64_t* value = find_memo(table, make_key(index));
+            sum += (value != NULL) ? *value : -1;
+        }
+    }
+    report("hit", rounds * num_entries, now_ms() - start, sum);
+
+    sum   = 0;
+    start = now_ms();
+    for (size_t r = 0; r < rounds; ++r)
+    {
+        for (size_t i = 0; i < num_entries; ++i)
+        {
+            sum += (find_memo(table, make_key(num_entries + i)) == NULL);
+        }
+    }
+    report("miss", rounds * num_entries, now_ms() - start, sum);
+
+    destroy_memo_table(table);
+    return 0;
+}
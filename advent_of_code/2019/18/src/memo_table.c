@@ -0,0 +1,233 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *  Date: 2020-06-20
+ *
+ */
+
+#include "challenge/memo_table.h"
+#include "string.h"
+
+/*The arena grows by blocks, entries are never copied.*/
+#define MEMO_BLOCK_BITS 12
+#define MEMO_BLOCK_SIZE (1u << MEMO_BLOCK_BITS)
+#define MEMO_BLOCK_MASK (MEMO_BLOCK_SIZE - 1u)
+#define MEMO_MIN_SLOT_BITS 6
+#define MEMO_MAX_ENTRIES (UINT32_MAX - 1u)
+
+typedef struct
+{
+    int64_t value;
+} MemoEntry;
+
+/*The key is kept next to the index, so probing does not touch the arena.*/
+typedef struct
+{
+    uint64_t key;
+    /*Index of the entry plus one, 0 marks an empty slot.*/
+    uint32_t entry;
+} MemoSlot;
+
+struct MemoTable
+{
+    MemoSlot* slots;
+    int slot_bits;
+    size_t count;
+    MemoEntry** blocks;
+    size_t num_blocks;
+    size_t blocks_capacity;
+};
+
+static int grow_slots(MemoTable* const table);
+static MemoEntry* new_entry(MemoTable* const table);
+
+static inline size_t hash_key(const uint64_t key, const int slot_bits)
+{
+    /*Fibonacci hashing, the upper bits depend on all bits of the key.*/
+    return (size_t) ((key * 11400714819323198485ull) >> (64 - slot_bits));
+}
+
+static inline MemoEntry* get_entry(const MemoTable* const table, const uint32_t index)
+{
+    return &table->blocks[index >> MEMO_BLOCK_BITS][index & MEMO_BLOCK_MASK];
+}
+
+MemoTable* create_memo_table(const size_t expected_entries)
+{
+    MemoTable* table = (MemoTable*) malloc(sizeof(MemoTable));
+    if (table != NULL)
+    {
+        /*Room for the expected entries below the maximum load factor of 1/2.*/
+        int slot_bits = MEMO_MIN_SLOT_BITS;
+        while ((((size_t) 1) << slot_bits) < 2 * expected_entries)
+        {
+            slot_bits++;
+        }
+        table->slot_bits       = slot_bits;
+        table->count           = 0;
+        table->blocks          = NULL;
+        table->num_blocks      = 0;
+        table->blocks_capacity = 0;
+        table->slots           = (MemoSlot*) calloc(((size_t) 1) << slot_bits, sizeof(MemoSlot));
+        if (table->slots == NULL)
+        {
+            free(table);
+            table = NULL;
+        }
+    }
+    return table;
+}
+
+void destroy_memo_table(MemoTable* const table)
+{
+    if (table != NULL)
+    {
+        for (size_t i = 0; i < table->num_blocks; ++i)
+        {
+            free(table->blocks[i]);
+        }
+        free(table->blocks);
+        free(table->slots);
+        free(table);
+    }
+}
+
+void clear_memo_table(MemoTable* const table)
+{
+    if (table != NULL)
+    {
+        /*The blocks of the arena are kept for the next entries.*/
+        memset(table->slots, 0, sizeof(MemoSlot) << table->slot_bits);
+        table->count = 0;
+    }
+}
+
+int64_t* find_memo(const MemoTable* const table, const uint64_t key)
+{
+    if (table == NULL)
+    {
+        return NULL;
+    }
+    size_t mask = (((size_t) 1) << table->slot_bits) - 1;
+    size_t slot = hash_key(key, table->slot_bits);
+    while (table->slots[slot].entry != 0)
+    {
+        if (table->slots[slot].key == key)
+        {
+            return &get_entry(table, table->slots[slot].entry - 1)->value;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
+int64_t* insert_memo(MemoTable* const table,
+                     const uint64_t key,
+                     const int64_t value,
+                     int* const inserted)
+{
+    if (inserted != NULL)
+    {
+        *inserted = 0;
+    }
+    if (table == NULL)
+    {
+        return NULL;
+    }
+    int64_t* existing = find_memo(table, key);
+    if (existing != NULL)
+    {
+        return existing;
+    }
+
+    /*Keep the load factor below 1/2 so probing sequences stay short.*/
+    if ((2 * (table->count + 1) > (((size_t) 1) << table->slot_bits)) && !grow_slots(table))
+    {
+        return NULL;
+    }
+    MemoEntry* entry = new_entry(table);
+    if (entry == NULL)
+    {
+        return NULL;
+    }
+    entry->value = value;
+
+    size_t mask = (((size_t) 1) << table->slot_bits) - 1;
+    size_t slot = hash_key(key, table->slot_bits);
+    while (table->slots[slot].entry != 0)
+    {
+        slot = (slot + 1) & mask;
+    }
+    table->count++;
+    table->slots[slot].key   = key;
+    table->slots[slot].entry = (uint32_t) table->count;
+    if (inserted != NULL)
+    {
+        *inserted = 1;
+    }
+    return &entry->value;
+}
+
+size_t get_memo_size(const MemoTable* const table)
+{
+    return (table != NULL) ? table->count : 0;
+}
+
+static int grow_slots(MemoTable* const table)
+{
+    int slot_bits   = table->slot_bits + 1;
+    size_t mask     = (((size_t) 1) << slot_bits) - 1;
+    MemoSlot* slots = (MemoSlot*) calloc(mask + 1, sizeof(MemoSlot));
+    if (slots == NULL)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < (((size_t) 1) << table->slot_bits); ++i)
+    {
+        if (table->slots[i].entry != 0)
+        {
+            size_t slot = hash_key(table->slots[i].key, slot_bits);
+            while (slots[slot].entry != 0)
+            {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = table->slots[i];
+        }
+    }
+    free(table->slots);
+    table->slots     = slots;
+    table->slot_bits = slot_bits;
+    return 1;
+}
+
+/*The next unused entry of the arena, entries of a cleared table are reused.*/
+static MemoEntry* new_entry(MemoTable* const table)
+{
+    if (table->count >= MEMO_MAX_ENTRIES)
+    {
+        return NULL;
+    }
+    size_t block = table->count >> MEMO_BLOCK_BITS;
+    if (block == table->num_blocks)
+    {
+        if (table->num_blocks == table->blocks_capacity)
+        {
+            size_t capacity = (table->blocks_capacity == 0) ? 16 : (2 * table->blocks_capacity);
+            MemoEntry** blocks =
+                (MemoEntry**) realloc(table->blocks, sizeof(MemoEntry*) * capacity);
+            if (blocks == NULL)
+            {
+                return NULL;
+            }
+            table->blocks          = blocks;
+            table->blocks_capacity = capacity;
+        }
+        table->blocks[block] = (MemoEntry*) malloc(sizeof(MemoEntry) * MEMO_BLOCK_SIZE);
+        if (table->blocks[block] == NULL)
+        {
+            return NULL;
+        }
+        table->num_blocks++;
+    }
+    return &table->blocks[block][table->count & MEMO_BLOCK_MASK];
+}
@@ -27,3 +27,16 @@ TEST_F(challenge_test, pos_test_01)
     bool ret = true;
     ASSERT_TRUE(ret);
 }
+
+TEST_F(challenge_test, minimal_steps_01)
+{
+    Overview* overview = read_input("test_input_01.txt", 9, 3, 2, 1);
+    ASSERT_TRUE(overview != NULL);
+    ASSERT_EQ(minimal_steps(overview), 8);
+    destroy_overview(overview);
+
+    overview = read_input("test_input_02.txt", 24, 5, 6, 5);
+    ASSERT_TRUE(overview != NULL);
+    ASSERT_EQ(minimal_steps(overview), 86);
+    destroy_overview(overview);
+}
@@ -0,0 +1,96 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *  Date: 2020-06-27
+ *
+ */
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+extern "C" {
+#include "challenge/challenge_lib.h"
+#include "challenge/distance_field.h"
+#include "challenge/key_graph.h"
+}
+
+TEST(distance_field_test, fill_distances_01)
+{
+    // #########
+    // #b.A.@.a#
+    // #########
+    Overview* overview = read_input("test_input_01.txt", 9, 3, 2, 1);
+    ASSERT_TRUE(overview != NULL);
+    DistanceField* field = create_distance_field(9, 3);
+    ASSERT_TRUE(field != NULL);
+
+    /*The door A blocks the way to b until a is collected.*/
+    ASSERT_EQ(fill_distances(field, overview->map, overview->entrance, 0), 4);
+    ASSERT_EQ(field->distance[9 + 7], 2);
+    ASSERT_EQ(field->distance[9 + 1], -1);
+    ASSERT_EQ(fill_distances(field, overview->map, overview->entrance, KEY_BIT('a')), 7);
+    ASSERT_EQ(field->distance[9 + 1], 4);
+    ASSERT_EQ(field->distance[0], -1);
+
+    destroy_distance_field(field);
+    destroy_overview(overview);
+}
+
+TEST(distance_field_test, large_map_01)
+{
+    /*Far too many cells for a recursion along the path.*/
+    const int size = 2000;
+    std::vector<char> data(size * size, '.');
+    Map map        = {data.data(), size, size};
+    Position start = {0, 0};
+
+    DistanceField* field = create_distance_field(size, size);
+    ASSERT_TRUE(field != NULL);
+    ASSERT_EQ(fill_distances(field, &map, start, 0), size * size);
+    ASSERT_EQ(field->distance[(size * size) - 1], 2 * (size - 1));
+    destroy_distance_field(field);
+}
+
+TEST(distance_field_test, sweep_distances_01)
+{
+    Overview* overview = read_input("input.txt", 81, 81, 26, 26);
+    ASSERT_TRUE(overview != NULL);
+    DistanceField* field = create_distance_field(81, 81);
+    ASSERT_TRUE(field != NULL);
+
+    /*The sweep matches one search per source, with and without the doors.*/
+    int num_sources = overview->num_keys + 1;
+    std::vector<Position> sources(num_sources);
+    uint32_t all_keys = 0;
+    sources[0]        = overview->entrance;
+    for (int i = 0; i < overview->num_keys; ++i)
+    {
+        sources[i + 1] = overview->keys[i]->pos;
+        all_keys |= KEY_BIT(overview->keys[i]->id);
+    }
+
+    std::vector<int> distances(num_sources * num_sources);
+    for (uint32_t open_doors : {0u, all_keys})
+    {
+        ASSERT_TRUE(sweep_distances(field,
+                                    overview->map,
+                                    sources.data(),
+                                    num_sources,
+                                    open_doors,
+                                    distances.data()));
+        std::vector<int> expected;
+        for (int s = 0; s < num_sources; ++s)
+        {
+            ASSERT_GT(fill_distances(field, overview->map, sources[s], open_doors), 0);
+            for (int t = 0; t < num_sources; ++t)
+            {
+                expected.push_back(field->distance[(sources[t].y * 81) + sources[t].x]);
+            }
+        }
+        ASSERT_EQ(distances, expected);
+    }
+
+    destroy_distance_field(field);
+    destroy_overview(overview);
+}
@@ -0,0 +1,149 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *  Date: 2020-06-14
+ *
+ */
+
+#include "gtest/gtest.h"
+
+#include <string>
+
+extern "C" {
+#include "challenge/challenge_lib.h"
+#include "challenge/key_graph.h"
+}
+
+typedef struct
+{
+    std::string file_path;
+    int width;
+    int height;
+    int num_keys;
+    int num_doors;
+    int steps;
+} VaultParam;
+
+class key_graph_test : public ::testing::TestWithParam<VaultParam>
+{
+  protected:
+    void SetUp() override
+    {
+        const VaultParam& param = GetParam();
+        overview                = read_input(param.file_path.c_str(),
+                              param.width,
+                              param.height,
+                              param.num_keys,
+                              param.num_doors);
+        ASSERT_TRUE(overview != NULL);
+    }
+
+    void TearDown() override { destroy_overview(overview); }
+
+    Overview* overview = NULL;
+};
+
+TEST_P(key_graph_test, collect_all_keys_01)
+{
+    KeyGraph* graph = build_key_graph(overview);
+    ASSERT_TRUE(graph != NULL);
+    ASSERT_EQ(graph->num_nodes, GetParam().num_keys + 1);
+    ASSERT_EQ(collect_all_keys(graph), GetParam().steps);
+    destroy_key_graph(graph);
+}
+
+INSTANTIATE_TEST_SUITE_P(vaults,
+                         key_graph_test,
+                         ::testing::Values(VaultParam{"test_input_01.txt", 9, 3, 2, 1, 8},
+                                           VaultParam{"test_input_02.txt", 24, 5, 6, 5, 86},
+                                           VaultParam{"test_input_03.txt", 24, 5, 7, 5, 132},
+                                           VaultParam{"test_input_04.txt", 17, 9, 16, 8, 136},
+                                           VaultParam{"test_input_05.txt", 24, 6, 9, 5, 81},
+                                           VaultParam{"input.txt", 81, 81, 26, 26, 3646}));
+
+class split_key_graph_test : public key_graph_test
+{
+};
+
+TEST_P(split_key_graph_test, collect_all_keys_01)
+{
+    ASSERT_TRUE(split_entrance(overview));
+    ASSERT_EQ(overview->num_entrances, 4);
+    KeyGraph* graph = build_key_graph(overview);
+    ASSERT_TRUE(graph != NULL);
+    ASSERT_EQ(graph->num_robots, 4);
+    ASSERT_EQ(collect_all_keys(graph), GetParam().steps);
+    destroy_key_graph(graph);
+}
+
+INSTANTIATE_TEST_SUITE_P(vaults,
+                         split_key_graph_test,
+                         ::testing::Values(VaultParam{"test_input_07.txt", 7, 7, 4, 3, 8},
+                                           VaultParam{"test_input_08.txt", 15, 7, 4, 3, 24},
+                                           VaultParam{"test_input_09.txt", 13, 7, 12, 11, 32},
+                                           VaultParam{"test_input_10.txt", 13, 9, 15, 13, 72},
+                                           VaultParam{"input.txt", 81, 81, 26, 26, 1730}));
+
+TEST(key_graph_edge_test, independent_regions_01)
+{
+    // ###########
+    // #bA.a@#@.c#
+    // ###########
+    // #d..@#@eEf#
+    // ###########
+    Overview* overview = read_input("test_input_11.txt", 11, 5, 6, 2);
+    ASSERT_TRUE(overview != NULL);
+    ASSERT_EQ(overview->num_entrances, 4);
+    ASSERT_FALSE(split_entrance(overview));
+    KeyGraph* graph = build_key_graph(overview);
+    ASSERT_TRUE(graph != NULL);
+
+    uint32_t region_keys[MAX_ENTRANCES];
+    ASSERT_TRUE(independent_regions(graph, region_keys));
+    ASSERT_EQ(region_keys[0], KEY_BIT('a') | KEY_BIT('b'));
+    ASSERT_EQ(region_keys[1], KEY_BIT('c'));
+    ASSERT_EQ(region_keys[2], KEY_BIT('d'));
+    ASSERT_EQ(region_keys[3], KEY_BIT('e') | KEY_BIT('f'));
+    ASSERT_EQ(collect_all_keys(graph), 4 + 2 + 3 + 3);
+    destroy_key_graph(graph);
+    destroy_overview(overview);
+}
+
+TEST(key_graph_edge_test, coupled_regions_01)
+{
+    Overview* overview = read_input("test_input_07.txt", 7, 7, 4, 3);
+    ASSERT_TRUE(overview != NULL);
+    ASSERT_TRUE(split_entrance(overview));
+    KeyGraph* graph = build_key_graph(overview);
+    ASSERT_TRUE(graph != NULL);
+
+    /*The door C in the upper right needs the key c from the lower left.*/
+    uint32_t region_keys[MAX_ENTRANCES];
+    ASSERT_FALSE(independent_regions(graph, region_keys));
+    destroy_key_graph(graph);
+    destroy_overview(overview);
+}
+
+TEST(key_graph_edge_test, doors_and_passed_keys_01)
+{
+    // #########
+    // #b.A.@.a#
+    // #########
+    Overview* overview = read_input("test_input_01.txt", 9, 3, 2, 1);
+    ASSERT_TRUE(overview != NULL);
+    KeyGraph* graph = build_key_graph(overview);
+    ASSERT_TRUE(graph != NULL);
+
+    /*Node 0 is the only entrance, the keys follow in reading order.*/
+    int num_nodes = graph->num_nodes;
+    int b         = 1;
+    int a         = 2;
+    ASSERT_EQ(graph->node_keys[b], KEY_BIT('b'));
+    ASSERT_EQ(graph->distances[a], 2);
+    ASSERT_EQ(graph->distances[b], 4);
+    ASSERT_EQ(graph->doors[b], KEY_BIT('a'));
+    ASSERT_EQ(graph->passed[(a * num_nodes) + b], 0u);
+    ASSERT_EQ(graph->doors[(a * num_nodes) + b], KEY_BIT('a'));
+    destroy_key_graph(graph);
+    destroy_overview(overview);
+}
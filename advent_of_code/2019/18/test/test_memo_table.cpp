@@ -0,0 +1,62 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *  Date: 2020-06-20
+ *
+ */
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "challenge/memo_table.h"
+}
+
+TEST(memo_table_test, insert_find_01)
+{
+    MemoTable* table = create_memo_table(0);
+    ASSERT_TRUE(table != NULL);
+
+    int inserted   = 0;
+    int64_t* value = insert_memo(table, MEMO_KEY(0x3u, 7), 42, &inserted);
+    ASSERT_TRUE(value != NULL);
+    ASSERT_TRUE(inserted);
+
+    /*Inserting again returns the stored value, which can be updated in place.*/
+    ASSERT_EQ(insert_memo(table, MEMO_KEY(0x3u, 7), 13, &inserted), value);
+    ASSERT_FALSE(inserted);
+    ASSERT_EQ(*value, 42);
+    *value = 13;
+    ASSERT_EQ(*find_memo(table, MEMO_KEY(0x3u, 7)), 13);
+
+    /*Keys and positions are told apart.*/
+    ASSERT_TRUE(find_memo(table, MEMO_KEY(0x3u, 8)) == NULL);
+    ASSERT_TRUE(find_memo(table, MEMO_KEY(0x7u, 7)) == NULL);
+    ASSERT_EQ(get_memo_size(table), 1u);
+    destroy_memo_table(table);
+}
+
+TEST(memo_table_test, grow_01)
+{
+    // Values stay in place while the table grows.
+    MemoTable* table = create_memo_table(0);
+    int64_t* first   = insert_memo(table, MEMO_KEY(1u, 0), 0, NULL);
+    for (uint32_t i = 1; i < 100000; ++i)
+    {
+        ASSERT_TRUE(insert_memo(table, MEMO_KEY(i, i % 81), i, NULL) != NULL);
+    }
+    ASSERT_EQ(get_memo_size(table), 100000u);
+    ASSERT_EQ(find_memo(table, MEMO_KEY(1u, 0)), first);
+    for (uint32_t i = 1; i < 100000; ++i)
+    {
+        const int64_t* value = find_memo(table, MEMO_KEY(i, i % 81));
+        ASSERT_TRUE(value != NULL);
+        ASSERT_EQ(*value, i);
+    }
+
+    clear_memo_table(table);
+    ASSERT_EQ(get_memo_size(table), 0u);
+    ASSERT_TRUE(find_memo(table, MEMO_KEY(5u, 5)) == NULL);
+    ASSERT_TRUE(insert_memo(table, MEMO_KEY(5u, 5), 5, NULL) != NULL);
+    ASSERT_EQ(*find_memo(table, MEMO_KEY(5u, 5)), 5);
+    destroy_memo_table(table);
+}
@@ -9,10 +9,62 @@
 #define INCLUDE_CHALLENGE_LIB_H
 
 #include "challenge/intcode.h"
+#include "stdint.h"
+
+typedef struct
+{
+    int x;
+    int y;
+} beam_coordinate_t;
+
+typedef struct
+{
+    intcode_io_ring_t* io_in;
+    intcode_io_ring_t* io_out;
+    /*Runs many coordinates in lockstep, only set for the probes of a prober.*/
+    intcode_batch_t* lanes;
+} beam_probe_t;
+
+/*Runs batches of coordinates against one pre-parsed drone program.*/
+typedef struct
+{
+    intcode_t* image;
+    size_t num_workers;
+    beam_probe_t* probes;
+} beam_prober_t;
+
+/*Beam fields of one row, from left to right inclusive. Empty if left > right.*/
+typedef struct
+{
+    int row;
+    int left;
+    int right;
+} beam_edges_t;
+
+/*Follows the edges of the beam, which is a cone starting in the origin.*/
+typedef struct
+{
+    beam_prober_t* prober;
+    beam_edges_t reference;
+    size_t num_probes;
+    int failed;
+} beam_tracker_t;
 
 int64_t scan_coordinate(const intcode_t* const prog, const int x, const int y);
 
-/*Thread functions*/
-void* system_func(void* args);
+beam_prober_t* create_beam_prober(const intcode_t* const prog, const size_t num_workers);
+void destroy_beam_prober(beam_prober_t* const prober);
+int probe_coordinates(beam_prober_t* const prober,
+                      const beam_coordinate_t* const coordinates,
+                      const size_t num_coordinates,
+                      uint8_t* const bitmap);
+int get_probe_result(const uint8_t* const bitmap, const size_t index);
+
+int init_beam_tracker(beam_tracker_t* const tracker,
+                      beam_prober_t* const prober,
+                      const int row,
+                      const int cols);
+int find_beam_edges(beam_tracker_t* const tracker, const int row, beam_edges_t* const edges);
+int find_square(beam_tracker_t* const tracker, const int size, int* const x, int* const y);
 
 #endif /* ifndef INCLUDE_CHALLENGE_LIB_H */
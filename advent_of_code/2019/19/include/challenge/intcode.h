@@ -1,7 +1,7 @@
 /*
  *
  *  Author: Peter Wolf <pwolf2310@gmail.com>
- *  Date: 2020-05-06
+ *  Date: 2020-05-07
  *
  */
 
@@ -9,6 +9,7 @@
 #define INCLUDE_INTCODE_H
 
 #include "pthread.h"
+#include "stdint.h"
 #include "stdio.h"
 #include "stdlib.h"
 
@@ -17,14 +18,27 @@ typedef enum
     INT_CODE_ERROR    = 0,
     INT_CODE_HALT     = 1,
     INT_CODE_CONTINUE = 2,
+    /*Only returned if the machine yields on IO, see set_io_yield.*/
+    INT_CODE_BLOCKED  = 3,
 } intcode_ret_t;
 
 typedef enum
 {
-    INT_CODE_STD_IO = 0,
-    INT_CODE_MEM_IO = 1,
+    INT_CODE_STD_IO    = 0,
+    INT_CODE_MEM_IO    = 1,
+    INT_CODE_RING_IO   = 2,
+    /*Input is taken from a recorded session, see replay_intcode.*/
+    INT_CODE_REPLAY_IO = 3,
 } intcode_io_mode_t;
 
+typedef enum
+{
+    INT_CODE_ENGINE_STEP     = 0,
+    INT_CODE_ENGINE_THREADED = 1,
+    /*Translates basic blocks into specialized closures, self-modified code is interpreted.*/
+    INT_CODE_ENGINE_COMPILED = 2,
+} intcode_engine_t;
+
 typedef struct
 {
     int64_t value;
@@ -33,51 +47,184 @@ typedef struct
     pthread_cond_t cond;
 } intcode_io_mem_t;
 
+/*Bounded single-producer/single-consumer ring, see create_io_ring.*/
+typedef struct intcode_io_ring intcode_io_ring_t;
+
+/*Instances of one program that run in lockstep, see create_intcode_batch.*/
+typedef struct intcode_batch intcode_batch_t;
+
+/*Op codes are below 100, so they index the counters directly.*/
+#define INT_CODE_PROFILE_OPS (100)
+
+/*Counters of a profiled machine, see enable_profiling.*/
+typedef struct
+{
+    uint64_t instructions;
+    uint64_t op_counts[INT_CODE_PROFILE_OPS];
+    /*Executions per address of the first cell of an instruction.*/
+    uint64_t* address_counts;
+    size_t num_addresses;
+    uint64_t run_ns;
+    /*Time spent in input and output instructions, including waiting for the other side.*/
+    uint64_t input_ns;
+    uint64_t output_ns;
+    uint64_t num_blocked;
+    uint64_t page_allocations;
+    uint64_t page_copies;
+    uint64_t memory_growths;
+    FILE* report;
+} intcode_profile_t;
+
+/*Instruction sequences the compiled engine runs as a single closure, see enable_fusion_stats.*/
+typedef enum
+{
+    /*Adjusting the relative base by an immediate is folded into the following instructions.*/
+    INT_CODE_FUSION_REL_BASE     = 0,
+    /*A comparison followed by a jump on its result.*/
+    INT_CODE_FUSION_COMPARE_JUMP = 1,
+    /*Adding an immediate to a cell in place, followed by a jump.*/
+    INT_CODE_FUSION_COUNTER_JUMP = 2,
+    INT_CODE_FUSION_KINDS        = 3,
+} intcode_fusion_t;
+
+/*Every fused sequence that ran saved the dispatch of one instruction.*/
+typedef struct
+{
+    uint64_t fired[INT_CODE_FUSION_KINDS];
+} intcode_fusion_stats_t;
+
+/*Input or output of a recorded session, see start_recording.*/
 typedef struct
 {
-    int64_t* memory;
+    /*Instructions executed since the recording started, not counting this one.*/
+    uint64_t instruction;
+    int64_t value;
+    int is_output;
+} intcode_io_event_t;
+
+/*A recorded session read back from its file, see load_recording.*/
+typedef struct intcode_recording intcode_recording_t;
+
+/*Frozen state of a machine to restore or clone it, see snapshot_intcode.*/
+typedef struct intcode_snapshot intcode_snapshot_t;
+
+typedef struct intcode_decoded intcode_decoded_t;
+typedef struct intcode_page intcode_page_t;
+typedef struct intcode_page_entry intcode_page_entry_t;
+typedef struct intcode_translation intcode_translation_t;
+typedef struct intcode_recorder intcode_recorder_t;
+
+typedef struct
+{
+    intcode_engine_t engine;
+    intcode_page_t** pages;
+    size_t num_pages;
+    intcode_page_entry_t* sparse_pages;
+    size_t sparse_capacity;
+    size_t sparse_count;
     size_t memory_size;
     size_t head;
     int64_t relative_base;
     intcode_io_mode_t io_mode;
     intcode_io_mem_t* mem_io_in;
     intcode_io_mem_t* mem_io_out;
+    intcode_io_ring_t* ring_io_in;
+    intcode_io_ring_t* ring_io_out;
     FILE* std_io_in;
     FILE* std_io_out;
     int waiting_for_input;
+    int io_yield;
+    intcode_profile_t* profile;
+    intcode_translation_t* translation;
+    intcode_fusion_stats_t* fusion_stats;
+    intcode_recorder_t* recorder;
 } intcode_t;
 
-intcode_t* read_intcode(const char* const file_path);
-intcode_t* create_intcode(int64_t* const content, const size_t content_size);
-void destroy_intcode(intcode_t* const prog);
-void print_intcode(const intcode_t* const prog);
-int set_mem_value(intcode_t* const prog, const size_t address, const int64_t value);
-int64_t get_mem_value(const intcode_t* const prog, const size_t address);
-void set_io_mode(intcode_t* const prog, const intcode_io_mode_t mode);
-void set_mem_io_in(intcode_t* const prog, intcode_io_mem_t* const input_store);
-void set_mem_io_out(intcode_t* const prog, intcode_io_mem_t* const output_store);
-void set_std_io_in(intcode_t* const prog, FILE* const input_stream);
-void set_std_io_out(intcode_t* const prog, FILE* const output_stream);
-intcode_t* copy_intcode(const intcode_t* const prog);
-int output_intcode(const intcode_t* const prog);
-int waiting_for_input(const intcode_t* const prog);
+intcode_t* read_intcode(const char* file_path);
+intcode_t* parse_intcode(const char* text, size_t length);
+int write_intcode(const intcode_t* prog, const char* file_path);
+intcode_t* create_intcode(int64_t* memory, size_t memory_size);
+void destroy_intcode(intcode_t* prog);
+void print_intcode(const intcode_t* prog);
+int set_mem_value(intcode_t* prog, size_t address, int64_t value);
+int64_t get_mem_value(const intcode_t* prog, size_t address);
+void set_io_mode(intcode_t* prog, intcode_io_mode_t mode);
+void set_engine(intcode_t* prog, intcode_engine_t engine);
+void set_io_yield(intcode_t* prog, int yield);
+void set_mem_io_in(intcode_t* prog, intcode_io_mem_t* input_store);
+void set_mem_io_out(intcode_t* prog, intcode_io_mem_t* output_store);
+void set_ring_io_in(intcode_t* prog, intcode_io_ring_t* input_ring);
+void set_ring_io_out(intcode_t* prog, intcode_io_ring_t* output_ring);
+void set_std_io_in(intcode_t* prog, FILE* input_stream);
+void set_std_io_out(intcode_t* prog, FILE* output_stream);
+intcode_t* copy_intcode(const intcode_t* prog);
+intcode_t* fork_intcode(const intcode_t* prog);
+intcode_snapshot_t* snapshot_intcode(const intcode_t* prog);
+void destroy_snapshot(intcode_snapshot_t* snapshot);
+int restore_intcode(intcode_t* prog, const intcode_snapshot_t* snapshot);
+intcode_t* clone_snapshot(const intcode_snapshot_t* snapshot);
+uint64_t hash_intcode(const intcode_t* prog);
+uint64_t get_snapshot_hash(const intcode_snapshot_t* snapshot);
+int snapshots_equal(const intcode_snapshot_t* first, const intcode_snapshot_t* second);
+int output_intcode(const intcode_t* prog);
+int waiting_for_input(const intcode_t* prog);
+int providing_ouput(const intcode_t* prog);
 
 intcode_io_mem_t* create_io_mem();
-void destroy_io_mem(intcode_io_mem_t* const store);
-
-int execute(intcode_t* const prog);
-int execute_head_block(intcode_t* const prog, int* const op_code);
-
-int add_op(intcode_t* const prog, const int64_t* const parameters);
-int multiply_op(intcode_t* const prog, const int64_t* const parameters);
-int input_op(intcode_t* const prog, const int64_t* const parameters);
-int output_op(intcode_t* const prog, const int64_t* const parameters);
-int jmp_if_true_op(intcode_t* const prog, const int64_t* const parameters);
-int jmp_if_false_op(intcode_t* const prog, const int64_t* const parameters);
-int is_less_op(intcode_t* const prog, const int64_t* const parameters);
-int is_equals_op(intcode_t* const prog, const int64_t* const parameters);
-int adjust_rel_base_op(intcode_t* const prog, const int64_t* const parameters);
-int error_op(intcode_t* const prog, const int64_t* const parameters);
+void destroy_io_mem(intcode_io_mem_t* store);
+
+intcode_io_ring_t* create_io_ring(size_t capacity);
+void destroy_io_ring(intcode_io_ring_t* ring);
+void close_io_ring(intcode_io_ring_t* ring);
+size_t io_ring_size(const intcode_io_ring_t* ring);
+size_t io_ring_capacity(const intcode_io_ring_t* ring);
+int io_ring_closed(const intcode_io_ring_t* ring);
+size_t io_ring_try_write(intcode_io_ring_t* ring, const int64_t* values, size_t count);
+size_t io_ring_try_read(intcode_io_ring_t* ring, int64_t* values, size_t count);
+size_t io_ring_write(intcode_io_ring_t* ring, const int64_t* values, size_t count);
+size_t io_ring_read(intcode_io_ring_t* ring, int64_t* values, size_t count);
+
+int enable_profiling(intcode_t* prog, FILE* report);
+const intcode_profile_t* get_profile(const intcode_t* prog);
+void print_profile(const intcode_t* prog, FILE* stream);
+
+int enable_fusion_stats(intcode_t* prog);
+const intcode_fusion_stats_t* get_fusion_stats(const intcode_t* prog);
+void print_fusion_stats(const intcode_t* prog, FILE* stream);
+
+int start_recording(intcode_t* prog, const char* file_path, uint64_t checkpoint_interval);
+int stop_recording(intcode_t* prog);
+uint64_t get_instruction_count(const intcode_t* prog);
+intcode_recording_t* load_recording(const char* file_path);
+void destroy_recording(intcode_recording_t* recording);
+const intcode_io_event_t* get_recorded_events(const intcode_recording_t* recording,
+                                              size_t* num_events);
+intcode_t* replay_intcode(const intcode_recording_t* recording, uint64_t instruction);
+
+intcode_batch_t* create_intcode_batch(const intcode_t* prog, size_t num_lanes, size_t io_capacity);
+void destroy_intcode_batch(intcode_batch_t* batch);
+void reset_intcode_batch(intcode_batch_t* batch, size_t num_lanes);
+size_t intcode_batch_write(intcode_batch_t* batch,
+                           size_t lane,
+                           const int64_t* values,
+                           size_t count);
+size_t intcode_batch_read(intcode_batch_t* batch, size_t lane, int64_t* values, size_t count);
+int intcode_batch_status(const intcode_batch_t* batch, size_t lane);
+int execute_intcode_batch(intcode_batch_t* batch);
+
+int execute(intcode_t* prog);
+int execute_head_block(intcode_t* prog, int* op_code);
+
+int add_op(intcode_t* prog, const int64_t* parameters);
+int multiply_op(intcode_t* prog, const int64_t* parameters);
+int input_op(intcode_t* prog, const int64_t* parameters);
+int output_op(intcode_t* prog, const int64_t* parameters);
+int jmp_if_true_op(intcode_t* prog, const int64_t* parameters);
+int jmp_if_false_op(intcode_t* prog, const int64_t* parameters);
+int is_less_op(intcode_t* prog, const int64_t* parameters);
+int is_equals_op(intcode_t* prog, const int64_t* parameters);
+int adjust_rel_base_op(intcode_t* prog, const int64_t* parameters);
+int error_op(intcode_t* prog, const int64_t* parameters);
 
 
 #endif /* ifndef INCLUDE_CHALLENGE_LIB_H */
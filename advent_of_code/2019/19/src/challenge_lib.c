@@ -6,79 +6,144 @@
  */
 
 #include "challenge/challenge_lib.h"
-#include "assert.h"
 #include "stdio.h"
 #include "string.h"
-#include "unistd.h"
 
-static void provide_input(const intcode_t* const prog, const int value)
+/*Two coordinates in, one answer out.*/
+#define PROBE_RING_CAPACITY (4)
+/*Smaller batches are not worth waking up other cores for.*/
+#define PROBE_MIN_BATCH_PER_WORKER (64)
+/*Coordinates a worker runs in lockstep, the drones of neighbouring fields mostly agree.*/
+#define PROBE_LANES (64)
+
+/*Edges estimated from the reference row are off by a few fields at most.*/
+#define BEAM_SEARCH_MARGIN (4)
+/*The search for a square gives up on rows beyond this.*/
+#define BEAM_MAX_ROW (1 << 24)
+
+typedef struct
 {
-    assert(prog != NULL);
-    assert(prog->mem_io_in != NULL);
+    beam_prober_t* prober;
+    beam_probe_t* probe;
+    const beam_coordinate_t* coordinates;
+    size_t begin;
+    size_t end;
+    uint8_t* bitmap;
+    int success;
+} probe_batch_t;
 
-    intcode_io_mem_t* input = prog->mem_io_in;
-    pthread_mutex_lock(&input->mut);
-    while (!input->consumed)
-    {
-        pthread_cond_wait(&input->cond, &input->mut);
-    }
-    input->value    = value;
-    input->consumed = 0;
-    pthread_cond_signal(&input->cond);
-    pthread_mutex_unlock(&input->mut);
-    usleep(10);
+static int init_probe(beam_probe_t* const probe)
+{
+    probe->io_in  = create_io_ring(PROBE_RING_CAPACITY);
+    probe->io_out = create_io_ring(PROBE_RING_CAPACITY);
+    probe->lanes  = NULL;
+    return (probe->io_in != NULL) && (probe->io_out != NULL);
 }
 
-static int64_t read_output(const intcode_t* const prog)
+static void clear_probe(beam_probe_t* const probe)
 {
-    assert(prog != NULL);
-    assert(prog->mem_io_out != NULL);
-
-    int64_t read_value = -1;
+    destroy_io_ring(probe->io_in);
+    destroy_io_ring(probe->io_out);
+    destroy_intcode_batch(probe->lanes);
+}
 
-    intcode_io_mem_t* output = prog->mem_io_out;
-    pthread_mutex_lock(&output->mut);
-    while (output->consumed)
+/*Runs the drone program for a single coordinate on the calling thread.*/
+static int64_t run_probe(const beam_probe_t* const probe,
+                         const intcode_t* const image,
+                         const int x,
+                         const int y)
+{
+    int64_t result = -1;
+    intcode_t* drone = fork_intcode(image);
+    if (drone == NULL)
     {
-        pthread_cond_wait(&output->cond, &output->mut);
+        return result;
     }
 
-    read_value       = output->value;
-    output->consumed = 1;
-    pthread_cond_signal(&output->cond);
-    pthread_mutex_unlock(&output->mut);
+    /*Both coordinates are provided up front, so the drone only yields if it wants more input.*/
+    int64_t values[2] = {x, y};
+    io_ring_try_write(probe->io_in, values, 2);
+    set_io_mode(drone, INT_CODE_RING_IO);
+    set_io_yield(drone, 1);
+    set_ring_io_in(drone, probe->io_in);
+    set_ring_io_out(drone, probe->io_out);
+
+    int ret = execute(drone);
+    if ((ret != INT_CODE_HALT) || (io_ring_try_read(probe->io_out, &result, 1) != 1))
+    {
+        printf("Programm did not halt as expected. Err code: %d\n", ret);
+        result = -1;
+    }
 
-    return read_value;
+    /*Leftovers would be read by the next probe.*/
+    while (io_ring_try_read(probe->io_in, values, 2) > 0)
+    {
+    }
+    while (io_ring_try_read(probe->io_out, values, 2) > 0)
+    {
+    }
+    destroy_intcode(drone);
+    return result;
 }
 
-static int64_t provide_coordinate(const intcode_t* const prog, const int x, const int y)
+/*Runs up to PROBE_LANES coordinates starting at first in lockstep.*/
+static void run_lanes(probe_batch_t* const batch, const size_t first, const size_t count)
 {
-    int64_t resp = -1;
-    while (!waiting_for_input(prog))
+    intcode_batch_t* lanes = batch->probe->lanes;
+    reset_intcode_batch(lanes, count);
+    for (size_t k = 0; k < count; ++k)
     {
-        usleep(10);
+        const beam_coordinate_t* coordinate = &batch->coordinates[first + k];
+        int64_t values[2]                   = {coordinate->x, coordinate->y};
+        intcode_batch_write(lanes, k, values, 2);
     }
-    provide_input(prog, x);
-    while (!waiting_for_input(prog))
+    execute_intcode_batch(lanes);
+
+    for (size_t k = 0; k < count; ++k)
     {
-        usleep(10);
+        int64_t result = -1;
+        int ret        = intcode_batch_status(lanes, k);
+        if ((ret != INT_CODE_HALT) || (intcode_batch_read(lanes, k, &result, 1) != 1))
+        {
+            printf("Programm did not halt as expected. Err code: %d\n", ret);
+            batch->success = 0;
+        }
+        else if (result > 0)
+        {
+            /*Workers own whole bytes of the bitmap, see probe_coordinates.*/
+            batch->bitmap[(first + k) / 8] |= (uint8_t) (1u << ((first + k) % 8));
+        }
     }
-    provide_input(prog, y);
-    resp = read_output(prog);
-    return resp;
 }
 
-void* system_func(void* args)
+static void* probe_func(void* args)
 {
-    if (args == NULL)
+    probe_batch_t* batch = (probe_batch_t*) args;
+    batch->success       = 1;
+    /*A single coordinate is cheaper to run on a fork of its own.*/
+    if (batch->end > (batch->begin + 1))
     {
+        for (size_t first = batch->begin; first < batch->end; first += PROBE_LANES)
+        {
+            size_t count = batch->end - first;
+            run_lanes(batch, first, (count < PROBE_LANES) ? count : PROBE_LANES);
+        }
         return NULL;
     }
-    intcode_t* prog = (intcode_t*) args;
-    int ret         = execute(prog);
-    if (ret != INT_CODE_HALT)
+    for (size_t i = batch->begin; i < batch->end; ++i)
     {
-        printf("Programm did not halt as expected. Err code: %d\n", ret);
+        const beam_coordinate_t* coordinate = &batch->coordinates[i];
+        int64_t result =
+            run_probe(batch->probe, batch->prober->image, coordinate->x, coordinate->y);
+        if (result < 0)
+        {
+            batch->success = 0;
+        }
+        else if (result > 0)
+        {
+            /*Workers own whole bytes of the bitmap, see probe_coordinates.*/
+            batch->bitmap[i / 8] |= (uint8_t) (1u << (i % 8));
+        }
     }
     return NULL;
 }
@@ -91,30 +156,419 @@ int64_t scan_coordinate(const intcode_t* const prog, const int x, const int y)
         return result;
     }
 
-    intcode_t* exe_code      = copy_intcode(prog);
-    intcode_io_mem_t* io_in  = create_io_mem();
-    intcode_io_mem_t* io_out = create_io_mem();
-    set_io_mode(exe_code, INT_CODE_MEM_IO);
-    set_mem_io_in(exe_code, io_in);
-    set_mem_io_out(exe_code, io_out);
+    beam_probe_t probe;
+    if (init_probe(&probe))
+    {
+        result = run_probe(&probe, prog, x, y);
+    }
+    else
+    {
+        printf("Error allocating IO memory\n");
+    }
+    clear_probe(&probe);
+    return result;
+}
 
-    if ((exe_code == NULL) || (io_in == NULL) || (io_out == NULL))
+beam_prober_t* create_beam_prober(const intcode_t* const prog, const size_t num_workers)
+{
+    beam_prober_t* prober = NULL;
+    if (prog == NULL)
     {
-        printf("Error reading programm or allocating IO memory\n");
-        return -1;
+        return prober;
     }
 
-    pthread_t system_thread;
-    pthread_create(&system_thread, NULL, system_func, exe_code);
+    prober = (beam_prober_t*) malloc(sizeof(beam_prober_t));
+    if (prober != NULL)
+    {
+        /*Forking shares and decodes the pages of the image once, afterwards it is only read and*/
+        /*can be forked by all workers at the same time.*/
+        prober->image       = fork_intcode(prog);
+        prober->num_workers = (num_workers > 0) ? num_workers : 1;
+        prober->probes      = (beam_probe_t*) calloc(prober->num_workers, sizeof(beam_probe_t));
+        int success         = (prober->image != NULL) && (prober->probes != NULL);
+        for (size_t i = 0; success && (i < prober->num_workers); ++i)
+        {
+            beam_probe_t* probe = &prober->probes[i];
+            success             = init_probe(probe);
+            probe->lanes = create_intcode_batch(prober->image, PROBE_LANES, PROBE_RING_CAPACITY);
+            success      = success && (probe->lanes != NULL);
+        }
+        if (!success)
+        {
+            destroy_beam_prober(prober);
+            prober = NULL;
+        }
+        else
+        {
+            set_engine(prober->image, INT_CODE_ENGINE_THREADED);
+        }
+    }
+    return prober;
+}
 
-    result = provide_coordinate(exe_code, x, y);
+void destroy_beam_prober(beam_prober_t* const prober)
+{
+    if (prober != NULL)
+    {
+        for (size_t i = 0; (prober->probes != NULL) && (i < prober->num_workers); ++i)
+        {
+            clear_probe(&prober->probes[i]);
+        }
+        destroy_intcode(prober->image);
+        free(prober->probes);
+        free(prober);
+    }
+}
 
-    /*Wait for threads to finish.*/
-    pthread_join(system_thread, NULL);
+int probe_coordinates(beam_prober_t* const prober,
+                      const beam_coordinate_t* const coordinates,
+                      const size_t num_coordinates,
+                      uint8_t* const bitmap)
+{
+    int success = 0;
+    if ((prober == NULL) || (coordinates == NULL) || (bitmap == NULL))
+    {
+        return success;
+    }
+    memset(bitmap, 0, (num_coordinates + 7) / 8);
 
-    destroy_io_mem(io_in);
-    destroy_io_mem(io_out);
-    destroy_intcode(exe_code);
+    size_t num_workers = num_coordinates / PROBE_MIN_BATCH_PER_WORKER;
+    if (num_workers > prober->num_workers)
+    {
+        num_workers = prober->num_workers;
+    }
+    if (num_workers == 0)
+    {
+        num_workers = 1;
+    }
 
+    /*Batches are split on whole bitmap bytes, so no two workers write the same byte.*/
+    probe_batch_t batches[num_workers];
+    pthread_t threads[num_workers];
+    size_t num_bytes = (num_coordinates + 7) / 8;
+    for (size_t i = 0; i < num_workers; ++i)
+    {
+        batches[i].prober      = prober;
+        batches[i].probe       = &prober->probes[i];
+        batches[i].coordinates = coordinates;
+        batches[i].begin       = ((num_bytes * i) / num_workers) * 8;
+        batches[i].end         = ((num_bytes * (i + 1)) / num_workers) * 8;
+        batches[i].bitmap      = bitmap;
+        batches[i].success     = 0;
+        if (batches[i].end > num_coordinates)
+        {
+            batches[i].end = num_coordinates;
+        }
+    }
+
+    /*The calling thread takes the first batch itself.*/
+    size_t num_threads = 1;
+    while (num_threads < num_workers)
+    {
+        if (pthread_create(&threads[num_threads], NULL, probe_func, &batches[num_threads]) != 0)
+        {
+            break;
+        }
+        num_threads++;
+    }
+    for (size_t i = num_threads; i < num_workers; ++i)
+    {
+        batches[i].probe = batches[0].probe;
+    }
+    probe_func(&batches[0]);
+    for (size_t i = num_threads; i < num_workers; ++i)
+    {
+        probe_func(&batches[i]);
+    }
+
+    success = batches[0].success;
+    for (size_t i = 1; i < num_workers; ++i)
+    {
+        if (i < num_threads)
+        {
+            pthread_join(threads[i], NULL);
+        }
+        success = success && batches[i].success;
+    }
+    return success;
+}
+
+int get_probe_result(const uint8_t* const bitmap, const size_t index)
+{
+    int result = 0;
+    if (bitmap != NULL)
+    {
+        result = (bitmap[index / 8] >> (index % 8)) & 1u;
+    }
     return result;
 }
+
+static int probe_point(beam_tracker_t* const tracker, const int x, const int y)
+{
+    if ((x < 0) || (y < 0))
+    {
+        return 0;
+    }
+    beam_coordinate_t coordinate = {.x = x, .y = y};
+    uint8_t bitmap               = 0;
+    tracker->num_probes++;
+    if (!probe_coordinates(tracker->prober, &coordinate, 1, &bitmap))
+    {
+        tracker->failed = 1;
+    }
+    return get_probe_result(&bitmap, 0);
+}
+
+/*Last pulled field of a row, starting from a pulled field.*/
+static int find_last_hit(beam_tracker_t* const tracker, const int row, const int hit)
+{
+    /*Gallop to the right until the beam is left, then search back between both.*/
+    int low  = hit;
+    int step = 1;
+    int high = hit + step;
+    while (probe_point(tracker, high, row))
+    {
+        low = high;
+        step *= 2;
+        high = hit + step;
+    }
+    while ((high - low) > 1)
+    {
+        int middle = low + ((high - low) / 2);
+        if (probe_point(tracker, middle, row))
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/*First pulled field of a row, starting from a pulled field.*/
+static int find_first_hit(beam_tracker_t* const tracker, const int row, const int hit)
+{
+    int high = hit;
+    int step = 1;
+    int low  = hit - step;
+    while ((low >= 0) && probe_point(tracker, low, row))
+    {
+        high = low;
+        step *= 2;
+        low = hit - step;
+    }
+    if (low < -1)
+    {
+        low = -1;
+    }
+    while ((high - low) > 1)
+    {
+        int middle = low + ((high - low) / 2);
+        if (probe_point(tracker, middle, row))
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle;
+        }
+    }
+    return high;
+}
+
+/*Any pulled field in [from, to], assuming the beam starts right of from. -1 if there is none.*/
+static int find_any_hit(beam_tracker_t* const tracker, const int row, const int from, const int to)
+{
+    /*Galloping is enough for wide beams, narrow ones might be jumped over.*/
+    for (int step = 1; (from + step - 1) <= to; step *= 2)
+    {
+        if (probe_point(tracker, from + step - 1, row))
+        {
+            return from + step - 1;
+        }
+    }
+    for (int x = from; x <= to; ++x)
+    {
+        if (probe_point(tracker, x, row))
+        {
+            return x;
+        }
+    }
+    return -1;
+}
+
+int init_beam_tracker(beam_tracker_t* const tracker,
+                      beam_prober_t* const prober,
+                      const int row,
+                      const int cols)
+{
+    int success = 0;
+    if ((tracker == NULL) || (prober == NULL) || (row <= 0) || (cols <= 0))
+    {
+        return success;
+    }
+    tracker->prober     = prober;
+    tracker->num_probes = 0;
+    tracker->failed     = 0;
+
+    /*The first row is scanned completely, afterwards its edges are used to estimate the others.*/
+    beam_coordinate_t* coordinates = (beam_coordinate_t*) malloc(sizeof(beam_coordinate_t) * cols);
+    uint8_t* bitmap                = (uint8_t*) malloc((cols + 7) / 8);
+    if ((coordinates != NULL) && (bitmap != NULL))
+    {
+        for (int x = 0; x < cols; ++x)
+        {
+            coordinates[x] = (beam_coordinate_t){.x = x, .y = row};
+        }
+        if (probe_coordinates(prober, coordinates, cols, bitmap))
+        {
+            tracker->num_probes += cols;
+            tracker->reference = (beam_edges_t){.row = row, .left = cols, .right = -1};
+            for (int x = 0; x < cols; ++x)
+            {
+                if (get_probe_result(bitmap, x))
+                {
+                    tracker->reference.left =
+                        (x < tracker->reference.left) ? x : tracker->reference.left;
+                    tracker->reference.right = x;
+                }
+            }
+            /*The beam has to end within the row, otherwise its edge is unknown.*/
+            success = (tracker->reference.left <= tracker->reference.right) &&
+                      (tracker->reference.right < (cols - 1));
+        }
+    }
+    free(coordinates);
+    free(bitmap);
+    return success;
+}
+
+int find_beam_edges(beam_tracker_t* const tracker, const int row, beam_edges_t* const edges)
+{
+    if ((tracker == NULL) || (edges == NULL) || (row < 0))
+    {
+        return 0;
+    }
+
+    /*The beam is a cone, so both edges scale with the row.*/
+    const beam_edges_t* reference = &tracker->reference;
+    int left_estimate  = (int) (((int64_t) reference->left * row) / reference->row);
+    int right_estimate = (int) (((int64_t) reference->right * row) / reference->row);
+    *edges             = (beam_edges_t){.row = row, .left = 0, .right = -1};
+
+    /*Usually the estimate is right next to the edge, so only a few probes are needed.*/
+    int left = -1;
+    if (probe_point(tracker, left_estimate, row))
+    {
+        left = find_first_hit(tracker, row, left_estimate);
+    }
+    else
+    {
+        int from = (left_estimate > BEAM_SEARCH_MARGIN) ? (left_estimate - BEAM_SEARCH_MARGIN) : 0;
+        int to   = right_estimate + BEAM_SEARCH_MARGIN;
+        int hit  = find_any_hit(tracker, row, left_estimate + 1, to);
+        if (hit < 0)
+        {
+            hit = find_any_hit(tracker, row, from, left_estimate - 1);
+        }
+        if (hit >= 0)
+        {
+            left = find_first_hit(tracker, row, hit);
+        }
+    }
+    if (left < 0)
+    {
+        /*Rows close to the origin might not be hit by the beam at all.*/
+        return !tracker->failed;
+    }
+
+    int right = (right_estimate > left) ? right_estimate : left;
+    if (probe_point(tracker, right, row))
+    {
+        right = find_last_hit(tracker, row, right);
+    }
+    else
+    {
+        /*Overshot, the last pulled field is between the left edge and the estimate.*/
+        int low  = left;
+        int high = right;
+        while ((high - low) > 1)
+        {
+            int middle = low + ((high - low) / 2);
+            if (probe_point(tracker, middle, row))
+            {
+                low = middle;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        right = low;
+    }
+
+    edges->left  = left;
+    edges->right = right;
+    /*The further away the reference, the better the estimate.*/
+    if (row > tracker->reference.row)
+    {
+        tracker->reference = *edges;
+    }
+    return !tracker->failed;
+}
+
+/*Whether a square fits with its top right corner on the right edge of the row.*/
+static int square_fits(beam_tracker_t* const tracker, const int size, const int row, int* const x)
+{
+    beam_edges_t top;
+    beam_edges_t bottom;
+    if (!find_beam_edges(tracker, row, &top) || (top.left > top.right) ||
+        !find_beam_edges(tracker, row + size - 1, &bottom) || (bottom.left > bottom.right))
+    {
+        return 0;
+    }
+    *x = top.right - size + 1;
+    return (*x >= top.left) && (bottom.left <= *x) && (bottom.right >= top.right);
+}
+
+int find_square(beam_tracker_t* const tracker, const int size, int* const x, int* const y)
+{
+    if ((tracker == NULL) || (size <= 0) || (x == NULL) || (y == NULL))
+    {
+        return 0;
+    }
+
+    /*The beam widens with every row, so once a square fits it fits in every row below.*/
+    /*Gallop to a row where it fits, then search for the first one.*/
+    int low  = -1;
+    int high = size - 1;
+    int fit  = 0;
+    while (!square_fits(tracker, size, high, &fit))
+    {
+        if (tracker->failed || (high > BEAM_MAX_ROW))
+        {
+            return 0;
+        }
+        low  = high;
+        high = (2 * high) + 1;
+    }
+    while ((high - low) > 1)
+    {
+        int middle = low + ((high - low) / 2);
+        int column = 0;
+        if (square_fits(tracker, size, middle, &column))
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle;
+        }
+    }
+    square_fits(tracker, size, high, &fit);
+    *x = fit;
+    *y = high;
+    return !tracker->failed;
+}
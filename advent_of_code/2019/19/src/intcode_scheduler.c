@@ -0,0 +1,352 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *  Date: 2020-05-07
+ *
+ */
+
+#include "challenge/intcode_scheduler.h"
+#include "stdint.h"
+
+#define SCHEDULER_NO_SLOT (SIZE_MAX)
+#define SCHEDULER_INITIAL_CAPACITY (16u)
+
+typedef enum
+{
+    SLOT_IDLE    = 0,
+    SLOT_QUEUED  = 1,
+    SLOT_RUNNING = 2,
+    SLOT_DONE    = 3,
+} intcode_slot_state_t;
+
+typedef struct
+{
+    intcode_t* prog;
+    intcode_slot_state_t state;
+    int ret;
+    /*Machines reading the output and writing the input of this one.*/
+    size_t consumer;
+    size_t producer;
+} intcode_slot_t;
+
+/*All fields are guarded by the mutex, machines are executed without holding it.*/
+struct intcode_scheduler
+{
+    intcode_slot_t* slots;
+    size_t num_slots;
+    size_t capacity;
+    /*FIFO of runnable slots, a slot is queued at most once.*/
+    size_t* queue;
+    size_t queue_head;
+    size_t queue_count;
+    size_t running;
+    int stop;
+    pthread_mutex_t mut;
+    pthread_cond_t work;
+    pthread_cond_t idle;
+    pthread_t* workers;
+    size_t num_workers;
+};
+
+static void* worker_func(void* args);
+static void run_queue(intcode_scheduler_t* scheduler, int until_idle);
+static void enqueue_slot(intcode_scheduler_t* scheduler, size_t index);
+static void wake_slot(intcode_scheduler_t* scheduler, size_t index);
+static int can_progress(const intcode_t* prog);
+
+
+intcode_scheduler_t* create_scheduler(const size_t num_workers)
+{
+    intcode_scheduler_t* scheduler = (intcode_scheduler_t*) malloc(sizeof(intcode_scheduler_t));
+    if (scheduler != NULL)
+    {
+        scheduler->slots       = NULL;
+        scheduler->num_slots   = 0;
+        scheduler->capacity    = 0;
+        scheduler->queue       = NULL;
+        scheduler->queue_head  = 0;
+        scheduler->queue_count = 0;
+        scheduler->running     = 0;
+        scheduler->stop        = 0;
+        scheduler->workers     = NULL;
+        scheduler->num_workers = 0;
+        pthread_mutex_init(&scheduler->mut, NULL);
+        pthread_cond_init(&scheduler->work, NULL);
+        pthread_cond_init(&scheduler->idle, NULL);
+
+        /*Without workers the machines are run on the thread calling run_scheduler.*/
+        if (num_workers > 0)
+        {
+            scheduler->workers = (pthread_t*) malloc(sizeof(pthread_t) * num_workers);
+            if (scheduler->workers == NULL)
+            {
+                destroy_scheduler(scheduler);
+                return NULL;
+            }
+            for (size_t i = 0; i < num_workers; ++i)
+            {
+                if (pthread_create(&scheduler->workers[i], NULL, worker_func, scheduler) != 0)
+                {
+                    destroy_scheduler(scheduler);
+                    return NULL;
+                }
+                scheduler->num_workers++;
+            }
+        }
+    }
+    return scheduler;
+}
+
+void destroy_scheduler(intcode_scheduler_t* const scheduler)
+{
+    if (scheduler != NULL)
+    {
+        pthread_mutex_lock(&scheduler->mut);
+        scheduler->stop = 1;
+        pthread_cond_broadcast(&scheduler->work);
+        pthread_mutex_unlock(&scheduler->mut);
+        for (size_t i = 0; i < scheduler->num_workers; ++i)
+        {
+            pthread_join(scheduler->workers[i], NULL);
+        }
+
+        /*The machines are owned by the caller.*/
+        pthread_mutex_destroy(&scheduler->mut);
+        pthread_cond_destroy(&scheduler->work);
+        pthread_cond_destroy(&scheduler->idle);
+        free(scheduler->workers);
+        free(scheduler->slots);
+        free(scheduler->queue);
+        free(scheduler);
+    }
+}
+
+void clear_scheduler(intcode_scheduler_t* const scheduler)
+{
+    if (scheduler != NULL)
+    {
+        /*Keeps the workers and the allocations, so the scheduler can be reused for new machines.*/
+        pthread_mutex_lock(&scheduler->mut);
+        scheduler->num_slots   = 0;
+        scheduler->queue_head  = 0;
+        scheduler->queue_count = 0;
+        pthread_mutex_unlock(&scheduler->mut);
+    }
+}
+
+int schedule_intcode(intcode_scheduler_t* const scheduler, intcode_t* const prog)
+{
+    int success = 0;
+    /*Machines have to be connected by rings before they are scheduled.*/
+    if ((scheduler != NULL) && (prog != NULL) && (prog->io_mode == INT_CODE_RING_IO))
+    {
+        pthread_mutex_lock(&scheduler->mut);
+        if (scheduler->num_slots == scheduler->capacity)
+        {
+            size_t capacity = (scheduler->capacity > 0) ? (scheduler->capacity * 2)
+                                                         : SCHEDULER_INITIAL_CAPACITY;
+            intcode_slot_t* slots =
+                (intcode_slot_t*) realloc(scheduler->slots, sizeof(intcode_slot_t) * capacity);
+            if (slots != NULL)
+            {
+                scheduler->slots = slots;
+            }
+            size_t* queue = (size_t*) malloc(sizeof(size_t) * capacity);
+            if ((slots != NULL) && (queue != NULL))
+            {
+                /*The ring may have wrapped, the queued slots move to the front in order.*/
+                for (size_t i = 0; i < scheduler->queue_count; ++i)
+                {
+                    queue[i] = scheduler->queue[(scheduler->queue_head + i) % scheduler->capacity];
+                }
+                free(scheduler->queue);
+                scheduler->queue      = queue;
+                scheduler->capacity   = capacity;
+                scheduler->queue_head = 0;
+            }
+            else
+            {
+                free(queue);
+            }
+        }
+
+        if (scheduler->num_slots < scheduler->capacity)
+        {
+            size_t index         = scheduler->num_slots;
+            intcode_slot_t* slot = &scheduler->slots[index];
+            slot->prog           = prog;
+            slot->state          = SLOT_IDLE;
+            slot->ret            = INT_CODE_CONTINUE;
+            slot->consumer       = SCHEDULER_NO_SLOT;
+            slot->producer       = SCHEDULER_NO_SLOT;
+            for (size_t i = 0; i < index; ++i)
+            {
+                intcode_t* other = scheduler->slots[i].prog;
+                if ((prog->ring_io_out != NULL) && (other->ring_io_in == prog->ring_io_out))
+                {
+                    slot->consumer               = i;
+                    scheduler->slots[i].producer = index;
+                }
+                if ((prog->ring_io_in != NULL) && (other->ring_io_out == prog->ring_io_in))
+                {
+                    slot->producer               = i;
+                    scheduler->slots[i].consumer = index;
+                }
+            }
+            set_io_yield(prog, 1);
+            scheduler->num_slots++;
+            success = 1;
+        }
+        pthread_mutex_unlock(&scheduler->mut);
+    }
+    return success;
+}
+
+int run_scheduler(intcode_scheduler_t* const scheduler)
+{
+    int ret = INT_CODE_ERROR;
+    if (scheduler != NULL)
+    {
+        pthread_mutex_lock(&scheduler->mut);
+        /*Machines that never ran or whose rings were changed by the caller are runnable.*/
+        for (size_t i = 0; i < scheduler->num_slots; ++i)
+        {
+            intcode_slot_t* slot = &scheduler->slots[i];
+            if ((slot->state == SLOT_IDLE) &&
+                ((slot->ret == INT_CODE_CONTINUE) || can_progress(slot->prog)))
+            {
+                enqueue_slot(scheduler, i);
+            }
+        }
+
+        if (scheduler->num_workers == 0)
+        {
+            run_queue(scheduler, 1);
+        }
+        else
+        {
+            while ((scheduler->queue_count > 0) || (scheduler->running > 0))
+            {
+                pthread_cond_wait(&scheduler->idle, &scheduler->mut);
+            }
+        }
+
+        /*Every machine is either finished or waits for IO nobody is going to provide.*/
+        ret = INT_CODE_HALT;
+        for (size_t i = 0; i < scheduler->num_slots; ++i)
+        {
+            int slot_ret = scheduler->slots[i].ret;
+            if (slot_ret == INT_CODE_ERROR)
+            {
+                ret = INT_CODE_ERROR;
+                break;
+            }
+            else if (slot_ret == INT_CODE_BLOCKED)
+            {
+                ret = INT_CODE_BLOCKED;
+            }
+        }
+        pthread_mutex_unlock(&scheduler->mut);
+    }
+    return ret;
+}
+
+size_t get_num_scheduled(const intcode_scheduler_t* const scheduler)
+{
+    return (scheduler != NULL) ? scheduler->num_slots : 0;
+}
+
+int get_scheduled_ret(const intcode_scheduler_t* const scheduler, const size_t index)
+{
+    int ret = INT_CODE_ERROR;
+    if ((scheduler != NULL) && (index < scheduler->num_slots))
+    {
+        ret = scheduler->slots[index].ret;
+    }
+    return ret;
+}
+
+static void* worker_func(void* args)
+{
+    intcode_scheduler_t* scheduler = (intcode_scheduler_t*) args;
+    pthread_mutex_lock(&scheduler->mut);
+    run_queue(scheduler, 0);
+    pthread_mutex_unlock(&scheduler->mut);
+    return NULL;
+}
+
+/*Called with the mutex held.*/
+static void run_queue(intcode_scheduler_t* const scheduler, const int until_idle)
+{
+    while (!scheduler->stop)
+    {
+        if (scheduler->queue_count > 0)
+        {
+            size_t index          = scheduler->queue[scheduler->queue_head];
+            scheduler->queue_head = (scheduler->queue_head + 1) % scheduler->capacity;
+            scheduler->queue_count--;
+            scheduler->running++;
+
+            intcode_slot_t* slot = &scheduler->slots[index];
+            intcode_t* prog      = slot->prog;
+            slot->state          = SLOT_RUNNING;
+            pthread_mutex_unlock(&scheduler->mut);
+
+            /*Runs until the machine halts or yields on an empty input or a full output ring.*/
+            int ret = execute(prog);
+
+            pthread_mutex_lock(&scheduler->mut);
+            scheduler->running--;
+            slot        = &scheduler->slots[index];
+            slot->ret   = ret;
+            slot->state = (ret == INT_CODE_BLOCKED) ? SLOT_IDLE : SLOT_DONE;
+
+            /*The rings might have changed while the machine was running.*/
+            wake_slot(scheduler, index);
+            wake_slot(scheduler, slot->consumer);
+            wake_slot(scheduler, slot->producer);
+            if ((scheduler->queue_count == 0) && (scheduler->running == 0))
+            {
+                pthread_cond_broadcast(&scheduler->idle);
+            }
+        }
+        else if (until_idle && (scheduler->running == 0))
+        {
+            break;
+        }
+        else
+        {
+            pthread_cond_wait(&scheduler->work, &scheduler->mut);
+        }
+    }
+}
+
+static void enqueue_slot(intcode_scheduler_t* const scheduler, const size_t index)
+{
+    size_t tail = (scheduler->queue_head + scheduler->queue_count) % scheduler->capacity;
+    scheduler->queue[tail]        = index;
+    scheduler->slots[index].state = SLOT_QUEUED;
+    scheduler->queue_count++;
+    pthread_cond_signal(&scheduler->work);
+}
+
+static void wake_slot(intcode_scheduler_t* const scheduler, const size_t index)
+{
+    if ((index != SCHEDULER_NO_SLOT) && (scheduler->slots[index].state == SLOT_IDLE) &&
+        (scheduler->slots[index].ret == INT_CODE_BLOCKED) &&
+        can_progress(scheduler->slots[index].prog))
+    {
+        enqueue_slot(scheduler, index);
+    }
+}
+
+static int can_progress(const intcode_t* const prog)
+{
+    /*A closed ring lets the machine fail instead of waiting forever.*/
+    if (prog->waiting_for_input)
+    {
+        return (io_ring_size(prog->ring_io_in) > 0) || io_ring_closed(prog->ring_io_in);
+    }
+    return (io_ring_size(prog->ring_io_out) < io_ring_capacity(prog->ring_io_out)) ||
+           io_ring_closed(prog->ring_io_out);
+}
@@ -7,10 +7,13 @@
 
 #include "challenge/challenge_lib.h"
 #include "challenge/intcode.h"
-#include "pthread.h"
-#include "stdbool.h"
 #include "stdio.h"
 #include "stdlib.h"
+#include "unistd.h"
+
+#define SCAN_SIZE (50)
+#define ROW_COLS (500)
+#define SQUARE_SIZE (100)
 
 int main(int argc, char* argv[])
 {
@@ -21,115 +24,59 @@ int main(int argc, char* argv[])
         return 0;
     }
 
-    /*Initialize the program with IO memory.*/
-    intcode_t* prog = read_intcode(argv[1]);
-    if (prog == NULL)
+    /*Initialize the program, every probe runs on a fork of it.*/
+    intcode_t* prog       = read_intcode(argv[1]);
+    beam_prober_t* prober = create_beam_prober(prog, sysconf(_SC_NPROCESSORS_ONLN));
+    if ((prog == NULL) || (prober == NULL))
     {
         printf("Error reading programm or allocating IO memory\n");
         return 0;
     }
 
+    /*One batch holds the whole area of part 01.*/
+    beam_coordinate_t coordinates[SCAN_SIZE * SCAN_SIZE];
+    uint8_t bitmap[(SCAN_SIZE * SCAN_SIZE + 7) / 8];
+
     /*Part 01*/
     int sum = 0;
-    for (int y = 0; y < 50; ++y)
+    for (int y = 0; y < SCAN_SIZE; ++y)
     {
-        for (int x = 0; x < 50; ++x)
+        for (int x = 0; x < SCAN_SIZE; ++x)
         {
-            int64_t result = scan_coordinate(prog, x, y);
-            /*printf("Scan result for (%d, %d): %ld\n", x, y, result);*/
-            sum += result;
+            coordinates[(y * SCAN_SIZE) + x] = (beam_coordinate_t){.x = x, .y = y};
         }
     }
+    probe_coordinates(prober, coordinates, SCAN_SIZE * SCAN_SIZE, bitmap);
+    for (size_t i = 0; i < SCAN_SIZE * SCAN_SIZE; ++i)
+    {
+        sum += get_probe_result(bitmap, i);
+    }
     printf("Total number of affected points: %d\n", sum);
 
     /*Part 02*/
 
-    /*Calculate slope of the beam.*/
-    int row   = 300;
-    int cols  = 500;
-    int beam  = 0;
-    int first = -1;
-    int last  = -1;
-    for (int x = 0; x < cols; ++x)
-    {
-        int64_t result = scan_coordinate(prog, x, row);
-        if (beam ^ result)
-        {
-            if (!beam)
-            {
-                first = x;
-            }
-            else
-            {
-                last = x - 1;
-            }
-            beam = !beam;
-        }
-    }
-    if (beam)
+    /*The edges of the reference row are used to estimate the edges of every other row.*/
+    beam_tracker_t tracker;
+    if (!init_beam_tracker(&tracker, prober, SCAN_SIZE, ROW_COLS))
     {
         printf("Didn't find end of beam, not enough columns.\n");
     }
-    float slope = ((first + last) / 2.0) / (row + 1);
-    printf("Slope for row #%d is %f.\n", row, slope);
-
-    /*Since the width of the beam increases about every 3rd row,
-     * the beam will hit a width of 100 at roughly this offset.
-     * Looking at earlier rows is not really useful.*/
-    row = 300;
-
-    /*The beam should be between 100-200 fields wide in the area we are looking
-     * for.*/
-    cols = 250;
-
-    int square_size = 100;
-
-    int found = 0;
-    while (!found)
+    else
     {
-        /*We are only interested in the beam area, so we offset the column*/
-        /*based on our estimate of the beam center.*/
-        int col_offset = (int) (row * slope);
-        beam           = 1;
-
-        /*Find the right most field affected by the beam.*/
-        /*We start looking roughly in the center of the beam.*/
-        for (int x = 0; x < cols; ++x)
+        int x = 0;
+        int y = 0;
+        if (find_square(&tracker, SQUARE_SIZE, &x, &y))
         {
-            int64_t result = scan_coordinate(prog, x + col_offset, row);
-            if (beam ^ result)
-            {
-                if (beam)
-                {
-                    /*End of beam found.*/
-                    /*last field of beam is in x-1.*/
-
-                    int right_x  = x - 1 + col_offset;
-                    int top_y    = row;
-                    int left_x   = right_x - (square_size - 1);
-                    int bottom_y = top_y + (square_size - 1);
-
-                    if (left_x >= 0)
-                    {
-                        /*check the corner coordinates.*/
-                        int64_t top_left     = scan_coordinate(prog, left_x, top_y);
-                        int64_t bottom_left  = scan_coordinate(prog, left_x, bottom_y);
-                        int64_t bottom_right = scan_coordinate(prog, right_x, bottom_y);
-
-                        if (top_left && bottom_left && bottom_right)
-                        {
-                            printf("Top Left: (%d, %d)\n", left_x, top_y);
-                            found = 1;
-                        }
-                    }
-
-                    break;
-                }
-            }
+            printf("Top Left: (%d, %d)\n", x, y);
+        }
+        else
+        {
+            printf("Didn't find a square of size %d.\n", SQUARE_SIZE);
         }
-        row++;
+        printf("Number of probes: %zu\n", tracker.num_probes);
     }
 
+    destroy_beam_prober(prober);
     destroy_intcode(prog);
     return 0;
 }
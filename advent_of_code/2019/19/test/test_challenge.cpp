@@ -6,6 +6,8 @@
 
 #include "gtest/gtest.h"
 
+#include <vector>
+
 extern "C" {
 #include "challenge/challenge_lib.h"
 }
@@ -27,3 +29,123 @@ TEST_F(challenge_test, pos_test_01)
     bool ret = true;
     ASSERT_TRUE(ret);
 }
+
+class probe_test : public ::testing::TestWithParam<size_t>
+{
+  protected:
+    void SetUp() override
+    {
+        /*Reads x and y, answers whether x < y.*/
+        const int64_t content[] = {3, 20, 3, 21, 7, 20, 21, 22, 4, 22, 99};
+        int64_t* memory         = (int64_t*) malloc(sizeof(content));
+        for (size_t i = 0; i < 11; ++i)
+        {
+            memory[i] = content[i];
+        }
+        prog = create_intcode(memory, 11);
+    }
+
+    void TearDown() override { destroy_intcode(prog); }
+
+    intcode_t* prog = NULL;
+};
+
+TEST_P(probe_test, scan_coordinate_01)
+{
+    ASSERT_EQ(scan_coordinate(prog, 1, 2), 1);
+    ASSERT_EQ(scan_coordinate(prog, 2, 1), 0);
+}
+
+TEST_P(probe_test, probe_coordinates_01)
+{
+    /*Large enough to be split over several workers, not a multiple of 8.*/
+    const size_t num_coordinates = 1001;
+    std::vector<beam_coordinate_t> coordinates(num_coordinates);
+    std::vector<uint8_t> bitmap((num_coordinates + 7) / 8, 0xff);
+    for (size_t i = 0; i < num_coordinates; ++i)
+    {
+        coordinates[i].x = i % 37;
+        coordinates[i].y = i % 23;
+    }
+
+    beam_prober_t* prober = create_beam_prober(prog, GetParam());
+    ASSERT_TRUE(prober != NULL);
+    ASSERT_TRUE(probe_coordinates(prober, coordinates.data(), num_coordinates, bitmap.data()));
+    for (size_t i = 0; i < num_coordinates; ++i)
+    {
+        ASSERT_EQ(get_probe_result(bitmap.data(), i), coordinates[i].x < coordinates[i].y);
+    }
+
+    /*The prober is reused for the next batch.*/
+    beam_coordinate_t corners[] = {{0, 1}, {2, 1}, {3, 4}};
+    ASSERT_TRUE(probe_coordinates(prober, corners, 3, bitmap.data()));
+    ASSERT_EQ(bitmap[0], 0x5);
+    destroy_beam_prober(prober);
+}
+
+INSTANTIATE_TEST_SUITE_P(workers, probe_test, ::testing::Values(1, 3, 64));
+
+class tracker_test : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        /*Reads x and y, answers whether y / 2 <= x <= y.*/
+        const int64_t content[] = {3,  30, 3,  31, 1002, 30, 2, 32, 7,  32, 31, 33, 7,  31,
+                                   30, 34, 1,  33, 34,   35, 1008, 35, 0, 36, 4, 36, 99};
+        const size_t nums       = 37;
+        int64_t* memory         = (int64_t*) calloc(nums, sizeof(int64_t));
+        for (size_t i = 0; i < sizeof(content) / sizeof(content[0]); ++i)
+        {
+            memory[i] = content[i];
+        }
+        prog   = create_intcode(memory, nums);
+        prober = create_beam_prober(prog, 1);
+    }
+
+    void TearDown() override
+    {
+        destroy_beam_prober(prober);
+        destroy_intcode(prog);
+    }
+
+    intcode_t* prog       = NULL;
+    beam_prober_t* prober = NULL;
+};
+
+TEST_F(tracker_test, find_beam_edges_01)
+{
+    beam_tracker_t tracker;
+    ASSERT_TRUE(init_beam_tracker(&tracker, prober, 10, 20));
+    ASSERT_EQ(tracker.reference.left, 5);
+    ASSERT_EQ(tracker.reference.right, 10);
+
+    /*Follow the edges row by row.*/
+    beam_edges_t edges;
+    for (int row = 0; row < 300; ++row)
+    {
+        ASSERT_TRUE(find_beam_edges(&tracker, row, &edges));
+        ASSERT_EQ(edges.row, row);
+        ASSERT_EQ(edges.left, (row + 1) / 2);
+        ASSERT_EQ(edges.right, row);
+    }
+    ASSERT_EQ(tracker.reference.row, 299);
+}
+
+TEST_F(tracker_test, find_square_01)
+{
+    /*The square fits first at row 3 * (size - 1).*/
+    for (int size : {1, 2, 10, 100, 1000})
+    {
+        beam_tracker_t tracker;
+        ASSERT_TRUE(init_beam_tracker(&tracker, prober, 10, 20));
+        int x = -1;
+        int y = -1;
+        ASSERT_TRUE(find_square(&tracker, size, &x, &y));
+        ASSERT_EQ(x, 2 * (size - 1));
+        ASSERT_EQ(y, 3 * (size - 1));
+
+        /*Besides the reference row, a few probes per row of the search.*/
+        ASSERT_LT(tracker.num_probes, 20u + 300u);
+    }
+}
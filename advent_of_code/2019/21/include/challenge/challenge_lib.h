@@ -9,16 +9,16 @@
 #define INCLUDE_CHALLENGE_LIB_H
 
 #include "challenge/intcode.h"
+#include "challenge/intcode_scheduler.h"
 
 typedef struct
 {
     intcode_t* brain;
+    intcode_scheduler_t* scheduler;
     int finished;
 } ASCII;
 
-/*Thread functions*/
-void* system_func(void* args);
-void* control_part01(void* args);
-void* control_part02(void* args);
+void control_part01(ASCII* const system);
+void control_part02(ASCII* const system);
 
 #endif /* ifndef INCLUDE_CHALLENGE_LIB_H */
@@ -9,46 +9,21 @@
 #include "assert.h"
 #include "stdio.h"
 #include "string.h"
-#include "unistd.h"
 
 #define RESIZE_AMOUNT 10
 
-static void provide_input(const ASCII* const system, const int value);
-static int64_t read_output(const ASCII* const system);
-static void read_prompt(const ASCII* const system);
+static void run_system(ASCII* const system);
+static void provide_input(const ASCII* const system, const int64_t value);
+static int read_output(ASCII* const system, int64_t* const value);
+static void read_prompt(ASCII* const system);
 static void provide_line(const ASCII* const system, const char* const line);
 
-void* system_func(void* args)
+void control_part01(ASCII* const system)
 {
-    if (args == NULL)
+    if (system == NULL)
     {
-        return NULL;
+        return;
     }
-    ASCII* system = (ASCII*) args;
-    int ret       = execute(system->brain);
-    if (ret != INT_CODE_HALT)
-    {
-        printf("Programm did not halt as expected. Err code: %d\n", ret);
-    }
-    else
-    {
-        /*Only writing access*/
-        usleep(1000);
-        system->finished = 1;
-    }
-    return NULL;
-}
-
-void* control_part01(void* args)
-{
-    if (args == NULL)
-    {
-        return NULL;
-    }
-    ASCII* system    = (ASCII*) args;
-
-    /*Give robot some time to setup.*/
-    usleep(3000);
 
     read_prompt(system);
 
@@ -63,19 +38,14 @@ void* control_part01(void* args)
     provide_line(system, "WALK\n");
 
     read_prompt(system);
-    return NULL;
 }
 
-void* control_part02(void* args)
+void control_part02(ASCII* const system)
 {
-    if (args == NULL)
+    if (system == NULL)
     {
-        return NULL;
+        return;
     }
-    ASCII* system    = (ASCII*) args;
-
-    /*Give robot some time to setup.*/
-    usleep(3000);
 
     read_prompt(system);
 
@@ -93,62 +63,62 @@ void* control_part02(void* args)
     provide_line(system, "RUN\n");
 
     read_prompt(system);
-    return NULL;
 }
 
-static void provide_input(const ASCII* const system, const int value)
+static void run_system(ASCII* const system)
 {
     assert(system != NULL);
     assert(system->brain != NULL);
-    assert(system->brain->mem_io_in != NULL);
 
-    intcode_io_mem_t* input = system->brain->mem_io_in;
-    pthread_mutex_lock(&input->mut);
-    while (!input->consumed && !system->finished)
+    /*Either the system waits for input, the output ring is full or it halted.*/
+    int ret = run_scheduler(system->scheduler);
+    if (ret != INT_CODE_BLOCKED)
     {
-        pthread_cond_wait(&input->cond, &input->mut);
+        if (ret != INT_CODE_HALT)
+        {
+            printf("Programm did not halt as expected. Err code: %d\n", ret);
+        }
+        system->finished = 1;
     }
-    input->value    = value;
-    input->consumed = 0;
-    pthread_cond_signal(&input->cond);
-    pthread_mutex_unlock(&input->mut);
-    usleep(10);
 }
 
-static int64_t read_output(const ASCII* const system)
+static void provide_input(const ASCII* const system, const int64_t value)
 {
-    assert(robot != NULL);
-    assert(robot->brain != NULL);
-    assert(robot->brain->mem_io_out != NULL);
+    assert(system != NULL);
+    assert(system->brain != NULL);
+    assert(system->brain->ring_io_in != NULL);
 
-    int64_t read_value = -1;
+    /*The whole springscript fits into the input ring, see IO_IN_CAPACITY.*/
+    size_t written = io_ring_try_write(system->brain->ring_io_in, &value, 1);
+    assert(written == 1);
+    (void) written;
+}
 
-    intcode_io_mem_t* output = system->brain->mem_io_out;
-    pthread_mutex_lock(&output->mut);
-    while (output->consumed && !system->finished)
-    {
-        pthread_cond_wait(&output->cond, &output->mut);
-    }
+/*Reads the next output and runs the system while there is none.*/
+/*Returns 0 once the system halted or waits for input and all output has been read.*/
+static int read_output(ASCII* const system, int64_t* const value)
+{
+    assert(system != NULL);
+    assert(system->brain != NULL);
+    assert(system->brain->ring_io_out != NULL);
 
-    if (!system->finished)
+    while (io_ring_try_read(system->brain->ring_io_out, value, 1) == 0)
     {
-        read_value       = output->value;
-        output->consumed = 1;
+        if (system->finished ||
+            (waiting_for_input(system->brain) && (io_ring_size(system->brain->ring_io_in) == 0)))
+        {
+            return 0;
+        }
+        run_system(system);
     }
-    pthread_cond_signal(&output->cond);
-    pthread_mutex_unlock(&output->mut);
-
-
-    return read_value;
+    return 1;
 }
 
-static void read_prompt(const ASCII* const system)
+static void read_prompt(ASCII* const system)
 {
-    /*Only reading access*/
-    while (!waiting_for_input(system->brain) && !system->finished)
+    int64_t resp = 0;
+    while (read_output(system, &resp))
     {
-        /*Read Response*/
-        int64_t resp = read_output(system);
         if (resp < 127) // is ASCII and not large integer output
         {
           printf("%c", (char)resp);
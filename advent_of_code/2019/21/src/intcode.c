@@ -6,10 +6,70 @@
  */
 
 #include "challenge/intcode.h"
+#include "fcntl.h"
+#include "stdatomic.h"
 #include "string.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#include "time.h"
+#include "unistd.h"
 
-#define INTCODE_DELIM ","
-#define INTCODE_NO_STORE -1
+#define INTCODE_NO_STORE (-1)
+#define INTCODE_MAX_PARAMS (3)
+#define INTCODE_DISPATCH_ERROR (0)
+#define INTCODE_DISPATCH_SIZE (100)
+
+/*Memory is split into pages of 512 cells (4 KiB).*/
+#define INTCODE_PAGE_BITS (9)
+#define INTCODE_PAGE_SIZE (1u << INTCODE_PAGE_BITS)
+#define INTCODE_PAGE_MASK (INTCODE_PAGE_SIZE - 1u)
+/*Pages below this index are kept in the dense page table, everything above is hashed.*/
+#define INTCODE_DENSE_PAGE_LIMIT (1024u)
+#define INTCODE_SPARSE_INITIAL_CAPACITY (16u)
+
+/*Binary program images start with this header, followed by the cells in native byte order.*/
+#define INTCODE_IMAGE_MAGIC "ICB1"
+#define INTCODE_IMAGE_VERSION (1u)
+/*Recorded sessions start with this header, followed by records in native byte order.*/
+#define INTCODE_RECORDING_MAGIC "ICR1"
+#define INTCODE_RECORDING_VERSION (1u)
+
+/*Number of addresses listed in a profile report.*/
+#define INTCODE_PROFILE_HOT_ADDRESSES (10)
+
+/*Translated blocks end after this many instructions, or at the first jump, IO or halt.*/
+#define INTCODE_BLOCK_LIMIT (32)
+#define INTCODE_BLOCK_SPAN (INTCODE_BLOCK_LIMIT * 4)
+/*Writes to code noted before the blocks covering them are dropped, more flush everything.*/
+#define INTCODE_PENDING_WRITES (16)
+/*Code above this address is always interpreted.*/
+#define INTCODE_TRANSLATION_LIMIT (1u << 20)
+/*State of a cell in the translation, see intcode_translation.*/
+#define INTCODE_CELL_CODE (1u)
+#define INTCODE_CELL_VOLATILE (2u)
+/*Fused jumps read their condition from the operand after the ones of the fused instruction.*/
+#define INTCODE_CLOSURE_OPERANDS (INTCODE_MAX_PARAMS + 1)
+#define INTCODE_CONDITION (INTCODE_MAX_PARAMS)
+
+/*Lanes of a batch do not write to cells above this address.*/
+#define INTCODE_BATCH_MEMORY_LIMIT (1u << 20)
+
+/*Keeps the producer and consumer indices of a ring on separate cache lines.*/
+#define INTCODE_CACHE_LINE (64u)
+
+/*Direct-threaded dispatch needs the labels-as-values extension.*/
+#if defined(__GNUC__) && !defined(INTCODE_NO_COMPUTED_GOTO)
+#define INTCODE_COMPUTED_GOTO 1
+#endif
+
+/*Memory accessors are on the hot path, the slow paths are kept out of line.*/
+#if defined(__GNUC__)
+#define INTCODE_ALWAYS_INLINE inline __attribute__((always_inline))
+#define INTCODE_NOINLINE __attribute__((noinline))
+#else
+#define INTCODE_ALWAYS_INLINE inline
+#define INTCODE_NOINLINE
+#endif
 /*#define DEBUG 1*/
 
 typedef enum
@@ -35,68 +95,440 @@ typedef enum
 
 typedef int (*intcode_op_f)(intcode_t* const, const int64_t* const);
 
-static void get_size_info(const char* const file_path,
-                          size_t* const total_chars,
-                          size_t* const amount_integers);
+/*Pre-decoded instruction, cached per memory cell.*/
+/*Only depends on the value of the cell itself, operands are read on execution.*/
+struct intcode_decoded
+{
+    intcode_op_f func;
+    int op_code;
+    uint8_t dispatch;
+    uint8_t valid;
+    uint8_t inst_size;
+    int8_t store_param;
+    uint8_t parameter_modes[INTCODE_MAX_PARAMS];
+};
 
-static size_t get_instruction_size(const int op_code);
-static int get_opcode(const int64_t number);
-static int is_valid_opcode(const int op_code);
+struct intcode_page
+{
+    /*Pages are shared copy-on-write between forked machines.*/
+    /*A page with more than one reference is never modified, including its decode cache.*/
+    atomic_int refs;
+    int64_t cells[INTCODE_PAGE_SIZE];
+    /*Decode cache for the cells, only allocated for pages that are executed.*/
+    intcode_decoded_t* decoded;
+    int fully_decoded;
+    /*Hash of the cells, only up to date while the page is shared, see share_page.*/
+    uint64_t hash;
+};
 
-static intcode_op_f get_op_func(const int op_code);
-static void get_parameter_modes(const int64_t number,
-                                const size_t num_parameters,
-                                int* const parameter_modes);
+typedef struct
+{
+    char magic[4];
+    /*Also tells images written on a machine with a different byte order apart.*/
+    uint32_t version;
+    uint64_t num_cells;
+} intcode_image_header_t;
 
-static int get_parameter_values(const intcode_t* const prog,
-                                const size_t num_parameters,
-                                const int store_param,
-                                const int* const parameter_modes,
-                                int64_t* const parameters);
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t checkpoint_interval;
+} intcode_recording_header_t;
+
+typedef enum
+{
+    INTCODE_RECORD_INPUT      = 0,
+    INTCODE_RECORD_OUTPUT     = 1,
+    /*Followed by an intcode_checkpoint_header_t and its pages.*/
+    INTCODE_RECORD_CHECKPOINT = 2,
+} intcode_record_kind_t;
+
+/*Every entry of a recording starts with a record of this size.*/
+typedef struct
+{
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t instruction;
+    int64_t value;
+} intcode_record_t;
+
+/*Followed by num_pages times the index of a page and its cells.*/
+typedef struct
+{
+    uint64_t head;
+    int64_t relative_base;
+    uint64_t memory_size;
+    uint64_t num_pages;
+} intcode_checkpoint_header_t;
+
+/*Attached to a machine while its IO is recorded or replayed.*/
+struct intcode_recorder
+{
+    /*Set while recording, events and checkpoints are appended to it.*/
+    FILE* log;
+    int failed;
+    uint64_t checkpoint_interval;
+    uint64_t next_checkpoint;
+    /*Instructions executed since the recording started, including the ones replayed.*/
+    uint64_t instructions;
+    /*Execution returns once this many instructions were executed, see replay_intcode.*/
+    uint64_t stop_at;
+    /*Set while replaying, inputs are taken from it and outputs compared to it.*/
+    const intcode_recording_t* recording;
+    size_t next_input;
+    size_t next_output;
+};
+
+typedef struct
+{
+    uint64_t instruction;
+    /*Checkpoint header and pages in the data of the recording.*/
+    const char* state;
+} intcode_checkpoint_t;
+
+struct intcode_recording
+{
+    intcode_io_event_t* events;
+    size_t num_events;
+    size_t events_capacity;
+    intcode_checkpoint_t* checkpoints;
+    size_t num_checkpoints;
+    size_t checkpoints_capacity;
+    char* data;
+    size_t length;
+    int mapped;
+};
+
+struct intcode_page_entry
+{
+    size_t index;
+    intcode_page_t* page;
+};
+
+struct intcode_snapshot
+{
+    /*A fork that never runs, so its pages stay shared with the machines restored from it.*/
+    intcode_t* state;
+    uint64_t hash;
+};
+
+/*How an operand of a translated instruction is read or written.*/
+typedef enum
+{
+    OPERAND_IMM  = 0,
+    /*Position mode, the cell is accessed through a pointer into its page.*/
+    OPERAND_CELL = 1,
+    OPERAND_REL  = 2,
+} intcode_operand_kind_t;
+
+/*Every combination of operand kinds gets a handler of its own, e.g. CLOSURE_ADD_IMM_REL_CELL.*/
+#define INTCODE_BINARY_DESTINATIONS(X, op, a, b) X(op, a, b, CELL) X(op, a, b, REL)
+#define INTCODE_BINARY_SECOND(X, op, a)         \
+    INTCODE_BINARY_DESTINATIONS(X, op, a, IMM)  \
+    INTCODE_BINARY_DESTINATIONS(X, op, a, CELL) \
+    INTCODE_BINARY_DESTINATIONS(X, op, a, REL)
+#define INTCODE_BINARY_HANDLERS(X, op)   \
+    INTCODE_BINARY_SECOND(X, op, IMM)    \
+    INTCODE_BINARY_SECOND(X, op, CELL)   \
+    INTCODE_BINARY_SECOND(X, op, REL)
+#define INTCODE_JUMP_TARGETS(X, op, a) X(op, a, IMM) X(op, a, CELL) X(op, a, REL)
+#define INTCODE_JUMP_HANDLERS(X, op)     \
+    INTCODE_JUMP_TARGETS(X, op, IMM)     \
+    INTCODE_JUMP_TARGETS(X, op, CELL)    \
+    INTCODE_JUMP_TARGETS(X, op, REL)
+#define INTCODE_UNARY_HANDLERS(X, op) X(op, IMM) X(op, CELL) X(op, REL)
+/*The counter is a cell or relative, the jump target is always immediate.*/
+#define INTCODE_COUNTER_HANDLERS(X, op)  \
+    INTCODE_JUMP_TARGETS(X, op, CELL)    \
+    INTCODE_JUMP_TARGETS(X, op, REL)
+
+#define INTCODE_BINARY_ID(op, a, b, c) CLOSURE_##op##_##a##_##b##_##c,
+#define INTCODE_JUMP_ID(op, a, b) CLOSURE_##op##_##a##_##b,
+#define INTCODE_UNARY_ID(op, a) CLOSURE_##op##_##a,
+
+typedef enum
+{
+    /*Ends a block that did not end in a jump, execution continues at the next block.*/
+    CLOSURE_EXIT = 0,
+    /*Operands without a page to point to, the interpreter runs the instruction.*/
+    CLOSURE_GENERIC,
+    CLOSURE_INPUT,
+    CLOSURE_OUTPUT,
+    CLOSURE_HALT,
+    INTCODE_UNARY_HANDLERS(INTCODE_UNARY_ID, ADJUST_REL_BASE)
+    INTCODE_JUMP_HANDLERS(INTCODE_JUMP_ID, JMP_IF_TRUE)
+    INTCODE_JUMP_HANDLERS(INTCODE_JUMP_ID, JMP_IF_FALSE)
+    INTCODE_BINARY_HANDLERS(INTCODE_BINARY_ID, ADD)
+    INTCODE_BINARY_HANDLERS(INTCODE_BINARY_ID, MULT)
+    INTCODE_BINARY_HANDLERS(INTCODE_BINARY_ID, IS_LESS)
+    INTCODE_BINARY_HANDLERS(INTCODE_BINARY_ID, IS_EQUALS)
+    /*Fused sequences, see intcode_fusion_t.*/
+    INTCODE_BINARY_HANDLERS(INTCODE_BINARY_ID, IS_LESS_JUMP)
+    INTCODE_BINARY_HANDLERS(INTCODE_BINARY_ID, IS_EQUALS_JUMP)
+    INTCODE_COUNTER_HANDLERS(INTCODE_JUMP_ID, COUNTER_JUMP)
+    /*Counts the fused sequence that follows, only emitted with fusion stats enabled.*/
+    CLOSURE_TALLY,
+    CLOSURE_COUNT,
+} intcode_closure_id_t;
+
+/*One translated instruction, the operands are taken from memory at translation time.*/
+typedef struct
+{
+    uint16_t id;
+    uint8_t kinds[INTCODE_CLOSURE_OPERANDS];
+    size_t address;
+    /*Immediate values, cell addresses or offsets to the relative base.*/
+    int64_t operands[INTCODE_CLOSURE_OPERANDS];
+    int64_t* cells[INTCODE_CLOSURE_OPERANDS];
+    intcode_page_t* store_page;
+    /*Sum of the folded adjustments of the relative base before the closure, relative operands*/
+    /*already include it. It is added to the relative base when the block is left here.*/
+    int64_t base_shift;
+    /*Where a fused jump continues if its condition is zero or not.*/
+    size_t targets[2];
+} intcode_closure_t;
+
+typedef struct
+{
+    /*First address after the translated instructions.*/
+    size_t end;
+    size_t num_closures;
+    intcode_closure_t closures[];
+} intcode_block_t;
+
+/*Blocks of a machine, indexed by the address they start at.*/
+/*The closures point into the pages of the machine, so the translation is flushed whenever a*/
+/*page is replaced. Blocks covering overwritten code are dropped, the overwritten cells are*/
+/*marked volatile and never translated again, the interpreter runs them instead.*/
+struct intcode_translation
+{
+    intcode_block_t** blocks;
+    uint8_t* cells;
+    size_t size;
+    size_t pending[INTCODE_PENDING_WRITES];
+    size_t num_pending;
+    /*Set if blocks have to be dropped before the next one is run.*/
+    int dirty;
+    int stale;
+    int running;
+};
+
+struct intcode_io_ring
+{
+    /*Next slot to write, only modified by the producer.*/
+    _Alignas(INTCODE_CACHE_LINE) atomic_size_t tail;
+    /*Next slot to read, only modified by the consumer.*/
+    _Alignas(INTCODE_CACHE_LINE) atomic_size_t head;
+    /*The mutex and condition variable are only used once a side has to sleep.*/
+    _Alignas(INTCODE_CACHE_LINE) atomic_int reader_waiting;
+    atomic_int writer_waiting;
+    atomic_int closed;
+    pthread_mutex_t mut;
+    pthread_cond_t cond;
+    size_t mask;
+    int64_t* values;
+};
+
+/*Lanes at the same head execute an instruction together, lanes that diverged wait until the*/
+/*group with the lowest head catches up. State is kept in one array per field, so the*/
+/*arithmetic of a group runs over consecutive values.*/
+struct intcode_batch
+{
+    size_t num_lanes;
+    size_t num_used;
+    /*Memory and state of the program the lanes start from, shared by all of them.*/
+    int64_t* image;
+    intcode_decoded_t* decoded;
+    size_t image_size;
+    size_t start_head;
+    int64_t start_base;
+    /*Cells written by any lane hold a value per lane, the others are read from the image.*/
+    int64_t** deltas;
+    size_t num_deltas;
+    size_t* written;
+    size_t num_written;
+    size_t written_capacity;
+    size_t* heads;
+    int64_t* bases;
+    uint8_t* states;
+    /*Queues of io_capacity values per lane.*/
+    size_t io_capacity;
+    int64_t* inputs;
+    size_t* input_first;
+    size_t* input_size;
+    int64_t* outputs;
+    size_t* output_first;
+    size_t* output_size;
+    /*Lanes of the last step, reused while they stay together ahead of all waiting lanes.*/
+    size_t* group;
+    size_t num_group;
+    size_t waiting_head;
+    int converged;
+    /*Scratch space of a step, one entry per lane of the group.*/
+    int64_t* operands[INTCODE_MAX_PARAMS];
+    int64_t* results;
+};
+
+static intcode_t* alloc_intcode();
+static int parse_cells(intcode_t* prog, const char* text, size_t length);
+static int load_image(intcode_t* prog, const char* data, size_t length);
+static char* map_file(const char* file_path, size_t* length, int* mapped);
+static void unmap_file(char* data, size_t length, int mapped);
+
+static size_t get_instruction_size(int op_code);
+static int get_opcode(int64_t number);
+static int is_valid_opcode(int op_code);
+
+static intcode_op_f get_op_func(int op_code);
+static void get_parameter_modes(int64_t number, size_t num_parameters, uint8_t* parameter_modes);
+static int get_store_param(int op_code, size_t inst_size);
+static void decode_instruction(int64_t number, intcode_decoded_t* decoded);
+static const intcode_decoded_t* get_decoded_instruction(intcode_t* prog,
+                                                        size_t address,
+                                                        intcode_decoded_t* scratch);
+static int execute_threaded(intcode_t* prog);
+static int execute_profiled(intcode_t* prog);
+static int execute_compiled(intcode_t* prog);
+
+static void regroup_batch(intcode_batch_t* batch);
+static int step_batch(intcode_batch_t* batch);
+static int execute_recorded(intcode_t* prog);
+static void write_checkpoint(intcode_t* prog);
+static void record_io(intcode_t* prog, int64_t value, int is_output);
+static int replay_input(intcode_t* prog, int64_t* value);
+static int replay_output(intcode_t* prog, int64_t value);
+static int parse_recording(intcode_recording_t* recording);
+static intcode_t* restore_checkpoint(const intcode_checkpoint_t* checkpoint);
+static void clear_deltas(intcode_batch_t* batch);
+
+static void destroy_translation(intcode_translation_t* translation);
+static void flush_translation(intcode_translation_t* translation);
+static void sync_translation(intcode_translation_t* translation);
+static void note_code_write(intcode_translation_t* translation, size_t address);
+
+static intcode_page_t* create_page();
+static intcode_page_t* copy_page(const intcode_page_t* page);
+static void share_page(intcode_page_t* page);
+static void release_page(intcode_page_t* page);
+static intcode_page_entry_t* find_sparse_entry(const intcode_t* prog, size_t index);
+static intcode_page_t* find_sparse_page(const intcode_t* prog, size_t index);
+static int insert_sparse_page(intcode_t* prog, size_t index, intcode_page_t* page);
+static intcode_page_t* get_page_for_write(intcode_t* prog, size_t address);
+static int share_page_tables(intcode_t* target, const intcode_t* source);
+static uint64_t mix_hash(uint64_t value);
+static uint64_t hash_page(const intcode_page_t* page);
+static int pages_equal(const intcode_page_t* first, const intcode_page_t* second);
+static int memory_contained_in(const intcode_t* prog, const intcode_t* other);
+
+static int get_parameter_values(const intcode_t* prog,
+                                size_t num_parameters,
+                                int store_param,
+                                const uint8_t* parameter_modes,
+                                int64_t* parameters);
+
+static void write_to_io_std(FILE* stream, int64_t value);
+static int read_from_io_std(FILE* stream, int64_t* value);
+static void write_to_io_mem(intcode_io_mem_t* storage, int64_t value);
+static void read_from_io_mem(intcode_io_mem_t* storage, int64_t* value);
+static void wake_io_ring(intcode_io_ring_t* ring, atomic_int* waiting);
+static int wait_for_io_ring(intcode_io_ring_t* ring, atomic_int* waiting, int for_space);
+
+
+static INTCODE_ALWAYS_INLINE intcode_page_t* find_page(const intcode_t* const prog,
+                                                       const size_t address)
+{
+    size_t index = address >> INTCODE_PAGE_BITS;
+    if (index < prog->num_pages)
+    {
+        return prog->pages[index];
+    }
+    return find_sparse_page(prog, index);
+}
 
-static void write_to_io_std(FILE* const stream, const int64_t value);
-static int read_from_io_std(FILE* const stream, int64_t* value);
-static void write_to_io_mem(intcode_io_mem_t* const storage, const int64_t value);
-static void read_from_io_mem(intcode_io_mem_t* const storage, int64_t* value);
+static INTCODE_ALWAYS_INLINE int page_is_shared(const intcode_page_t* const page)
+{
+    return atomic_load_explicit(&page->refs, memory_order_acquire) > 1;
+}
 
+static INTCODE_ALWAYS_INLINE int64_t load_mem(const intcode_t* const prog, const size_t address)
+{
+    const intcode_page_t* page = find_page(prog, address);
+    return (page != NULL) ? page->cells[address & INTCODE_PAGE_MASK] : 0;
+}
 
 intcode_t* read_intcode(const char* const file_path)
 {
     intcode_t* prog = NULL;
-    if (file_path != NULL)
+    size_t length   = 0;
+    int mapped      = 0;
+    char* data      = map_file(file_path, &length, &mapped);
+    if (data != NULL)
     {
-        size_t num_chars = 0;
-        size_t num_ints  = 0;
-        get_size_info(file_path, &num_chars, &num_ints);
-
-        char* str       = (char*) malloc(sizeof(char) * num_chars);
-        int64_t* memory = (int64_t*) malloc(sizeof(int64_t) * num_ints);
-        FILE* fp        = fopen(file_path, "r");
-        if ((fp != NULL) && (str != NULL) && (memory != NULL))
+        /*Binary images are told apart from text by their header.*/
+        if ((length >= sizeof(intcode_image_header_t)) &&
+            (memcmp(data, INTCODE_IMAGE_MAGIC, 4) == 0))
         {
-            /*We only read the first line.*/
-            if (fscanf(fp, "%s", str) == EOF)
+            prog = alloc_intcode();
+            if ((prog != NULL) && !load_image(prog, data, length))
             {
-                printf("No lines in file.\n");
+                destroy_intcode(prog);
+                prog = NULL;
             }
-            fclose(fp);
+        }
+        else
+        {
+            prog = parse_intcode(data, length);
+        }
+        unmap_file(data, length, mapped);
+    }
+    return prog;
+}
 
-            /*Tokenize string*/
-            size_t index = 0;
-            char* token  = strtok(str, INTCODE_DELIM);
-            while (token != NULL)
+intcode_t* parse_intcode(const char* const text, const size_t length)
+{
+    intcode_t* prog = NULL;
+    if (text != NULL)
+    {
+        prog = alloc_intcode();
+        if ((prog != NULL) && !parse_cells(prog, text, length))
+        {
+            destroy_intcode(prog);
+            prog = NULL;
+        }
+    }
+    return prog;
+}
+
+int write_intcode(const intcode_t* const prog, const char* const file_path)
+{
+    int success = 0;
+    if ((prog != NULL) && (file_path != NULL))
+    {
+        FILE* fp = fopen(file_path, "wb");
+        if (fp != NULL)
+        {
+            intcode_image_header_t header;
+            memcpy(header.magic, INTCODE_IMAGE_MAGIC, 4);
+            header.version   = INTCODE_IMAGE_VERSION;
+            header.num_cells = prog->memory_size;
+            success          = (fwrite(&header, sizeof(header), 1, fp) == 1);
+
+            /*Unallocated pages are written as zeros, the image is always dense.*/
+            int64_t zeros[INTCODE_PAGE_SIZE] = {0};
+            for (size_t address = 0; success && (address < prog->memory_size);
+                 address += INTCODE_PAGE_SIZE)
             {
-                /*TODO might need changing to correctly parse int64_t*/
-                memory[index++] = strtoll(token, NULL, 10);
-                token           = strtok(NULL, INTCODE_DELIM);
+                const intcode_page_t* page = find_page(prog, address);
+                const int64_t* cells       = (page != NULL) ? page->cells : zeros;
+                size_t count               = prog->memory_size - address;
+                count   = (count < INTCODE_PAGE_SIZE) ? count : INTCODE_PAGE_SIZE;
+                success = (fwrite(cells, sizeof(int64_t), count, fp) == count);
             }
-            free(str);
-
-            prog = create_intcode(memory, num_ints);
+            success = (fclose(fp) == 0) && success;
         }
     }
-
-    return prog;
+    return success;
 }
 
 intcode_t* create_intcode(int64_t* const memory, const size_t memory_size)
@@ -104,20 +536,25 @@ intcode_t* create_intcode(int64_t* const memory, const size_t memory_size)
     intcode_t* prog = NULL;
     if (memory != NULL)
     {
-        prog = (intcode_t*) malloc(sizeof(intcode_t));
+        prog = alloc_intcode();
         if (prog != NULL)
         {
-            prog->memory            = memory;
-            prog->memory_size       = memory_size;
-            prog->head              = 0;
-            prog->relative_base     = 0;
-            prog->io_mode           = INT_CODE_STD_IO;
-            prog->std_io_in         = stdin;
-            prog->std_io_out        = stdout;
-            prog->mem_io_in         = NULL;
-            prog->mem_io_out        = NULL;
-            prog->waiting_for_input = 0;
+            /*The program image is copied into pages, the flat array is not needed anymore.*/
+            for (size_t i = 0; i < memory_size; ++i)
+            {
+                if (!set_mem_value(prog, i, memory[i]))
+                {
+                    destroy_intcode(prog);
+                    prog = NULL;
+                    break;
+                }
+            }
+            if (prog != NULL)
+            {
+                prog->memory_size = memory_size;
+            }
         }
+        free(memory);
     }
     return prog;
 }
@@ -126,10 +563,26 @@ void destroy_intcode(intcode_t* const prog)
 {
     if (prog != NULL)
     {
-        if (prog->memory != NULL)
+        destroy_io_mem(prog->mem_io_in);
+        destroy_io_mem(prog->mem_io_out);
+        for (size_t i = 0; i < prog->num_pages; ++i)
+        {
+            release_page(prog->pages[i]);
+        }
+        for (size_t i = 0; i < prog->sparse_capacity; ++i)
         {
-            free(prog->memory);
+            release_page(prog->sparse_pages[i].page);
         }
+        destroy_translation(prog->translation);
+        if (prog->profile != NULL)
+        {
+            free(prog->profile->address_counts);
+            free(prog->profile);
+        }
+        free(prog->fusion_stats);
+        stop_recording(prog);
+        free(prog->pages);
+        free(prog->sparse_pages);
         free(prog);
     }
 }
@@ -137,26 +590,34 @@ void destroy_intcode(intcode_t* const prog)
 int set_mem_value(intcode_t* const prog, const size_t address, const int64_t value)
 {
     int success = 0;
-    if ((prog != NULL) && (prog->memory != NULL))
+    /*Addresses of the program are int64_t, larger ones come from negative values.*/
+    if ((prog != NULL) && (address < (size_t) INT64_MAX))
     {
-        if (address >= prog->memory_size)
+        intcode_page_t* page = get_page_for_write(prog, address);
+        if (page != NULL)
         {
-            /*Allocate more memory*/
-            size_t new_size = address + 1;
-            prog->memory    = realloc(prog->memory, sizeof(int64_t) * new_size);
-            if (prog->memory != NULL)
+            size_t offset       = address & INTCODE_PAGE_MASK;
+            page->cells[offset] = value;
+            success             = 1;
+
+            /*Self-modifying code, the cell has to be decoded again.*/
+            if (page->decoded != NULL)
             {
-                memset(prog->memory + prog->memory_size,
-                       0,
-                       sizeof(int64_t) * (new_size - prog->memory_size));
-                prog->memory_size = new_size;
+                page->decoded[offset].valid = 0;
+                page->fully_decoded         = 0;
+            }
+            if (prog->translation != NULL)
+            {
+                note_code_write(prog->translation, address);
+            }
+            if (address >= prog->memory_size)
+            {
+                prog->memory_size = address + 1;
+                if (prog->profile != NULL)
+                {
+                    prog->profile->memory_growths++;
+                }
             }
-        }
-
-        if (prog->memory != NULL)
-        {
-            prog->memory[address] = value;
-            success               = 1;
         }
     }
     return success;
@@ -167,18 +628,8 @@ int64_t get_mem_value(const intcode_t* const prog, const size_t address)
     int64_t value = 0;
     if (prog != NULL)
     {
-        if (address >= prog->memory_size)
-        {
-            /*Address is outside of memory, i.e. not set.*/
-            /*Even if memory was resized to fit, 0 would be returned.*/
-            /*So let's wait with allocating until values are stored there.*/
-            value = 0;
-        }
-
-        if (prog->memory != NULL)
-        {
-            value = prog->memory[address];
-        }
+        /*Cells that were never written are not backed by a page and read as 0.*/
+        value = load_mem(prog, address);
     }
     return value;
 }
@@ -188,19 +639,19 @@ void print_intcode(const intcode_t* const prog)
     if (prog != NULL)
     {
         /*Print program*/
-        int op_code       = get_opcode(prog->memory[0]);
+        int op_code       = get_opcode(get_mem_value(prog, 0));
         size_t inst_index = 0;
         size_t inst_size  = get_instruction_size(op_code);
         for (size_t i = 0; i < prog->memory_size; i++)
         {
-            printf("%ld", prog->memory[i]);
+            printf("%ld", get_mem_value(prog, i));
             if (((inst_index + 1) % inst_size) == 0)
             {
                 printf("\n");
                 if ((i + 1) < prog->memory_size)
                 {
                     inst_index = 0;
-                    op_code    = get_opcode(prog->memory[i + 1]);
+                    op_code    = get_opcode(get_mem_value(prog, i + 1));
                     inst_size  = get_instruction_size(op_code);
                 }
             }
@@ -222,6 +673,28 @@ void set_io_mode(intcode_t* const prog, const intcode_io_mode_t mode)
     }
 }
 
+void set_engine(intcode_t* const prog, const intcode_engine_t engine)
+{
+    if (prog != NULL)
+    {
+        /*Only the compiled engine keeps the translation up to date.*/
+        if (engine != INT_CODE_ENGINE_COMPILED)
+        {
+            destroy_translation(prog->translation);
+            prog->translation = NULL;
+        }
+        prog->engine = engine;
+    }
+}
+
+void set_io_yield(intcode_t* const prog, const int yield)
+{
+    if (prog != NULL)
+    {
+        prog->io_yield = yield;
+    }
+}
+
 void set_mem_io_in(intcode_t* const prog, intcode_io_mem_t* const input_store)
 {
     if (prog != NULL)
@@ -238,6 +711,22 @@ void set_mem_io_out(intcode_t* const prog, intcode_io_mem_t* const output_store)
     }
 }
 
+void set_ring_io_in(intcode_t* const prog, intcode_io_ring_t* const input_ring)
+{
+    if (prog != NULL)
+    {
+        prog->ring_io_in = input_ring;
+    }
+}
+
+void set_ring_io_out(intcode_t* const prog, intcode_io_ring_t* const output_ring)
+{
+    if (prog != NULL)
+    {
+        prog->ring_io_out = output_ring;
+    }
+}
+
 void set_std_io_in(intcode_t* const prog, FILE* const input_stream)
 {
     if (prog != NULL)
@@ -256,30 +745,187 @@ void set_std_io_out(intcode_t* const prog, FILE* const output_stream)
 intcode_t* copy_intcode(const intcode_t* const prog)
 {
     intcode_t* copy = NULL;
+    if ((prog != NULL) && (prog->memory_size > 0))
+    {
+        /*Same memory, but the copy starts from the beginning with default IO.*/
+        copy = fork_intcode(prog);
+        if (copy != NULL)
+        {
+            copy->head          = 0;
+            copy->relative_base = 0;
+            copy->io_mode       = INT_CODE_STD_IO;
+            copy->std_io_in     = stdin;
+            copy->std_io_out    = stdout;
+        }
+    }
+    return copy;
+}
+
+intcode_t* fork_intcode(const intcode_t* const prog)
+{
+    intcode_t* fork = NULL;
     if (prog != NULL)
     {
-        if ((prog->memory != NULL) && (prog->memory_size > 0))
+        fork = (intcode_t*) malloc(sizeof(intcode_t));
+        if (fork == NULL)
         {
-            int64_t* memory_copy = (int64_t*) malloc(sizeof(int64_t) * prog->memory_size);
-            if (memory_copy != NULL)
+            return NULL;
+        }
+        *fork                   = *prog;
+        fork->mem_io_in         = NULL;
+        fork->mem_io_out        = NULL;
+        fork->ring_io_in        = NULL;
+        fork->ring_io_out       = NULL;
+        fork->waiting_for_input = 0;
+        fork->profile           = NULL;
+        fork->translation       = NULL;
+        fork->fusion_stats      = NULL;
+        fork->recorder          = NULL;
+        if (!share_page_tables(fork, prog))
+        {
+            free(fork);
+            return NULL;
+        }
+    }
+    return fork;
+}
+
+intcode_snapshot_t* snapshot_intcode(const intcode_t* const prog)
+{
+    intcode_snapshot_t* snapshot = NULL;
+    if (prog != NULL)
+    {
+        snapshot = (intcode_snapshot_t*) malloc(sizeof(intcode_snapshot_t));
+        if (snapshot != NULL)
+        {
+            snapshot->state = fork_intcode(prog);
+            if (snapshot->state == NULL)
             {
-                for (size_t i = 0; i < prog->memory_size; ++i)
-                {
-                    memory_copy[i] = prog->memory[i];
-                }
+                free(snapshot);
+                return NULL;
             }
-            copy = create_intcode(memory_copy, prog->memory_size);
+            /*All pages are shared now, only the ones written since the last fork are hashed.*/
+            snapshot->hash = hash_intcode(snapshot->state);
         }
     }
-    return copy;
+    return snapshot;
+}
+
+void destroy_snapshot(intcode_snapshot_t* const snapshot)
+{
+    if (snapshot != NULL)
+    {
+        destroy_intcode(snapshot->state);
+        free(snapshot);
+    }
+}
+
+int restore_intcode(intcode_t* const prog, const intcode_snapshot_t* const snapshot)
+{
+    /*A recording can only be replayed if the machine never jumps between states.*/
+    if ((prog == NULL) || (snapshot == NULL) || (prog->recorder != NULL))
+    {
+        return 0;
+    }
+
+    intcode_page_t** pages             = prog->pages;
+    size_t num_pages                   = prog->num_pages;
+    intcode_page_entry_t* sparse_pages = prog->sparse_pages;
+    size_t sparse_capacity             = prog->sparse_capacity;
+    size_t sparse_count                = prog->sparse_count;
+    if (!share_page_tables(prog, snapshot->state))
+    {
+        prog->pages           = pages;
+        prog->num_pages       = num_pages;
+        prog->sparse_pages    = sparse_pages;
+        prog->sparse_capacity = sparse_capacity;
+        prog->sparse_count    = sparse_count;
+        return 0;
+    }
+    for (size_t i = 0; i < num_pages; ++i)
+    {
+        release_page(pages[i]);
+    }
+    for (size_t i = 0; i < sparse_capacity; ++i)
+    {
+        release_page(sparse_pages[i].page);
+    }
+    free(pages);
+    free(sparse_pages);
+
+    prog->memory_size       = snapshot->state->memory_size;
+    prog->head              = snapshot->state->head;
+    prog->relative_base     = snapshot->state->relative_base;
+    prog->waiting_for_input = 0;
+    if (prog->translation != NULL)
+    {
+        /*Closures still point into the replaced pages.*/
+        prog->translation->stale = 1;
+        prog->translation->dirty = 1;
+    }
+    return 1;
+}
+
+intcode_t* clone_snapshot(const intcode_snapshot_t* const snapshot)
+{
+    return (snapshot != NULL) ? fork_intcode(snapshot->state) : NULL;
+}
+
+uint64_t hash_intcode(const intcode_t* const prog)
+{
+    if (prog == NULL)
+    {
+        return 0;
+    }
+
+    /*Combined order independent, so the layout of the sparse table does not matter.*/
+    uint64_t hash = mix_hash(prog->head) ^ mix_hash(~(uint64_t) prog->relative_base);
+    for (size_t i = 0; i < prog->num_pages + prog->sparse_capacity; ++i)
+    {
+        const intcode_page_t* page =
+            (i < prog->num_pages) ? prog->pages[i] : prog->sparse_pages[i - prog->num_pages].page;
+        size_t index = (i < prog->num_pages) ? i : prog->sparse_pages[i - prog->num_pages].index;
+        if (page != NULL)
+        {
+            uint64_t page_hash = page_is_shared(page) ? page->hash : hash_page(page);
+            /*Zero pages read like unallocated ones and are left out.*/
+            if (page_hash != 0)
+            {
+                hash ^= mix_hash(page_hash + (index * 0x9E3779B97F4A7C15ull));
+            }
+        }
+    }
+    return hash;
+}
+
+uint64_t get_snapshot_hash(const intcode_snapshot_t* const snapshot)
+{
+    return (snapshot != NULL) ? snapshot->hash : 0;
+}
+
+int snapshots_equal(const intcode_snapshot_t* const first, const intcode_snapshot_t* const second)
+{
+    if ((first == NULL) || (second == NULL))
+    {
+        return 0;
+    }
+    if (first == second)
+    {
+        return 1;
+    }
+    const intcode_t* a = first->state;
+    const intcode_t* b = second->state;
+    return (first->hash == second->hash) && (a->head == b->head) &&
+           (a->relative_base == b->relative_base) && memory_contained_in(a, b) &&
+           memory_contained_in(b, a);
 }
 
 int output_intcode(const intcode_t* const prog)
 {
     int out = -1;
-    if ((prog != NULL) && (prog->memory != NULL) && (prog->memory_size > 0))
+    if ((prog != NULL) && (prog->memory_size > 0))
     {
-        out = prog->memory[0];
+        out = get_mem_value(prog, 0);
     }
     return out;
 }
@@ -306,465 +952,3599 @@ void destroy_io_mem(intcode_io_mem_t* const store)
     }
 }
 
-int execute(intcode_t* const prog)
+intcode_io_ring_t* create_io_ring(const size_t capacity)
 {
-    int ret = INT_CODE_ERROR;
-    if (prog != NULL)
+    /*The capacity is rounded up to a power of two, so slots are found with a mask.*/
+    size_t size = 2;
+    while ((size < capacity) && (size <= (SIZE_MAX / 2)))
     {
-        ret = INT_CODE_CONTINUE;
-        while (ret == INT_CODE_CONTINUE)
+        size *= 2;
+    }
+
+    /*Rings are not owned by a machine, a ring connects the output of one to the input of another.*/
+    size_t ring_size = sizeof(intcode_io_ring_t);
+    ring_size        = (ring_size + INTCODE_CACHE_LINE - 1) & ~((size_t) INTCODE_CACHE_LINE - 1);
+    intcode_io_ring_t* ring = (intcode_io_ring_t*) aligned_alloc(INTCODE_CACHE_LINE, ring_size);
+    if (ring != NULL)
+    {
+        ring->values = (int64_t*) malloc(sizeof(int64_t) * size);
+        if (ring->values == NULL)
         {
-            int op_code;
-            ret = execute_head_block(prog, &op_code);
+            free(ring);
+            return NULL;
         }
+        ring->mask = size - 1;
+        atomic_init(&ring->tail, 0);
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->reader_waiting, 0);
+        atomic_init(&ring->writer_waiting, 0);
+        atomic_init(&ring->closed, 0);
+        pthread_mutex_init(&ring->mut, NULL);
+        pthread_cond_init(&ring->cond, NULL);
     }
-    return ret;
+    return ring;
 }
 
-int execute_head_block(intcode_t* const prog, int* const op_code)
+void destroy_io_ring(intcode_io_ring_t* const ring)
 {
-    int ret = INT_CODE_ERROR;
-    if (prog != NULL)
+    if (ring != NULL)
     {
-        size_t head = prog->head;
-        *op_code    = get_opcode(get_mem_value(prog, prog->head));
-#ifdef DEBUG
-        printf("Op Code: %d\n", *op_code);
-#endif
-        size_t inst_size = get_instruction_size(*op_code);
-
-#ifdef DEBUG
-        for (int i = 0; i < inst_size; ++i)
-        {
-            printf("%ld ", prog->memory[head + i]);
-        }
-        printf("\n");
-#endif
-        if (*op_code == OP_CODE_HALT)
-        {
-            ret = INT_CODE_HALT;
-        }
-        else if (is_valid_opcode(*op_code))
-        {
-            int64_t parameters[inst_size - 1];
-            int parameter_modes[inst_size - 1];
-            int store_param = inst_size - 2;
-            if ((*op_code == OP_CODE_OUTPUT) || (*op_code == OP_CODE_JMP_IF_TRUE) ||
-                (*op_code == OP_CODE_JMP_IF_FALSE) || (*op_code == OP_CODE_ADJUST_REL_BASE))
-            {
-                store_param = INTCODE_NO_STORE;
-            }
-            get_parameter_modes(get_mem_value(prog, head), inst_size - 1, parameter_modes);
-            if (get_parameter_values(prog, inst_size - 1, store_param, parameter_modes, parameters))
-            {
-#ifdef DEBUG
-                for (int i = 0; i < inst_size - 1; i++)
-                {
-                    printf("%d\t%ld\n", parameter_modes[i], parameters[i]);
-                }
-#endif
-                ret = get_op_func(*op_code)(prog, parameters);
-            }
-        }
+        pthread_mutex_destroy(&ring->mut);
+        pthread_cond_destroy(&ring->cond);
+        free(ring->values);
+        free(ring);
     }
-    return ret;
 }
 
-int waiting_for_input(const intcode_t* const prog)
+void close_io_ring(intcode_io_ring_t* const ring)
 {
-    int waiting = 0;
-    if (prog != NULL)
+    if (ring != NULL)
     {
-        waiting = prog->waiting_for_input;
+        /*Values already in the ring can still be read, blocked readers and writers return.*/
+        atomic_store(&ring->closed, 1);
+        pthread_mutex_lock(&ring->mut);
+        pthread_cond_broadcast(&ring->cond);
+        pthread_mutex_unlock(&ring->mut);
     }
-    return waiting;
 }
 
-int add_op(intcode_t* const prog, const int64_t* const parameters)
+size_t io_ring_size(const intcode_io_ring_t* const ring)
 {
-    int op_ret = INT_CODE_ERROR;
-    /*TODO add boundary checks*/
-    /*Assuming parameters has the correct size*/
-    if ((prog != NULL) && (parameters != NULL))
+    size_t size = 0;
+    if (ring != NULL)
     {
-        int64_t first  = parameters[0];
-        int64_t second = parameters[1];
-        int64_t result = parameters[2];
-        int ret        = set_mem_value(prog, result, (first + second));
-        if (ret != 0)
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        size        = tail - head;
+    }
+    return size;
+}
+
+size_t io_ring_capacity(const intcode_io_ring_t* const ring)
+{
+    return (ring != NULL) ? (ring->mask + 1) : 0;
+}
+
+int io_ring_closed(const intcode_io_ring_t* const ring)
+{
+    return (ring == NULL) || atomic_load(&ring->closed);
+}
+
+size_t io_ring_try_write(intcode_io_ring_t* const ring,
+                         const int64_t* const values,
+                         const size_t count)
+{
+    size_t written = 0;
+    if ((ring != NULL) && (values != NULL))
+    {
+        size_t tail  = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        size_t head  = atomic_load_explicit(&ring->head, memory_order_acquire);
+        size_t space = (ring->mask + 1) - (tail - head);
+        written      = (count < space) ? count : space;
+        for (size_t i = 0; i < written; ++i)
         {
-            prog->head += get_instruction_size(OP_CODE_ADD);
-            op_ret = INT_CODE_CONTINUE;
+            ring->values[(tail + i) & ring->mask] = values[i];
+        }
+        if (written > 0)
+        {
+            /*The whole batch is published with a single store.*/
+            atomic_store_explicit(&ring->tail, tail + written, memory_order_release);
+            wake_io_ring(ring, &ring->reader_waiting);
         }
     }
-    return op_ret;
+    return written;
 }
 
-int multiply_op(intcode_t* const prog, const int64_t* const parameters)
+size_t io_ring_try_read(intcode_io_ring_t* const ring, int64_t* const values, const size_t count)
 {
-    int op_ret = INT_CODE_ERROR;
-    /*TODO add boundary checks*/
-    /*Assuming parameters has the correct size*/
-    if ((prog != NULL) && (parameters != NULL))
+    size_t read = 0;
+    if ((ring != NULL) && (values != NULL))
     {
-        int64_t first  = parameters[0];
-        int64_t second = parameters[1];
-        int64_t result = parameters[2];
-        int ret        = set_mem_value(prog, result, (first * second));
-        if (ret != 0)
+        size_t head      = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        size_t tail      = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        size_t available = tail - head;
+        read             = (count < available) ? count : available;
+        for (size_t i = 0; i < read; ++i)
         {
-            prog->head += get_instruction_size(OP_CODE_MULT);
-            op_ret = INT_CODE_CONTINUE;
+            values[i] = ring->values[(head + i) & ring->mask];
+        }
+        if (read > 0)
+        {
+            atomic_store_explicit(&ring->head, head + read, memory_order_release);
+            wake_io_ring(ring, &ring->writer_waiting);
         }
     }
-    return op_ret;
+    return read;
 }
 
-int input_op(intcode_t* const prog, const int64_t* const parameters)
+size_t io_ring_write(intcode_io_ring_t* const ring, const int64_t* const values, const size_t count)
 {
-    int op_ret = INT_CODE_ERROR;
-    if ((prog != NULL) && (parameters != NULL))
+    size_t written = 0;
+    if ((ring != NULL) && (values != NULL))
     {
-        int64_t val;
-        prog->waiting_for_input = 1;
-        if (prog->io_mode == INT_CODE_STD_IO)
+        written = io_ring_try_write(ring, values, count);
+        while ((written < count) && wait_for_io_ring(ring, &ring->writer_waiting, 1))
         {
-            if (read_from_io_std(prog->std_io_in, &val))
-            {
-                int ret = set_mem_value(prog, parameters[0], val);
-                if (ret != 0)
-                {
-                    prog->head += get_instruction_size(OP_CODE_INPUT);
-                    op_ret = INT_CODE_CONTINUE;
-                }
-                prog->waiting_for_input = 0;
-            }
+            written += io_ring_try_write(ring, values + written, count - written);
         }
-        else if (prog->io_mode == INT_CODE_MEM_IO)
+    }
+    return written;
+}
+
+size_t io_ring_read(intcode_io_ring_t* const ring, int64_t* const values, const size_t count)
+{
+    size_t read = 0;
+    if ((ring != NULL) && (values != NULL))
+    {
+        read = io_ring_try_read(ring, values, count);
+        while ((read < count) && wait_for_io_ring(ring, &ring->reader_waiting, 0))
         {
-            pthread_mutex_lock(&prog->mem_io_in->mut);
-            while (prog->mem_io_in->consumed)
+            read += io_ring_try_read(ring, values + read, count - read);
+        }
+    }
+    return read;
+}
+
+int enable_profiling(intcode_t* const prog, FILE* const report)
+{
+    int success = 0;
+    if (prog != NULL)
+    {
+        if (prog->profile == NULL)
+        {
+            prog->profile = (intcode_profile_t*) calloc(1, sizeof(intcode_profile_t));
+        }
+        if (prog->profile != NULL)
+        {
+            prog->profile->report = report;
+            success               = 1;
+        }
+    }
+    return success;
+}
+
+const intcode_profile_t* get_profile(const intcode_t* const prog)
+{
+    return (prog != NULL) ? prog->profile : NULL;
+}
+
+void print_profile(const intcode_t* const prog, FILE* const stream)
+{
+    static const char* const op_names[INT_CODE_PROFILE_OPS] = {
+        [OP_CODE_ADD] = "add",
+        [OP_CODE_MULT] = "multiply",
+        [OP_CODE_INPUT] = "input",
+        [OP_CODE_OUTPUT] = "output",
+        [OP_CODE_JMP_IF_TRUE] = "jump if true",
+        [OP_CODE_JMP_IF_FALSE] = "jump if false",
+        [OP_CODE_IS_LESS] = "less than",
+        [OP_CODE_IS_EQUALS] = "equals",
+        [OP_CODE_ADJUST_REL_BASE] = "adjust base",
+        [OP_CODE_HALT] = "halt",
+    };
+    if ((prog == NULL) || (prog->profile == NULL) || (stream == NULL))
+    {
+        return;
+    }
+    const intcode_profile_t* profile = prog->profile;
+    double run_ms                    = profile->run_ns / 1e6;
+    double total                     = (profile->instructions > 0) ? profile->instructions : 1;
+    double run                       = (profile->run_ns > 0) ? profile->run_ns : 1;
+
+    fprintf(stream, "Intcode profile\n");
+    fprintf(stream,
+            "  %lu instructions in %.3f ms, %.2f M/s\n",
+            profile->instructions,
+            run_ms,
+            (profile->instructions / run) * 1e3);
+    /*A large share of IO time means the machine mostly waited for the other side.*/
+    fprintf(stream,
+            "  input %.3f ms (%.1f%%), output %.3f ms (%.1f%%), %lu yields\n",
+            profile->input_ns / 1e6,
+            (100.0 * profile->input_ns) / run,
+            profile->output_ns / 1e6,
+            (100.0 * profile->output_ns) / run,
+            profile->num_blocked);
+    fprintf(stream,
+            "  memory %zu cells, %lu growths, %lu pages allocated, %lu pages copied\n",
+            prog->memory_size,
+            profile->memory_growths,
+            profile->page_allocations,
+            profile->page_copies);
+
+    fprintf(stream, "  %4s %-14s %14s %8s\n", "op", "name", "count", "share");
+    for (int op = 0; op < INT_CODE_PROFILE_OPS; ++op)
+    {
+        if (profile->op_counts[op] > 0)
+        {
+            fprintf(stream,
+                    "  %4d %-14s %14lu %7.2f%%\n",
+                    op,
+                    (op_names[op] != NULL) ? op_names[op] : "invalid",
+                    profile->op_counts[op],
+                    (100.0 * profile->op_counts[op]) / total);
+        }
+    }
+
+    /*Repeated selection is fine for a handful of entries.*/
+    fprintf(stream, "  %8s %14s %8s\n", "address", "count", "share");
+    size_t previous = SIZE_MAX;
+    for (int rank = 0; rank < INTCODE_PROFILE_HOT_ADDRESSES; ++rank)
+    {
+        size_t best = SIZE_MAX;
+        for (size_t i = 0; i < profile->num_addresses; ++i)
+        {
+            uint64_t count = profile->address_counts[i];
+            int below      = (previous == SIZE_MAX) ||
+                        (count < profile->address_counts[previous]) ||
+                        ((count == profile->address_counts[previous]) && (i > previous));
+            if ((count > 0) && below &&
+                ((best == SIZE_MAX) || (count > profile->address_counts[best])))
             {
-                pthread_cond_wait(&prog->mem_io_in->cond, &prog->mem_io_in->mut);
+                best = i;
             }
-            read_from_io_mem(prog->mem_io_in, &val);
-            pthread_cond_signal(&prog->mem_io_in->cond);
-            pthread_mutex_unlock(&prog->mem_io_in->mut);
+        }
+        if (best == SIZE_MAX)
+        {
+            break;
+        }
+        fprintf(stream,
+                "  %8zu %14lu %7.2f%%\n",
+                best,
+                profile->address_counts[best],
+                (100.0 * profile->address_counts[best]) / total);
+        previous = best;
+    }
+}
 
-            int ret = set_mem_value(prog, parameters[0], val);
-            if (ret != 0)
+int enable_fusion_stats(intcode_t* const prog)
+{
+    int success = 0;
+    if (prog != NULL)
+    {
+        if (prog->fusion_stats == NULL)
+        {
+            prog->fusion_stats =
+                (intcode_fusion_stats_t*) calloc(1, sizeof(intcode_fusion_stats_t));
+            /*Blocks translated so far do not count their fused closures.*/
+            if (prog->translation != NULL)
             {
-                prog->head += get_instruction_size(OP_CODE_INPUT);
-                op_ret = INT_CODE_CONTINUE;
+                flush_translation(prog->translation);
             }
-            prog->waiting_for_input = 0;
         }
+        success = (prog->fusion_stats != NULL);
     }
-    return op_ret;
+    return success;
 }
 
-int output_op(intcode_t* const prog, const int64_t* const parameters)
+const intcode_fusion_stats_t* get_fusion_stats(const intcode_t* const prog)
 {
-    /*TODO add boundary checks*/
-    int op_ret = INT_CODE_ERROR;
-    if (parameters != NULL)
+    return (prog != NULL) ? prog->fusion_stats : NULL;
+}
+
+void print_fusion_stats(const intcode_t* const prog, FILE* const stream)
+{
+    static const char* const fusion_names[INT_CODE_FUSION_KINDS] = {
+        [INT_CODE_FUSION_REL_BASE]     = "relative base",
+        [INT_CODE_FUSION_COMPARE_JUMP] = "compare and jump",
+        [INT_CODE_FUSION_COUNTER_JUMP] = "counter and jump",
+    };
+    if ((prog == NULL) || (prog->fusion_stats == NULL) || (stream == NULL))
     {
-        if (prog->io_mode == INT_CODE_STD_IO)
+        return;
+    }
+    uint64_t total = 0;
+    fprintf(stream, "Intcode fusions\n");
+    fprintf(stream, "  %-18s %14s\n", "fusion", "fired");
+    for (int kind = 0; kind < INT_CODE_FUSION_KINDS; ++kind)
+    {
+        fprintf(stream, "  %-18s %14lu\n", fusion_names[kind], prog->fusion_stats->fired[kind]);
+        total += prog->fusion_stats->fired[kind];
+    }
+    fprintf(stream, "  %lu dispatches saved\n", total);
+}
+
+int start_recording(intcode_t* const prog,
+                    const char* const file_path,
+                    const uint64_t checkpoint_interval)
+{
+    if ((prog == NULL) || (file_path == NULL) || (prog->recorder != NULL))
+    {
+        return 0;
+    }
+    intcode_recorder_t* recorder = (intcode_recorder_t*) calloc(1, sizeof(intcode_recorder_t));
+    if (recorder == NULL)
+    {
+        return 0;
+    }
+    recorder->log = fopen(file_path, "wb");
+    if (recorder->log == NULL)
+    {
+        free(recorder);
+        return 0;
+    }
+    recorder->checkpoint_interval = checkpoint_interval;
+    recorder->stop_at             = UINT64_MAX;
+    prog->recorder                = recorder;
+
+    intcode_recording_header_t header;
+    memcpy(header.magic, INTCODE_RECORDING_MAGIC, 4);
+    header.version             = INTCODE_RECORDING_VERSION;
+    header.checkpoint_interval = checkpoint_interval;
+    recorder->failed           = (fwrite(&header, sizeof(header), 1, recorder->log) != 1);
+
+    /*The first checkpoint holds the whole machine, a replay does not need the program.*/
+    write_checkpoint(prog);
+    return !recorder->failed;
+}
+
+int stop_recording(intcode_t* const prog)
+{
+    if ((prog == NULL) || (prog->recorder == NULL))
+    {
+        return 0;
+    }
+    intcode_recorder_t* recorder = prog->recorder;
+    int success                  = !recorder->failed;
+    if (recorder->log != NULL)
+    {
+        success = (fclose(recorder->log) == 0) && success;
+    }
+    free(recorder);
+    prog->recorder = NULL;
+    return success;
+}
+
+uint64_t get_instruction_count(const intcode_t* const prog)
+{
+    return ((prog != NULL) && (prog->recorder != NULL)) ? prog->recorder->instructions : 0;
+}
+
+intcode_recording_t* load_recording(const char* const file_path)
+{
+    size_t length = 0;
+    int mapped    = 0;
+    char* data    = map_file(file_path, &length, &mapped);
+    if (data == NULL)
+    {
+        return NULL;
+    }
+    intcode_recording_t* recording =
+        (intcode_recording_t*) calloc(1, sizeof(intcode_recording_t));
+    if (recording == NULL)
+    {
+        unmap_file(data, length, mapped);
+        return NULL;
+    }
+    recording->data   = data;
+    recording->length = length;
+    recording->mapped = mapped;
+    if (!parse_recording(recording))
+    {
+        destroy_recording(recording);
+        return NULL;
+    }
+    return recording;
+}
+
+void destroy_recording(intcode_recording_t* const recording)
+{
+    if (recording != NULL)
+    {
+        unmap_file(recording->data, recording->length, recording->mapped);
+        free(recording->events);
+        free(recording->checkpoints);
+        free(recording);
+    }
+}
+
+const intcode_io_event_t* get_recorded_events(const intcode_recording_t* const recording,
+                                              size_t* const num_events)
+{
+    if ((recording == NULL) || (num_events == NULL))
+    {
+        return NULL;
+    }
+    *num_events = recording->num_events;
+    return recording->events;
+}
+
+intcode_t* replay_intcode(const intcode_recording_t* const recording, const uint64_t instruction)
+{
+    if (recording == NULL)
+    {
+        return NULL;
+    }
+    /*The last checkpoint before the instruction, the first one is always at instruction 0.*/
+    size_t low  = 0;
+    size_t high = recording->num_checkpoints;
+    while ((high - low) > 1)
+    {
+        size_t middle = low + ((high - low) / 2);
+        if (recording->checkpoints[middle].instruction <= instruction)
         {
-            write_to_io_std(prog->std_io_out, parameters[0]);
+            low = middle;
         }
-        else if (prog->io_mode == INT_CODE_MEM_IO)
+        else
         {
-            pthread_mutex_lock(&prog->mem_io_out->mut);
-            while (!prog->mem_io_out->consumed)
-            {
-                /*spin*/
-                pthread_cond_signal(&prog->mem_io_out->cond);
-                pthread_cond_wait(&prog->mem_io_out->cond, &prog->mem_io_out->mut);
-            }
-            write_to_io_mem(prog->mem_io_out, parameters[0]);
-            /*prog->output_ready = 1;*/
-            pthread_cond_signal(&prog->mem_io_out->cond);
-            pthread_mutex_unlock(&prog->mem_io_out->mut);
+            high = middle;
         }
-        prog->head += get_instruction_size(OP_CODE_OUTPUT);
-        op_ret = INT_CODE_CONTINUE;
     }
-    return op_ret;
+    const intcode_checkpoint_t* checkpoint = &recording->checkpoints[low];
+    intcode_t* prog                        = restore_checkpoint(checkpoint);
+    intcode_recorder_t* recorder = (intcode_recorder_t*) calloc(1, sizeof(intcode_recorder_t));
+    if ((prog == NULL) || (recorder == NULL))
+    {
+        destroy_intcode(prog);
+        free(recorder);
+        return NULL;
+    }
+
+    /*Events before the checkpoint happened before the state it holds.*/
+    recorder->recording    = recording;
+    recorder->instructions = checkpoint->instruction;
+    recorder->stop_at      = instruction;
+    while ((recorder->next_input < recording->num_events) &&
+           (recording->events[recorder->next_input].instruction < checkpoint->instruction))
+    {
+        recorder->next_input++;
+    }
+    recorder->next_output = recorder->next_input;
+    prog->recorder        = recorder;
+    prog->io_mode         = INT_CODE_REPLAY_IO;
+
+    /*Running out of recorded input before the instruction leaves the machine where it stopped.*/
+    prog->io_yield    = 1;
+    int ret           = execute_recorded(prog);
+    prog->io_yield    = 0;
+    recorder->stop_at = UINT64_MAX;
+    if (ret == INT_CODE_ERROR)
+    {
+        destroy_intcode(prog);
+        return NULL;
+    }
+    return prog;
 }
 
-int jmp_if_true_op(intcode_t* const prog, const int64_t* const parameters)
+intcode_batch_t* create_intcode_batch(const intcode_t* const prog,
+                                      const size_t num_lanes,
+                                      const size_t io_capacity)
 {
-    /*TODO add boundary checks*/
-    int op_ret = INT_CODE_ERROR;
-    if (parameters != NULL)
+    if ((prog == NULL) || (num_lanes == 0) || (io_capacity == 0))
     {
-        if (parameters[0] != 0)
+        return NULL;
+    }
+    intcode_batch_t* batch = (intcode_batch_t*) calloc(1, sizeof(intcode_batch_t));
+    if (batch == NULL)
+    {
+        return NULL;
+    }
+    /*The lanes start where the program is, like forks of it.*/
+    batch->num_lanes    = num_lanes;
+    batch->image_size   = prog->memory_size;
+    batch->start_head   = prog->head;
+    batch->start_base   = prog->relative_base;
+    batch->num_deltas   = (prog->memory_size > 0) ? prog->memory_size : 1;
+    batch->io_capacity  = io_capacity;
+    batch->image        = (int64_t*) malloc(sizeof(int64_t) * batch->num_deltas);
+    batch->decoded      = (intcode_decoded_t*) calloc(batch->num_deltas, sizeof(intcode_decoded_t));
+    batch->deltas       = (int64_t**) calloc(batch->num_deltas, sizeof(int64_t*));
+    batch->heads        = (size_t*) calloc(num_lanes, sizeof(size_t));
+    batch->bases        = (int64_t*) calloc(num_lanes, sizeof(int64_t));
+    batch->states       = (uint8_t*) calloc(num_lanes, sizeof(uint8_t));
+    batch->inputs       = (int64_t*) calloc(num_lanes * io_capacity, sizeof(int64_t));
+    batch->input_first  = (size_t*) calloc(num_lanes, sizeof(size_t));
+    batch->input_size   = (size_t*) calloc(num_lanes, sizeof(size_t));
+    batch->outputs      = (int64_t*) calloc(num_lanes * io_capacity, sizeof(int64_t));
+    batch->output_first = (size_t*) calloc(num_lanes, sizeof(size_t));
+    batch->output_size  = (size_t*) calloc(num_lanes, sizeof(size_t));
+    batch->group        = (size_t*) calloc(num_lanes, sizeof(size_t));
+    batch->results      = (int64_t*) calloc(num_lanes, sizeof(int64_t));
+    int success = (batch->image != NULL) && (batch->decoded != NULL) && (batch->deltas != NULL) &&
+                  (batch->heads != NULL) && (batch->bases != NULL) && (batch->states != NULL) &&
+                  (batch->inputs != NULL) && (batch->input_first != NULL) &&
+                  (batch->input_size != NULL) && (batch->outputs != NULL) &&
+                  (batch->output_first != NULL) && (batch->output_size != NULL) &&
+                  (batch->group != NULL) && (batch->results != NULL);
+    for (int p = 0; p < INTCODE_MAX_PARAMS; ++p)
+    {
+        batch->operands[p] = (int64_t*) calloc(num_lanes, sizeof(int64_t));
+        success            = success && (batch->operands[p] != NULL);
+    }
+    if (!success)
+    {
+        destroy_intcode_batch(batch);
+        return NULL;
+    }
+    for (size_t address = 0; address < batch->image_size; ++address)
+    {
+        batch->image[address] = get_mem_value(prog, address);
+        decode_instruction(batch->image[address], &batch->decoded[address]);
+    }
+    reset_intcode_batch(batch, num_lanes);
+    return batch;
+}
+
+void destroy_intcode_batch(intcode_batch_t* const batch)
+{
+    if (batch != NULL)
+    {
+        if (batch->deltas != NULL)
+        {
+            clear_deltas(batch);
+        }
+        for (int p = 0; p < INTCODE_MAX_PARAMS; ++p)
+        {
+            free(batch->operands[p]);
+        }
+        free(batch->image);
+        free(batch->decoded);
+        free(batch->deltas);
+        free(batch->written);
+        free(batch->heads);
+        free(batch->bases);
+        free(batch->states);
+        free(batch->inputs);
+        free(batch->input_first);
+        free(batch->input_size);
+        free(batch->outputs);
+        free(batch->output_first);
+        free(batch->output_size);
+        free(batch->group);
+        free(batch->results);
+        free(batch);
+    }
+}
+
+void reset_intcode_batch(intcode_batch_t* const batch, const size_t num_lanes)
+{
+    if (batch == NULL)
+    {
+        return;
+    }
+    clear_deltas(batch);
+    /*Lanes left out report that they halted.*/
+    batch->num_used  = (num_lanes < batch->num_lanes) ? num_lanes : batch->num_lanes;
+    batch->converged = 0;
+    for (size_t lane = 0; lane < batch->num_lanes; ++lane)
+    {
+        batch->heads[lane]        = batch->start_head;
+        batch->bases[lane]        = batch->start_base;
+        batch->states[lane]       = (lane < batch->num_used) ? INT_CODE_CONTINUE : INT_CODE_HALT;
+        batch->input_first[lane]  = 0;
+        batch->input_size[lane]   = 0;
+        batch->output_first[lane] = 0;
+        batch->output_size[lane]  = 0;
+    }
+}
+
+size_t intcode_batch_write(intcode_batch_t* const batch,
+                           const size_t lane,
+                           const int64_t* const values,
+                           const size_t count)
+{
+    if ((batch == NULL) || (lane >= batch->num_used) || (values == NULL))
+    {
+        return 0;
+    }
+    int64_t* queue = &batch->inputs[lane * batch->io_capacity];
+    size_t written = 0;
+    while ((written < count) && (batch->input_size[lane] < batch->io_capacity))
+    {
+        size_t slot = (batch->input_first[lane] + batch->input_size[lane]) % batch->io_capacity;
+        queue[slot] = values[written++];
+        batch->input_size[lane]++;
+    }
+    return written;
+}
+
+size_t intcode_batch_read(intcode_batch_t* const batch,
+                          const size_t lane,
+                          int64_t* const values,
+                          const size_t count)
+{
+    if ((batch == NULL) || (lane >= batch->num_used) || (values == NULL))
+    {
+        return 0;
+    }
+    const int64_t* queue = &batch->outputs[lane * batch->io_capacity];
+    size_t read          = 0;
+    while ((read < count) && (batch->output_size[lane] > 0))
+    {
+        values[read++]            = queue[batch->output_first[lane]];
+        batch->output_first[lane] = (batch->output_first[lane] + 1) % batch->io_capacity;
+        batch->output_size[lane]--;
+    }
+    return read;
+}
+
+int intcode_batch_status(const intcode_batch_t* const batch, const size_t lane)
+{
+    if ((batch == NULL) || (lane >= batch->num_lanes))
+    {
+        return INT_CODE_ERROR;
+    }
+    return batch->states[lane];
+}
+
+int execute_intcode_batch(intcode_batch_t* const batch)
+{
+    if (batch == NULL)
+    {
+        return INT_CODE_ERROR;
+    }
+    /*Blocked lanes try again, their queues may have changed since.*/
+    for (size_t lane = 0; lane < batch->num_used; ++lane)
+    {
+        if (batch->states[lane] == INT_CODE_BLOCKED)
+        {
+            batch->states[lane] = INT_CODE_CONTINUE;
+        }
+    }
+    batch->converged = 0;
+    while (step_batch(batch))
+    {
+    }
+
+    int ret = INT_CODE_HALT;
+    for (size_t lane = 0; lane < batch->num_used; ++lane)
+    {
+        if (batch->states[lane] == INT_CODE_ERROR)
+        {
+            return INT_CODE_ERROR;
+        }
+        if (batch->states[lane] == INT_CODE_BLOCKED)
+        {
+            ret = INT_CODE_BLOCKED;
+        }
+    }
+    return ret;
+}
+
+int execute(intcode_t* const prog)
+{
+    int ret = INT_CODE_ERROR;
+    if ((prog != NULL) && (prog->recorder != NULL))
+    {
+        ret = execute_recorded(prog);
+    }
+    else if ((prog != NULL) && (prog->profile != NULL))
+    {
+        ret = execute_profiled(prog);
+    }
+    else if ((prog != NULL) && (prog->engine == INT_CODE_ENGINE_THREADED))
+    {
+        ret = execute_threaded(prog);
+    }
+    else if ((prog != NULL) && (prog->engine == INT_CODE_ENGINE_COMPILED))
+    {
+        ret = execute_compiled(prog);
+    }
+    else if (prog != NULL)
+    {
+        ret = INT_CODE_CONTINUE;
+        while (ret == INT_CODE_CONTINUE)
+        {
+            int op_code = 0;
+            ret         = execute_head_block(prog, &op_code);
+        }
+    }
+    return ret;
+}
+
+int execute_head_block(intcode_t* const prog, int* const op_code)
+{
+    int ret = INT_CODE_ERROR;
+    if (prog != NULL)
+    {
+        intcode_decoded_t scratch;
+        const intcode_decoded_t* inst = get_decoded_instruction(prog, prog->head, &scratch);
+        *op_code                      = inst->op_code;
+#ifdef DEBUG
+        printf("Op Code: %d\n", *op_code);
+        for (int i = 0; i < inst->inst_size; ++i)
+        {
+            printf("%ld ", get_mem_value(prog, prog->head + i));
+        }
+        printf("\n");
+#endif
+        if (*op_code == OP_CODE_HALT)
+        {
+            ret = INT_CODE_HALT;
+        }
+        else if (inst->func != NULL)
+        {
+            int64_t parameters[INTCODE_MAX_PARAMS];
+            if (get_parameter_values(prog,
+                                     inst->inst_size - 1,
+                                     inst->store_param,
+                                     inst->parameter_modes,
+                                     parameters))
+            {
+#ifdef DEBUG
+                for (int i = 0; i < inst->inst_size - 1; i++)
+                {
+                    printf("%d\t%ld\n", inst->parameter_modes[i], parameters[i]);
+                }
+#endif
+                ret = inst->func(prog, parameters);
+            }
+        }
+    }
+    return ret;
+}
+
+int waiting_for_input(const intcode_t* const prog)
+{
+    int waiting = 0;
+    if (prog != NULL)
+    {
+        waiting = prog->waiting_for_input;
+    }
+    return waiting;
+}
+
+int providing_ouput(const intcode_t* const prog)
+{
+    int providing = 0;
+    if (prog != NULL)
+    {
+        if (prog->io_mode == INT_CODE_RING_IO)
+        {
+            providing = io_ring_size(prog->ring_io_out) > 0;
+        }
+        else
+        {
+            providing = !prog->mem_io_out->consumed;
+        }
+    }
+    return providing;
+}
+
+int add_op(intcode_t* const prog, const int64_t* const parameters)
+{
+    int op_ret = INT_CODE_ERROR;
+    /*TODO add boundary checks*/
+    /*Assuming parameters has the correct size*/
+    if ((prog != NULL) && (parameters != NULL))
+    {
+        int64_t first  = parameters[0];
+        int64_t second = parameters[1];
+        int64_t result = parameters[2];
+        int ret        = set_mem_value(prog, result, (first + second));
+        if (ret != 0)
+        {
+            prog->head += get_instruction_size(OP_CODE_ADD);
+            op_ret = INT_CODE_CONTINUE;
+        }
+    }
+    return op_ret;
+}
+
+int multiply_op(intcode_t* const prog, const int64_t* const parameters)
+{
+    int op_ret = INT_CODE_ERROR;
+    /*TODO add boundary checks*/
+    /*Assuming parameters has the correct size*/
+    if ((prog != NULL) && (parameters != NULL))
+    {
+        int64_t first  = parameters[0];
+        int64_t second = parameters[1];
+        int64_t result = parameters[2];
+        int ret        = set_mem_value(prog, result, (first * second));
+        if (ret != 0)
+        {
+            prog->head += get_instruction_size(OP_CODE_MULT);
+            op_ret = INT_CODE_CONTINUE;
+        }
+    }
+    return op_ret;
+}
+
+int input_op(intcode_t* const prog, const int64_t* const parameters)
+{
+    int op_ret = INT_CODE_ERROR;
+    if ((prog != NULL) && (parameters != NULL))
+    {
+        int64_t val             = 0;
+        prog->waiting_for_input = 1;
+        if (prog->io_mode == INT_CODE_STD_IO)
+        {
+            if (read_from_io_std(prog->std_io_in, &val))
+            {
+                int ret = set_mem_value(prog, parameters[0], val);
+                if (ret != 0)
+                {
+                    prog->head += get_instruction_size(OP_CODE_INPUT);
+                    op_ret = INT_CODE_CONTINUE;
+                }
+                prog->waiting_for_input = 0;
+            }
+        }
+        else if (prog->io_mode == INT_CODE_MEM_IO)
+        {
+            /*printf("I want to receive input\n");*/
+            pthread_mutex_lock(&prog->mem_io_in->mut);
+            while (prog->mem_io_in->consumed)
+            {
+                pthread_cond_wait(&prog->mem_io_in->cond, &prog->mem_io_in->mut);
+            }
+            read_from_io_mem(prog->mem_io_in, &val);
+            pthread_cond_signal(&prog->mem_io_in->cond);
+            pthread_mutex_unlock(&prog->mem_io_in->mut);
+
+            /*printf("I received a value: %ld\n", val);*/
+            int ret = set_mem_value(prog, parameters[0], val);
+            if (ret != 0)
+            {
+                prog->head += get_instruction_size(OP_CODE_INPUT);
+                op_ret = INT_CODE_CONTINUE;
+            }
+            prog->waiting_for_input = 0;
+        }
+        else if (prog->io_mode == INT_CODE_RING_IO)
+        {
+            /*Only blocks if the ring is empty, fails once it is closed and drained.*/
+            /*A yielding machine returns instead and retries the instruction when resumed.*/
+            size_t read = prog->io_yield ? io_ring_try_read(prog->ring_io_in, &val, 1)
+                                         : io_ring_read(prog->ring_io_in, &val, 1);
+            if (read == 1)
+            {
+                int ret = set_mem_value(prog, parameters[0], val);
+                if (ret != 0)
+                {
+                    prog->head += get_instruction_size(OP_CODE_INPUT);
+                    op_ret = INT_CODE_CONTINUE;
+                }
+                prog->waiting_for_input = 0;
+            }
+            else if (prog->io_yield && !io_ring_closed(prog->ring_io_in))
+            {
+                op_ret = INT_CODE_BLOCKED;
+            }
+        }
+        else if (prog->io_mode == INT_CODE_REPLAY_IO)
+        {
+            /*A yielding machine can be given another IO mode once the recording ran out.*/
+            int replayed = replay_input(prog, &val);
+            if (replayed == INT_CODE_CONTINUE)
+            {
+                int ret = set_mem_value(prog, parameters[0], val);
+                if (ret != 0)
+                {
+                    prog->head += get_instruction_size(OP_CODE_INPUT);
+                    op_ret = INT_CODE_CONTINUE;
+                }
+                prog->waiting_for_input = 0;
+            }
+            else if ((replayed == INT_CODE_BLOCKED) && prog->io_yield)
+            {
+                op_ret = INT_CODE_BLOCKED;
+            }
+        }
+        if ((op_ret == INT_CODE_CONTINUE) && (prog->recorder != NULL))
+        {
+            record_io(prog, val, 0);
+        }
+    }
+    return op_ret;
+}
+
+int output_op(intcode_t* const prog, const int64_t* const parameters)
+{
+    /*TODO add boundary checks*/
+    int op_ret = INT_CODE_ERROR;
+    if (parameters != NULL)
+    {
+        if (prog->io_mode == INT_CODE_STD_IO)
+        {
+            write_to_io_std(prog->std_io_out, parameters[0]);
+        }
+        else if (prog->io_mode == INT_CODE_MEM_IO)
+        {
+            /*printf("I want to provide output: %ld\n", parameters[0]);*/
+            pthread_mutex_lock(&prog->mem_io_out->mut);
+            while (!prog->mem_io_out->consumed)
+            {
+                /*spin*/
+                pthread_cond_signal(&prog->mem_io_out->cond);
+                pthread_cond_wait(&prog->mem_io_out->cond, &prog->mem_io_out->mut);
+            }
+            write_to_io_mem(prog->mem_io_out, parameters[0]);
+            /*prog->output_ready = 1;*/
+            pthread_cond_signal(&prog->mem_io_out->cond);
+            pthread_mutex_unlock(&prog->mem_io_out->mut);
+        }
+        else if (prog->io_mode == INT_CODE_RING_IO)
+        {
+            size_t written = prog->io_yield ? io_ring_try_write(prog->ring_io_out, parameters, 1)
+                                            : io_ring_write(prog->ring_io_out, parameters, 1);
+            if (written != 1)
+            {
+                return (prog->io_yield && !io_ring_closed(prog->ring_io_out)) ? INT_CODE_BLOCKED
+                                                                               : op_ret;
+            }
+        }
+        else if ((prog->io_mode == INT_CODE_REPLAY_IO) && !replay_output(prog, parameters[0]))
+        {
+            return op_ret;
+        }
+        if (prog->recorder != NULL)
+        {
+            record_io(prog, parameters[0], 1);
+        }
+        prog->head += get_instruction_size(OP_CODE_OUTPUT);
+        op_ret = INT_CODE_CONTINUE;
+    }
+    return op_ret;
+}
+
+int jmp_if_true_op(intcode_t* const prog, const int64_t* const parameters)
+{
+    /*TODO add boundary checks*/
+    int op_ret = INT_CODE_ERROR;
+    if (parameters != NULL)
+    {
+        if (parameters[0] != 0)
+        {
+            prog->head = parameters[1];
+        }
+        else
+        {
+            prog->head += get_instruction_size(OP_CODE_JMP_IF_TRUE);
+        }
+        op_ret = INT_CODE_CONTINUE;
+    }
+    return op_ret;
+}
+
+int jmp_if_false_op(intcode_t* const prog, const int64_t* const parameters)
+{
+    /*TODO add boundary checks*/
+    int op_ret = INT_CODE_ERROR;
+    if (parameters != NULL)
+    {
+        if (parameters[0] == 0)
+        {
+            prog->head = parameters[1];
+        }
+        else
+        {
+            prog->head += get_instruction_size(OP_CODE_JMP_IF_FALSE);
+        }
+        op_ret = INT_CODE_CONTINUE;
+    }
+    return op_ret;
+}
+
+int is_less_op(intcode_t* const prog, const int64_t* const parameters)
+{
+    /*TODO add boundary checks*/
+    int op_ret = INT_CODE_ERROR;
+    if (parameters != NULL)
+    {
+        int ret = 0;
+        if (parameters[0] < parameters[1])
+        {
+            ret = set_mem_value(prog, parameters[2], 1);
+        }
+        else
+        {
+            ret = set_mem_value(prog, parameters[2], 0);
+        }
+        if (ret != 0)
+        {
+            prog->head += get_instruction_size(OP_CODE_IS_LESS);
+            op_ret = INT_CODE_CONTINUE;
+        }
+    }
+    return op_ret;
+}
+int is_equals_op(intcode_t* const prog, const int64_t* const parameters)
+{
+    /*TODO add boundary checks*/
+    int op_ret = INT_CODE_ERROR;
+    if (parameters != NULL)
+    {
+        int ret = 0;
+        if (parameters[0] == parameters[1])
+        {
+            ret = set_mem_value(prog, parameters[2], 1);
+        }
+        else
+        {
+            ret = set_mem_value(prog, parameters[2], 0);
+        }
+        if (ret != 0)
+        {
+            prog->head += get_instruction_size(OP_CODE_IS_EQUALS);
+            op_ret = INT_CODE_CONTINUE;
+        }
+    }
+    return op_ret;
+}
+
+int adjust_rel_base_op(intcode_t* const prog, const int64_t* const parameters)
+{
+    int op_ret = INT_CODE_ERROR;
+    if ((prog != NULL) && (parameters != NULL))
+    {
+        prog->relative_base += parameters[0];
+        prog->head += get_instruction_size(OP_CODE_ADJUST_REL_BASE);
+        op_ret = INT_CODE_CONTINUE;
+    }
+    return op_ret;
+}
+
+int error_op(intcode_t* const prog, const int64_t* const parameters)
+{
+    return INT_CODE_ERROR;
+}
+
+static intcode_t* alloc_intcode()
+{
+    intcode_t* prog = (intcode_t*) malloc(sizeof(intcode_t));
+    if (prog != NULL)
+    {
+        prog->engine            = INT_CODE_ENGINE_STEP;
+        prog->memory_size       = 0;
+        prog->num_pages         = 0;
+        prog->pages             = NULL;
+        prog->sparse_pages      = NULL;
+        prog->sparse_capacity   = 0;
+        prog->sparse_count      = 0;
+        prog->head              = 0;
+        prog->relative_base     = 0;
+        prog->io_mode           = INT_CODE_STD_IO;
+        prog->std_io_in         = stdin;
+        prog->std_io_out        = stdout;
+        prog->mem_io_in         = NULL;
+        prog->mem_io_out        = NULL;
+        prog->ring_io_in        = NULL;
+        prog->ring_io_out       = NULL;
+        prog->waiting_for_input = 0;
+        prog->io_yield          = 0;
+        prog->profile           = NULL;
+        prog->translation       = NULL;
+        prog->fusion_stats      = NULL;
+        prog->recorder          = NULL;
+    }
+    return prog;
+}
+
+static INTCODE_ALWAYS_INLINE int is_blank(const char ch)
+{
+    return (ch == ' ') || (ch == '\n') || (ch == '\r') || (ch == '\t');
+}
+
+/*Single pass over the text, every value is written straight into its page.*/
+static int parse_cells(intcode_t* const prog, const char* const text, const size_t length)
+{
+    const char* pos      = text;
+    const char* end      = text + length;
+    size_t address       = 0;
+    intcode_page_t* page = NULL;
+
+    while ((pos < end) && is_blank(*pos))
+    {
+        pos++;
+    }
+    while (pos < end)
+    {
+        int negative = (*pos == '-');
+        if (negative || (*pos == '+'))
+        {
+            pos++;
+        }
+        if ((pos == end) || (*pos < '0') || (*pos > '9'))
+        {
+            return 0;
+        }
+
+        /*The magnitude of INT64_MIN does not fit into an int64_t.*/
+        uint64_t limit     = negative ? ((uint64_t) INT64_MAX + 1u) : (uint64_t) INT64_MAX;
+        uint64_t magnitude = 0;
+        while ((pos < end) && (*pos >= '0') && (*pos <= '9'))
+        {
+            uint64_t digit = (uint64_t) (*pos - '0');
+            if (magnitude > ((limit - digit) / 10u))
+            {
+                return 0;
+            }
+            magnitude = (magnitude * 10u) + digit;
+            pos++;
+        }
+
+        if ((address & INTCODE_PAGE_MASK) == 0)
+        {
+            page = get_page_for_write(prog, address);
+            if (page == NULL)
+            {
+                return 0;
+            }
+        }
+        page->cells[address & INTCODE_PAGE_MASK] =
+            negative ? (-(int64_t) (magnitude - 1u) - 1) : (int64_t) magnitude;
+        address++;
+
+        /*Values are separated by commas, a trailing comma or newline is fine.*/
+        while ((pos < end) && is_blank(*pos))
+        {
+            pos++;
+        }
+        if (pos < end)
+        {
+            if (*pos != ',')
+            {
+                return 0;
+            }
+            pos++;
+            while ((pos < end) && is_blank(*pos))
+            {
+                pos++;
+            }
+        }
+    }
+    prog->memory_size = address;
+    return address > 0;
+}
+
+static int load_image(intcode_t* const prog, const char* const data, const size_t length)
+{
+    intcode_image_header_t header;
+    memcpy(&header, data, sizeof(header));
+    if ((header.version != INTCODE_IMAGE_VERSION) ||
+        (header.num_cells > ((length - sizeof(header)) / sizeof(int64_t))))
+    {
+        return 0;
+    }
+
+    /*Whole pages are copied at once, there is nothing to parse.*/
+    const char* cells = data + sizeof(header);
+    for (size_t address = 0; address < header.num_cells; address += INTCODE_PAGE_SIZE)
+    {
+        intcode_page_t* page = get_page_for_write(prog, address);
+        if (page == NULL)
+        {
+            return 0;
+        }
+        size_t count = header.num_cells - address;
+        count        = (count < INTCODE_PAGE_SIZE) ? count : INTCODE_PAGE_SIZE;
+        memcpy(page->cells, cells + (address * sizeof(int64_t)), count * sizeof(int64_t));
+    }
+    prog->memory_size = header.num_cells;
+    return header.num_cells > 0;
+}
+
+static char* map_file(const char* const file_path, size_t* const length, int* const mapped)
+{
+    char* data = NULL;
+    *length    = 0;
+    *mapped    = 0;
+    if (file_path == NULL)
+    {
+        return NULL;
+    }
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    struct stat info;
+    if ((fstat(fd, &info) == 0) && S_ISREG(info.st_mode))
+    {
+        if (info.st_size > 0)
+        {
+            void* map = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED)
+            {
+                data    = (char*) map;
+                *length = (size_t) info.st_size;
+                *mapped = 1;
+            }
+        }
+    }
+    else
+    {
+        /*Pipes and the like can not be mapped, they are read into a buffer instead.*/
+        size_t capacity = 0;
+        ssize_t count   = 0;
+        do
+        {
+            if (*length == capacity)
+            {
+                capacity     = (capacity > 0) ? (capacity * 2) : 4096;
+                char* buffer = (char*) realloc(data, capacity);
+                if (buffer == NULL)
+                {
+                    free(data);
+                    data = NULL;
+                    break;
+                }
+                data = buffer;
+            }
+            count = read(fd, data + *length, capacity - *length);
+            if (count > 0)
+            {
+                *length += (size_t) count;
+            }
+        } while (count > 0);
+    }
+    close(fd);
+    return data;
+}
+
+static void unmap_file(char* const data, const size_t length, const int mapped)
+{
+    if (mapped)
+    {
+        munmap(data, length);
+    }
+    else
+    {
+        free(data);
+    }
+}
+
+
+static size_t get_instruction_size(const int op_code)
+{
+    size_t inst_size = 1;
+    if ((op_code == OP_CODE_ADD) || (op_code == OP_CODE_MULT) || (op_code == OP_CODE_IS_LESS) ||
+        (op_code == OP_CODE_IS_EQUALS))
+    {
+        inst_size = 4;
+    }
+    else if ((op_code == OP_CODE_JMP_IF_TRUE) || (op_code == OP_CODE_JMP_IF_FALSE))
+    {
+        inst_size = 3;
+    }
+    else if ((op_code == OP_CODE_INPUT) || (op_code == OP_CODE_OUTPUT) ||
+             (op_code == OP_CODE_ADJUST_REL_BASE))
+    {
+        inst_size = 2;
+    }
+    else if (op_code == OP_CODE_HALT)
+    {
+        inst_size = 1;
+    }
+    return inst_size;
+}
+
+static int get_opcode(const int64_t number)
+{
+    int op_code = 0;
+    if (number > 99)
+    {
+        op_code = number % 100;
+    }
+    else
+    {
+        op_code = number;
+    }
+    return op_code;
+}
+
+static int is_valid_opcode(const int op_code)
+{
+    return (op_code >= 1 && op_code <= 9) || (op_code == OP_CODE_HALT);
+}
+
+static void get_parameter_modes(const int64_t number,
+                                const size_t num_parameters,
+                                uint8_t* const parameter_modes)
+{
+    if (NULL != parameter_modes)
+    {
+        int64_t modes = number / 100;
+        for (size_t i = 0; i < num_parameters; i++)
+        {
+            int mode           = modes % 10;
+            parameter_modes[i] = mode;
+            modes /= 10;
+        }
+    }
+}
+
+static int get_store_param(const int op_code, const size_t inst_size)
+{
+    int store_param = inst_size - 2;
+    if ((op_code == OP_CODE_OUTPUT) || (op_code == OP_CODE_JMP_IF_TRUE) ||
+        (op_code == OP_CODE_JMP_IF_FALSE) || (op_code == OP_CODE_ADJUST_REL_BASE))
+    {
+        store_param = INTCODE_NO_STORE;
+    }
+    return store_param;
+}
+
+static void decode_instruction(const int64_t number, intcode_decoded_t* const decoded)
+{
+    int op_code          = get_opcode(number);
+    decoded->op_code     = op_code;
+    decoded->inst_size   = get_instruction_size(op_code);
+    decoded->store_param = get_store_param(op_code, decoded->inst_size);
+    decoded->func        = NULL;
+    decoded->dispatch    = INTCODE_DISPATCH_ERROR;
+    memset(decoded->parameter_modes, 0, sizeof(decoded->parameter_modes));
+    if (op_code == OP_CODE_HALT)
+    {
+        decoded->dispatch = OP_CODE_HALT;
+    }
+    else if (is_valid_opcode(op_code))
+    {
+        decoded->func     = get_op_func(op_code);
+        decoded->dispatch = op_code;
+        get_parameter_modes(number, decoded->inst_size - 1, decoded->parameter_modes);
+        for (int i = 0; i < (decoded->inst_size - 1); ++i)
+        {
+            if (decoded->parameter_modes[i] > PARAM_MODE_RELATIVE)
+            {
+                decoded->dispatch = INTCODE_DISPATCH_ERROR;
+            }
+        }
+    }
+    decoded->valid = 1;
+}
+
+static const intcode_decoded_t* get_decoded_instruction(intcode_t* const prog,
+                                                        const size_t address,
+                                                        intcode_decoded_t* const scratch)
+{
+    intcode_decoded_t* decoded = scratch;
+    intcode_page_t* page       = find_page(prog, address);
+    if ((page != NULL) && (page->decoded == NULL))
+    {
+        page->decoded = (intcode_decoded_t*) calloc(INTCODE_PAGE_SIZE, sizeof(intcode_decoded_t));
+    }
+    if ((page != NULL) && (page->decoded != NULL))
+    {
+        decoded = &page->decoded[address & INTCODE_PAGE_MASK];
+        if (decoded->valid)
+        {
+            return decoded;
+        }
+    }
+    /*Cache miss or no page backing the address.*/
+    decode_instruction(load_mem(prog, address), decoded);
+    return decoded;
+}
+
+static INTCODE_ALWAYS_INLINE const intcode_decoded_t*
+fetch_instruction(intcode_t* const prog, const size_t head, intcode_decoded_t* const scratch)
+{
+    const intcode_page_t* page = find_page(prog, head);
+    if ((page != NULL) && (page->decoded != NULL) &&
+        page->decoded[head & INTCODE_PAGE_MASK].valid)
+    {
+        return &page->decoded[head & INTCODE_PAGE_MASK];
+    }
+    return get_decoded_instruction(prog, head, scratch);
+}
+
+static INTCODE_ALWAYS_INLINE int store_mem(intcode_t* const prog,
+                                           const size_t address,
+                                           const int64_t value)
+{
+    intcode_page_t* page = find_page(prog, address);
+    if ((page != NULL) && (address < prog->memory_size) && !page_is_shared(page))
+    {
+        size_t offset       = address & INTCODE_PAGE_MASK;
+        page->cells[offset] = value;
+        if (page->decoded != NULL)
+        {
+            page->decoded[offset].valid = 0;
+            page->fully_decoded         = 0;
+        }
+        return 1;
+    }
+    return set_mem_value(prog, address, value);
+}
+
+static INTCODE_ALWAYS_INLINE int64_t param_address(const intcode_t* const prog,
+                                                   const size_t head,
+                                                   const int64_t relative_base,
+                                                   const intcode_decoded_t* const inst,
+                                                   const int index,
+                                                   int* const fault)
+{
+    int64_t address = load_mem(prog, head + index + 1);
+    if (inst->parameter_modes[index] == PARAM_MODE_RELATIVE)
+    {
+        address += relative_base;
+    }
+    *fault |= (address < 0);
+    return address;
+}
+
+static INTCODE_ALWAYS_INLINE int64_t load_param(const intcode_t* const prog,
+                                                const size_t head,
+                                                const int64_t relative_base,
+                                                const intcode_decoded_t* const inst,
+                                                const int index,
+                                                int* const fault)
+{
+    if (inst->parameter_modes[index] == PARAM_MODE_IMMEDIATE)
+    {
+        return load_mem(prog, head + index + 1);
+    }
+    return load_mem(prog, param_address(prog, head, relative_base, inst, index, fault));
+}
+
+/*Same semantics as repeated execute_head_block calls, but head and relative base are kept in
+ * locals and only written back to prog for IO, halt and errors.*/
+static int execute_threaded(intcode_t* const prog)
+{
+    int ret                       = INT_CODE_ERROR;
+    size_t head                   = prog->head;
+    int64_t relative_base         = prog->relative_base;
+    const intcode_decoded_t* inst = NULL;
+    intcode_decoded_t scratch;
+    int64_t parameters[INTCODE_MAX_PARAMS];
+    int fault = 0;
+
+#define LOAD(index) load_param(prog, head, relative_base, inst, (index), &fault)
+#define STORE_ADDRESS(index) param_address(prog, head, relative_base, inst, (index), &fault)
+#define FETCH() (inst = fetch_instruction(prog, head, &scratch))
+
+#ifdef INTCODE_COMPUTED_GOTO
+#define TARGET(op) \
+    case op:       \
+    target_##op
+#define DISPATCH()                              \
+    do                                          \
+    {                                           \
+        FETCH();                                \
+        goto* dispatch_table[inst->dispatch];   \
+    } while (0)
+
+    static void* const dispatch_table[INTCODE_DISPATCH_SIZE] = {
+        [0 ... (INTCODE_DISPATCH_SIZE - 1)] = &&target_INTCODE_DISPATCH_ERROR,
+        [OP_CODE_ADD]                        = &&target_OP_CODE_ADD,
+        [OP_CODE_MULT]                       = &&target_OP_CODE_MULT,
+        [OP_CODE_INPUT]                      = &&target_OP_CODE_INPUT,
+        [OP_CODE_OUTPUT]                     = &&target_OP_CODE_OUTPUT,
+        [OP_CODE_JMP_IF_TRUE]                = &&target_OP_CODE_JMP_IF_TRUE,
+        [OP_CODE_JMP_IF_FALSE]               = &&target_OP_CODE_JMP_IF_FALSE,
+        [OP_CODE_IS_LESS]                    = &&target_OP_CODE_IS_LESS,
+        [OP_CODE_IS_EQUALS]                  = &&target_OP_CODE_IS_EQUALS,
+        [OP_CODE_ADJUST_REL_BASE]            = &&target_OP_CODE_ADJUST_REL_BASE,
+        [OP_CODE_HALT]                       = &&target_OP_CODE_HALT,
+    };
+#else
+#define TARGET(op) case op
+#define DISPATCH() continue
+#endif
+
+    for (;;)
+    {
+        FETCH();
+        switch (inst->dispatch)
+        {
+            TARGET(OP_CODE_ADD):
+            {
+                int64_t value = LOAD(0) + LOAD(1);
+                size_t address = STORE_ADDRESS(2);
+                if (fault || !store_mem(prog, address, value))
+                {
+                    goto error;
+                }
+                head += 4;
+                DISPATCH();
+            }
+            TARGET(OP_CODE_MULT):
+            {
+                int64_t value = LOAD(0) * LOAD(1);
+                size_t address = STORE_ADDRESS(2);
+                if (fault || !store_mem(prog, address, value))
+                {
+                    goto error;
+                }
+                head += 4;
+                DISPATCH();
+            }
+            TARGET(OP_CODE_INPUT):
+            {
+                parameters[0] = STORE_ADDRESS(0);
+                if (fault)
+                {
+                    goto error;
+                }
+                prog->head          = head;
+                prog->relative_base = relative_base;
+                ret                 = input_op(prog, parameters);
+                if (ret != INT_CODE_CONTINUE)
+                {
+                    return ret;
+                }
+                head = prog->head;
+                DISPATCH();
+            }
+            TARGET(OP_CODE_OUTPUT):
+            {
+                parameters[0] = LOAD(0);
+                if (fault)
+                {
+                    goto error;
+                }
+                prog->head          = head;
+                prog->relative_base = relative_base;
+                ret                 = output_op(prog, parameters);
+                if (ret != INT_CODE_CONTINUE)
+                {
+                    return ret;
+                }
+                head = prog->head;
+                DISPATCH();
+            }
+            TARGET(OP_CODE_JMP_IF_TRUE):
+            {
+                int64_t condition = LOAD(0);
+                int64_t target    = LOAD(1);
+                if (fault)
+                {
+                    goto error;
+                }
+                head = (condition != 0) ? (size_t) target : head + 3;
+                DISPATCH();
+            }
+            TARGET(OP_CODE_JMP_IF_FALSE):
+            {
+                int64_t condition = LOAD(0);
+                int64_t target    = LOAD(1);
+                if (fault)
+                {
+                    goto error;
+                }
+                head = (condition == 0) ? (size_t) target : head + 3;
+                DISPATCH();
+            }
+            TARGET(OP_CODE_IS_LESS):
+            {
+                int64_t value = LOAD(0) < LOAD(1);
+                size_t address = STORE_ADDRESS(2);
+                if (fault || !store_mem(prog, address, value))
+                {
+                    goto error;
+                }
+                head += 4;
+                DISPATCH();
+            }
+            TARGET(OP_CODE_IS_EQUALS):
+            {
+                int64_t value = LOAD(0) == LOAD(1);
+                size_t address = STORE_ADDRESS(2);
+                if (fault || !store_mem(prog, address, value))
+                {
+                    goto error;
+                }
+                head += 4;
+                DISPATCH();
+            }
+            TARGET(OP_CODE_ADJUST_REL_BASE):
+            {
+                int64_t offset = LOAD(0);
+                if (fault)
+                {
+                    goto error;
+                }
+                relative_base += offset;
+                head += 2;
+                DISPATCH();
+            }
+            TARGET(OP_CODE_HALT):
+            {
+                ret = INT_CODE_HALT;
+                goto exit;
+            }
+            TARGET(INTCODE_DISPATCH_ERROR):
+            default:
+            {
+                goto error;
+            }
+        }
+    }
+
+#undef LOAD
+#undef STORE_ADDRESS
+#undef FETCH
+#undef TARGET
+#undef DISPATCH
+
+error:
+    ret = INT_CODE_ERROR;
+exit:
+    prog->head          = head;
+    prog->relative_base = relative_base;
+    return ret;
+}
+
+/*Marks heads the translation gave up on, the interpreter runs them instead.*/
+static intcode_block_t untranslatable_block = {0, 0, {}};
+
+static void flush_translation(intcode_translation_t* const translation)
+{
+    for (size_t i = 0; i < translation->size; ++i)
+    {
+        if (translation->blocks[i] != &untranslatable_block)
+        {
+            free(translation->blocks[i]);
+        }
+        translation->blocks[i] = NULL;
+        translation->cells[i] &= ~INTCODE_CELL_CODE;
+    }
+    translation->num_pending = 0;
+    translation->dirty       = 0;
+    translation->stale       = 0;
+}
+
+static void drop_blocks_at(intcode_translation_t* const translation, const size_t address)
+{
+    size_t first = (address >= INTCODE_BLOCK_SPAN) ? (address - INTCODE_BLOCK_SPAN + 1) : 0;
+    for (size_t head = first; head <= address; ++head)
+    {
+        intcode_block_t* block = translation->blocks[head];
+        if ((block != NULL) && (block != &untranslatable_block) && (block->end > address))
+        {
+            free(block);
+            translation->blocks[head] = NULL;
+        }
+    }
+    translation->cells[address] &= ~INTCODE_CELL_CODE;
+}
+
+/*Drops the blocks that became invalid since the last block was run.*/
+static void sync_translation(intcode_translation_t* const translation)
+{
+    if (translation->stale)
+    {
+        flush_translation(translation);
+        return;
+    }
+    for (size_t i = 0; i < translation->num_pending; ++i)
+    {
+        drop_blocks_at(translation, translation->pending[i]);
+    }
+    translation->num_pending = 0;
+    translation->dirty       = 0;
+}
+
+static void destroy_translation(intcode_translation_t* const translation)
+{
+    if (translation != NULL)
+    {
+        flush_translation(translation);
+        free(translation->blocks);
+        free(translation->cells);
+        free(translation);
+    }
+}
+
+static INTCODE_ALWAYS_INLINE int is_code(const intcode_translation_t* const translation,
+                                         const size_t address)
+{
+    return (address < translation->size) && (translation->cells[address] & INTCODE_CELL_CODE);
+}
+
+static void note_code_write(intcode_translation_t* const translation, const size_t address)
+{
+    if (is_code(translation, address))
+    {
+        /*Code that modifies itself while running would be translated over and over again.*/
+        if (translation->running)
+        {
+            translation->cells[address] |= INTCODE_CELL_VOLATILE;
+        }
+        if (translation->num_pending < INTCODE_PENDING_WRITES)
+        {
+            translation->pending[translation->num_pending++] = address;
+        }
+        else
+        {
+            translation->stale = 1;
+        }
+        translation->dirty = 1;
+    }
+}
+
+static int reserve_translation(intcode_translation_t* const translation, const size_t size)
+{
+    if (size <= translation->size)
+    {
+        return 1;
+    }
+    if (size > INTCODE_TRANSLATION_LIMIT)
+    {
+        return 0;
+    }
+    size_t capacity = (size + INTCODE_PAGE_MASK) & ~((size_t) INTCODE_PAGE_MASK);
+    intcode_block_t** blocks =
+        (intcode_block_t**) realloc(translation->blocks, sizeof(intcode_block_t*) * capacity);
+    if (blocks == NULL)
+    {
+        return 0;
+    }
+    translation->blocks = blocks;
+    uint8_t* cells      = (uint8_t*) realloc(translation->cells, capacity);
+    if (cells == NULL)
+    {
+        return 0;
+    }
+    translation->cells = cells;
+    size_t added = capacity - translation->size;
+    memset(blocks + translation->size, 0, sizeof(intcode_block_t*) * added);
+    memset(cells + translation->size, 0, added);
+    translation->size = capacity;
+    return 1;
+}
+
+static int can_translate(const intcode_t* const prog,
+                         intcode_translation_t* const translation,
+                         const size_t address,
+                         const intcode_decoded_t* const inst)
+{
+    if ((inst->dispatch == INTCODE_DISPATCH_ERROR) ||
+        ((address + inst->inst_size) > prog->memory_size) ||
+        !reserve_translation(translation, address + inst->inst_size))
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < inst->inst_size; ++i)
+    {
+        if (translation->cells[address + i] & INTCODE_CELL_VOLATILE)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*Returns 0 if a position operand has no page to point to.*/
+static int resolve_operand(const intcode_t* const prog,
+                           const intcode_decoded_t* const inst,
+                           const size_t address,
+                           const int index,
+                           intcode_closure_t* const closure)
+{
+    int64_t value            = load_mem(prog, address + index + 1);
+    int is_store             = (index == inst->store_param);
+    closure->operands[index] = value;
+    if (inst->parameter_modes[index] == PARAM_MODE_RELATIVE)
+    {
+        closure->kinds[index] = OPERAND_REL;
+        return 1;
+    }
+    if ((inst->parameter_modes[index] == PARAM_MODE_IMMEDIATE) && !is_store)
+    {
+        closure->kinds[index] = OPERAND_IMM;
+        return 1;
+    }
+
+    /*Stores to an immediate operand write to the position, like the interpreter does.*/
+    intcode_page_t* page = (value >= 0) ? find_page(prog, value) : NULL;
+    if ((page == NULL) || (is_store && ((size_t) value >= prog->memory_size)))
+    {
+        return 0;
+    }
+    closure->kinds[index] = OPERAND_CELL;
+    closure->cells[index] = &page->cells[value & INTCODE_PAGE_MASK];
+    if (is_store)
+    {
+        closure->store_page = page;
+    }
+    return 1;
+}
+
+static uint16_t get_closure_id(const intcode_decoded_t* const inst,
+                               const intcode_closure_t* const closure)
+{
+    const uint8_t* kinds = closure->kinds;
+    switch (inst->op_code)
+    {
+        case OP_CODE_ADD:
+            return CLOSURE_ADD_IMM_IMM_CELL + (6 * kinds[0]) + (2 * kinds[1]) + kinds[2] - 1;
+        case OP_CODE_MULT:
+            return CLOSURE_MULT_IMM_IMM_CELL + (6 * kinds[0]) + (2 * kinds[1]) + kinds[2] - 1;
+        case OP_CODE_IS_LESS:
+            return CLOSURE_IS_LESS_IMM_IMM_CELL + (6 * kinds[0]) + (2 * kinds[1]) + kinds[2] - 1;
+        case OP_CODE_IS_EQUALS:
+            return CLOSURE_IS_EQUALS_IMM_IMM_CELL + (6 * kinds[0]) + (2 * kinds[1]) + kinds[2] - 1;
+        case OP_CODE_JMP_IF_TRUE:
+            return CLOSURE_JMP_IF_TRUE_IMM_IMM + (3 * kinds[0]) + kinds[1];
+        case OP_CODE_JMP_IF_FALSE:
+            return CLOSURE_JMP_IF_FALSE_IMM_IMM + (3 * kinds[0]) + kinds[1];
+        case OP_CODE_ADJUST_REL_BASE:
+            return CLOSURE_ADJUST_REL_BASE_IMM + kinds[0];
+        case OP_CODE_INPUT:
+            return CLOSURE_INPUT;
+        case OP_CODE_OUTPUT:
+            return CLOSURE_OUTPUT;
+        default:
+            return CLOSURE_HALT;
+    }
+}
+
+/*Returns 0 if an operand could not be resolved, relative operands include the base shift.*/
+static int resolve_closure(const intcode_t* const prog,
+                           const intcode_decoded_t* const inst,
+                           const size_t address,
+                           const int64_t base_shift,
+                           intcode_closure_t* const closure)
+{
+    memset(closure, 0, sizeof(intcode_closure_t));
+    closure->address    = address;
+    closure->base_shift = base_shift;
+    int resolved        = 1;
+    for (int p = 0; p < (inst->inst_size - 1); ++p)
+    {
+        resolved = resolve_operand(prog, inst, address, p, closure) && resolved;
+        if (closure->kinds[p] == OPERAND_REL)
+        {
+            closure->operands[p] += base_shift;
+        }
+    }
+    return resolved;
+}
+
+/*Fuses a comparison or a counter with the jump after it, returns the kind of the fusion.*/
+/*Returns INT_CODE_FUSION_KINDS if the two instructions do not match.*/
+static int fuse_jump(const intcode_decoded_t* const inst,
+                     intcode_closure_t* const closure,
+                     const intcode_decoded_t* const jump_inst,
+                     const intcode_closure_t* const jump)
+{
+    if (((jump_inst->op_code != OP_CODE_JMP_IF_TRUE) &&
+         (jump_inst->op_code != OP_CODE_JMP_IF_FALSE)) ||
+        (jump->kinds[1] != OPERAND_IMM))
+    {
+        return INT_CODE_FUSION_KINDS;
+    }
+    const uint8_t* kinds = closure->kinds;
+    int fusion           = INT_CODE_FUSION_KINDS;
+    if (((inst->op_code == OP_CODE_IS_LESS) || (inst->op_code == OP_CODE_IS_EQUALS)) &&
+        (jump->kinds[0] == kinds[2]) && (jump->operands[0] == closure->operands[2]))
+    {
+        /*The jump reads the result of the comparison, which is kept in a register instead.*/
+        uint16_t first = (inst->op_code == OP_CODE_IS_LESS) ? CLOSURE_IS_LESS_JUMP_IMM_IMM_CELL
+                                                            : CLOSURE_IS_EQUALS_JUMP_IMM_IMM_CELL;
+        closure->id = first + (6 * kinds[0]) + (2 * kinds[1]) + kinds[2] - 1;
+        fusion      = INT_CODE_FUSION_COMPARE_JUMP;
+    }
+    else if ((inst->op_code == OP_CODE_ADD) && (kinds[0] != OPERAND_IMM) &&
+             (kinds[1] == OPERAND_IMM) && (kinds[2] == kinds[0]) &&
+             (closure->operands[2] == closure->operands[0]))
+    {
+        closure->kinds[INTCODE_CONDITION]    = jump->kinds[0];
+        closure->operands[INTCODE_CONDITION] = jump->operands[0];
+        closure->cells[INTCODE_CONDITION]    = jump->cells[0];
+        closure->id = CLOSURE_COUNTER_JUMP_CELL_IMM + (3 * (kinds[0] - 1)) + jump->kinds[0];
+        fusion      = INT_CODE_FUSION_COUNTER_JUMP;
+    }
+    else
+    {
+        return INT_CODE_FUSION_KINDS;
+    }
+    size_t next         = jump->address + jump_inst->inst_size;
+    size_t target       = (size_t) jump->operands[1];
+    int if_true         = (jump_inst->op_code == OP_CODE_JMP_IF_TRUE);
+    closure->targets[0] = if_true ? next : target;
+    closure->targets[1] = if_true ? target : next;
+    return fusion;
+}
+
+/*Counts the fused sequence at the address of the closure.*/
+static void append_tally(intcode_block_t* const block,
+                         const intcode_closure_t* const closure,
+                         const int fusion)
+{
+    intcode_closure_t* tally = &block->closures[block->num_closures++];
+    memset(tally, 0, sizeof(intcode_closure_t));
+    tally->id          = CLOSURE_TALLY;
+    tally->address     = closure->address;
+    tally->base_shift  = closure->base_shift;
+    tally->operands[0] = fusion;
+}
+
+/*Translates the instructions from head up to the first jump, IO, halt or untranslatable cell.*/
+static intcode_block_t* translate_block(intcode_t* const prog,
+                                        intcode_translation_t* const translation,
+                                        const size_t head)
+{
+    intcode_decoded_t insts[INTCODE_BLOCK_LIMIT];
+    size_t num_insts = 0;
+    size_t address   = head;
+    int terminated   = 0;
+    while ((num_insts < INTCODE_BLOCK_LIMIT) && !terminated)
+    {
+        intcode_decoded_t* inst = &insts[num_insts];
+        decode_instruction(load_mem(prog, address), inst);
+        if (!can_translate(prog, translation, address, inst))
+        {
+            break;
+        }
+        /*Closures store straight into the page, so it has to be private.*/
+        if ((inst->store_param != INTCODE_NO_STORE) &&
+            (inst->parameter_modes[inst->store_param] != PARAM_MODE_RELATIVE))
+        {
+            int64_t target = load_mem(prog, address + inst->store_param + 1);
+            if ((target >= 0) && ((size_t) target < prog->memory_size))
+            {
+                get_page_for_write(prog, target);
+            }
+        }
+        terminated = (inst->op_code == OP_CODE_INPUT) || (inst->op_code == OP_CODE_OUTPUT) ||
+                     (inst->op_code == OP_CODE_JMP_IF_TRUE) ||
+                     (inst->op_code == OP_CODE_JMP_IF_FALSE) || (inst->op_code == OP_CODE_HALT);
+        address += inst->inst_size;
+        num_insts++;
+    }
+    if (num_insts == 0)
+    {
+        return NULL;
+    }
+    /*Copying pages above invalidated the closures of other blocks.*/
+    if (translation->dirty)
+    {
+        sync_translation(translation);
+    }
+
+    /*With fusion stats enabled, every fused sequence gets a tally in front of it.*/
+    int tally       = (prog->fusion_stats != NULL);
+    size_t capacity = (tally ? (2 * num_insts) : num_insts) + 1;
+    intcode_block_t* block =
+        (intcode_block_t*) malloc(sizeof(intcode_block_t) + (sizeof(intcode_closure_t) * capacity));
+    if (block == NULL)
+    {
+        return NULL;
+    }
+    block->num_closures = 0;
+    address             = head;
+    int64_t base_shift  = 0;
+    for (size_t i = 0; i < num_insts; ++i)
+    {
+        intcode_closure_t closure;
+        int resolved = resolve_closure(prog, &insts[i], address, base_shift, &closure);
+        address += insts[i].inst_size;
+        if (!resolved)
+        {
+            /*Reads its operands at run time, so its cells are not marked as code.*/
+            closure.id                             = CLOSURE_GENERIC;
+            block->closures[block->num_closures++] = closure;
+            break;
+        }
+        memset(translation->cells + closure.address, INTCODE_CELL_CODE, insts[i].inst_size);
+
+        /*The relative base is only adjusted once the block is left.*/
+        if ((insts[i].op_code == OP_CODE_ADJUST_REL_BASE) && (closure.kinds[0] == OPERAND_IMM))
+        {
+            if (tally)
+            {
+                append_tally(block, &closure, INT_CODE_FUSION_REL_BASE);
+            }
+            base_shift += closure.operands[0];
+            continue;
+        }
+
+        closure.id = get_closure_id(&insts[i], &closure);
+        intcode_closure_t jump;
+        int fusion = INT_CODE_FUSION_KINDS;
+        if (((i + 1) < num_insts) &&
+            resolve_closure(prog, &insts[i + 1], address, base_shift, &jump))
+        {
+            fusion = fuse_jump(&insts[i], &closure, &insts[i + 1], &jump);
+        }
+        if (fusion != INT_CODE_FUSION_KINDS)
+        {
+            memset(translation->cells + address, INTCODE_CELL_CODE, insts[i + 1].inst_size);
+            address += insts[++i].inst_size;
+            if (tally)
+            {
+                append_tally(block, &closure, fusion);
+            }
+        }
+        block->closures[block->num_closures++] = closure;
+    }
+
+    /*Blocks that do not end in a jump continue at the next address.*/
+    intcode_closure_t* exit = &block->closures[block->num_closures++];
+    memset(exit, 0, sizeof(intcode_closure_t));
+    exit->id                  = CLOSURE_EXIT;
+    exit->address             = address;
+    exit->base_shift          = base_shift;
+    block->end                = address;
+    translation->blocks[head] = block;
+    return block;
+}
+
+static INTCODE_NOINLINE const intcode_block_t*
+translate_head(intcode_t* const prog, intcode_translation_t* const translation, const size_t head)
+{
+    intcode_block_t* block = translate_block(prog, translation, head);
+    if (block == NULL)
+    {
+        if (head < translation->size)
+        {
+            translation->blocks[head] = &untranslatable_block;
+        }
+        return &untranslatable_block;
+    }
+    return block;
+}
+
+static INTCODE_ALWAYS_INLINE const intcode_block_t*
+find_block(intcode_t* const prog, intcode_translation_t* const translation, const size_t head)
+{
+    if ((head < translation->size) && (translation->blocks[head] != NULL))
+    {
+        return translation->blocks[head];
+    }
+    return translate_head(prog, translation, head);
+}
+
+static INTCODE_ALWAYS_INLINE int64_t load_relative(const intcode_t* const prog,
+                                                   const int64_t address,
+                                                   int* const fault)
+{
+    *fault |= (address < 0);
+    return load_mem(prog, address);
+}
+
+static INTCODE_ALWAYS_INLINE int store_cell(intcode_t* const prog,
+                                            intcode_translation_t* const translation,
+                                            const intcode_closure_t* const closure,
+                                            const int64_t value)
+{
+    intcode_page_t* page = closure->store_page;
+    size_t address       = closure->operands[2];
+    if (page_is_shared(page))
+    {
+        /*The machine was forked since the translation, the page is copied first.*/
+        return set_mem_value(prog, address, value);
+    }
+    size_t offset       = address & INTCODE_PAGE_MASK;
+    page->cells[offset] = value;
+    if (page->decoded != NULL)
+    {
+        page->decoded[offset].valid = 0;
+        page->fully_decoded         = 0;
+    }
+    if (is_code(translation, address))
+    {
+        note_code_write(translation, address);
+    }
+    return 1;
+}
+
+static INTCODE_ALWAYS_INLINE int store_relative(intcode_t* const prog,
+                                                intcode_translation_t* const translation,
+                                                const int64_t address,
+                                                const int64_t value)
+{
+    if ((address < 0) || !store_mem(prog, address, value))
+    {
+        return 0;
+    }
+    if (is_code(translation, address))
+    {
+        note_code_write(translation, address);
+    }
+    return 1;
+}
+
+/*Runs translated blocks, the head is only kept up to date between blocks.*/
+static int execute_compiled(intcode_t* const prog)
+{
+    if (prog->translation == NULL)
+    {
+        prog->translation = (intcode_translation_t*) calloc(1, sizeof(intcode_translation_t));
+        if (prog->translation == NULL)
+        {
+            return execute_threaded(prog);
+        }
+    }
+    intcode_translation_t* const translation = prog->translation;
+    int ret                                  = INT_CODE_ERROR;
+    size_t head                              = prog->head;
+    int64_t relative_base                    = prog->relative_base;
+    const intcode_block_t* block             = NULL;
+    const intcode_closure_t* closure         = NULL;
+    int64_t parameters[INTCODE_MAX_PARAMS];
+    int op_code          = 0;
+    int fault            = 0;
+    translation->running = 1;
+
+#define LOAD_IMM(index) (closure->operands[index])
+#define LOAD_CELL(index) (*closure->cells[index])
+#define LOAD_REL(index) load_relative(prog, relative_base + closure->operands[index], &fault)
+#define STORE_CELL(value) store_cell(prog, translation, closure, (value))
+#define STORE_REL(value) \
+    store_relative(prog, translation, relative_base + closure->operands[2], (value))
+
+#define INTCODE_ADD(x, y) ((x) + (y))
+#define INTCODE_MULT(x, y) ((x) * (y))
+#define INTCODE_IS_LESS(x, y) ((x) < (y))
+#define INTCODE_IS_EQUALS(x, y) ((x) == (y))
+#define INTCODE_JMP_IF_TRUE(x) ((x) != 0)
+#define INTCODE_JMP_IF_FALSE(x) ((x) == 0)
+#define INTCODE_IS_LESS_JUMP(x, y) ((x) < (y))
+#define INTCODE_IS_EQUALS_JUMP(x, y) ((x) == (y))
+
+#ifdef INTCODE_COMPUTED_GOTO
+#define CLOSURE(id) \
+    case id:        \
+    label_##id
+#define DISPATCH() goto* closure_table[closure->id]
+
+#define INTCODE_BINARY_LABEL(op, a, b, c) \
+    [CLOSURE_##op##_##a##_##b##_##c] = &&label_CLOSURE_##op##_##a##_##b##_##c,
+#define INTCODE_JUMP_LABEL(op, a, b) [CLOSURE_##op##_##a##_##b] = &&label_CLOSURE_##op##_##a##_##b,
+#define INTCODE_UNARY_LABEL(op, a) [CLOSURE_##op##_##a] = &&label_CLOSURE_##op##_##a,
+
+    static void* const closure_table[CLOSURE_COUNT] = {
+        [CLOSURE_EXIT]    = &&label_CLOSURE_EXIT,
+        [CLOSURE_GENERIC] = &&label_CLOSURE_GENERIC,
+        [CLOSURE_INPUT]   = &&label_CLOSURE_INPUT,
+        [CLOSURE_OUTPUT]  = &&label_CLOSURE_OUTPUT,
+        [CLOSURE_HALT]    = &&label_CLOSURE_HALT,
+        INTCODE_UNARY_HANDLERS(INTCODE_UNARY_LABEL, ADJUST_REL_BASE)
+        INTCODE_JUMP_HANDLERS(INTCODE_JUMP_LABEL, JMP_IF_TRUE)
+        INTCODE_JUMP_HANDLERS(INTCODE_JUMP_LABEL, JMP_IF_FALSE)
+        INTCODE_BINARY_HANDLERS(INTCODE_BINARY_LABEL, ADD)
+        INTCODE_BINARY_HANDLERS(INTCODE_BINARY_LABEL, MULT)
+        INTCODE_BINARY_HANDLERS(INTCODE_BINARY_LABEL, IS_LESS)
+        INTCODE_BINARY_HANDLERS(INTCODE_BINARY_LABEL, IS_EQUALS)
+        INTCODE_BINARY_HANDLERS(INTCODE_BINARY_LABEL, IS_LESS_JUMP)
+        INTCODE_BINARY_HANDLERS(INTCODE_BINARY_LABEL, IS_EQUALS_JUMP)
+        INTCODE_COUNTER_HANDLERS(INTCODE_JUMP_LABEL, COUNTER_JUMP)
+        [CLOSURE_TALLY] = &&label_CLOSURE_TALLY,
+    };
+
+#undef INTCODE_BINARY_LABEL
+#undef INTCODE_JUMP_LABEL
+#undef INTCODE_UNARY_LABEL
+#else
+#define CLOSURE(id) case id
+#define DISPATCH() goto dispatch
+#endif
+#define NEXT()      \
+    do              \
+    {               \
+        ++closure;  \
+        DISPATCH(); \
+    } while (0)
+
+    /*Every store may have overwritten code of the running block or replaced a page. The next*/
+    /*closure may include a folded adjustment that was overwritten, so only the adjustments*/
+    /*before the storing closure are applied and the block is translated again after it.*/
+#define NEXT_AFTER_STORE()                        \
+    do                                            \
+    {                                             \
+        if (translation->dirty)                   \
+        {                                         \
+            head = closure->address + 4;          \
+            relative_base += closure->base_shift; \
+            goto lookup;                          \
+        }                                         \
+        NEXT();                                   \
+    } while (0)
+
+#define INTCODE_BINARY_BODY(op, a, b, c)                           \
+    CLOSURE(CLOSURE_##op##_##a##_##b##_##c):                       \
+    {                                                              \
+        int64_t value = INTCODE_##op(LOAD_##a(0), LOAD_##b(1));    \
+        if (fault || !STORE_##c(value))                            \
+        {                                                          \
+            goto error;                                            \
+        }                                                          \
+        NEXT_AFTER_STORE();                                        \
+    }
+#define INTCODE_JUMP_BODY(op, a, b)                                                   \
+    CLOSURE(CLOSURE_##op##_##a##_##b):                                                \
+    {                                                                                 \
+        int64_t condition = LOAD_##a(0);                                              \
+        int64_t target    = LOAD_##b(1);                                              \
+        if (fault)                                                                    \
+        {                                                                             \
+            goto error;                                                               \
+        }                                                                             \
+        head = INTCODE_##op(condition) ? (size_t) target : (closure->address + 3);    \
+        relative_base += closure->base_shift;                                         \
+        goto lookup;                                                                  \
+    }
+/*A jump overwritten by the fused store is looked up again, it starts 4 cells in. The target*/
+/*is picked by a branch, indexing the targets with the condition would defeat prediction.*/
+#define INTCODE_COMPARE_JUMP_BODY(op, a, b, c)                                        \
+    CLOSURE(CLOSURE_##op##_##a##_##b##_##c):                                          \
+    {                                                                                 \
+        int64_t value = INTCODE_##op(LOAD_##a(0), LOAD_##b(1));                       \
+        if (fault || !STORE_##c(value))                                               \
+        {                                                                             \
+            goto error;                                                               \
+        }                                                                             \
+        head = value ? closure->targets[1] : closure->targets[0];                     \
+        if (translation->dirty)                                                       \
+        {                                                                             \
+            head = closure->address + 4;                                              \
+        }                                                                             \
+        relative_base += closure->base_shift;                                         \
+        goto lookup;                                                                  \
+    }
+#define INTCODE_COUNTER_BODY(op, a, b)                                                \
+    CLOSURE(CLOSURE_##op##_##a##_##b):                                                \
+    {                                                                                 \
+        int64_t value = LOAD_##a(0) + LOAD_IMM(1);                                    \
+        if (fault || !STORE_##a(value))                                               \
+        {                                                                             \
+            goto error;                                                               \
+        }                                                                             \
+        head = closure->address + 4;                                                  \
+        if (!translation->dirty)                                                      \
+        {                                                                             \
+            int64_t condition = LOAD_##b(INTCODE_CONDITION);                          \
+            head = condition ? closure->targets[1] : closure->targets[0];             \
+        }                                                                             \
+        relative_base += closure->base_shift;                                         \
+        if (fault)                                                                    \
+        {                                                                             \
+            head = closure->address + 4;                                              \
+            ret  = INT_CODE_ERROR;                                                    \
+            goto exit;                                                                \
+        }                                                                             \
+        goto lookup;                                                                  \
+    }
+#define INTCODE_UNARY_BODY(op, a)           \
+    CLOSURE(CLOSURE_##op##_##a):            \
+    {                                       \
+        int64_t offset = LOAD_##a(0);       \
+        if (fault)                          \
+        {                                   \
+            goto error;                     \
+        }                                   \
+        relative_base += offset;            \
+        NEXT();                             \
+    }
+
+lookup:
+    if (translation->dirty)
+    {
+        sync_translation(translation);
+    }
+    block = find_block(prog, translation, head);
+    if (block->num_closures == 0)
+    {
+        /*Nothing translated at head, e.g. self-modified code, the interpreter takes a step.*/
+        prog->head          = head;
+        prog->relative_base = relative_base;
+        ret                 = execute_head_block(prog, &op_code);
+        if (ret != INT_CODE_CONTINUE)
+        {
+            goto leave;
+        }
+        head          = prog->head;
+        relative_base = prog->relative_base;
+        goto lookup;
+    }
+    closure = block->closures;
+
+#ifndef INTCODE_COMPUTED_GOTO
+dispatch:
+#endif
+    switch (closure->id)
+    {
+        INTCODE_BINARY_HANDLERS(INTCODE_BINARY_BODY, ADD)
+        INTCODE_BINARY_HANDLERS(INTCODE_BINARY_BODY, MULT)
+        INTCODE_BINARY_HANDLERS(INTCODE_BINARY_BODY, IS_LESS)
+        INTCODE_BINARY_HANDLERS(INTCODE_BINARY_BODY, IS_EQUALS)
+        INTCODE_JUMP_HANDLERS(INTCODE_JUMP_BODY, JMP_IF_TRUE)
+        INTCODE_JUMP_HANDLERS(INTCODE_JUMP_BODY, JMP_IF_FALSE)
+        INTCODE_UNARY_HANDLERS(INTCODE_UNARY_BODY, ADJUST_REL_BASE)
+        INTCODE_BINARY_HANDLERS(INTCODE_COMPARE_JUMP_BODY, IS_LESS_JUMP)
+        INTCODE_BINARY_HANDLERS(INTCODE_COMPARE_JUMP_BODY, IS_EQUALS_JUMP)
+        INTCODE_COUNTER_HANDLERS(INTCODE_COUNTER_BODY, COUNTER_JUMP)
+        CLOSURE(CLOSURE_TALLY):
+        {
+            prog->fusion_stats->fired[closure->operands[0]]++;
+            NEXT();
+        }
+        CLOSURE(CLOSURE_INPUT):
+        {
+            int64_t address = closure->operands[0];
+            if (closure->kinds[0] == OPERAND_REL)
+            {
+                address += relative_base;
+            }
+            if (address < 0)
+            {
+                goto error;
+            }
+            relative_base += closure->base_shift;
+            parameters[0]       = address;
+            prog->head          = closure->address;
+            prog->relative_base = relative_base;
+            ret                 = input_op(prog, parameters);
+            if (ret != INT_CODE_CONTINUE)
+            {
+                goto leave;
+            }
+            head = prog->head;
+            goto lookup;
+        }
+        CLOSURE(CLOSURE_OUTPUT):
+        {
+            if (closure->kinds[0] == OPERAND_IMM)
+            {
+                parameters[0] = LOAD_IMM(0);
+            }
+            else if (closure->kinds[0] == OPERAND_CELL)
+            {
+                parameters[0] = LOAD_CELL(0);
+            }
+            else
+            {
+                parameters[0] = LOAD_REL(0);
+            }
+            if (fault)
+            {
+                goto error;
+            }
+            relative_base += closure->base_shift;
+            prog->head          = closure->address;
+            prog->relative_base = relative_base;
+            ret                 = output_op(prog, parameters);
+            if (ret != INT_CODE_CONTINUE)
+            {
+                goto leave;
+            }
+            head = prog->head;
+            goto lookup;
+        }
+        CLOSURE(CLOSURE_GENERIC):
+        {
+            relative_base += closure->base_shift;
+            prog->head          = closure->address;
+            prog->relative_base = relative_base;
+            ret                 = execute_head_block(prog, &op_code);
+            if (ret != INT_CODE_CONTINUE)
+            {
+                goto leave;
+            }
+            head          = prog->head;
+            relative_base = prog->relative_base;
+            goto lookup;
+        }
+        CLOSURE(CLOSURE_EXIT):
+        {
+            head = closure->address;
+            relative_base += closure->base_shift;
+            goto lookup;
+        }
+        CLOSURE(CLOSURE_HALT):
+        {
+            head = closure->address;
+            relative_base += closure->base_shift;
+            ret = INT_CODE_HALT;
+            goto exit;
+        }
+        default:
+        {
+            goto error;
+        }
+    }
+
+#undef LOAD_IMM
+#undef LOAD_CELL
+#undef LOAD_REL
+#undef STORE_CELL
+#undef STORE_REL
+#undef INTCODE_ADD
+#undef INTCODE_MULT
+#undef INTCODE_IS_LESS
+#undef INTCODE_IS_EQUALS
+#undef INTCODE_JMP_IF_TRUE
+#undef INTCODE_JMP_IF_FALSE
+#undef INTCODE_IS_LESS_JUMP
+#undef INTCODE_IS_EQUALS_JUMP
+#undef CLOSURE
+#undef DISPATCH
+#undef NEXT
+#undef NEXT_AFTER_STORE
+#undef INTCODE_BINARY_BODY
+#undef INTCODE_JUMP_BODY
+#undef INTCODE_UNARY_BODY
+#undef INTCODE_COMPARE_JUMP_BODY
+#undef INTCODE_COUNTER_BODY
+
+error:
+    head = closure->address;
+    relative_base += closure->base_shift;
+    ret = INT_CODE_ERROR;
+exit:
+    prog->head          = head;
+    prog->relative_base = relative_base;
+leave:
+    translation->running = 0;
+    return ret;
+}
+
+static INTCODE_ALWAYS_INLINE int64_t load_lane(const intcode_batch_t* const batch,
+                                               const size_t lane,
+                                               const size_t address)
+{
+    if ((address < batch->num_deltas) && (batch->deltas[address] != NULL))
+    {
+        return batch->deltas[address][lane];
+    }
+    return (address < batch->image_size) ? batch->image[address] : 0;
+}
+
+static int reserve_deltas(intcode_batch_t* const batch, const size_t size)
+{
+    if (size <= batch->num_deltas)
+    {
+        return 1;
+    }
+    if (size > INTCODE_BATCH_MEMORY_LIMIT)
+    {
+        return 0;
+    }
+    size_t capacity = ((batch->num_deltas * 2) > size) ? (batch->num_deltas * 2) : size;
+    if (capacity > INTCODE_BATCH_MEMORY_LIMIT)
+    {
+        capacity = INTCODE_BATCH_MEMORY_LIMIT;
+    }
+    int64_t** deltas = (int64_t**) realloc(batch->deltas, sizeof(int64_t*) * capacity);
+    if (deltas == NULL)
+    {
+        return 0;
+    }
+    memset(deltas + batch->num_deltas, 0, sizeof(int64_t*) * (capacity - batch->num_deltas));
+    batch->deltas     = deltas;
+    batch->num_deltas = capacity;
+    return 1;
+}
+
+static int store_lane(intcode_batch_t* const batch,
+                      const size_t lane,
+                      const int64_t address,
+                      const int64_t value)
+{
+    if ((address < 0) || !reserve_deltas(batch, (size_t) address + 1))
+    {
+        return 0;
+    }
+    int64_t* cells = batch->deltas[address];
+    if (cells == NULL)
+    {
+        if (batch->num_written == batch->written_capacity)
+        {
+            size_t capacity = (batch->written_capacity > 0) ? (batch->written_capacity * 2) : 16;
+            size_t* written = (size_t*) realloc(batch->written, sizeof(size_t) * capacity);
+            if (written == NULL)
+            {
+                return 0;
+            }
+            batch->written          = written;
+            batch->written_capacity = capacity;
+        }
+        cells = (int64_t*) malloc(sizeof(int64_t) * batch->num_lanes);
+        if (cells == NULL)
+        {
+            return 0;
+        }
+        /*The other lanes keep the value of the image.*/
+        int64_t initial = ((size_t) address < batch->image_size) ? batch->image[address] : 0;
+        for (size_t i = 0; i < batch->num_lanes; ++i)
+        {
+            cells[i] = initial;
+        }
+        batch->deltas[address]               = cells;
+        batch->written[batch->num_written++] = address;
+    }
+    cells[lane] = value;
+    return 1;
+}
+
+static void clear_deltas(intcode_batch_t* const batch)
+{
+    for (size_t i = 0; i < batch->num_written; ++i)
+    {
+        free(batch->deltas[batch->written[i]]);
+        batch->deltas[batch->written[i]] = NULL;
+    }
+    batch->num_written = 0;
+}
+
+/*Reads a parameter of the instruction at head for every lane of the group.*/
+static void fetch_operand(intcode_batch_t* const batch,
+                          const intcode_decoded_t* const inst,
+                          const size_t head,
+                          const int index,
+                          const size_t num_group)
+{
+    const size_t* group = batch->group;
+    int64_t* operands   = batch->operands[index];
+    size_t address      = head + index + 1;
+    int is_store        = (index == inst->store_param);
+    /*Parameters are the same for all lanes, unless a lane wrote to them.*/
+    if ((address < batch->num_deltas) && (batch->deltas[address] != NULL))
+    {
+        for (size_t k = 0; k < num_group; ++k)
+        {
+            operands[k] = batch->deltas[address][group[k]];
+        }
+    }
+    else
+    {
+        int mode      = inst->parameter_modes[index];
+        int64_t value = (address < batch->image_size) ? batch->image[address] : 0;
+        if (!is_store && (mode == PARAM_MODE_POSITION))
+        {
+            if (value < 0)
+            {
+                for (size_t k = 0; k < num_group; ++k)
+                {
+                    batch->states[group[k]] = INT_CODE_ERROR;
+                }
+                value = 0;
+            }
+            /*All lanes read the same cell, only lanes that wrote to it hold different values.*/
+            address = (size_t) value;
+            if ((address < batch->num_deltas) && (batch->deltas[address] != NULL))
+            {
+                for (size_t k = 0; k < num_group; ++k)
+                {
+                    operands[k] = batch->deltas[address][group[k]];
+                }
+                return;
+            }
+            value = (address < batch->image_size) ? batch->image[address] : 0;
+        }
+        for (size_t k = 0; k < num_group; ++k)
+        {
+            operands[k] = value;
+        }
+        if (mode != PARAM_MODE_RELATIVE)
+        {
+            return;
+        }
+    }
+    if (inst->parameter_modes[index] == PARAM_MODE_RELATIVE)
+    {
+        for (size_t k = 0; k < num_group; ++k)
+        {
+            operands[k] += batch->bases[group[k]];
+        }
+    }
+
+    /*Stores keep the address, like the interpreter also for immediate stores.*/
+    if (is_store || (inst->parameter_modes[index] == PARAM_MODE_IMMEDIATE))
+    {
+        return;
+    }
+    /*Lanes of a group mostly share their relative base, so the cell is looked up once for all.*/
+    int64_t last         = -1;
+    const int64_t* cells = NULL;
+    int64_t value        = 0;
+    for (size_t k = 0; k < num_group; ++k)
+    {
+        if (operands[k] < 0)
+        {
+            batch->states[group[k]] = INT_CODE_ERROR;
+            operands[k]             = 0;
+        }
+        if (operands[k] != last)
+        {
+            last    = operands[k];
+            address = (size_t) last;
+            cells   = (address < batch->num_deltas) ? batch->deltas[address] : NULL;
+            value   = (address < batch->image_size) ? batch->image[address] : 0;
+        }
+        operands[k] = (cells != NULL) ? cells[group[k]] : value;
+    }
+}
+
+/*Stores the results of the group and moves its lanes on to the next instruction.*/
+static void store_results(intcode_batch_t* const batch,
+                          const intcode_decoded_t* const inst,
+                          const size_t head,
+                          const size_t num_group)
+{
+    const int64_t* addresses = batch->operands[inst->store_param];
+    int64_t* cells           = NULL;
+    int64_t last             = -1;
+    for (size_t k = 0; k < num_group; ++k)
+    {
+        size_t lane = batch->group[k];
+        if (batch->states[lane] != INT_CODE_CONTINUE)
+        {
+            continue;
+        }
+        /*Lanes storing to the cell of the lane before them skip the lookup.*/
+        if ((cells != NULL) && (addresses[k] == last))
+        {
+            cells[lane] = batch->results[k];
+        }
+        else if (store_lane(batch, lane, addresses[k], batch->results[k]))
+        {
+            last  = addresses[k];
+            cells = batch->deltas[last];
+        }
+        else
+        {
+            batch->states[lane] = INT_CODE_ERROR;
+            continue;
+        }
+        batch->heads[lane] = head + inst->inst_size;
+    }
+}
+
+/*Collects the running lanes with the lowest head that see the same instruction there.*/
+static void regroup_batch(intcode_batch_t* const batch)
+{
+    const size_t* heads   = batch->heads;
+    const uint8_t* states = batch->states;
+    size_t leader         = SIZE_MAX;
+    for (size_t lane = 0; lane < batch->num_used; ++lane)
+    {
+        if ((states[lane] == INT_CODE_CONTINUE) &&
+            ((leader == SIZE_MAX) || (heads[lane] < heads[leader])))
+        {
+            leader = lane;
+        }
+    }
+    batch->num_group    = 0;
+    batch->waiting_head = SIZE_MAX;
+    if (leader == SIZE_MAX)
+    {
+        return;
+    }
+
+    /*Lanes that modified the instruction at head run it in a group of their own.*/
+    size_t head    = heads[leader];
+    int64_t number = load_lane(batch, leader, head);
+    int uniform    = (head >= batch->num_deltas) || (batch->deltas[head] == NULL);
+    for (size_t lane = leader; lane < batch->num_used; ++lane)
+    {
+        if (states[lane] != INT_CODE_CONTINUE)
+        {
+            continue;
+        }
+        if ((heads[lane] == head) && (uniform || (load_lane(batch, lane, head) == number)))
+        {
+            batch->group[batch->num_group++] = lane;
+        }
+        else if (heads[lane] < batch->waiting_head)
+        {
+            batch->waiting_head = heads[lane];
+        }
+    }
+}
+
+/*Executes the instruction at the lowest head of all running lanes, returns 0 if none is left.*/
+static int step_batch(intcode_batch_t* const batch)
+{
+    size_t* const heads   = batch->heads;
+    uint8_t* const states = batch->states;
+    /*A group that is still ahead of all other lanes only has to be checked for modified code.*/
+    if (!batch->converged || ((heads[batch->group[0]] < batch->num_deltas) &&
+                              (batch->deltas[heads[batch->group[0]]] != NULL)))
+    {
+        regroup_batch(batch);
+    }
+    size_t num_group = batch->num_group;
+    if (num_group == 0)
+    {
+        return 0;
+    }
+
+    size_t head = heads[batch->group[0]];
+    intcode_decoded_t inst;
+    if ((head < batch->image_size) && (batch->deltas[head] == NULL))
+    {
+        inst = batch->decoded[head];
+    }
+    else
+    {
+        decode_instruction(load_lane(batch, batch->group[0], head), &inst);
+    }
+    if (inst.dispatch == INTCODE_DISPATCH_ERROR)
+    {
+        for (size_t k = 0; k < num_group; ++k)
+        {
+            states[batch->group[k]] = INT_CODE_ERROR;
+        }
+        batch->converged = 0;
+        return 1;
+    }
+    for (int p = 0; p < (inst.inst_size - 1); ++p)
+    {
+        fetch_operand(batch, &inst, head, p, num_group);
+    }
+
+    /*The operands of the group are consecutive, so the loops below vectorize.*/
+    const size_t* group = batch->group;
+    const int64_t* a    = batch->operands[0];
+    const int64_t* b    = batch->operands[1];
+    int64_t* results    = batch->results;
+    switch (inst.op_code)
+    {
+        case OP_CODE_ADD:
+            for (size_t k = 0; k < num_group; ++k)
+            {
+                results[k] = a[k] + b[k];
+            }
+            store_results(batch, &inst, head, num_group);
+            break;
+        case OP_CODE_MULT:
+            for (size_t k = 0; k < num_group; ++k)
+            {
+                results[k] = a[k] * b[k];
+            }
+            store_results(batch, &inst, head, num_group);
+            break;
+        case OP_CODE_IS_LESS:
+            for (size_t k = 0; k < num_group; ++k)
+            {
+                results[k] = a[k] < b[k];
+            }
+            store_results(batch, &inst, head, num_group);
+            break;
+        case OP_CODE_IS_EQUALS:
+            for (size_t k = 0; k < num_group; ++k)
+            {
+                results[k] = a[k] == b[k];
+            }
+            store_results(batch, &inst, head, num_group);
+            break;
+        case OP_CODE_JMP_IF_TRUE:
+        case OP_CODE_JMP_IF_FALSE:
+        {
+            /*Lanes taking different branches form separate groups from here on.*/
+            int64_t next    = head + inst.inst_size;
+            int64_t if_zero = (inst.op_code == OP_CODE_JMP_IF_FALSE);
+            for (size_t k = 0; k < num_group; ++k)
+            {
+                results[k] = ((a[k] == 0) == if_zero) ? b[k] : next;
+            }
+            for (size_t k = 0; k < num_group; ++k)
+            {
+                if (states[group[k]] == INT_CODE_CONTINUE)
+                {
+                    heads[group[k]] = (size_t) results[k];
+                }
+            }
+            break;
+        }
+        case OP_CODE_ADJUST_REL_BASE:
+            for (size_t k = 0; k < num_group; ++k)
+            {
+                if (states[group[k]] == INT_CODE_CONTINUE)
+                {
+                    batch->bases[group[k]] += a[k];
+                    heads[group[k]] = head + inst.inst_size;
+                }
+            }
+            break;
+        case OP_CODE_INPUT:
+            for (size_t k = 0; k < num_group; ++k)
+            {
+                size_t lane = group[k];
+                if (batch->input_size[lane] == 0)
+                {
+                    states[lane] = INT_CODE_BLOCKED;
+                    continue;
+                }
+                size_t first             = batch->input_first[lane];
+                results[k]               = batch->inputs[(lane * batch->io_capacity) + first];
+                batch->input_first[lane] = (first + 1) % batch->io_capacity;
+                batch->input_size[lane]--;
+            }
+            store_results(batch, &inst, head, num_group);
+            break;
+        case OP_CODE_OUTPUT:
+            for (size_t k = 0; k < num_group; ++k)
+            {
+                size_t lane = group[k];
+                if (states[lane] != INT_CODE_CONTINUE)
+                {
+                    continue;
+                }
+                if (batch->output_size[lane] == batch->io_capacity)
+                {
+                    states[lane] = INT_CODE_BLOCKED;
+                    continue;
+                }
+                size_t slot = (batch->output_first[lane] + batch->output_size[lane]) %
+                              batch->io_capacity;
+                batch->outputs[(lane * batch->io_capacity) + slot] = a[k];
+                batch->output_size[lane]++;
+                heads[lane] = head + inst.inst_size;
+            }
+            break;
+        default:
+            for (size_t k = 0; k < num_group; ++k)
+            {
+                states[group[k]] = INT_CODE_HALT;
+            }
+            break;
+    }
+
+    /*The group runs on as it is while no lane halted, blocked, took another branch or caught up.*/
+    size_t next   = heads[group[0]];
+    int converged = (next < batch->waiting_head);
+    for (size_t k = 0; k < num_group; ++k)
+    {
+        converged = converged && (states[group[k]] == INT_CODE_CONTINUE) &&
+                    (heads[group[k]] == next);
+    }
+    batch->converged = converged;
+    return 1;
+}
+
+static int get_parameter_values(const intcode_t* const prog,
+                                const size_t num_parameters,
+                                const int store_param,
+                                const uint8_t* const parameter_modes,
+                                int64_t* const parameters)
+{
+    int no_error = 0;
+    /*Assuming range checks are made by caller*/
+    if ((prog != NULL) && (parameter_modes != NULL) && (parameters != NULL))
+    {
+        no_error = 1;
+        for (size_t i = 0; i < num_parameters; i++)
+        {
+            int64_t memory_val = get_mem_value(prog, prog->head + i + 1);
+            int64_t param_val  = 0;
+            if (parameter_modes[i] == PARAM_MODE_IMMEDIATE)
+            {
+                if ((store_param == i) && (memory_val < 0))
+                {
+                    /*Stores to an immediate operand write to the position, it has to exist.*/
+                    no_error = 0;
+                    break;
+                }
+                param_val = memory_val;
+            }
+            else if ((parameter_modes[i] == PARAM_MODE_POSITION) ||
+                     (parameter_modes[i] == PARAM_MODE_RELATIVE))
+            {
+                int64_t address = memory_val;
+                if (parameter_modes[i] == PARAM_MODE_RELATIVE)
+                {
+                    address += prog->relative_base;
+                }
+                if (address < 0)
+                {
+                    /*Negative addresses are outside of the memory.*/
+                    no_error = 0;
+                    break;
+                }
+                if ((store_param != INTCODE_NO_STORE) && (store_param == i))
+                {
+                    /*The parameter value is the address where the result of op
+                     * is stored.*/
+                    param_val = address;
+                }
+                else
+                {
+                    /*The parameter value is stored at the address*/
+                    param_val = get_mem_value(prog, address);
+                }
+            }
+            else
+            {
+                no_error = 0;
+                break;
+            }
+            parameters[i] = param_val;
+        }
+    }
+    return no_error;
+}
+
+static intcode_op_f get_op_func(const int op_code)
+{
+    switch (op_code)
+    {
+        case OP_CODE_ADD:
+            return add_op;
+        case OP_CODE_MULT:
+            return multiply_op;
+        case OP_CODE_INPUT:
+            return input_op;
+        case OP_CODE_OUTPUT:
+            return output_op;
+        case OP_CODE_IS_LESS:
+            return is_less_op;
+        case OP_CODE_IS_EQUALS:
+            return is_equals_op;
+        case OP_CODE_JMP_IF_TRUE:
+            return jmp_if_true_op;
+        case OP_CODE_JMP_IF_FALSE:
+            return jmp_if_false_op;
+        case OP_CODE_ADJUST_REL_BASE:
+            return adjust_rel_base_op;
+        default:
+            return error_op;
+    }
+}
+
+static uint64_t now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t) now.tv_sec * 1000000000u) + (uint64_t) now.tv_nsec;
+}
+
+/*Step engine with counters, so the other engines do not pay for profiling.*/
+/*Steps like the interpreter and counts the instructions, IO and checkpoints refer to them.*/
+static int execute_recorded(intcode_t* const prog)
+{
+    intcode_recorder_t* recorder = prog->recorder;
+    int ret                      = INT_CODE_CONTINUE;
+    while ((ret == INT_CODE_CONTINUE) && (recorder->instructions < recorder->stop_at))
+    {
+        if ((recorder->log != NULL) && (recorder->instructions >= recorder->next_checkpoint))
+        {
+            write_checkpoint(prog);
+        }
+        int op_code = 0;
+        ret         = execute_head_block(prog, &op_code);
+        if (ret == INT_CODE_CONTINUE)
+        {
+            recorder->instructions++;
+        }
+    }
+    return ret;
+}
+
+static void write_checkpoint(intcode_t* const prog)
+{
+    intcode_recorder_t* recorder       = prog->recorder;
+    intcode_record_t record            = {.kind        = INTCODE_RECORD_CHECKPOINT,
+                                          .reserved    = 0,
+                                          .instruction = recorder->instructions,
+                                          .value       = 0};
+    intcode_checkpoint_header_t header = {.head          = prog->head,
+                                          .relative_base = prog->relative_base,
+                                          .memory_size   = prog->memory_size,
+                                          .num_pages     = 0};
+    for (size_t i = 0; i < prog->num_pages; ++i)
+    {
+        header.num_pages += (prog->pages[i] != NULL);
+    }
+    for (size_t i = 0; i < prog->sparse_capacity; ++i)
+    {
+        header.num_pages += (prog->sparse_pages[i].page != NULL);
+    }
+
+    /*Pages that were never written read as 0 and are left out.*/
+    int success = (fwrite(&record, sizeof(record), 1, recorder->log) == 1) &&
+                  (fwrite(&header, sizeof(header), 1, recorder->log) == 1);
+    for (size_t i = 0; success && (i < prog->num_pages + prog->sparse_capacity); ++i)
+    {
+        const intcode_page_t* page = NULL;
+        uint64_t index             = i;
+        if (i < prog->num_pages)
+        {
+            page = prog->pages[i];
+        }
+        else
+        {
+            page  = prog->sparse_pages[i - prog->num_pages].page;
+            index = prog->sparse_pages[i - prog->num_pages].index;
+        }
+        if (page != NULL)
+        {
+            success = (fwrite(&index, sizeof(index), 1, recorder->log) == 1) &&
+                      (fwrite(page->cells, sizeof(page->cells), 1, recorder->log) == 1);
+        }
+    }
+    recorder->failed          = recorder->failed || !success;
+    recorder->next_checkpoint = (recorder->checkpoint_interval > 0)
+                                    ? (recorder->instructions + recorder->checkpoint_interval)
+                                    : UINT64_MAX;
+}
+
+static void record_io(intcode_t* const prog, const int64_t value, const int is_output)
+{
+    intcode_recorder_t* recorder = prog->recorder;
+    if (recorder->log == NULL)
+    {
+        return;
+    }
+    intcode_record_t record = {.kind = is_output ? INTCODE_RECORD_OUTPUT : INTCODE_RECORD_INPUT,
+                               .reserved    = 0,
+                               .instruction = recorder->instructions,
+                               .value       = value};
+    if (fwrite(&record, sizeof(record), 1, recorder->log) != 1)
+    {
+        recorder->failed = 1;
+    }
+}
+
+/*Returns INT_CODE_BLOCKED once the recording ran out and INT_CODE_ERROR if the machine took*/
+/*another path than the recorded one.*/
+static int replay_input(intcode_t* const prog, int64_t* const value)
+{
+    intcode_recorder_t* recorder = prog->recorder;
+    if ((recorder == NULL) || (recorder->recording == NULL))
+    {
+        return INT_CODE_ERROR;
+    }
+    const intcode_recording_t* recording = recorder->recording;
+    size_t next                          = recorder->next_input;
+    while ((next < recording->num_events) && recording->events[next].is_output)
+    {
+        next++;
+    }
+    if (next == recording->num_events)
+    {
+        return INT_CODE_BLOCKED;
+    }
+    if (recording->events[next].instruction != recorder->instructions)
+    {
+        return INT_CODE_ERROR;
+    }
+    *value               = recording->events[next].value;
+    recorder->next_input = next + 1;
+    return INT_CODE_CONTINUE;
+}
+
+/*Outputs past the end of the recording are accepted, the session just was not recorded further.*/
+static int replay_output(intcode_t* const prog, const int64_t value)
+{
+    intcode_recorder_t* recorder = prog->recorder;
+    if ((recorder == NULL) || (recorder->recording == NULL))
+    {
+        return 0;
+    }
+    const intcode_recording_t* recording = recorder->recording;
+    size_t next                          = recorder->next_output;
+    while ((next < recording->num_events) && !recording->events[next].is_output)
+    {
+        next++;
+    }
+    if (next == recording->num_events)
+    {
+        recorder->next_output = next;
+        return 1;
+    }
+    recorder->next_output = next + 1;
+    return (recording->events[next].instruction == recorder->instructions) &&
+           (recording->events[next].value == value);
+}
+
+/*A session that was cut off may end within a record, which is ignored.*/
+static int parse_recording(intcode_recording_t* const recording)
+{
+    intcode_recording_header_t header;
+    if (recording->length < sizeof(header))
+    {
+        return 0;
+    }
+    memcpy(&header, recording->data, sizeof(header));
+    if ((memcmp(header.magic, INTCODE_RECORDING_MAGIC, 4) != 0) ||
+        (header.version != INTCODE_RECORDING_VERSION))
+    {
+        return 0;
+    }
+
+    const size_t page_size = sizeof(uint64_t) + (sizeof(int64_t) * INTCODE_PAGE_SIZE);
+    size_t pos             = sizeof(header);
+    while ((recording->length - pos) >= sizeof(intcode_record_t))
+    {
+        intcode_record_t record;
+        memcpy(&record, recording->data + pos, sizeof(record));
+        pos += sizeof(record);
+        if (record.kind == INTCODE_RECORD_CHECKPOINT)
+        {
+            intcode_checkpoint_header_t state;
+            if ((recording->length - pos) < sizeof(state))
+            {
+                break;
+            }
+            memcpy(&state, recording->data + pos, sizeof(state));
+            if (state.num_pages > ((recording->length - pos - sizeof(state)) / page_size))
+            {
+                break;
+            }
+            if (recording->num_checkpoints == recording->checkpoints_capacity)
+            {
+                size_t capacity = (recording->checkpoints_capacity > 0)
+                                      ? (recording->checkpoints_capacity * 2)
+                                      : 16;
+                intcode_checkpoint_t* checkpoints = (intcode_checkpoint_t*) realloc(
+                    recording->checkpoints, sizeof(intcode_checkpoint_t) * capacity);
+                if (checkpoints == NULL)
+                {
+                    return 0;
+                }
+                recording->checkpoints          = checkpoints;
+                recording->checkpoints_capacity = capacity;
+            }
+            intcode_checkpoint_t* checkpoint = &recording->checkpoints[recording->num_checkpoints];
+            checkpoint->instruction          = record.instruction;
+            checkpoint->state                = recording->data + pos;
+            recording->num_checkpoints++;
+            pos += sizeof(state) + (state.num_pages * page_size);
+        }
+        else if ((record.kind == INTCODE_RECORD_INPUT) || (record.kind == INTCODE_RECORD_OUTPUT))
         {
-            prog->head = parameters[1];
+            if (recording->num_events == recording->events_capacity)
+            {
+                size_t capacity = (recording->events_capacity > 0)
+                                      ? (recording->events_capacity * 2)
+                                      : 256;
+                intcode_io_event_t* events = (intcode_io_event_t*) realloc(
+                    recording->events, sizeof(intcode_io_event_t) * capacity);
+                if (events == NULL)
+                {
+                    return 0;
+                }
+                recording->events          = events;
+                recording->events_capacity = capacity;
+            }
+            intcode_io_event_t* event = &recording->events[recording->num_events++];
+            event->instruction        = record.instruction;
+            event->value              = record.value;
+            event->is_output          = (record.kind == INTCODE_RECORD_OUTPUT);
         }
         else
         {
-            prog->head += get_instruction_size(OP_CODE_JMP_IF_TRUE);
+            return 0;
         }
-        op_ret = INT_CODE_CONTINUE;
     }
-    return op_ret;
+    /*Replays start from a checkpoint, the first one is written when the recording starts.*/
+    return (recording->num_checkpoints > 0) && (recording->checkpoints[0].instruction == 0);
 }
 
-int jmp_if_false_op(intcode_t* const prog, const int64_t* const parameters)
+static intcode_t* restore_checkpoint(const intcode_checkpoint_t* const checkpoint)
 {
-    /*TODO add boundary checks*/
-    int op_ret = INT_CODE_ERROR;
-    if (parameters != NULL)
+    intcode_checkpoint_header_t state;
+    memcpy(&state, checkpoint->state, sizeof(state));
+    intcode_t* prog = alloc_intcode();
+    if (prog == NULL)
     {
-        if (parameters[0] == 0)
-        {
-            prog->head = parameters[1];
-        }
-        else
+        return NULL;
+    }
+
+    const char* pages = checkpoint->state + sizeof(state);
+    for (uint64_t i = 0; i < state.num_pages; ++i)
+    {
+        uint64_t index = 0;
+        memcpy(&index, pages, sizeof(index));
+        intcode_page_t* page = (index <= (SIZE_MAX >> INTCODE_PAGE_BITS))
+                                   ? get_page_for_write(prog, index << INTCODE_PAGE_BITS)
+                                   : NULL;
+        if (page == NULL)
         {
-            prog->head += get_instruction_size(OP_CODE_JMP_IF_FALSE);
+            destroy_intcode(prog);
+            return NULL;
         }
-        op_ret = INT_CODE_CONTINUE;
+        memcpy(page->cells, pages + sizeof(index), sizeof(page->cells));
+        pages += sizeof(index) + sizeof(page->cells);
     }
-    return op_ret;
+    prog->head          = state.head;
+    prog->relative_base = state.relative_base;
+    prog->memory_size   = state.memory_size;
+    return prog;
 }
 
-int is_less_op(intcode_t* const prog, const int64_t* const parameters)
+static int execute_profiled(intcode_t* const prog)
 {
-    /*TODO add boundary checks*/
-    int op_ret = INT_CODE_ERROR;
-    if (parameters != NULL)
+    intcode_profile_t* profile = prog->profile;
+    uint64_t start             = now_ns();
+    int ret                    = INT_CODE_CONTINUE;
+    while (ret == INT_CODE_CONTINUE)
     {
-        int ret = 0;
-        if (parameters[0] < parameters[1])
-        {
-            ret = set_mem_value(prog, parameters[2], 1);
-        }
-        else
+        size_t head = prog->head;
+        if (head >= profile->num_addresses)
         {
-            ret = set_mem_value(prog, parameters[2], 0);
+            size_t num_addresses =
+                (profile->num_addresses > 0) ? profile->num_addresses : INTCODE_PAGE_SIZE;
+            while (num_addresses <= head)
+            {
+                num_addresses *= 2;
+            }
+            uint64_t* counts = (uint64_t*) realloc(profile->address_counts,
+                                                   sizeof(uint64_t) * num_addresses);
+            if (counts == NULL)
+            {
+                ret = INT_CODE_ERROR;
+                break;
+            }
+            memset(counts + profile->num_addresses,
+                   0,
+                   sizeof(uint64_t) * (num_addresses - profile->num_addresses));
+            profile->address_counts = counts;
+            profile->num_addresses  = num_addresses;
         }
-        if (ret != 0)
+
+        /*Only IO instructions are timed, reading the clock for every step would dominate.*/
+        int op_code       = get_opcode(load_mem(prog, head));
+        int is_input      = (op_code == OP_CODE_INPUT);
+        int is_output     = (op_code == OP_CODE_OUTPUT);
+        uint64_t io_start = (is_input || is_output) ? now_ns() : 0;
+        ret               = execute_head_block(prog, &op_code);
+        if (is_input)
         {
-            prog->head += get_instruction_size(OP_CODE_IS_LESS);
-            op_ret = INT_CODE_CONTINUE;
+            profile->input_ns += now_ns() - io_start;
         }
-    }
-    return op_ret;
-}
-int is_equals_op(intcode_t* const prog, const int64_t* const parameters)
-{
-    /*TODO add boundary checks*/
-    int op_ret = INT_CODE_ERROR;
-    if (parameters != NULL)
-    {
-        int ret = 0;
-        if (parameters[0] == parameters[1])
+        else if (is_output)
         {
-            ret = set_mem_value(prog, parameters[2], 1);
+            profile->output_ns += now_ns() - io_start;
         }
-        else
+
+        /*A yielding machine retries the instruction later, it was not executed yet.*/
+        if (ret == INT_CODE_BLOCKED)
         {
-            ret = set_mem_value(prog, parameters[2], 0);
+            profile->num_blocked++;
+            break;
         }
-        if (ret != 0)
+        if ((op_code >= 0) && (op_code < INT_CODE_PROFILE_OPS))
         {
-            prog->head += get_instruction_size(OP_CODE_IS_EQUALS);
-            op_ret = INT_CODE_CONTINUE;
+            profile->op_counts[op_code]++;
         }
+        profile->address_counts[head]++;
+        profile->instructions++;
     }
-    return op_ret;
+    profile->run_ns += now_ns() - start;
+
+    if ((ret == INT_CODE_HALT) && (profile->report != NULL))
+    {
+        print_profile(prog, profile->report);
+    }
+    return ret;
 }
 
-int adjust_rel_base_op(intcode_t* const prog, const int64_t* const parameters)
+static intcode_page_t* create_page()
 {
-    int op_ret = INT_CODE_ERROR;
-    if ((prog != NULL) && (parameters != NULL))
+    intcode_page_t* page = (intcode_page_t*) calloc(1, sizeof(intcode_page_t));
+    if (page != NULL)
     {
-        prog->relative_base += parameters[0];
-        prog->head += get_instruction_size(OP_CODE_ADJUST_REL_BASE);
-        op_ret = INT_CODE_CONTINUE;
+        atomic_init(&page->refs, 1);
     }
-    return op_ret;
+    return page;
 }
 
-int error_op(intcode_t* const prog, const int64_t* const parameters)
+static intcode_page_t* copy_page(const intcode_page_t* const page)
 {
-    return INT_CODE_ERROR;
+    intcode_page_t* copy = create_page();
+    if (copy != NULL)
+    {
+        memcpy(copy->cells, page->cells, sizeof(copy->cells));
+        if (page->decoded != NULL)
+        {
+            /*Keep the cache warm, a failed allocation just means decoding again.*/
+            size_t decoded_size = sizeof(intcode_decoded_t) * INTCODE_PAGE_SIZE;
+            copy->decoded       = (intcode_decoded_t*) malloc(decoded_size);
+            if (copy->decoded != NULL)
+            {
+                memcpy(copy->decoded, page->decoded, decoded_size);
+                copy->fully_decoded = page->fully_decoded;
+            }
+        }
+    }
+    return copy;
 }
 
-static void get_size_info(const char* const file_path,
-                          size_t* const total_chars,
-                          size_t* const amount_integers)
+static void share_page(intcode_page_t* const page)
 {
-    /*Again, inefficient but lazy*/
-    if (file_path != NULL)
+    if (page != NULL)
     {
-        FILE* fp = fopen(file_path, "r");
-        if (fp != NULL)
+        /*Shared pages are read-only, so the decode cache has to be complete before sharing.*/
+        if ((page->decoded == NULL) && !page_is_shared(page))
+        {
+            page->decoded =
+                (intcode_decoded_t*) calloc(INTCODE_PAGE_SIZE, sizeof(intcode_decoded_t));
+        }
+        if ((page->decoded != NULL) && !page->fully_decoded && !page_is_shared(page))
         {
-            char ch = fgetc(fp);
-            while (ch != EOF)
+            for (size_t i = 0; i < INTCODE_PAGE_SIZE; ++i)
             {
-                *total_chars += 1;
-                if (ch == ',')
+                if (!page->decoded[i].valid)
                 {
-                    *amount_integers += 1;
+                    decode_instruction(page->cells[i], &page->decoded[i]);
                 }
-                ch = fgetc(fp);
             }
-            *amount_integers += 1;
-            fclose(fp);
+            page->fully_decoded = 1;
+        }
+        if (!page_is_shared(page))
+        {
+            page->hash = hash_page(page);
         }
+        atomic_fetch_add_explicit(&page->refs, 1, memory_order_relaxed);
     }
 }
 
-static size_t get_instruction_size(const int op_code)
+static void release_page(intcode_page_t* const page)
 {
-    size_t inst_size = 1;
-    if ((op_code == OP_CODE_ADD) || (op_code == OP_CODE_MULT) || (op_code == OP_CODE_IS_LESS) ||
-        (op_code == OP_CODE_IS_EQUALS))
+    if ((page != NULL) && (atomic_fetch_sub_explicit(&page->refs, 1, memory_order_acq_rel) == 1))
     {
-        inst_size = 4;
+        free(page->decoded);
+        free(page);
     }
-    else if ((op_code == OP_CODE_JMP_IF_TRUE) || (op_code == OP_CODE_JMP_IF_FALSE))
+}
+
+/*Allocates the page tables of the target and shares the pages of the source with it.*/
+static int share_page_tables(intcode_t* const target, const intcode_t* const source)
+{
+    intcode_page_t** pages             = NULL;
+    intcode_page_entry_t* sparse_pages = NULL;
+    if (source->num_pages > 0)
     {
-        inst_size = 3;
+        pages = (intcode_page_t**) malloc(sizeof(intcode_page_t*) * source->num_pages);
     }
-    else if ((op_code == OP_CODE_INPUT) || (op_code == OP_CODE_OUTPUT) ||
-             (op_code == OP_CODE_ADJUST_REL_BASE))
+    if (source->sparse_capacity > 0)
     {
-        inst_size = 2;
+        size_t entries_size = sizeof(intcode_page_entry_t) * source->sparse_capacity;
+        sparse_pages        = (intcode_page_entry_t*) malloc(entries_size);
     }
-    else if (op_code == OP_CODE_HALT)
+    if (((source->num_pages > 0) && (pages == NULL)) ||
+        ((source->sparse_capacity > 0) && (sparse_pages == NULL)))
     {
-        inst_size = 1;
+        free(pages);
+        free(sparse_pages);
+        return 0;
     }
-    return inst_size;
+
+    /*Only the page tables are copied, the pages themselves are shared.*/
+    for (size_t i = 0; i < source->num_pages; ++i)
+    {
+        pages[i] = source->pages[i];
+        share_page(pages[i]);
+    }
+    for (size_t i = 0; i < source->sparse_capacity; ++i)
+    {
+        sparse_pages[i] = source->sparse_pages[i];
+        share_page(sparse_pages[i].page);
+    }
+    target->pages           = pages;
+    target->num_pages       = source->num_pages;
+    target->sparse_pages    = sparse_pages;
+    target->sparse_capacity = source->sparse_capacity;
+    target->sparse_count    = source->sparse_count;
+    return 1;
 }
 
-static int get_opcode(const int64_t number)
+static uint64_t mix_hash(uint64_t value)
 {
-    int op_code = 0;
-    if (number > 99)
+    /*Finalizer of splitmix64, every input bit affects every output bit.*/
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ull;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBull;
+    value ^= value >> 31;
+    return value;
+}
+
+static uint64_t hash_page(const intcode_page_t* const page)
+{
+    /*Zero cells are left out, so a page of zeros hashes to zero.*/
+    uint64_t hash = 0;
+    for (size_t i = 0; i < INTCODE_PAGE_SIZE; ++i)
     {
-        op_code = number % 100;
+        if (page->cells[i] != 0)
+        {
+            hash ^= mix_hash((uint64_t) page->cells[i] + (i * 0x9E3779B97F4A7C15ull));
+        }
     }
-    else
+    return hash;
+}
+
+/*Unallocated pages are equal to pages of zeros.*/
+static int pages_equal(const intcode_page_t* const first, const intcode_page_t* const second)
+{
+    if (first == second)
     {
-        op_code = number;
+        return 1;
     }
-    return op_code;
+    for (size_t i = 0; i < INTCODE_PAGE_SIZE; ++i)
+    {
+        int64_t a = (first != NULL) ? first->cells[i] : 0;
+        int64_t b = (second != NULL) ? second->cells[i] : 0;
+        if (a != b)
+        {
+            return 0;
+        }
+    }
+    return 1;
 }
 
-static int is_valid_opcode(const int op_code)
+/*Every allocated page of the machine reads the same in the other one.*/
+static int memory_contained_in(const intcode_t* const prog, const intcode_t* const other)
 {
-    return (op_code >= 1 && op_code <= 9) || (op_code == OP_CODE_HALT);
+    for (size_t i = 0; i < prog->num_pages; ++i)
+    {
+        if (!pages_equal(prog->pages[i], find_page(other, i << INTCODE_PAGE_BITS)))
+        {
+            return 0;
+        }
+    }
+    for (size_t i = 0; i < prog->sparse_capacity; ++i)
+    {
+        const intcode_page_entry_t* entry = &prog->sparse_pages[i];
+        if ((entry->page != NULL) &&
+            !pages_equal(entry->page, find_page(other, entry->index << INTCODE_PAGE_BITS)))
+        {
+            return 0;
+        }
+    }
+    return 1;
 }
 
-static void get_parameter_modes(const int64_t number,
-                                const size_t num_parameters,
-                                int* const parameter_modes)
+static size_t hash_page_index(const size_t index)
 {
-    if (NULL != parameter_modes)
+    /*Fibonacci hashing, page indices of one program tend to be close to each other.*/
+    return (size_t) (((uint64_t) index * 11400714819323198485ull) >> 32);
+}
+
+static intcode_page_entry_t* find_sparse_entry(const intcode_t* const prog, const size_t index)
+{
+    if (prog->sparse_count > 0)
     {
-        int64_t modes = number / 100;
-        for (size_t i = 0; i < num_parameters; i++)
+        size_t mask = prog->sparse_capacity - 1;
+        size_t slot = hash_page_index(index) & mask;
+        while (prog->sparse_pages[slot].page != NULL)
         {
-            int mode           = modes % 10;
-            parameter_modes[i] = mode;
-            modes /= 10;
+            if (prog->sparse_pages[slot].index == index)
+            {
+                return &prog->sparse_pages[slot];
+            }
+            slot = (slot + 1) & mask;
         }
     }
+    return NULL;
 }
 
-static int get_parameter_values(const intcode_t* const prog,
-                                const size_t num_parameters,
-                                const int store_param,
-                                const int* const parameter_modes,
-                                int64_t* const parameters)
+static INTCODE_NOINLINE intcode_page_t* find_sparse_page(const intcode_t* const prog,
+                                                         const size_t index)
 {
-    int no_error = 0;
-    /*Assuming range checks are made by caller*/
-    if ((prog != NULL) && (parameter_modes != NULL) && (parameters != NULL))
+    const intcode_page_entry_t* entry = find_sparse_entry(prog, index);
+    return (entry != NULL) ? entry->page : NULL;
+}
+
+static int insert_sparse_page(intcode_t* const prog, const size_t index, intcode_page_t* const page)
+{
+    /*Keep the load factor below 1/2 so probing sequences stay short.*/
+    if (2 * (prog->sparse_count + 1) > prog->sparse_capacity)
     {
-        no_error = 1;
-        for (size_t i = 0; i < num_parameters; i++)
+        size_t capacity = (prog->sparse_capacity == 0) ? INTCODE_SPARSE_INITIAL_CAPACITY
+                                                       : 2 * prog->sparse_capacity;
+        intcode_page_entry_t* entries =
+            (intcode_page_entry_t*) calloc(capacity, sizeof(intcode_page_entry_t));
+        if (entries == NULL)
         {
-            int64_t memory_val = get_mem_value(prog, prog->head + i + 1);
-            int64_t param_val  = 0;
-            if (parameter_modes[i] == PARAM_MODE_POSITION)
+            return 0;
+        }
+        for (size_t i = 0; i < prog->sparse_capacity; ++i)
+        {
+            if (prog->sparse_pages[i].page != NULL)
             {
-                /*TODO check boundaries*/
-                if ((store_param != INTCODE_NO_STORE) && (store_param == i))
-                {
-                    /*The parameter value is the address where the result of op
-                     * is stored.*/
-                    param_val = memory_val;
-                }
-                else
+                size_t slot = hash_page_index(prog->sparse_pages[i].index) & (capacity - 1);
+                while (entries[slot].page != NULL)
                 {
-                    /*The parameter value is stored at the address*/
-                    param_val = get_mem_value(prog, memory_val);
+                    slot = (slot + 1) & (capacity - 1);
                 }
+                entries[slot] = prog->sparse_pages[i];
             }
-            else if (parameter_modes[i] == PARAM_MODE_IMMEDIATE)
+        }
+        free(prog->sparse_pages);
+        prog->sparse_pages    = entries;
+        prog->sparse_capacity = capacity;
+    }
+
+    size_t mask = prog->sparse_capacity - 1;
+    size_t slot = hash_page_index(index) & mask;
+    while (prog->sparse_pages[slot].page != NULL)
+    {
+        slot = (slot + 1) & mask;
+    }
+    prog->sparse_pages[slot].index = index;
+    prog->sparse_pages[slot].page  = page;
+    prog->sparse_count++;
+    return 1;
+}
+
+static intcode_page_t* get_page_for_write(intcode_t* const prog, const size_t address)
+{
+    size_t index          = address >> INTCODE_PAGE_BITS;
+    intcode_page_t** slot = NULL;
+    if (index < prog->num_pages)
+    {
+        slot = &prog->pages[index];
+    }
+    else
+    {
+        intcode_page_entry_t* entry = find_sparse_entry(prog, index);
+        slot                        = (entry != NULL) ? &entry->page : NULL;
+    }
+
+    if ((slot != NULL) && (*slot != NULL))
+    {
+        if (page_is_shared(*slot))
+        {
+            /*Copy on write, the other owners keep the original page.*/
+            intcode_page_t* copy = copy_page(*slot);
+            if (copy == NULL)
             {
-                param_val = memory_val;
+                return NULL;
             }
-            else if (parameter_modes[i] == PARAM_MODE_RELATIVE)
+            if (prog->profile != NULL)
             {
-                /*TODO check boundaries*/
-                if ((store_param != INTCODE_NO_STORE) && (store_param == i))
-                {
-                    /*The parameter value is the address where the result of op
-                     * is stored.*/
-                    param_val = memory_val + prog->relative_base;
-                }
-                else
-                {
-                    /*The parameter value is stored at the address*/
-                    param_val = get_mem_value(prog, memory_val + prog->relative_base);
-                }
+                prog->profile->page_copies++;
             }
-            else
+            if (prog->translation != NULL)
             {
-                no_error = 0;
-                break;
+                /*Closures still point into the old page.*/
+                prog->translation->stale = 1;
+                prog->translation->dirty = 1;
             }
-            parameters[i] = param_val;
+            release_page(*slot);
+            *slot = copy;
         }
+        return *slot;
     }
-    return no_error;
-}
 
-static intcode_op_f get_op_func(const int op_code)
-{
-    switch (op_code)
+    intcode_page_t* page = create_page();
+    if (page == NULL)
     {
-        case OP_CODE_ADD:
-            return add_op;
-        case OP_CODE_MULT:
-            return multiply_op;
-        case OP_CODE_INPUT:
-            return input_op;
-        case OP_CODE_OUTPUT:
-            return output_op;
-        case OP_CODE_IS_LESS:
-            return is_less_op;
-        case OP_CODE_IS_EQUALS:
-            return is_equals_op;
-        case OP_CODE_JMP_IF_TRUE:
-            return jmp_if_true_op;
-        case OP_CODE_JMP_IF_FALSE:
-            return jmp_if_false_op;
-        case OP_CODE_ADJUST_REL_BASE:
-            return adjust_rel_base_op;
-        default:
-            return error_op;
+        return NULL;
+    }
+    if (prog->profile != NULL)
+    {
+        prog->profile->page_allocations++;
+    }
+
+    if (index < INTCODE_DENSE_PAGE_LIMIT)
+    {
+        if (index >= prog->num_pages)
+        {
+            /*Only the table of page pointers grows, the pages in between stay unallocated.*/
+            size_t num_pages = index + 1;
+            intcode_page_t** pages =
+                (intcode_page_t**) realloc(prog->pages, sizeof(intcode_page_t*) * num_pages);
+            if (pages == NULL)
+            {
+                release_page(page);
+                return NULL;
+            }
+            memset(pages + prog->num_pages,
+                   0,
+                   sizeof(intcode_page_t*) * (num_pages - prog->num_pages));
+            prog->pages     = pages;
+            prog->num_pages = num_pages;
+        }
+        prog->pages[index] = page;
+    }
+    else if (!insert_sparse_page(prog, index, page))
+    {
+        release_page(page);
+        page = NULL;
     }
+    return page;
 }
 
 static void write_to_io_std(FILE* const stream, const int64_t value)
@@ -805,3 +4585,37 @@ static void read_from_io_mem(intcode_io_mem_t* const storage, int64_t* value)
         storage->consumed = 1;
     }
 }
+
+static void wake_io_ring(intcode_io_ring_t* const ring, atomic_int* const waiting)
+{
+    /*Pairs with the fence in wait_for_io_ring, either the waiter sees the new index or we see the*/
+    /*waiter. The mutex is only taken if the other side is about to sleep.*/
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiting, memory_order_relaxed))
+    {
+        pthread_mutex_lock(&ring->mut);
+        pthread_cond_broadcast(&ring->cond);
+        pthread_mutex_unlock(&ring->mut);
+    }
+}
+
+static int wait_for_io_ring(intcode_io_ring_t* const ring,
+                            atomic_int* const waiting,
+                            const int for_space)
+{
+    atomic_store_explicit(waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    pthread_mutex_lock(&ring->mut);
+    size_t size = io_ring_size(ring);
+    while (!atomic_load(&ring->closed) && (for_space ? (size > ring->mask) : (size == 0)))
+    {
+        pthread_cond_wait(&ring->cond, &ring->mut);
+        size = io_ring_size(ring);
+    }
+    pthread_mutex_unlock(&ring->mut);
+
+    atomic_store_explicit(waiting, 0, memory_order_relaxed);
+    /*A closed ring can still be drained by the reader.*/
+    return !atomic_load(&ring->closed) || (!for_space && (size > 0));
+}
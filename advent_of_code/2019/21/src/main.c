@@ -7,11 +7,14 @@
 
 #include "challenge/challenge_lib.h"
 #include "challenge/intcode.h"
-#include "pthread.h"
 #include "stdbool.h"
 #include "stdio.h"
 #include "stdlib.h"
 
+/*The springscript is written at once, it has at most 15 instructions.*/
+#define IO_IN_CAPACITY 256
+#define IO_OUT_CAPACITY 1024
+
 int main(int argc, char* argv[])
 {
     if (argc != 2)
@@ -21,19 +24,21 @@ int main(int argc, char* argv[])
         return 0;
     }
 
-    /*Initialize the program with IO memory.*/
-    intcode_t* prog          = read_intcode(argv[1]);
-    intcode_io_mem_t* io_in  = create_io_mem();
-    intcode_io_mem_t* io_out = create_io_mem();
-    if ((prog == NULL) || (io_in == NULL) || (io_out == NULL))
+    /*Initialize the program with IO rings, the system is run on this thread.*/
+    intcode_t* prog                = read_intcode(argv[1]);
+    intcode_io_ring_t* io_in       = create_io_ring(IO_IN_CAPACITY);
+    intcode_io_ring_t* io_out      = create_io_ring(IO_OUT_CAPACITY);
+    intcode_scheduler_t* scheduler = create_scheduler(0);
+    if ((prog == NULL) || (io_in == NULL) || (io_out == NULL) || (scheduler == NULL))
     {
         printf("Error reading programm or allocating IO memory\n");
         return 0;
     }
 
-    set_io_mode(prog, INT_CODE_MEM_IO);
-    set_mem_io_in(prog, io_in);
-    set_mem_io_out(prog, io_out);
+    set_io_mode(prog, INT_CODE_RING_IO);
+    set_ring_io_in(prog, io_in);
+    set_ring_io_out(prog, io_out);
+    schedule_intcode(scheduler, prog);
 
     /*Setup area, overview and robot with intial size and values.*/
     ASCII* system      = (ASCII*) malloc(sizeof(ASCII));
@@ -44,27 +49,19 @@ int main(int argc, char* argv[])
     }
 
     /*Initialize everything*/
-    system->brain    = prog;
-    system->finished = 0;
-
-    /*Start robot and control threads*/
-    pthread_t system_thread = 0;
-    pthread_create(&system_thread, NULL, system_func, system);
+    system->brain     = prog;
+    system->scheduler = scheduler;
+    system->finished  = 0;
 
-    pthread_t control_thread = 0;
     /*Use this for part 1*/
-    /*pthread_create(&control_thread, NULL, control_part01, system);*/
-    pthread_create(&control_thread, NULL, control_part02, system);
-
-
-    /*Wait for threads to finish.*/
-    pthread_join(control_thread, NULL);
-    pthread_join(system_thread, NULL);
+    /*control_part01(system);*/
+    control_part02(system);
 
     /*Clean up*/
-    destroy_io_mem(io_in);
-    destroy_io_mem(io_out);
+    destroy_scheduler(scheduler);
     destroy_intcode(prog);
+    destroy_io_ring(io_in);
+    destroy_io_ring(io_out);
     if (system != NULL)
     {
         free(system);
@@ -8,21 +8,45 @@
 #define INCLUDE_CHALLENGE_LIB_H
 
 #include "challenge/intcode.h"
+#include "challenge/intcode_scheduler.h"
+#include "challenge/packet.h"
+#include "challenge/queue.h"
+
+#define NAT_ADDRESS (255)
 
 typedef struct
 {
     intcode_t* brain;
-    int finished;
-} ASCII;
+    intcode_io_ring_t* input;
+    intcode_io_ring_t* output;
+    /*Packets that did not fit into the input ring yet.*/
+    PacketQueue inbox;
+    /*Values of a packet that was only partly sent.*/
+    int64_t partial[2];
+    int num_partial;
+    /*Set once the NIC was given -1 and has not sent anything since.*/
+    int idle;
+} NIC;
 
 typedef struct
 {
-    ASCII* nics;
+    NIC* nics;
     int num_of_nics;
-} ControllerParams;
+    intcode_scheduler_t* scheduler;
+    Packet nat_packet;
+    int nat_received;
+    size_t num_packets;
+    size_t num_rounds;
+} Network;
+
+int init_nic(NIC* nic, const intcode_t* prog, int64_t address);
+void destroy_nic(NIC* nic);
+void feed_nic(NIC* nic);
+int read_packet(NIC* nic, int64_t* address, Packet* packet);
+int nic_is_idle(const NIC* nic);
 
-/*Thread functions*/
-void* nic_func(void* args);
-void* nat_control(void* args);
+Network* create_network(const intcode_t* prog, int num_of_nics, size_t num_workers);
+void destroy_network(Network* network);
+int run_network(Network* network, int64_t* first_nat_y, int64_t* repeated_nat_y);
 
 #endif /* ifndef INCLUDE_CHALLENGE_LIB_H */
@@ -3,22 +3,21 @@
 
 #include "challenge/packet.h"
 
-typedef struct PacketQueueNode
-{
-    Packet content;
-    struct PacketQueueNode* next;
-} PacketQueueNode;
-
+/*FIFO of packets in a ring buffer, which only grows when it is full.*/
 typedef struct
 {
-    PacketQueueNode* head;
-    PacketQueueNode* tail;
-    int size;
+    Packet* packets;
+    size_t head;
+    size_t size;
+    size_t capacity;
 } PacketQueue;
 
 int queue_is_empty(PacketQueue const* q);
+size_t queue_size(PacketQueue const* q);
 void queue_push(PacketQueue* q, Packet p);
 Packet queue_pop(PacketQueue* q);
+size_t queue_push_bulk(PacketQueue* q, const Packet* packets, size_t count);
+size_t queue_pop_bulk(PacketQueue* q, Packet* packets, size_t count);
 PacketQueue queue_create();
 void queue_destroy(PacketQueue* q);
 
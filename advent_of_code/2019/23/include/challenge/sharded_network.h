@@ -0,0 +1,45 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *
+ */
+
+#ifndef INCLUDE_CHALLENGE_SHARDED_NETWORK_H
+#define INCLUDE_CHALLENGE_SHARDED_NETWORK_H
+
+#include "challenge/challenge_lib.h"
+
+/*NICs are split into blocks of consecutive addresses, one shard per thread.*/
+/*Networks with more NICs than NAT_ADDRESS reach the NAT at num_of_nics, so no NIC is lost.*/
+typedef struct Shard Shard;
+
+typedef struct
+{
+    NIC* nics;
+    int num_of_nics;
+    Shard* shards;
+    int num_shards;
+    int nics_per_shard;
+    int64_t nat_address;
+    /*Shard threads wait at the start until all of them run, only then the barrier exists.*/
+    pthread_mutex_t start_mut;
+    pthread_cond_t start_cond;
+    int start_state;
+    pthread_barrier_t barrier;
+    int64_t first_nat_y;
+    int64_t repeated_nat_y;
+    int result;
+    size_t num_packets;
+    size_t num_rounds;
+    double seconds;
+} ShardedNetwork;
+
+ShardedNetwork* create_sharded_network(const intcode_t* prog, int num_of_nics, int num_shards);
+void destroy_sharded_network(ShardedNetwork* network);
+int inject_packet(ShardedNetwork* network, int64_t address, Packet packet);
+int run_sharded_network(ShardedNetwork* network, int64_t* first_nat_y, int64_t* repeated_nat_y);
+int64_t get_nat_address(int num_of_nics);
+
+intcode_t* create_forwarding_nic(int64_t num_of_nics, int64_t stride);
+
+#endif /* ifndef INCLUDE_CHALLENGE_SHARDED_NETWORK_H */
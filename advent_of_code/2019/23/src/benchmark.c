@@ -0,0 +1,270 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *
+ */
+
+#include "challenge/packet.h"
+#include "challenge/queue.h"
+#include "challenge/sharded_network.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+#include "unistd.h"
+
+#define NUM_QUEUES (50)
+#define DEFAULT_PACKETS (1000000)
+#define BULK_SIZE (32)
+#define DEFAULT_NICS (10000)
+#define DEFAULT_HOPS (100)
+
+/*The linked list the ring buffer replaced, one allocation per packet.*/
+typedef struct ListNode
+{
+    Packet content;
+    struct ListNode* next;
+} ListNode;
+
+typedef struct
+{
+    ListNode* head;
+    ListNode* tail;
+} ListQueue;
+
+static void list_push(ListQueue* q, Packet p)
+{
+    ListNode* node = (ListNode*) malloc(sizeof(ListNode));
+    node->content  = p;
+    node->next     = NULL;
+    if (q->tail)
+    {
+        q->tail->next = node;
+    }
+    else
+    {
+        q->head = node;
+    }
+    q->tail = node;
+}
+
+static Packet list_pop(ListQueue* q)
+{
+    ListNode* node = q->head;
+    Packet p       = node->content;
+    q->head        = node->next;
+    if (q->head == NULL)
+    {
+        q->tail = NULL;
+    }
+    free(node);
+    return p;
+}
+
+static double now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1e9) + now.tv_nsec;
+}
+
+/*Every round pushes a burst into every queue, then drains them, like a packet storm.*/
+static double time_list(const size_t num_packets, const size_t burst, int64_t* const checksum)
+{
+    ListQueue queues[NUM_QUEUES] = {{NULL, NULL}};
+    double start                 = now_ns();
+    for (size_t sent = 0; sent < num_packets; sent += burst * NUM_QUEUES)
+    {
+        for (size_t q = 0; q < NUM_QUEUES; ++q)
+        {
+            for (size_t i = 0; i < burst; ++i)
+            {
+                list_push(&queues[q], (Packet){.x = (int64_t) i, .y = (int64_t) q});
+            }
+        }
+        for (size_t q = 0; q < NUM_QUEUES; ++q)
+        {
+            while (queues[q].head != NULL)
+            {
+                *checksum += list_pop(&queues[q]).x;
+            }
+        }
+    }
+    return now_ns() - start;
+}
+
+static double time_ring(const size_t num_packets, const size_t burst, int64_t* const checksum)
+{
+    PacketQueue queues[NUM_QUEUES];
+    for (size_t q = 0; q < NUM_QUEUES; ++q)
+    {
+        queues[q] = queue_create();
+    }
+    double start = now_ns();
+    for (size_t sent = 0; sent < num_packets; sent += burst * NUM_QUEUES)
+    {
+        for (size_t q = 0; q < NUM_QUEUES; ++q)
+        {
+            for (size_t i = 0; i < burst; ++i)
+            {
+                queue_push(&queues[q], (Packet){.x = (int64_t) i, .y = (int64_t) q});
+            }
+        }
+        for (size_t q = 0; q < NUM_QUEUES; ++q)
+        {
+            while (!queue_is_empty(&queues[q]))
+            {
+                *checksum += queue_pop(&queues[q]).x;
+            }
+        }
+    }
+    double time = now_ns() - start;
+    for (size_t q = 0; q < NUM_QUEUES; ++q)
+    {
+        queue_destroy(&queues[q]);
+    }
+    return time;
+}
+
+static double time_bulk(const size_t num_packets, const size_t burst, int64_t* const checksum)
+{
+    PacketQueue queues[NUM_QUEUES];
+    for (size_t q = 0; q < NUM_QUEUES; ++q)
+    {
+        queues[q] = queue_create();
+    }
+    Packet packets[BULK_SIZE];
+    double start = now_ns();
+    for (size_t sent = 0; sent < num_packets; sent += burst * NUM_QUEUES)
+    {
+        for (size_t q = 0; q < NUM_QUEUES; ++q)
+        {
+            for (size_t i = 0; i < burst; i += BULK_SIZE)
+            {
+                size_t count = ((burst - i) < BULK_SIZE) ? (burst - i) : BULK_SIZE;
+                for (size_t j = 0; j < count; ++j)
+                {
+                    packets[j] = (Packet){.x = (int64_t) (i + j), .y = (int64_t) q};
+                }
+                queue_push_bulk(&queues[q], packets, count);
+            }
+        }
+        for (size_t q = 0; q < NUM_QUEUES; ++q)
+        {
+            size_t count = 0;
+            while ((count = queue_pop_bulk(&queues[q], packets, BULK_SIZE)) > 0)
+            {
+                for (size_t j = 0; j < count; ++j)
+                {
+                    *checksum += packets[j].x;
+                }
+            }
+        }
+    }
+    double time = now_ns() - start;
+    for (size_t q = 0; q < NUM_QUEUES; ++q)
+    {
+        queue_destroy(&queues[q]);
+    }
+    return time;
+}
+
+static void run_queue_benchmark(const size_t num_packets)
+{
+    printf("Queues: %d, packets per run: %zu\n", NUM_QUEUES, num_packets);
+    printf("%8s %12s %12s %12s\n", "burst", "list ns/pkt", "ring ns/pkt", "bulk ns/pkt");
+    for (size_t burst = 1; burst <= 1024; burst *= 4)
+    {
+        /*The checksums keep the compiler from dropping the pops and have to match.*/
+        int64_t checksum[3] = {0, 0, 0};
+        double list         = time_list(num_packets, burst, &checksum[0]);
+        double ring         = time_ring(num_packets, burst, &checksum[1]);
+        double bulk         = time_bulk(num_packets, burst, &checksum[2]);
+        if ((checksum[0] != checksum[1]) || (checksum[0] != checksum[2]))
+        {
+            printf("Queues returned different packets.\n");
+            return;
+        }
+        printf("%8zu %12.2f %12.2f %12.2f\n",
+               burst,
+               list / num_packets,
+               ring / num_packets,
+               bulk / num_packets);
+    }
+}
+
+static void run_network_benchmark(const int num_of_nics, const int64_t hops)
+{
+    /*Every NIC starts with one packet that is forwarded across about half the network.*/
+    long num_cores  = sysconf(_SC_NPROCESSORS_ONLN);
+    intcode_t* prog = create_forwarding_nic(num_of_nics, (num_of_nics / 2) + 1);
+    if (prog == NULL)
+    {
+        return;
+    }
+    printf("Cores: %ld, NICs: %d, hops per packet: %ld\n", num_cores, num_of_nics, hops);
+    printf("%8s %12s %8s %10s %14s %14s\n",
+           "shards",
+           "packets",
+           "rounds",
+           "seconds",
+           "pkts/s",
+           "pkts/s/core");
+    for (int num_shards = 1; (num_shards <= 2 * num_cores) || (num_shards <= 4); num_shards *= 2)
+    {
+        ShardedNetwork* network = create_sharded_network(prog, num_of_nics, num_shards);
+        if (network == NULL)
+        {
+            printf("Error allocating the network.\n");
+            break;
+        }
+        for (int i = 0; i < num_of_nics; ++i)
+        {
+            inject_packet(network, i, (Packet){.x = i, .y = hops});
+        }
+
+        int64_t first_nat_y    = 0;
+        int64_t repeated_nat_y = 0;
+        if (!run_sharded_network(network, &first_nat_y, &repeated_nat_y))
+        {
+            printf("Network did not finish.\n");
+            destroy_sharded_network(network);
+            break;
+        }
+
+        /*Shards beyond the number of cores share them.*/
+        long cores          = (network->num_shards < num_cores) ? network->num_shards : num_cores;
+        double packets_rate = network->num_packets / network->seconds;
+        printf("%8d %12zu %8zu %10.3f %14.0f %14.0f\n",
+               network->num_shards,
+               network->num_packets,
+               network->num_rounds,
+               network->seconds,
+               packets_rate,
+               packets_rate / cores);
+        destroy_sharded_network(network);
+    }
+    destroy_intcode(prog);
+}
+
+int main(int argc, char* argv[])
+{
+    int queue   = (argc < 2) || (strcmp(argv[1], "queue") == 0);
+    int network = (argc < 2) || (strcmp(argv[1], "network") == 0);
+    if (!queue && !network)
+    {
+        printf("Usage: aoc2019_23_benchmark [queue [NUM_PACKETS] | network [NUM_NICS] [HOPS]].\n");
+        return 0;
+    }
+
+    if (queue)
+    {
+        run_queue_benchmark((argc > 2) ? strtoul(argv[2], NULL, 10) : DEFAULT_PACKETS);
+    }
+    if (network)
+    {
+        run_network_benchmark((argc > 2) ? atoi(argv[2]) : DEFAULT_NICS,
+                              (argc > 3) ? strtol(argv[3], NULL, 10) : DEFAULT_HOPS);
+    }
+    return 0;
+}
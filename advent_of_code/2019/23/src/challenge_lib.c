@@ -4,225 +4,247 @@
  *
  */
 
-#include "assert.h"
+#include "challenge/challenge_lib.h"
 #include "challenge/intcode.h"
 #include "stdio.h"
-#include "unistd.h"
-
-#include "challenge/challenge_lib.h"
-#include "challenge/packet.h"
-#include "challenge/queue.h"
 
-#define NAT_ADDRESS (255)
-#define IDLE_ROUNDS (5)
+#define NO_PACKET (-1)
+/*Several packets can be queued in the rings before the NIC has to yield.*/
+#define NIC_INPUT_CAPACITY (64)
+#define NIC_OUTPUT_CAPACITY (96)
 
-static void provide_input(const ASCII* const system, const int64_t value)
+void feed_nic(NIC* const nic)
 {
-    assert(system != NULL);
-    assert(system->brain != NULL);
-    assert(system->brain->mem_io_in != NULL);
-
-    intcode_io_mem_t* input = system->brain->mem_io_in;
-    pthread_mutex_lock(&input->mut);
-    while (!input->consumed && !system->finished)
+    /*Only NICs waiting on an empty ring are fed, so the X and Y of a packet stay together.*/
+    if (!waiting_for_input(nic->brain) || (io_ring_size(nic->input) > 0))
     {
-        pthread_cond_wait(&input->cond, &input->mut);
+        return;
     }
-    input->value    = value;
-    input->consumed = 0;
-    pthread_cond_signal(&input->cond);
-    pthread_mutex_unlock(&input->mut);
-    usleep(10);
-}
-
-static int64_t read_output(const ASCII* const system)
-{
-    assert(robot != NULL);
-    assert(robot->brain != NULL);
-    assert(robot->brain->mem_io_out != NULL);
-
-    int64_t read_value = -1;
-
-    intcode_io_mem_t* output = system->brain->mem_io_out;
-    pthread_mutex_lock(&output->mut);
-    while (output->consumed && !system->finished)
+    if (queue_is_empty(&nic->inbox))
     {
-        pthread_cond_wait(&output->cond, &output->mut);
+        /*Input never blocks, so an empty inbox reads as -1 once, then the NIC is idle.*/
+        if (!nic->idle)
+        {
+            int64_t value = NO_PACKET;
+            io_ring_try_write(nic->input, &value, 1);
+            nic->idle = 1;
+        }
+        return;
     }
 
-    if (!system->finished)
+    /*The ring is empty here, so as many packets as fit are moved in one batch.*/
+    Packet packets[NIC_INPUT_CAPACITY / 2];
+    int64_t values[NIC_INPUT_CAPACITY];
+    size_t space = io_ring_capacity(nic->input) / 2;
+    space        = (space < (NIC_INPUT_CAPACITY / 2)) ? space : (NIC_INPUT_CAPACITY / 2);
+    size_t count = queue_pop_bulk(&nic->inbox, packets, space);
+    for (size_t i = 0; i < count; ++i)
     {
-        read_value       = output->value;
-        output->consumed = 1;
+        values[2 * i]       = packets[i].x;
+        values[(2 * i) + 1] = packets[i].y;
     }
-    pthread_cond_signal(&output->cond);
-    pthread_mutex_unlock(&output->mut);
-
-
-    return read_value;
+    io_ring_try_write(nic->input, values, 2 * count);
 }
 
-static void assign_address(ASCII* nic, const int address)
+int read_packet(NIC* const nic, int64_t* const address, Packet* const packet)
 {
-    assert(system != NULL);
-    assert(system->brain != NULL);
-    while (!waiting_for_input(nic->brain))
+    int64_t value = 0;
+    while (io_ring_try_read(nic->output, &value, 1) == 1)
     {
-        usleep(10);
+        nic->idle = 0;
+        if (nic->num_partial < 2)
+        {
+            nic->partial[nic->num_partial++] = value;
+            continue;
+        }
+        *address         = nic->partial[0];
+        *packet          = (Packet){.x = nic->partial[1], .y = value};
+        nic->num_partial = 0;
+        return 1;
     }
-    provide_input(nic, address);
+    return 0;
 }
 
-static void start_up(ControllerParams* params)
+int init_nic(NIC* const nic, const intcode_t* const prog, const int64_t address)
 {
-    for (int i = 0; i < params->num_of_nics; ++i)
+    /*All NICs share the pages of the program until they write to them.*/
+    nic->brain       = fork_intcode(prog);
+    nic->input       = create_io_ring(NIC_INPUT_CAPACITY);
+    nic->output      = create_io_ring(NIC_OUTPUT_CAPACITY);
+    nic->inbox       = queue_create();
+    nic->num_partial = 0;
+    nic->idle        = 0;
+    if ((nic->brain == NULL) || (nic->input == NULL) || (nic->output == NULL))
     {
-        assign_address(&params->nics[i], i);
+        return 0;
     }
+    set_engine(nic->brain, INT_CODE_ENGINE_THREADED);
+    set_io_mode(nic->brain, INT_CODE_RING_IO);
+    set_ring_io_in(nic->brain, nic->input);
+    set_ring_io_out(nic->brain, nic->output);
+
+    /*Every NIC asks for its address first.*/
+    io_ring_try_write(nic->input, &address, 1);
+    return 1;
 }
 
-static Packet read_packet(const ASCII* const nic_system)
+void destroy_nic(NIC* const nic)
 {
-    int64_t read_x = read_output(nic_system);
-    int64_t read_y = read_output(nic_system);
-    Packet ret     = {.x = read_x, .y = read_y};
-    return ret;
+    if (nic != NULL)
+    {
+        destroy_intcode(nic->brain);
+        destroy_io_ring(nic->input);
+        destroy_io_ring(nic->output);
+        queue_destroy(&nic->inbox);
+    }
 }
 
-static void send_packet(const ASCII* const nic_system, Packet p)
+int nic_is_idle(const NIC* const nic)
 {
-    provide_input(nic_system, p.x);
-    provide_input(nic_system, p.y);
+    return nic->idle && waiting_for_input(nic->brain) && (io_ring_size(nic->input) == 0) &&
+           queue_is_empty(&nic->inbox);
 }
 
-static void send_receive_phase(ControllerParams* params, PacketQueue* queues)
+static void route_packets(Network* const network, NIC* const nic, int* const nat_sent)
 {
-    Packet nat_packet        = {0, 0};
-    int64_t last_nat_value   = 0;
-    int all_systems_finished = 0;
-    int idle_count           = 0;
-    while (!all_systems_finished)
+    int64_t address = 0;
+    Packet packet;
+    while (read_packet(nic, &address, &packet))
     {
-        all_systems_finished    = 1;
-        int no_output_available = 1;
-        int all_queues_empty    = 1;
-        for (int i = 0; i < params->num_of_nics; ++i)
+        network->num_packets++;
+        if (address == NAT_ADDRESS)
         {
-            all_systems_finished = all_systems_finished && params->nics[i].finished;
-            all_queues_empty     = all_queues_empty && queue_is_empty(&queues[i]);
-            if (providing_ouput(params->nics[i].brain))
-            {
-                no_output_available = 0;
-                /*Read address and packet, then add packet to queue for receiver*/
-                int64_t address = read_output(&params->nics[i]);
-                Packet packet   = read_packet(&params->nics[i]);
-                if (address == NAT_ADDRESS)
-                {
-                    /*Received packet for NAT*/
-                    nat_packet = packet;
-
-                    /*Enable for part 1*/
-                    /*printf("Packet for address 255: (X=%ld, Y=%ld).\n", packet.x, packet.y);*/
-                    /*return;*/
-                }
-                else
-                {
-                    assert(address < params->num_of_nics);
-                    queue_push(&queues[address], packet);
-                }
-            }
-            if (waiting_for_input(params->nics[i].brain))
-            {
-                if (queue_is_empty(&queues[i]))
-                {
-                    provide_input(&params->nics[i], -1);
-                }
-                else
-                {
-                    Packet p = queue_pop(&queues[i]);
-                    send_packet(&params->nics[i], p);
-                }
-            }
+            /*The NAT only remembers the last packet.*/
+            network->nat_packet   = packet;
+            network->nat_received = 1;
+            *nat_sent             = 1;
         }
-
-        if (no_output_available && all_queues_empty)
+        else if ((address >= 0) && (address < network->num_of_nics))
         {
-            idle_count++;
-            if (idle_count == IDLE_ROUNDS)
-            {
-                // Send NAT packet to 0
-                printf("Send NAT Package (X=%ld, Y=%ld) to address 0.\n",
-                       nat_packet.x,
-                       nat_packet.y);
-                send_packet(&params->nics[0], nat_packet);
-                idle_count = 0;
-
-                /*Part 2 output*/
-                if (nat_packet.y == last_nat_value)
-                {
-                    printf("The following value was sent twice in a row: %ld\n", last_nat_value);
-                }
-                last_nat_value = nat_packet.y;
-            }
+            NIC* receiver = &network->nics[address];
+            queue_push(&receiver->inbox, packet);
+            receiver->idle = 0;
         }
         else
         {
-            idle_count = 0;
+            printf("Dropped packet for unknown address %ld.\n", address);
         }
     }
 }
 
-void* nic_func(void* args)
+Network* create_network(const intcode_t* const prog,
+                        const int num_of_nics,
+                        const size_t num_workers)
 {
-    if (args == NULL)
+    if ((prog == NULL) || (num_of_nics <= 0))
     {
         return NULL;
     }
-    ASCII* system = (ASCII*) args;
-    int ret       = execute(system->brain);
-    if (ret != INT_CODE_HALT)
+    Network* network = (Network*) malloc(sizeof(Network));
+    if (network == NULL)
     {
-        printf("Programm did not halt as expected. Err code: %d\n", ret);
+        return NULL;
     }
-    else
+    network->nics         = (NIC*) calloc(num_of_nics, sizeof(NIC));
+    network->num_of_nics  = 0;
+    network->scheduler    = create_scheduler(num_workers);
+    network->nat_packet   = (Packet){0, 0};
+    network->nat_received = 0;
+    network->num_packets  = 0;
+    network->num_rounds   = 0;
+    if ((network->nics == NULL) || (network->scheduler == NULL))
     {
-        usleep(1000);
-        system->finished = 1;
+        destroy_network(network);
+        return NULL;
     }
-    return NULL;
+
+    for (int i = 0; i < num_of_nics; ++i)
+    {
+        network->num_of_nics++;
+        if (!init_nic(&network->nics[i], prog, i) ||
+            !schedule_intcode(network->scheduler, network->nics[i].brain))
+        {
+            destroy_network(network);
+            return NULL;
+        }
+    }
+    return network;
 }
 
-void* nat_control(void* args)
+void destroy_network(Network* const network)
 {
-    if (args == NULL)
+    if (network != NULL)
     {
-        return NULL;
+        destroy_scheduler(network->scheduler);
+        for (int i = 0; i < network->num_of_nics; ++i)
+        {
+            destroy_nic(&network->nics[i]);
+        }
+        free(network->nics);
+        free(network);
     }
-    ControllerParams* params = (ControllerParams*) args;
-    /*Give robot some time to setup.*/
-    usleep(3000);
+}
 
-    /*Setup packet queues*/
-    PacketQueue queues[params->num_of_nics];
-    for (int i = 0; i < params->num_of_nics; i++)
+int run_network(Network* const network, int64_t* const first_nat_y, int64_t* const repeated_nat_y)
+{
+    if ((network == NULL) || (first_nat_y == NULL) || (repeated_nat_y == NULL))
     {
-        queues[i] = queue_create();
+        return 0;
     }
 
-    /*Assign addresses*/
-    start_up(params);
+    int first_received     = 0;
+    int nat_delivered      = 0;
+    int64_t last_delivered = 0;
+    while (1)
+    {
+        /*Every NIC runs until it waits for input that is not there yet.*/
+        network->num_rounds++;
+        if (run_scheduler(network->scheduler) == INT_CODE_ERROR)
+        {
+            printf("A NIC failed.\n");
+            return 0;
+        }
 
-    /*Give robot some time to setup.*/
-    usleep(3000);
+        /*Packets are routed in address order, so the result does not depend on the workers.*/
+        int nat_sent = 0;
+        for (int i = 0; i < network->num_of_nics; ++i)
+        {
+            route_packets(network, &network->nics[i], &nat_sent);
+        }
+        if (nat_sent && !first_received)
+        {
+            *first_nat_y   = network->nat_packet.y;
+            first_received = 1;
+        }
 
-    /*Send and receive packages*/
-    send_receive_phase(params, queues);
+        /*Idle once every NIC got -1, sent nothing since and nothing is on its way to it.*/
+        int idle = 1;
+        for (int i = 0; i < network->num_of_nics; ++i)
+        {
+            feed_nic(&network->nics[i]);
+            int halted = (get_scheduled_ret(network->scheduler, i) == INT_CODE_HALT);
+            idle       = idle && (halted || nic_is_idle(&network->nics[i]));
+        }
+        if (!idle)
+        {
+            continue;
+        }
 
-    /*Clean up*/
-    for (int i = 0; i < params->num_of_nics; i++)
-    {
-        queue_destroy(&queues[i]);
+        if (!network->nat_received)
+        {
+            printf("Network is idle, but the NAT has nothing to send.\n");
+            return 0;
+        }
+        if (nat_delivered && (network->nat_packet.y == last_delivered))
+        {
+            *repeated_nat_y = last_delivered;
+            return 1;
+        }
+        NIC* first = &network->nics[0];
+        queue_push(&first->inbox, network->nat_packet);
+        first->idle = 0;
+        feed_nic(first);
+        last_delivered = network->nat_packet.y;
+        nat_delivered  = 1;
     }
-
-    return NULL;
 }
@@ -4,8 +4,6 @@
  *
  */
 
-#include "pthread.h"
-#include "stdbool.h"
 #include "stdio.h"
 #include "stdlib.h"
 
@@ -16,67 +14,35 @@
 
 int main(int argc, char* argv[])
 {
-    if (argc != 2)
+    if ((argc != 2) && (argc != 3))
     {
-        printf("This executabel takes exactly one argument.\n");
-        printf("Usage: aoc2019_23 FILE_PATH.\n");
+        printf("This executabel takes one or two arguments.\n");
+        printf("Usage: aoc2019_23 FILE_PATH [NUM_WORKERS].\n");
         return 0;
     }
 
-    /*Initialize the program.*/
-    intcode_t* prog = read_intcode(argv[1]);
-
-    ASCII nics[NUMBER_OF_NICS];
-    nics[0].brain = prog;
-
-    /*Create 49 other copies*/
-    for (int i = 0; i < NUMBER_OF_NICS; ++i)
+    /*Initialize the program, every NIC runs on a fork of it.*/
+    intcode_t* prog    = read_intcode(argv[1]);
+    size_t num_workers = (argc == 3) ? strtoul(argv[2], NULL, 10) : 0;
+    Network* network   = create_network(prog, NUMBER_OF_NICS, num_workers);
+    if ((prog == NULL) || (network == NULL))
     {
-        if (i != 0)
-        {
-            nics[i].brain = copy_intcode(prog);
-        }
-        nics[i].finished = 0;
-
-        /*Create IO memory*/
-        intcode_io_mem_t* io_in  = create_io_mem();
-        intcode_io_mem_t* io_out = create_io_mem();
-        if ((nics[i].brain == NULL) || (io_in == NULL) || (io_out == NULL))
-        {
-            printf("Error reading programm or allocating IO memory\n");
-            return 0;
-        }
-        set_io_mode(nics[i].brain, INT_CODE_MEM_IO);
-        set_mem_io_in(nics[i].brain, io_in);
-        set_mem_io_out(nics[i].brain, io_out);
-    }
-
-    ControllerParams params = {nics, NUMBER_OF_NICS};
-
-    pthread_t controller = 0;
-    pthread_create(&controller, NULL, nat_control, &params);
-
-    // Start NIC threads
-    pthread_t nic_threads[NUMBER_OF_NICS];
-    for (int i = 0; i < NUMBER_OF_NICS; ++i)
-    {
-        nic_threads[i] = 0;
-        pthread_create(&nic_threads[i], NULL, nic_func, &nics[i]);
+        printf("Error reading programm or allocating IO memory\n");
+        destroy_intcode(prog);
+        return 0;
     }
 
-    /*Wait for threads to finish.*/
-    for (int i = 0; i < NUMBER_OF_NICS; ++i)
+    int64_t first_nat_y    = 0;
+    int64_t repeated_nat_y = 0;
+    if (run_network(network, &first_nat_y, &repeated_nat_y))
     {
-        pthread_join(nic_threads[i], NULL);
+        printf("Packet for address 255: Y=%ld.\n", first_nat_y);
+        printf("The following value was sent twice in a row: %ld\n", repeated_nat_y);
+        printf("Packets: %zu, rounds: %zu\n", network->num_packets, network->num_rounds);
     }
-    pthread_join(controller, NULL);
-
 
     /*Clean Up*/
-    for (int i = 0; i < NUMBER_OF_NICS; ++i)
-    {
-        destroy_intcode(nics[i].brain);
-    }
-
+    destroy_network(network);
+    destroy_intcode(prog);
     return 0;
 }
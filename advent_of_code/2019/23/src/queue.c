@@ -1,25 +1,43 @@
 #include "challenge/queue.h"
 #include "assert.h"
 #include "challenge/packet.h"
+#include "string.h"
 
-static PacketQueueNode* create_node(Packet p)
+#define QUEUE_INITIAL_CAPACITY (16u)
+
+/*The capacity is a power of two, so positions wrap with a mask.*/
+static int reserve(PacketQueue* q, size_t count)
 {
-    PacketQueueNode* created = (PacketQueueNode*) malloc(sizeof(PacketQueueNode));
-    assert(created != NULL);
-    if (created)
+    size_t needed = q->size + count;
+    if (needed <= q->capacity)
     {
-        created->content = p;
-        created->next    = NULL;
+        return 1;
+    }
+    size_t capacity = (q->capacity > 0) ? q->capacity : QUEUE_INITIAL_CAPACITY;
+    while (capacity < needed)
+    {
+        capacity *= 2;
+    }
+    Packet* packets = (Packet*) malloc(sizeof(Packet) * capacity);
+    assert(packets != NULL);
+    if (packets == NULL)
+    {
+        return 0;
     }
-    return created;
-}
 
-static void destroy_node(PacketQueueNode* node)
-{
-    if (node)
+    /*Unwrap the queued packets to the front of the new buffer.*/
+    size_t first = q->capacity - q->head;
+    first        = (first < q->size) ? first : q->size;
+    if (q->size > 0)
     {
-        free(node);
+        memcpy(packets, q->packets + q->head, sizeof(Packet) * first);
+        memcpy(packets + first, q->packets, sizeof(Packet) * (q->size - first));
     }
+    free(q->packets);
+    q->packets  = packets;
+    q->head     = 0;
+    q->capacity = capacity;
+    return 1;
 }
 
 int queue_is_empty(PacketQueue const* q)
@@ -31,23 +49,17 @@ int queue_is_empty(PacketQueue const* q)
     return 1;
 }
 
+size_t queue_size(PacketQueue const* q)
+{
+    return q ? q->size : 0;
+}
+
 void queue_push(PacketQueue* q, Packet p)
 {
-    if (q)
+    if (q && reserve(q, 1))
     {
-        PacketQueueNode* new_node = create_node(p);
-        if (queue_is_empty(q))
-        {
-            q->head = new_node;
-            q->tail = new_node;
-            q->size = 1;
-        }
-        else
-        {
-            q->tail->next = new_node;
-            q->tail       = new_node;
-            q->size++;
-        }
+        q->packets[(q->head + q->size) & (q->capacity - 1)] = p;
+        q->size++;
     }
 }
 
@@ -56,47 +68,60 @@ Packet queue_pop(PacketQueue* q)
     Packet p = {0, 0};
     if (!queue_is_empty(q))
     {
-        PacketQueueNode* first = q->head;
-        p                      = first->content;
-        if (first->next)
-        {
-            q->head = first->next;
-            q->size--;
-        }
-        else
-        {
-            // queue had no other nodes and is now empty
-            q->head = NULL;
-            q->tail = NULL;
-            q->size = 0;
-        }
-        destroy_node(first);
+        p       = q->packets[q->head];
+        q->head = (q->head + 1) & (q->capacity - 1);
+        q->size--;
     }
-
     return p;
 }
 
+size_t queue_push_bulk(PacketQueue* q, const Packet* packets, size_t count)
+{
+    if (!q || !packets || (count == 0) || !reserve(q, count))
+    {
+        return 0;
+    }
+
+    /*At most two copies, before and after the end of the buffer.*/
+    size_t tail  = (q->head + q->size) & (q->capacity - 1);
+    size_t first = q->capacity - tail;
+    first        = (first < count) ? first : count;
+    memcpy(q->packets + tail, packets, sizeof(Packet) * first);
+    memcpy(q->packets, packets + first, sizeof(Packet) * (count - first));
+    q->size += count;
+    return count;
+}
+
+size_t queue_pop_bulk(PacketQueue* q, Packet* packets, size_t count)
+{
+    if (!q || !packets)
+    {
+        return 0;
+    }
+    count        = (count < q->size) ? count : q->size;
+    size_t first = q->capacity - q->head;
+    first        = (first < count) ? first : count;
+    if (count > 0)
+    {
+        memcpy(packets, q->packets + q->head, sizeof(Packet) * first);
+        memcpy(packets + first, q->packets, sizeof(Packet) * (count - first));
+        q->head = (q->head + count) & (q->capacity - 1);
+        q->size -= count;
+    }
+    return count;
+}
+
 PacketQueue queue_create()
 {
-    PacketQueue q = {.head = NULL, .tail = NULL, .size = 0};
+    PacketQueue q = {.packets = NULL, .head = 0, .size = 0, .capacity = 0};
     return q;
 }
+
 void queue_destroy(PacketQueue* q)
 {
     if (q)
     {
-        if (!queue_is_empty(q))
-        {
-            PacketQueueNode* current = q->head;
-            PacketQueueNode* next    = q->head->next;
-
-            destroy_node(current);
-            while (next)
-            {
-                current = next;
-                next    = current->next;
-                destroy_node(current);
-            }
-        }
+        free(q->packets);
+        *q = queue_create();
     }
 }
@@ -0,0 +1,538 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *
+ */
+
+#include "challenge/sharded_network.h"
+#include "stdatomic.h"
+#include "stdio.h"
+#include "string.h"
+#include "time.h"
+
+#define SHARD_CACHE_LINE (64u)
+#define BATCH_INITIAL_CAPACITY (64u)
+
+#define START_WAITING (0)
+#define START_RUNNING (1)
+#define START_ABORTED (2)
+
+typedef struct
+{
+    int64_t address;
+    Packet packet;
+} RoutedPacket;
+
+/*All packets one shard sends to another in a round, so there is one allocation per round.*/
+typedef struct RoutedBatch
+{
+    struct RoutedBatch* next;
+    int source;
+    size_t count;
+    size_t capacity;
+    RoutedPacket packets[];
+} RoutedBatch;
+
+/*Written by a shard before the second barrier of a round, read by all shards after it.*/
+typedef struct
+{
+    int idle;
+    int failed;
+    size_t sent;
+    size_t received;
+    int nat_received;
+    Packet nat_first;
+    Packet nat_last;
+} ShardReport;
+
+struct Shard
+{
+    /*Stack of batches from other shards, pushed by any shard and taken by the owner.*/
+    _Alignas(SHARD_CACHE_LINE) _Atomic(RoutedBatch*) inbound;
+    _Alignas(SHARD_CACHE_LINE) ShardedNetwork* network;
+    int index;
+    int first_nic;
+    int num_nics;
+    intcode_scheduler_t* scheduler;
+    /*Batches being filled for every other shard, and the ones taken from the inbound stack.*/
+    RoutedBatch** outbox;
+    RoutedBatch** drained;
+    ShardReport report;
+    /*Collected while routing, only published after the next barrier.*/
+    ShardReport pending;
+    size_t num_packets;
+    size_t num_rounds;
+    /*Every shard keeps the NAT state and makes the same decisions from the same reports.*/
+    int first_received;
+    int nat_valid;
+    Packet nat_packet;
+    int nat_delivered;
+    int64_t last_delivered;
+    pthread_t thread;
+};
+
+static void* shard_func(void* args);
+
+static int shard_of(const ShardedNetwork* const network, const int64_t address)
+{
+    return (int) (address / network->nics_per_shard);
+}
+
+static double now_seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+ShardedNetwork* create_sharded_network(const intcode_t* const prog,
+                                       const int num_of_nics,
+                                       int num_shards)
+{
+    if ((prog == NULL) || (num_of_nics <= 0) || (num_shards <= 0))
+    {
+        return NULL;
+    }
+    ShardedNetwork* network = (ShardedNetwork*) malloc(sizeof(ShardedNetwork));
+    if (network == NULL)
+    {
+        return NULL;
+    }
+    pthread_mutex_init(&network->start_mut, NULL);
+    pthread_cond_init(&network->start_cond, NULL);
+    network->start_state = START_WAITING;
+    network->nat_address = get_nat_address(num_of_nics);
+
+    /*Every shard gets at least one NIC.*/
+    network->nics_per_shard = (num_of_nics + num_shards - 1) / num_shards;
+    num_shards              = (num_of_nics + network->nics_per_shard - 1) / network->nics_per_shard;
+    network->nics           = (NIC*) calloc(num_of_nics, sizeof(NIC));
+    network->num_of_nics    = 0;
+    network->shards         = (Shard*) aligned_alloc(SHARD_CACHE_LINE, sizeof(Shard) * num_shards);
+    network->num_shards     = 0;
+    network->first_nat_y    = 0;
+    network->repeated_nat_y = 0;
+    network->result         = 0;
+    network->num_packets    = 0;
+    network->num_rounds     = 0;
+    network->seconds        = 0.0;
+    if ((network->nics == NULL) || (network->shards == NULL))
+    {
+        free(network->shards);
+        network->shards = NULL;
+        destroy_sharded_network(network);
+        return NULL;
+    }
+    memset(network->shards, 0, sizeof(Shard) * num_shards);
+
+    for (int s = 0; s < num_shards; ++s)
+    {
+        Shard* shard = &network->shards[s];
+        atomic_init(&shard->inbound, NULL);
+        shard->network   = network;
+        shard->index     = s;
+        shard->first_nic = s * network->nics_per_shard;
+        shard->num_nics  = num_of_nics - shard->first_nic;
+        shard->num_nics  = (shard->num_nics < network->nics_per_shard) ? shard->num_nics
+                                                                       : network->nics_per_shard;
+        /*The shard thread runs its NICs itself.*/
+        shard->scheduler = create_scheduler(0);
+        shard->outbox    = (RoutedBatch**) calloc(num_shards, sizeof(RoutedBatch*));
+        shard->drained   = (RoutedBatch**) calloc(num_shards, sizeof(RoutedBatch*));
+        network->num_shards++;
+        if ((shard->scheduler == NULL) || (shard->outbox == NULL) || (shard->drained == NULL))
+        {
+            destroy_sharded_network(network);
+            return NULL;
+        }
+
+        for (int i = shard->first_nic; i < (shard->first_nic + shard->num_nics); ++i)
+        {
+            network->num_of_nics++;
+            if (!init_nic(&network->nics[i], prog, i) ||
+                !schedule_intcode(shard->scheduler, network->nics[i].brain))
+            {
+                destroy_sharded_network(network);
+                return NULL;
+            }
+        }
+    }
+    return network;
+}
+
+void destroy_sharded_network(ShardedNetwork* const network)
+{
+    if (network != NULL)
+    {
+        for (int s = 0; s < network->num_shards; ++s)
+        {
+            Shard* shard = &network->shards[s];
+            destroy_scheduler(shard->scheduler);
+            RoutedBatch* batch = atomic_load(&shard->inbound);
+            while (batch != NULL)
+            {
+                RoutedBatch* next = batch->next;
+                free(batch);
+                batch = next;
+            }
+            for (int i = 0; (shard->outbox != NULL) && (i < network->num_shards); ++i)
+            {
+                free(shard->outbox[i]);
+            }
+            free(shard->outbox);
+            free(shard->drained);
+        }
+        pthread_mutex_destroy(&network->start_mut);
+        pthread_cond_destroy(&network->start_cond);
+        for (int i = 0; i < network->num_of_nics; ++i)
+        {
+            destroy_nic(&network->nics[i]);
+        }
+        free(network->shards);
+        free(network->nics);
+        free(network);
+    }
+}
+
+int inject_packet(ShardedNetwork* const network, const int64_t address, const Packet packet)
+{
+    if ((network == NULL) || (address < 0) || (address >= network->num_of_nics))
+    {
+        return 0;
+    }
+    queue_push(&network->nics[address].inbox, packet);
+    network->nics[address].idle = 0;
+    return 1;
+}
+
+int run_sharded_network(ShardedNetwork* const network,
+                        int64_t* const first_nat_y,
+                        int64_t* const repeated_nat_y)
+{
+    if ((network == NULL) || (first_nat_y == NULL) || (repeated_nat_y == NULL))
+    {
+        return 0;
+    }
+
+    /*The first shard runs on the calling thread.*/
+    double start         = now_seconds();
+    int started          = 1;
+    network->start_state = START_WAITING;
+    for (int s = 1; s < network->num_shards; ++s)
+    {
+        if (pthread_create(&network->shards[s].thread, NULL, shard_func, &network->shards[s]) != 0)
+        {
+            printf("Could not start shard %d.\n", s);
+            break;
+        }
+        started++;
+    }
+
+    /*The barrier counts all shards, without every thread the started ones are sent home.*/
+    int ready = (started == network->num_shards) &&
+                (pthread_barrier_init(&network->barrier, NULL, network->num_shards) == 0);
+    pthread_mutex_lock(&network->start_mut);
+    network->start_state = ready ? START_RUNNING : START_ABORTED;
+    pthread_cond_broadcast(&network->start_cond);
+    pthread_mutex_unlock(&network->start_mut);
+    if (ready)
+    {
+        shard_func(&network->shards[0]);
+    }
+    for (int s = 1; s < started; ++s)
+    {
+        pthread_join(network->shards[s].thread, NULL);
+    }
+    if (!ready)
+    {
+        return 0;
+    }
+    pthread_barrier_destroy(&network->barrier);
+    network->seconds = now_seconds() - start;
+
+    network->num_packets = 0;
+    for (int s = 0; s < network->num_shards; ++s)
+    {
+        network->num_packets += network->shards[s].num_packets;
+    }
+    network->num_rounds = network->shards[0].num_rounds;
+    *first_nat_y        = network->first_nat_y;
+    *repeated_nat_y     = network->repeated_nat_y;
+    return network->result;
+}
+
+int64_t get_nat_address(const int num_of_nics)
+{
+    return (num_of_nics > NAT_ADDRESS) ? num_of_nics : NAT_ADDRESS;
+}
+
+intcode_t* create_forwarding_nic(const int64_t num_of_nics, const int64_t stride)
+{
+    /*Reads its address, then forwards every packet (x, y) with y > 0 as (x', y - 1) to
+     * x' = (x + stride) mod num_of_nics. Packets with y = 0 are sent to the NAT.*/
+    const int64_t content[] = {3,    53, 3,  54, 1008, 54, -1, 56, 1005, 56, 2,  3,
+                               55,   1005, 55, 25, 104, 255, 4, 54, 4,    55, 1105, 1,
+                               2,    1001, 54, 0,  57,  1007, 57, 0, 56,   1005, 56, 40,
+                               1001, 57,   0,  57, 1001, 55, -1, 55, 4,    57, 4,  57,
+                               4,    55,   1105, 1, 2, 0, 0, 0, 0, 0};
+    const size_t nums       = sizeof(content) / sizeof(content[0]);
+    if ((num_of_nics <= 0) || (stride < 0) || (stride >= num_of_nics))
+    {
+        return NULL;
+    }
+    int64_t* memory = (int64_t*) malloc(sizeof(content));
+    if (memory == NULL)
+    {
+        return NULL;
+    }
+    memcpy(memory, content, sizeof(content));
+    memory[17] = get_nat_address(num_of_nics);
+    memory[27] = stride;
+    memory[31] = num_of_nics;
+    memory[38] = -num_of_nics;
+    return create_intcode(memory, nums);
+}
+
+static void push_inbound(Shard* const shard, RoutedBatch* const batch)
+{
+    RoutedBatch* head = atomic_load_explicit(&shard->inbound, memory_order_relaxed);
+    do
+    {
+        batch->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(
+        &shard->inbound, &head, batch, memory_order_release, memory_order_relaxed));
+}
+
+static void drain_inbound(Shard* const shard)
+{
+    ShardedNetwork* network = shard->network;
+    RoutedBatch* batch = atomic_exchange_explicit(&shard->inbound, NULL, memory_order_acquire);
+
+    /*Every shard sends at most one batch per round, ordered by sender they are delivered in
+     * the same order no matter which thread was first.*/
+    int count = 0;
+    while ((batch != NULL) && (count < network->num_shards))
+    {
+        RoutedBatch* next = batch->next;
+        int i             = count++;
+        while ((i > 0) && (shard->drained[i - 1]->source > batch->source))
+        {
+            shard->drained[i] = shard->drained[i - 1];
+            i--;
+        }
+        shard->drained[i] = batch;
+        batch             = next;
+    }
+
+    for (int b = 0; b < count; ++b)
+    {
+        batch = shard->drained[b];
+        for (size_t i = 0; i < batch->count; ++i)
+        {
+            NIC* receiver = &network->nics[batch->packets[i].address];
+            queue_push(&receiver->inbox, batch->packets[i].packet);
+            receiver->idle = 0;
+        }
+        shard->pending.received += batch->count;
+        free(batch);
+    }
+}
+
+static int send_remote(Shard* const shard, const int owner, const int64_t address, Packet packet)
+{
+    RoutedBatch* batch = shard->outbox[owner];
+    if ((batch == NULL) || (batch->count == batch->capacity))
+    {
+        /*Not published yet, so the batch can still move.*/
+        size_t capacity = (batch != NULL) ? (batch->capacity * 2) : BATCH_INITIAL_CAPACITY;
+        RoutedBatch* grown =
+            (RoutedBatch*) realloc(batch, sizeof(RoutedBatch) + (sizeof(RoutedPacket) * capacity));
+        if (grown == NULL)
+        {
+            return 0;
+        }
+        if (batch == NULL)
+        {
+            grown->source = shard->index;
+            grown->count  = 0;
+        }
+        grown->capacity      = capacity;
+        shard->outbox[owner] = grown;
+        batch                = grown;
+    }
+    batch->packets[batch->count++] = (RoutedPacket){.address = address, .packet = packet};
+    return 1;
+}
+
+static void route_shard(Shard* const shard)
+{
+    ShardedNetwork* network = shard->network;
+    for (int i = shard->first_nic; i < (shard->first_nic + shard->num_nics); ++i)
+    {
+        int64_t address = 0;
+        Packet packet;
+        while (read_packet(&network->nics[i], &address, &packet))
+        {
+            shard->num_packets++;
+            if (address == network->nat_address)
+            {
+                if (!shard->pending.nat_received)
+                {
+                    shard->pending.nat_first = packet;
+                }
+                shard->pending.nat_last     = packet;
+                shard->pending.nat_received = 1;
+            }
+            else if ((address < 0) || (address >= network->num_of_nics))
+            {
+                printf("Dropped packet for unknown address %ld.\n", address);
+            }
+            else if (shard_of(network, address) == shard->index)
+            {
+                queue_push(&network->nics[address].inbox, packet);
+                network->nics[address].idle = 0;
+            }
+            else if (!send_remote(shard, shard_of(network, address), address, packet))
+            {
+                shard->pending.failed = 1;
+            }
+        }
+    }
+
+    for (int s = 0; s < network->num_shards; ++s)
+    {
+        if (shard->outbox[s] != NULL)
+        {
+            shard->pending.sent += shard->outbox[s]->count;
+            push_inbound(&network->shards[s], shard->outbox[s]);
+            shard->outbox[s] = NULL;
+        }
+    }
+}
+
+/*Every shard comes to the same result, so no further round trip is needed.*/
+static int decide(Shard* const shard)
+{
+    ShardedNetwork* network = shard->network;
+    int idle                = 1;
+    int failed              = 0;
+    size_t sent             = 0;
+    size_t received         = 0;
+    int first_nat           = -1;
+    int last_nat            = -1;
+    for (int s = 0; s < network->num_shards; ++s)
+    {
+        const ShardReport* report = &network->shards[s].report;
+        idle                      = idle && report->idle;
+        failed                    = failed || report->failed;
+        sent += report->sent;
+        received += report->received;
+        if (report->nat_received)
+        {
+            first_nat = (first_nat < 0) ? s : first_nat;
+            last_nat  = s;
+        }
+    }
+
+    if (first_nat >= 0)
+    {
+        if (!shard->first_received && (shard->index == 0))
+        {
+            network->first_nat_y = network->shards[first_nat].report.nat_first.y;
+        }
+        shard->first_received = 1;
+        shard->nat_packet = network->shards[last_nat].report.nat_last;
+        shard->nat_valid  = 1;
+    }
+    if (failed)
+    {
+        return 0;
+    }
+
+    /*Quiescent once no shard has work left and every packet sent between shards arrived.*/
+    if (!idle || (sent != received))
+    {
+        return 1;
+    }
+    if (!shard->nat_valid)
+    {
+        if (shard->index == 0)
+        {
+            printf("Network is idle, but the NAT has nothing to send.\n");
+        }
+        return 0;
+    }
+    if (shard->nat_delivered && (shard->nat_packet.y == shard->last_delivered))
+    {
+        if (shard->index == 0)
+        {
+            network->repeated_nat_y = shard->last_delivered;
+            network->result         = 1;
+        }
+        return 0;
+    }
+
+    /*Only the owner of address 0 touches its NIC.*/
+    if (shard_of(network, 0) == shard->index)
+    {
+        NIC* first = &network->nics[0];
+        queue_push(&first->inbox, shard->nat_packet);
+        first->idle = 0;
+        feed_nic(first);
+    }
+    shard->last_delivered = shard->nat_packet.y;
+    shard->nat_delivered  = 1;
+    return 1;
+}
+
+static void* shard_func(void* args)
+{
+    Shard* shard            = (Shard*) args;
+    ShardedNetwork* network = shard->network;
+    pthread_mutex_lock(&network->start_mut);
+    while (network->start_state == START_WAITING)
+    {
+        pthread_cond_wait(&network->start_cond, &network->start_mut);
+    }
+    int aborted = (network->start_state == START_ABORTED);
+    pthread_mutex_unlock(&network->start_mut);
+    if (aborted)
+    {
+        return NULL;
+    }
+
+    while (1)
+    {
+        /*After this barrier every batch of the last round has been pushed.*/
+        pthread_barrier_wait(&network->barrier);
+        drain_inbound(shard);
+
+        int idle = 1;
+        for (int i = 0; i < shard->num_nics; ++i)
+        {
+            NIC* nic = &network->nics[shard->first_nic + i];
+            feed_nic(nic);
+            int halted = (get_scheduled_ret(shard->scheduler, i) == INT_CODE_HALT);
+            idle       = idle && (halted || nic_is_idle(nic));
+        }
+        shard->pending.idle         = idle;
+        shard->report               = shard->pending;
+        shard->pending.nat_received = 0;
+        pthread_barrier_wait(&network->barrier);
+
+        shard->num_rounds++;
+        if (!decide(shard))
+        {
+            break;
+        }
+
+        /*Every NIC of the shard runs until it waits for input that is not there yet.*/
+        if (run_scheduler(shard->scheduler) == INT_CODE_ERROR)
+        {
+            printf("A NIC in shard %d failed.\n", shard->index);
+            shard->pending.failed = 1;
+        }
+        route_shard(shard);
+    }
+    return NULL;
+}
@@ -27,3 +27,57 @@ TEST_F(challenge_test, pos_test_01)
     bool ret = true;
     ASSERT_TRUE(ret);
 }
+
+class network_test : public ::testing::TestWithParam<size_t>
+{
+  protected:
+    void SetUp() override { prog = read_intcode("input.txt"); }
+
+    void TearDown() override { destroy_intcode(prog); }
+
+    intcode_t* prog = NULL;
+};
+
+TEST_P(network_test, run_network_01)
+{
+    ASSERT_TRUE(prog != NULL);
+    Network* network = create_network(prog, 50, GetParam());
+    ASSERT_TRUE(network != NULL);
+
+    int64_t first_nat_y    = 0;
+    int64_t repeated_nat_y = 0;
+    ASSERT_TRUE(run_network(network, &first_nat_y, &repeated_nat_y));
+    ASSERT_EQ(first_nat_y, 17740);
+    ASSERT_EQ(repeated_nat_y, 12567);
+
+    /*Routing does not depend on the workers, so neither do the statistics.*/
+    ASSERT_EQ(network->num_packets, 619);
+    ASSERT_EQ(network->num_rounds, 125);
+    destroy_network(network);
+}
+
+TEST_P(network_test, idle_without_nat_01)
+{
+    /*Reads its address, then polls forever without sending anything.*/
+    int64_t content[] = {3, 7, 3, 7, 1105, 1, 2, 0};
+    int64_t* memory   = (int64_t*) malloc(sizeof(content));
+    for (size_t i = 0; i < 8; ++i)
+    {
+        memory[i] = content[i];
+    }
+    intcode_t* silent = create_intcode(memory, 8);
+    Network* network  = create_network(silent, 4, GetParam());
+    ASSERT_TRUE(network != NULL);
+
+    /*The network is idle right away and the NAT has nothing to resume it with.*/
+    int64_t first_nat_y    = 0;
+    int64_t repeated_nat_y = 0;
+    testing::internal::CaptureStdout();
+    ASSERT_FALSE(run_network(network, &first_nat_y, &repeated_nat_y));
+    testing::internal::GetCapturedStdout();
+    ASSERT_EQ(network->num_packets, 0);
+    destroy_network(network);
+    destroy_intcode(silent);
+}
+
+INSTANTIATE_TEST_SUITE_P(workers, network_test, ::testing::Values(0, 1, 4));
@@ -0,0 +1,80 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *
+ */
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+extern "C" {
+#include "challenge/queue.h"
+}
+
+TEST(queue_test, push_pop_01)
+{
+    PacketQueue q = queue_create();
+    ASSERT_TRUE(queue_is_empty(&q));
+
+    /*Interleaving keeps the head moving, so the buffer wraps and grows while wrapped.*/
+    int64_t pushed = 0;
+    int64_t popped = 0;
+    for (int round = 0; round < 100; ++round)
+    {
+        for (int i = 0; i < 7; ++i)
+        {
+            queue_push(&q, Packet{pushed, -pushed});
+            pushed++;
+        }
+        for (int i = 0; i < 5; ++i)
+        {
+            Packet p = queue_pop(&q);
+            ASSERT_EQ(p.x, popped);
+            ASSERT_EQ(p.y, -popped);
+            popped++;
+        }
+        ASSERT_EQ(queue_size(&q), pushed - popped);
+    }
+    while (!queue_is_empty(&q))
+    {
+        ASSERT_EQ(queue_pop(&q).x, popped++);
+    }
+    ASSERT_EQ(popped, pushed);
+
+    /*Popping an empty queue returns an empty packet.*/
+    Packet p = queue_pop(&q);
+    ASSERT_EQ(p.x, 0);
+    ASSERT_EQ(p.y, 0);
+    queue_destroy(&q);
+}
+
+TEST(queue_test, bulk_01)
+{
+    PacketQueue q = queue_create();
+    std::vector<Packet> packets(40);
+    std::vector<Packet> read(40);
+    for (size_t i = 0; i < packets.size(); ++i)
+    {
+        packets[i] = Packet{(int64_t) i, (int64_t) (2 * i)};
+    }
+
+    /*Move the head close to the end of the buffer, then push across it.*/
+    ASSERT_EQ(queue_push_bulk(&q, packets.data(), 12), 12);
+    ASSERT_EQ(queue_pop_bulk(&q, read.data(), 12), 12);
+    ASSERT_EQ(queue_push_bulk(&q, packets.data(), 10), 10);
+    ASSERT_EQ(queue_pop_bulk(&q, read.data(), 3), 3);
+    ASSERT_EQ(read[2].x, 2);
+
+    /*Grows while wrapped, the order is kept.*/
+    ASSERT_EQ(queue_push_bulk(&q, packets.data() + 10, 30), 30);
+    ASSERT_EQ(queue_size(&q), 37);
+    ASSERT_EQ(queue_pop_bulk(&q, read.data(), 100), 37);
+    for (size_t i = 0; i < 37; ++i)
+    {
+        ASSERT_EQ(read[i].x, (int64_t) (i + 3));
+        ASSERT_EQ(read[i].y, (int64_t) (2 * (i + 3)));
+    }
+    ASSERT_EQ(queue_pop_bulk(&q, read.data(), 1), 0);
+    queue_destroy(&q);
+}
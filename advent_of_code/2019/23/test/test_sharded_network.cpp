@@ -0,0 +1,88 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *
+ */
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "challenge/sharded_network.h"
+}
+
+class sharded_network_test : public ::testing::TestWithParam<int>
+{
+};
+
+TEST_P(sharded_network_test, run_input_01)
+{
+    intcode_t* prog = read_intcode("input.txt");
+    ASSERT_TRUE(prog != NULL);
+    ShardedNetwork* network = create_sharded_network(prog, 50, GetParam());
+    ASSERT_TRUE(network != NULL);
+
+    int64_t first_nat_y    = 0;
+    int64_t repeated_nat_y = 0;
+    ASSERT_TRUE(run_sharded_network(network, &first_nat_y, &repeated_nat_y));
+    ASSERT_EQ(first_nat_y, 17740);
+    ASSERT_EQ(repeated_nat_y, 12567);
+
+    /*Batches are delivered in sender order, so the shards do not change the traffic.*/
+    ASSERT_EQ(network->num_packets, 619);
+    ASSERT_EQ(network->num_rounds, 126);
+    destroy_sharded_network(network);
+    destroy_intcode(prog);
+}
+
+TEST_P(sharded_network_test, forwarding_01)
+{
+    /*Every packet is forwarded ten times, then reported to the NAT.*/
+    const int num_of_nics = 200;
+    const int64_t hops    = 10;
+    intcode_t* prog       = create_forwarding_nic(num_of_nics, 77);
+    ASSERT_TRUE(prog != NULL);
+    ShardedNetwork* network = create_sharded_network(prog, num_of_nics, GetParam());
+    ASSERT_TRUE(network != NULL);
+    for (int i = 0; i < num_of_nics; ++i)
+    {
+        ASSERT_TRUE(inject_packet(network, i, Packet{i, hops}));
+    }
+    ASSERT_FALSE(inject_packet(network, num_of_nics, Packet{0, 0}));
+
+    /*The NAT resumes address 0 with a packet that goes straight back to it.*/
+    int64_t first_nat_y    = -1;
+    int64_t repeated_nat_y = -1;
+    ASSERT_TRUE(run_sharded_network(network, &first_nat_y, &repeated_nat_y));
+    ASSERT_EQ(first_nat_y, 0);
+    ASSERT_EQ(repeated_nat_y, 0);
+    ASSERT_EQ(network->num_packets, (num_of_nics * (hops + 1)) + 1);
+    destroy_sharded_network(network);
+    destroy_intcode(prog);
+}
+
+TEST_P(sharded_network_test, forwarding_02)
+{
+    /*More NICs than NAT_ADDRESS, NIC 255 gets its packets and the NAT is moved behind the NICs.*/
+    const int num_of_nics = 300;
+    const int64_t hops    = 10;
+    ASSERT_EQ(get_nat_address(num_of_nics), num_of_nics);
+    intcode_t* prog = create_forwarding_nic(num_of_nics, 77);
+    ASSERT_TRUE(prog != NULL);
+    ShardedNetwork* network = create_sharded_network(prog, num_of_nics, GetParam());
+    ASSERT_TRUE(network != NULL);
+    for (int i = 0; i < num_of_nics; ++i)
+    {
+        ASSERT_TRUE(inject_packet(network, i, Packet{i, hops}));
+    }
+
+    int64_t first_nat_y    = -1;
+    int64_t repeated_nat_y = -1;
+    ASSERT_TRUE(run_sharded_network(network, &first_nat_y, &repeated_nat_y));
+    ASSERT_EQ(first_nat_y, 0);
+    ASSERT_EQ(repeated_nat_y, 0);
+    ASSERT_EQ(network->num_packets, (num_of_nics * (hops + 1)) + 1);
+    destroy_sharded_network(network);
+    destroy_intcode(prog);
+}
+
+INSTANTIATE_TEST_SUITE_P(shards, sharded_network_test, ::testing::Values(1, 2, 3, 7, 500));
@@ -8,10 +8,12 @@
 #define INCLUDE_CHALLENGE_LIB_H
 
 #include "challenge/intcode.h"
+#include "challenge/intcode_scheduler.h"
 
 typedef struct
 {
     intcode_t* brain;
+    intcode_scheduler_t* scheduler;
     int finished;
 } ASCII;
 
@@ -23,8 +25,7 @@ typedef struct {
   int verbose;
 } ControlParams;
 
-void* drone_func(void* args);
-void* control_func(void* args);
+void run_drone(ControlParams* control_params);
 
 
 #endif /* ifndef INCLUDE_CHALLENGE_LIB_H */
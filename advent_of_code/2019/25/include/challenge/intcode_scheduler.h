@@ -0,0 +1,25 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *  Date: 2020-05-07
+ *
+ */
+
+#ifndef INCLUDE_INTCODE_SCHEDULER_H
+#define INCLUDE_INTCODE_SCHEDULER_H
+
+#include "challenge/intcode.h"
+
+/*Runs many machines connected by IO rings without a thread per machine.*/
+typedef struct intcode_scheduler intcode_scheduler_t;
+
+intcode_scheduler_t* create_scheduler(size_t num_workers);
+void destroy_scheduler(intcode_scheduler_t* scheduler);
+void clear_scheduler(intcode_scheduler_t* scheduler);
+int schedule_intcode(intcode_scheduler_t* scheduler, intcode_t* prog);
+int run_scheduler(intcode_scheduler_t* scheduler);
+size_t get_num_scheduled(const intcode_scheduler_t* scheduler);
+int get_scheduled_ret(const intcode_scheduler_t* scheduler, size_t index);
+
+
+#endif /* ifndef INCLUDE_INTCODE_SCHEDULER_H */
@@ -0,0 +1,3 @@
+#!/usr/bin/env bash
+
+./build/aoc2019_25_benchmark .. "$@"
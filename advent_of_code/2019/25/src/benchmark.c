@@ -0,0 +1,681 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *
+ */
+
+#include "challenge/intcode.h"
+#include "pthread.h"
+#include "stdatomic.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "sys/resource.h"
+#include "sys/wait.h"
+#include "time.h"
+#include "unistd.h"
+
+#define DEFAULT_ROOT ".."
+#define DEFAULT_ITERATIONS (1)
+#define RING_CAPACITY (256)
+#define MAX_PATH_LENGTH (512)
+#define MAX_LINE_LENGTH (256)
+
+/*Scripted input of one run, the interactive days get a fixed sequence instead of a player.*/
+typedef struct
+{
+    int64_t* values;
+    size_t size;
+    size_t capacity;
+    /*Written to address 0 before the run if not 0, e.g. the quarters of day 13.*/
+    int64_t address_zero;
+} script_t;
+
+typedef struct
+{
+    const char* name;
+    size_t num_runs;
+    int (*build)(const char* root, size_t run, script_t* script);
+    /*The program never halts, running out of input ends the run.*/
+    int open_ended;
+} benchmark_day_t;
+
+typedef struct
+{
+    int ok;
+    double wall_ms;
+    uint64_t instructions;
+    uint64_t fused[INT_CODE_FUSION_KINDS];
+    uint64_t checksum;
+    long threads;
+} measurement_t;
+
+/*The machine of a memory IO run and the two threads serving it.*/
+typedef struct
+{
+    intcode_io_mem_t* input;
+    intcode_io_mem_t* output;
+    const script_t* script;
+    uint64_t checksum;
+    atomic_int done;
+} mem_session_t;
+
+static const char* engine_names[] = {"step", "threaded", "compiled"};
+static const char* io_names[]     = {"std", "mem", "ring"};
+
+static double now_ms()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000.0) + (now.tv_nsec / 1000000.0);
+}
+
+static long count_threads()
+{
+    FILE* status = fopen("/proc/self/status", "r");
+    if (status == NULL)
+    {
+        return 0;
+    }
+    char line[MAX_LINE_LENGTH];
+    long threads = 0;
+    while (fgets(line, sizeof(line), status) != NULL)
+    {
+        if (sscanf(line, "Threads: %ld", &threads) == 1)
+        {
+            break;
+        }
+    }
+    fclose(status);
+    return threads;
+}
+
+static uint64_t add_to_checksum(const uint64_t checksum, const int64_t value)
+{
+    return (checksum * 31) + (uint64_t) value;
+}
+
+static int push_value(script_t* const script, const int64_t value)
+{
+    if (script->size == script->capacity)
+    {
+        size_t capacity = (script->capacity == 0) ? 64 : 2 * script->capacity;
+        int64_t* values = (int64_t*) realloc(script->values, capacity * sizeof(int64_t));
+        if (values == NULL)
+        {
+            return 0;
+        }
+        script->values   = values;
+        script->capacity = capacity;
+    }
+    script->values[script->size++] = value;
+    return 1;
+}
+
+static int push_text(script_t* const script, const char* const text)
+{
+    for (const char* c = text; *c != '\0'; ++c)
+    {
+        if (!push_value(script, *c))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int build_day05(const char* root, const size_t run, script_t* const script)
+{
+    /*The air conditioner and the thermal radiator controller.*/
+    return push_value(script, (run == 0) ? 1 : 5);
+}
+
+static int build_day07(const char* root, const size_t run, script_t* const script)
+{
+    /*One amplifier per phase, the feedback phases get ten signals before they halt.*/
+    int ok = push_value(script, run);
+    for (int64_t signal = 0; signal < ((run < 5) ? 1 : 10); ++signal)
+    {
+        ok = ok && push_value(script, signal);
+    }
+    return ok;
+}
+
+static int build_day09(const char* root, const size_t run, script_t* const script)
+{
+    return push_value(script, run + 1);
+}
+
+static int build_day11(const char* root, const size_t run, script_t* const script)
+{
+    /*The robot only ever sees black panels.*/
+    int ok = 1;
+    for (size_t i = 0; i < 20000; ++i)
+    {
+        ok = ok && push_value(script, 0);
+    }
+    return ok;
+}
+
+static int build_day13(const char* root, const size_t run, script_t* const script)
+{
+    /*Draw the screen, then play for free with the joystick in neutral until the ball is lost.*/
+    int ok = 1;
+    if (run == 1)
+    {
+        script->address_zero = 2;
+        for (size_t i = 0; i < 20000; ++i)
+        {
+            ok = ok && push_value(script, 0);
+        }
+    }
+    return ok;
+}
+
+static int build_day15(const char* root, const size_t run, script_t* const script)
+{
+    /*A random walk of the droid.*/
+    int ok         = 1;
+    uint64_t state = 42;
+    for (size_t i = 0; i < 20000; ++i)
+    {
+        state = (state * 6364136223846793005ULL) + 1442695040888963407ULL;
+        ok    = ok && push_value(script, 1 + ((state >> 33) % 4));
+    }
+    return ok;
+}
+
+static int build_day17(const char* root, const size_t run, script_t* const script)
+{
+    /*Take the picture, then walk the scaffold with the movement routine of part 2.*/
+    if (run == 0)
+    {
+        return 1;
+    }
+    script->address_zero = 2;
+    return push_text(script, "A,B,A,C,B,A,C,A,C,B\n") && push_text(script, "L,6,6,L,8,L,8\n") &&
+           push_text(script, "L,6,6,R,4,L,6,6,R,6\n") &&
+           push_text(script, "R,4,L,6,6,L,6,6,R,6\n") && push_text(script, "n\n");
+}
+
+static int build_day19(const char* root, const size_t run, script_t* const script)
+{
+    /*Every probe of the 50x50 area is a run of its own.*/
+    return push_value(script, run % 50) && push_value(script, run / 50);
+}
+
+static int build_day21(const char* root, const size_t run, script_t* const script)
+{
+    if (run == 0)
+    {
+        return push_text(script, "NOT A J\nNOT B T\nOR T J\nNOT C T\nOR T J\nAND D J\nWALK\n");
+    }
+    return push_text(script,
+                     "NOT B J\nNOT C T\nOR T J\nAND D J\nAND H J\nNOT A T\nOR T J\nRUN\n");
+}
+
+static int build_day23(const char* root, const size_t run, script_t* const script)
+{
+    /*Every NIC on its own, it never receives a packet.*/
+    int ok = push_value(script, run);
+    for (size_t i = 0; i < 200; ++i)
+    {
+        ok = ok && push_value(script, -1);
+    }
+    return ok;
+}
+
+static int build_day25(const char* root, const size_t run, script_t* const script)
+{
+    /*The commands that solve the game.*/
+    char path[MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/25/complete_commands.txt", root);
+    FILE* commands = fopen(path, "r");
+    if (commands == NULL)
+    {
+        printf("Could not open %s\n", path);
+        return 0;
+    }
+    char line[MAX_LINE_LENGTH];
+    int ok = 1;
+    while (ok && (fgets(line, sizeof(line), commands) != NULL))
+    {
+        ok = push_text(script, line);
+    }
+    fclose(commands);
+    return ok;
+}
+
+static const benchmark_day_t days[] = {
+    {"05", 2, build_day05, 0},
+    {"07", 10, build_day07, 0},
+    {"09", 2, build_day09, 0},
+    {"11", 1, build_day11, 0},
+    {"13", 2, build_day13, 0},
+    {"15", 1, build_day15, 1},
+    {"17", 2, build_day17, 0},
+    {"19", 2500, build_day19, 0},
+    {"21", 2, build_day21, 0},
+    {"23", 50, build_day23, 1},
+    {"25", 1, build_day25, 0},
+};
+
+static int run_std_io(intcode_t* const prog, const script_t* const script, uint64_t* const checksum)
+{
+    FILE* input  = tmpfile();
+    FILE* output = tmpfile();
+    if ((input == NULL) || (output == NULL))
+    {
+        if (input != NULL)
+        {
+            fclose(input);
+        }
+        if (output != NULL)
+        {
+            fclose(output);
+        }
+        return INT_CODE_ERROR;
+    }
+    for (size_t i = 0; i < script->size; ++i)
+    {
+        fprintf(input, "%ld\n", script->values[i]);
+    }
+    rewind(input);
+    set_io_mode(prog, INT_CODE_STD_IO);
+    set_std_io_in(prog, input);
+    set_std_io_out(prog, output);
+    int ret = execute(prog);
+
+    int64_t value = 0;
+    rewind(output);
+    while (fscanf(output, "%ld", &value) == 1)
+    {
+        *checksum = add_to_checksum(*checksum, value);
+    }
+    fclose(input);
+    fclose(output);
+    return ret;
+}
+
+static void* feed_mem_io(void* args)
+{
+    mem_session_t* session = (mem_session_t*) args;
+    intcode_io_mem_t* in   = session->input;
+    pthread_mutex_lock(&in->mut);
+    for (size_t i = 0; i < session->script->size; ++i)
+    {
+        while (!in->consumed && !atomic_load(&session->done))
+        {
+            pthread_cond_wait(&in->cond, &in->mut);
+        }
+        if (atomic_load(&session->done))
+        {
+            break;
+        }
+        in->value    = session->script->values[i];
+        in->consumed = 0;
+        pthread_cond_signal(&in->cond);
+    }
+    pthread_mutex_unlock(&in->mut);
+    return NULL;
+}
+
+static void* drain_mem_io(void* args)
+{
+    mem_session_t* session = (mem_session_t*) args;
+    intcode_io_mem_t* out  = session->output;
+    pthread_mutex_lock(&out->mut);
+    while (1)
+    {
+        while (out->consumed && !atomic_load(&session->done))
+        {
+            pthread_cond_wait(&out->cond, &out->mut);
+        }
+        /*The last output is still there after the machine halted.*/
+        if (out->consumed)
+        {
+            break;
+        }
+        session->checksum = add_to_checksum(session->checksum, out->value);
+        out->consumed     = 1;
+        pthread_cond_signal(&out->cond);
+    }
+    pthread_mutex_unlock(&out->mut);
+    return NULL;
+}
+
+static void finish_mem_session(mem_session_t* const session, intcode_io_mem_t* const store)
+{
+    pthread_mutex_lock(&store->mut);
+    atomic_store(&session->done, 1);
+    pthread_cond_broadcast(&store->cond);
+    pthread_mutex_unlock(&store->mut);
+}
+
+static int run_mem_io(intcode_t* const prog,
+                      const script_t* const script,
+                      uint64_t* const checksum,
+                      long* const threads)
+{
+    mem_session_t session = {create_io_mem(), create_io_mem(), script, *checksum, 0};
+    if ((session.input == NULL) || (session.output == NULL))
+    {
+        destroy_io_mem(session.input);
+        destroy_io_mem(session.output);
+        return INT_CODE_ERROR;
+    }
+    /*The machine owns the stores from here on.*/
+    set_io_mode(prog, INT_CODE_MEM_IO);
+    set_mem_io_in(prog, session.input);
+    set_mem_io_out(prog, session.output);
+
+    /*The handshake needs a thread on the other side of each store, the machine runs here.*/
+    pthread_t feeder;
+    pthread_t drainer;
+    pthread_create(&feeder, NULL, feed_mem_io, &session);
+    pthread_create(&drainer, NULL, drain_mem_io, &session);
+    long running = count_threads();
+    *threads     = (running > *threads) ? running : *threads;
+
+    int ret = execute(prog);
+    finish_mem_session(&session, session.input);
+    finish_mem_session(&session, session.output);
+    pthread_join(feeder, NULL);
+    pthread_join(drainer, NULL);
+    *checksum = session.checksum;
+    return ret;
+}
+
+static int run_ring_io(intcode_t* const prog,
+                       const script_t* const script,
+                       uint64_t* const checksum)
+{
+    intcode_io_ring_t* input  = create_io_ring(RING_CAPACITY);
+    intcode_io_ring_t* output = create_io_ring(RING_CAPACITY);
+    int ret                   = INT_CODE_ERROR;
+    if ((input != NULL) && (output != NULL))
+    {
+        set_io_mode(prog, INT_CODE_RING_IO);
+        set_io_yield(prog, 1);
+        set_ring_io_in(prog, input);
+        set_ring_io_out(prog, output);
+
+        /*The machine yields whenever a ring runs empty or full and is resumed right away.*/
+        size_t fed = 0;
+        do
+        {
+            fed += io_ring_try_write(input, script->values + fed, script->size - fed);
+            if ((fed == script->size) && !io_ring_closed(input))
+            {
+                close_io_ring(input);
+            }
+            ret = execute(prog);
+
+            int64_t values[RING_CAPACITY];
+            size_t count = 0;
+            while ((count = io_ring_try_read(output, values, RING_CAPACITY)) > 0)
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    *checksum = add_to_checksum(*checksum, values[i]);
+                }
+            }
+        } while (ret == INT_CODE_BLOCKED);
+    }
+    destroy_io_ring(input);
+    destroy_io_ring(output);
+    return ret;
+}
+
+static measurement_t run_configuration(const benchmark_day_t* const day,
+                                       const intcode_t* const prog,
+                                       const script_t* const scripts,
+                                       const intcode_engine_t engine,
+                                       const intcode_io_mode_t io_mode,
+                                       const size_t iterations,
+                                       const int profile)
+{
+    measurement_t result = {1, 0.0, 0, {0}, 0, count_threads()};
+    double start         = now_ms();
+    for (size_t i = 0; (i < iterations) && result.ok; ++i)
+    {
+        /*Every iteration produces the same output.*/
+        uint64_t checksum = 0;
+        for (size_t run = 0; (run < day->num_runs) && result.ok; ++run)
+        {
+            intcode_t* machine = fork_intcode(prog);
+            if (machine == NULL)
+            {
+                result.ok = 0;
+                break;
+            }
+            set_engine(machine, engine);
+            /*Profiled machines run the step loop, so the compiled engine counts its fusions.*/
+            if (profile && (engine == INT_CODE_ENGINE_COMPILED))
+            {
+                enable_fusion_stats(machine);
+            }
+            else if (profile)
+            {
+                enable_profiling(machine, NULL);
+            }
+            if (scripts[run].address_zero != 0)
+            {
+                set_mem_value(machine, 0, scripts[run].address_zero);
+            }
+
+            int ret = INT_CODE_ERROR;
+            if (io_mode == INT_CODE_STD_IO)
+            {
+                ret = run_std_io(machine, &scripts[run], &checksum);
+            }
+            else if (io_mode == INT_CODE_MEM_IO)
+            {
+                ret = run_mem_io(machine, &scripts[run], &checksum, &result.threads);
+            }
+            else
+            {
+                ret = run_ring_io(machine, &scripts[run], &checksum);
+            }
+            result.ok = (ret == INT_CODE_HALT) || (day->open_ended && (ret == INT_CODE_ERROR));
+            if (get_profile(machine) != NULL)
+            {
+                result.instructions += get_profile(machine)->instructions;
+            }
+            const intcode_fusion_stats_t* stats = get_fusion_stats(machine);
+            for (int kind = 0; (stats != NULL) && (kind < INT_CODE_FUSION_KINDS); ++kind)
+            {
+                result.fused[kind] += stats->fired[kind];
+            }
+            destroy_intcode(machine);
+        }
+        result.checksum = checksum;
+    }
+    result.wall_ms = (now_ms() - start) / iterations;
+    return result;
+}
+
+/*Every configuration runs in a child process, so its peak RSS is its own.*/
+static int measure(const benchmark_day_t* const day,
+                   const intcode_t* const prog,
+                   const script_t* const scripts,
+                   const intcode_engine_t engine,
+                   const intcode_io_mode_t io_mode,
+                   const size_t iterations,
+                   const int profile,
+                   measurement_t* const result,
+                   long* const peak_rss_kb)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return 0;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return 0;
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        measurement_t measurement =
+            run_configuration(day, prog, scripts, engine, io_mode, iterations, profile);
+        ssize_t written = write(fds[1], &measurement, sizeof(measurement));
+        _exit(written == sizeof(measurement) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t received = read(fds[0], result, sizeof(measurement_t));
+    close(fds[0]);
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid)
+    {
+        return 0;
+    }
+    *peak_rss_kb = usage.ru_maxrss;
+    return (received == sizeof(measurement_t)) && WIFEXITED(status) &&
+           (WEXITSTATUS(status) == 0) && result->ok;
+}
+
+static int benchmark_day(const char* const root,
+                         const benchmark_day_t* const day,
+                         const size_t iterations)
+{
+    char path[MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/%s/input.txt", root, day->name);
+    intcode_t* prog   = read_intcode(path);
+    script_t* scripts = (script_t*) calloc(day->num_runs, sizeof(script_t));
+    int ok            = (prog != NULL) && (scripts != NULL);
+    for (size_t run = 0; ok && (run < day->num_runs); ++run)
+    {
+        ok = day->build(root, run, &scripts[run]);
+    }
+
+    /*The instructions are counted once on the profiled step loop, the input is the same for all.*/
+    measurement_t reference;
+    long peak_rss_kb = 0;
+    if (ok && !measure(day,
+                       prog,
+                       scripts,
+                       INT_CODE_ENGINE_STEP,
+                       INT_CODE_RING_IO,
+                       1,
+                       1,
+                       &reference,
+                       &peak_rss_kb))
+    {
+        printf("%-4s failed to run %s\n", day->name, path);
+        ok = 0;
+    }
+
+    for (int engine = INT_CODE_ENGINE_STEP; ok && (engine <= INT_CODE_ENGINE_COMPILED); ++engine)
+    {
+        for (int io_mode = INT_CODE_STD_IO; io_mode <= INT_CODE_RING_IO; ++io_mode)
+        {
+            /*Nothing can wake a machine waiting on a memory store once the input ran out.*/
+            if (day->open_ended && (io_mode == INT_CODE_MEM_IO))
+            {
+                printf("%-4s %-9s %-5s %6zu %14s\n",
+                       day->name,
+                       engine_names[engine],
+                       io_names[io_mode],
+                       day->num_runs,
+                       "-");
+                continue;
+            }
+            measurement_t result;
+            if (!measure(day, prog, scripts, engine, io_mode, iterations, 0, &result, &peak_rss_kb))
+            {
+                printf(
+                    "%-4s %-9s %-5s failed\n", day->name, engine_names[engine], io_names[io_mode]);
+                continue;
+            }
+            printf("%-4s %-9s %-5s %6zu %14lu %10.3f %12.2f %12ld %8ld%s\n",
+                   day->name,
+                   engine_names[engine],
+                   io_names[io_mode],
+                   day->num_runs,
+                   reference.instructions,
+                   result.wall_ms,
+                   reference.instructions / (result.wall_ms * 1000.0),
+                   peak_rss_kb,
+                   result.threads,
+                   (result.checksum == reference.checksum) ? "" : "  output differs");
+        }
+    }
+
+    /*Every fused sequence that ran saved the compiled engine one dispatch.*/
+    measurement_t fusion;
+    if (ok && measure(day,
+                      prog,
+                      scripts,
+                      INT_CODE_ENGINE_COMPILED,
+                      INT_CODE_RING_IO,
+                      1,
+                      1,
+                      &fusion,
+                      &peak_rss_kb))
+    {
+        uint64_t saved = 0;
+        for (int kind = 0; kind < INT_CODE_FUSION_KINDS; ++kind)
+        {
+            saved += fusion.fused[kind];
+        }
+        printf("%-4s fused: %lu dispatches saved (%.1f%%), %lu relative base, %lu compare and "
+               "jump, %lu counter and jump\n",
+               day->name,
+               saved,
+               (100.0 * saved) / ((reference.instructions > 0) ? reference.instructions : 1),
+               fusion.fused[INT_CODE_FUSION_REL_BASE],
+               fusion.fused[INT_CODE_FUSION_COMPARE_JUMP],
+               fusion.fused[INT_CODE_FUSION_COUNTER_JUMP]);
+    }
+
+    for (size_t run = 0; (scripts != NULL) && (run < day->num_runs); ++run)
+    {
+        free(scripts[run].values);
+    }
+    free(scripts);
+    destroy_intcode(prog);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 3)
+    {
+        printf("This executabel takes up to two arguments.\n");
+        printf("Usage: aoc2019_25_benchmark [ROOT] [ITERATIONS].\n");
+        return 0;
+    }
+
+    const char* root  = (argc >= 2) ? argv[1] : DEFAULT_ROOT;
+    size_t iterations = (argc == 3) ? strtoul(argv[2], NULL, 10) : DEFAULT_ITERATIONS;
+    if (iterations == 0)
+    {
+        iterations = 1;
+    }
+
+    printf("Root: %s, iterations: %zu\n", root, iterations);
+    printf("%-4s %-9s %-5s %6s %14s %10s %12s %12s %8s\n",
+           "day",
+           "engine",
+           "io",
+           "runs",
+           "instructions",
+           "wall ms",
+           "M instr/s",
+           "peak RSS kB",
+           "threads");
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(days) / sizeof(days[0]); ++i)
+    {
+        failed += !benchmark_day(root, &days[i], iterations);
+    }
+    return (failed > 0) ? 1 : 0;
+}
@@ -17,84 +17,68 @@
 #define NUM_OF_ITEMS (8)
 #define INV_CMD ("inv\n")
 
-static int64_t read_output(const ASCII* const system)
+/*Runs the droid until it waits for the next command or halts and collects its output.*/
+static void run_until_prompt(ASCII* const system, int print_output, char* buffer, int* idx)
 {
     assert(system != NULL);
     assert(system->brain != NULL);
-    assert(system->brain->mem_io_out != NULL);
+    assert(system->brain->ring_io_out != NULL);
 
-    int64_t read_value = -1;
-
-    intcode_io_mem_t* output = system->brain->mem_io_out;
-    pthread_mutex_lock(&output->mut);
-    while (output->consumed && !system->finished)
-    {
-        pthread_cond_wait(&output->cond, &output->mut);
-    }
-
-    if (!system->finished)
+    int ret = INT_CODE_BLOCKED;
+    while ((ret == INT_CODE_BLOCKED) && !system->finished)
     {
-        read_value       = output->value;
-        output->consumed = 1;
-    }
-    pthread_cond_signal(&output->cond);
-    pthread_mutex_unlock(&output->mut);
-
-
-    return read_value;
-}
+        /*Either the droid waits for input or the output ring is full.*/
+        ret = run_scheduler(system->scheduler);
 
-static void provide_input(const ASCII* const system, const int value)
-{
-    assert(system != NULL);
-    assert(system->brain != NULL);
-    assert(system->brain->mem_io_in != NULL);
+        int64_t values[MAX_OUTPUT_LENGTH];
+        size_t num_values = 0;
+        do
+        {
+            num_values = io_ring_try_read(system->brain->ring_io_out, values, MAX_OUTPUT_LENGTH);
+            for (size_t i = 0; i < num_values; ++i)
+            {
+                char resp = (char) values[i];
+                if (print_output)
+                {
+                    printf("%c", resp);
+                }
+                if ((buffer != NULL) && (*idx < (MAX_OUTPUT_LENGTH - 1)))
+                {
+                    buffer[*idx] = resp;
+                    *idx += 1;
+                }
+            }
+        } while (num_values > 0);
 
-    intcode_io_mem_t* input = system->brain->mem_io_in;
-    pthread_mutex_lock(&input->mut);
-    while (!input->consumed && !system->finished)
-    {
-        pthread_cond_wait(&input->cond, &input->mut);
+        if (ret == INT_CODE_HALT)
+        {
+            system->finished = 1;
+        }
+        else if (ret == INT_CODE_ERROR)
+        {
+            printf("Programm did not halt as expected. Err code: %d\n", ret);
+            system->finished = 1;
+        }
+        else if (waiting_for_input(system->brain))
+        {
+            break;
+        }
     }
-    input->value    = value;
-    input->consumed = 0;
-    pthread_cond_signal(&input->cond);
-    pthread_mutex_unlock(&input->mut);
 }
 
 /*Read command prompt. Afterwards either finished or expecting input.*/
-static void read_prompt(const ASCII* const system, int print_output)
+static void read_prompt(ASCII* const system, int print_output)
 {
-    while (!waiting_for_input(system->brain) && !system->finished)
-    {
-        if (providing_ouput(system->brain))
-        {
-            /*Read Response*/
-            char resp = (char) read_output(system);
-            if (print_output)
-            {
-                printf("%c", resp);
-            }
-        }
-    }
+    run_until_prompt(system, print_output, NULL, NULL);
 }
 
 /*Read command prompt. Afterwards either finished or expecting input.*/
-static void read_prompt_to_buffer(const ASCII* const system, char* buffer, int* idx)
+static void read_prompt_to_buffer(ASCII* const system, char* buffer, int* idx)
 {
-    while (!waiting_for_input(system->brain) && !system->finished)
-    {
-        if (providing_ouput(system->brain))
-        {
-            /*Read Response*/
-            char resp    = (char) read_output(system);
-            buffer[*idx] = resp;
-            *idx += 1;
-        }
-    }
+    run_until_prompt(system, 0, buffer, idx);
 }
 
-/*Provide input. Afterwards either finished or providing output.*/
+/*Provide input, it is evaluated by the next read of the prompt.*/
 static void provide_line(const ASCII* const system, const char* const line)
 {
     assert(system != NULL);
@@ -102,11 +86,8 @@ static void provide_line(const ASCII* const system, const char* const line)
     assert(line != NULL);
     for (int i = 0; i < strlen(line); ++i)
     {
-        provide_input(system, (int64_t) line[i]);
-    }
-    while (!system->finished && !providing_ouput(system->brain))
-    {
-        /*spin to ensure the provided line has been evaluated*/
+        int64_t value = (int64_t) line[i];
+        io_ring_try_write(system->brain->ring_io_in, &value, 1);
     }
 }
 
@@ -137,7 +118,7 @@ static void parse_inv(char* inv, char** items)
     }
 }
 
-static void take(const ASCII* const system, char const* item)
+static void take(ASCII* const system, char const* item)
 {
     char cmd[MAX_COMMAND_LENGTH];
     cmd[0] = '\0';
@@ -148,7 +129,7 @@ static void take(const ASCII* const system, char const* item)
     read_prompt(system, 0);
 }
 
-static void drop(const ASCII* const system, char const* item)
+static void drop(ASCII* const system, char const* item)
 {
     char cmd[MAX_COMMAND_LENGTH];
     cmd[0] = '\0';
@@ -159,17 +140,28 @@ static void drop(const ASCII* const system, char const* item)
     read_prompt(system, 0);
 }
 
-static void bruteforce(const ASCII* const system, char** items, char const* cmd)
+static void bruteforce(ASCII* const system, char** items, char const* cmd)
 {
     char resp[MAX_OUTPUT_LENGTH];
     int resp_idx     = 0;
     uint8_t solution = 0u;
+
+    /*Every attempt starts from the droid holding all items, so it only has to drop some.*/
+    intcode_snapshot_t* all_items = snapshot_intcode(system->brain);
     for (uint8_t i = 0u; i < 255u; ++i)
     {
-        /*prepare inventory*/
+        /*prepare inventory, a recorded session can not be restored and takes the items back*/
+        int restored = restore_intcode(system->brain, all_items);
         for (uint8_t j = 0u; j < NUM_OF_ITEMS; ++j)
         {
-            ((i >> j) & 1u) ? take(system, items[j]) : drop(system, items[j]);
+            if (!((i >> j) & 1u))
+            {
+                drop(system, items[j]);
+            }
+            else if (!restored)
+            {
+                take(system, items[j]);
+            }
         }
         /*issue command to move into room*/
         provide_line(system, cmd);
@@ -184,6 +176,7 @@ static void bruteforce(const ASCII* const system, char** items, char const* cmd)
         }
         resp_idx = 0;
     }
+    destroy_snapshot(all_items);
     printf("\nFound solution using the following items:\n");
     for (uint8_t i = 0; i < NUM_OF_ITEMS; ++i)
     {
@@ -195,32 +188,24 @@ static void bruteforce(const ASCII* const system, char** items, char const* cmd)
     printf("\nFinal Message:\n%s", resp);
 }
 
-static void prompt_and_command_loop(const ASCII* const system,
+static void prompt_and_command_loop(ASCII* const system,
                                     FILE* input_stream,
                                     int verbose_output,
                                     char* last_command)
 {
     /*Prompt and Command loop*/
     char cmd_buffer[MAX_COMMAND_LENGTH];
-    int input_definitely_consumed = 0;
+    cmd_buffer[0] = '\0';
     while (!system->finished && !feof(input_stream))
     {
-        if (providing_ouput(system->brain))
-        {
-            input_definitely_consumed = 1;
-            read_prompt(system, verbose_output);
-        }
-        else if (waiting_for_input(system->brain) && input_definitely_consumed)
+        read_prompt(system, verbose_output);
+        if (!system->finished && fgets(cmd_buffer, MAX_COMMAND_LENGTH, input_stream))
         {
-            if (fgets(cmd_buffer, MAX_COMMAND_LENGTH, input_stream))
+            if (input_stream != stdin && verbose_output)
             {
-                if (input_stream != stdin && verbose_output)
-                {
-                    printf("%s", cmd_buffer);
-                }
-                provide_line(system, cmd_buffer);
-                input_definitely_consumed = 0;
+                printf("%s", cmd_buffer);
             }
+            provide_line(system, cmd_buffer);
         }
     }
     if (last_command)
@@ -229,12 +214,12 @@ static void prompt_and_command_loop(const ASCII* const system,
     }
 }
 
-static void run_interactive_program(const ASCII* const system)
+static void run_interactive_program(ASCII* const system)
 {
     prompt_and_command_loop(system, stdin, 1, NULL);
 }
 
-static void run_hardcoded_commands(const ASCII* const system,
+static void run_hardcoded_commands(ASCII* const system,
                                    char const* command_file,
                                    int bruteforce_required,
                                    int verbose_output)
@@ -249,11 +234,6 @@ static void run_hardcoded_commands(const ASCII* const system,
 
         printf("Finished command list.\n");
 
-        while (!system->finished && bruteforce_required && !waiting_for_input(system->brain))
-        {
-            /*spin until input is required*/
-        }
-
         if (!system->finished && bruteforce_required && waiting_for_input(system->brain))
         {
             printf("Bruteforcing!\n");
@@ -262,13 +242,7 @@ static void run_hardcoded_commands(const ASCII* const system,
             char output_buffer[MAX_OUTPUT_LENGTH];
             int output_idx = 0;
             provide_line(system, INV_CMD);
-            while (!system->finished && output_idx == 0)
-            {
-                if (providing_ouput(system->brain))
-                {
-                    read_prompt_to_buffer(system, output_buffer, &output_idx);
-                }
-            }
+            read_prompt_to_buffer(system, output_buffer, &output_idx);
             output_buffer[output_idx] = '\0';
 
             // parse output of inv command
@@ -294,32 +268,12 @@ static void run_hardcoded_commands(const ASCII* const system,
 }
 
 
-void* drone_func(void* args)
-{
-    if (args == NULL)
-    {
-        return NULL;
-    }
-    ASCII* system = (ASCII*) args;
-    int ret       = execute(system->brain);
-    if (ret != INT_CODE_HALT)
-    {
-        printf("Programm did not halt as expected. Err code: %d\n", ret);
-    }
-    else
-    {
-        system->finished = 1;
-    }
-    return NULL;
-}
-
-void* control_func(void* args)
+void run_drone(ControlParams* const control_params)
 {
-    if (args == NULL)
+    if (control_params == NULL)
     {
-        return NULL;
+        return;
     }
-    ControlParams* control_params = (ControlParams*) args;
     if (control_params->interactive)
     {
         run_interactive_program(control_params->drone);
@@ -331,5 +285,4 @@ void* control_func(void* args)
                                control_params->bruteforce,
                                control_params->verbose);
     }
-    return NULL;
 }
@@ -4,7 +4,6 @@
  *
  */
 
-#include "pthread.h"
 #include "stdbool.h"
 #include "stdio.h"
 #include "stdlib.h"
@@ -16,6 +15,12 @@
 #define VERBOSE (0)
 #endif
 
+/*A command has to fit into the input ring, see MAX_COMMAND_LENGTH.*/
+#define IO_IN_CAPACITY (128)
+#define IO_OUT_CAPACITY (1024)
+/*Even bruteforcing the items takes about a million instructions, seeking steps a tenth of it.*/
+#define RECORD_CHECKPOINT_INTERVAL (100000)
+
 int main(int argc, char* argv[])
 {
     if (argc < 2)
@@ -32,39 +37,47 @@ int main(int argc, char* argv[])
         command_file = argv[2];
     }
 
-    /*Initialize the program with IO memory.*/
-    intcode_t* prog          = read_intcode(argv[1]);
-    intcode_io_mem_t* io_in  = create_io_mem();
-    intcode_io_mem_t* io_out = create_io_mem();
-    if ((prog == NULL) || (io_in == NULL) || (io_out == NULL))
+    /*Initialize the program with IO rings, the droid is run on this thread.*/
+    intcode_t* prog                = read_intcode(argv[1]);
+    intcode_io_ring_t* io_in       = create_io_ring(IO_IN_CAPACITY);
+    intcode_io_ring_t* io_out      = create_io_ring(IO_OUT_CAPACITY);
+    intcode_scheduler_t* scheduler = create_scheduler(0);
+    if ((prog == NULL) || (io_in == NULL) || (io_out == NULL) || (scheduler == NULL))
     {
         printf("Error reading programm or allocating IO memory\n");
         return 0;
     }
 
-    set_io_mode(prog, INT_CODE_MEM_IO);
-    set_mem_io_in(prog, io_in);
-    set_mem_io_out(prog, io_out);
+    set_engine(prog, INT_CODE_ENGINE_THREADED);
+    set_io_mode(prog, INT_CODE_RING_IO);
+    set_ring_io_in(prog, io_in);
+    set_ring_io_out(prog, io_out);
+    schedule_intcode(scheduler, prog);
+
+    /*The session can be recorded to reproduce it later, see replay.c.*/
+    const char* record_file = getenv("INTCODE_RECORD");
+    if ((record_file != NULL) && !start_recording(prog, record_file, RECORD_CHECKPOINT_INTERVAL))
+    {
+        printf("Error starting to record to %s\n", record_file);
+    }
 
-    ASCII drone           = {.brain = prog, .finished = 0};
+    ASCII drone           = {.brain = prog, .scheduler = scheduler, .finished = 0};
     ControlParams control = {.drone        = &drone,
                              .interactive  = (command_file) ? 0 : 1,
                              .command_file = command_file,
                              .bruteforce   = bruteforce,
                              .verbose      = VERBOSE};
-
-    /*Setup threads etc.*/
-    pthread_t drone_thread   = 0;
-    pthread_t control_thread = 0;
-    pthread_create(&drone_thread, NULL, drone_func, &drone);
-    pthread_create(&control_thread, NULL, control_func, &control);
-
-    /*Wait for threads to finish.*/
-    pthread_join(drone_thread, NULL);
-    pthread_join(control_thread, NULL);
+    run_drone(&control);
 
     /*Clean Up*/
+    if ((record_file != NULL) && !stop_recording(prog))
+    {
+        printf("Error writing the recording to %s\n", record_file);
+    }
+    destroy_scheduler(scheduler);
     destroy_intcode(prog);
+    destroy_io_ring(io_in);
+    destroy_io_ring(io_out);
 
     return 0;
 }
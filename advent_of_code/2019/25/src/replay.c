@@ -0,0 +1,95 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *
+ */
+
+#include "challenge/intcode.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+static int is_text(const intcode_io_event_t* const events, const size_t num_events);
+
+int main(int argc, char* argv[])
+{
+    if ((argc != 2) && (argc != 3))
+    {
+        printf("This executabel takes one or two arguments.\n");
+        printf("Usage: aoc2019_25_replay RECORDING [INSTRUCTION].\n");
+        return 0;
+    }
+    uint64_t instruction = 0;
+    if (argc == 3)
+    {
+        instruction = strtoull(argv[2], NULL, 10);
+    }
+
+    intcode_recording_t* recording = load_recording(argv[1]);
+    if (recording == NULL)
+    {
+        printf("Error reading recording %s\n", argv[1]);
+        return 0;
+    }
+    intcode_t* prog = replay_intcode(recording, instruction);
+    if (prog == NULL)
+    {
+        printf("The droid did not follow the recording up to instruction %lu.\n", instruction);
+        destroy_recording(recording);
+        return 0;
+    }
+    uint64_t start = get_instruction_count(prog);
+
+    /*The droid runs on this thread until the recorded input is used up.*/
+    set_io_yield(prog, 1);
+    int ret = execute(prog);
+    if (ret == INT_CODE_ERROR)
+    {
+        printf("The droid left the recording at instruction %lu.\n", get_instruction_count(prog));
+    }
+
+    /*The IO from the instruction on, as text for ASCII programs like the droid.*/
+    /*Other days, e.g. the game of day 13, get a line per value.*/
+    size_t num_events                = 0;
+    const intcode_io_event_t* events = get_recorded_events(recording, &num_events);
+    int text                         = is_text(events, num_events);
+    for (size_t i = 0; i < num_events; ++i)
+    {
+        if (events[i].instruction < start)
+        {
+            continue;
+        }
+        if (text)
+        {
+            putchar((int) events[i].value);
+        }
+        else
+        {
+            printf("%lu %s %ld\n",
+                   events[i].instruction,
+                   events[i].is_output ? "out" : "in",
+                   events[i].value);
+        }
+    }
+    printf("\nReplayed instructions %lu to %lu, the droid %s.\n",
+           start,
+           get_instruction_count(prog),
+           (ret == INT_CODE_HALT) ? "halted" : "waits for input");
+
+    destroy_intcode(prog);
+    destroy_recording(recording);
+    return 0;
+}
+
+/*Whether every value of the recording is a printable character or a line break.*/
+static int is_text(const intcode_io_event_t* const events, const size_t num_events)
+{
+    for (size_t i = 0; i < num_events; ++i)
+    {
+        int64_t value = events[i].value;
+        if ((value != '\n') && ((value < ' ') || (value > '~')))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
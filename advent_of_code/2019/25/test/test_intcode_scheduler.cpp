@@ -0,0 +1,187 @@
+/*
+ *
+ *  Author: Peter Wolf <pwolf2310@gmail.com>
+ *  Date: 2020-05-07
+ *
+ */
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+extern "C" {
+#include "challenge/intcode_scheduler.h"
+}
+
+class intcode_scheduler_test : public ::testing::TestWithParam<size_t>
+{
+  protected:
+    void SetUp() override { scheduler = create_scheduler(GetParam()); }
+
+    void TearDown() override
+    {
+        destroy_scheduler(scheduler);
+        for (intcode_t* prog : progs)
+        {
+            destroy_intcode(prog);
+        }
+        for (intcode_io_ring_t* ring : rings)
+        {
+            destroy_io_ring(ring);
+        }
+    }
+
+    intcode_io_ring_t* ring(size_t capacity)
+    {
+        rings.push_back(create_io_ring(capacity));
+        return rings.back();
+    }
+
+    intcode_t* machine(const int64_t* content,
+                       size_t nums,
+                       intcode_io_ring_t* input,
+                       intcode_io_ring_t* output)
+    {
+        int64_t* memory = (int64_t*) malloc(sizeof(int64_t) * nums);
+        for (size_t i = 0; i < nums; ++i)
+        {
+            memory[i] = content[i];
+        }
+        intcode_t* prog = create_intcode(memory, nums);
+        set_engine(prog, INT_CODE_ENGINE_THREADED);
+        set_io_mode(prog, INT_CODE_RING_IO);
+        set_ring_io_in(prog, input);
+        set_ring_io_out(prog, output);
+        progs.push_back(prog);
+        return prog;
+    }
+
+    intcode_scheduler_t* scheduler = NULL;
+    std::vector<intcode_t*> progs;
+    std::vector<intcode_io_ring_t*> rings;
+};
+
+TEST_P(intcode_scheduler_test, chain_01)
+{
+    /*Every machine adds one to each value, forever.*/
+    int64_t memory[]          = {3, 11, 1001, 11, 1, 11, 4, 11, 1105, 1, 0, 0};
+    const size_t num_machines = 5;
+    const size_t num_values   = 1000;
+
+    intcode_io_ring_t* first = ring(4);
+    intcode_io_ring_t* input = first;
+    for (size_t i = 0; i < num_machines; ++i)
+    {
+        intcode_io_ring_t* output = ring(4);
+        ASSERT_TRUE(schedule_intcode(scheduler, machine(memory, 12, input, output)));
+        input = output;
+    }
+
+    /*The rings are much smaller than the stream, so the machines have to yield.*/
+    int64_t written = 0;
+    std::vector<int64_t> values;
+    while (values.size() < num_values)
+    {
+        while ((written < (int64_t) num_values) && io_ring_try_write(first, &written, 1))
+        {
+            written++;
+        }
+        ASSERT_EQ(run_scheduler(scheduler), INT_CODE_BLOCKED);
+
+        int64_t value = 0;
+        while (io_ring_try_read(input, &value, 1) == 1)
+        {
+            values.push_back(value);
+        }
+    }
+    for (size_t i = 0; i < num_values; ++i)
+    {
+        ASSERT_EQ(values[i], i + num_machines);
+    }
+}
+
+TEST_P(intcode_scheduler_test, many_machines_01)
+{
+    /*Reads one value and outputs it doubled.*/
+    int64_t memory[]          = {3, 9, 1002, 9, 2, 9, 4, 9, 99, 0};
+    const size_t num_machines = 2000;
+
+    for (size_t i = 0; i < num_machines; ++i)
+    {
+        intcode_io_ring_t* input = ring(2);
+        int64_t value            = i;
+        io_ring_try_write(input, &value, 1);
+        ASSERT_TRUE(schedule_intcode(scheduler, machine(memory, 10, input, ring(2))));
+    }
+    ASSERT_EQ(get_num_scheduled(scheduler), num_machines);
+    ASSERT_EQ(run_scheduler(scheduler), INT_CODE_HALT);
+
+    for (size_t i = 0; i < num_machines; ++i)
+    {
+        int64_t value = 0;
+        ASSERT_EQ(get_scheduled_ret(scheduler, i), INT_CODE_HALT);
+        ASSERT_EQ(io_ring_try_read(progs[i]->ring_io_out, &value, 1), 1);
+        ASSERT_EQ(value, 2 * i);
+    }
+}
+
+TEST_P(intcode_scheduler_test, resume_01)
+{
+    int64_t memory[]          = {3, 9, 1002, 9, 2, 9, 4, 9, 99, 0};
+    intcode_io_ring_t* input  = ring(2);
+    intcode_io_ring_t* output = ring(2);
+    intcode_t* prog           = machine(memory, 10, input, output);
+    ASSERT_TRUE(schedule_intcode(scheduler, prog));
+
+    /*Nobody provides input, the machine is parked instead of blocking the thread.*/
+    ASSERT_EQ(run_scheduler(scheduler), INT_CODE_BLOCKED);
+    ASSERT_TRUE(waiting_for_input(prog));
+    ASSERT_EQ(prog->head, 0);
+
+    int64_t value = 21;
+    io_ring_try_write(input, &value, 1);
+    ASSERT_EQ(run_scheduler(scheduler), INT_CODE_HALT);
+    ASSERT_EQ(io_ring_try_read(output, &value, 1), 1);
+    ASSERT_EQ(value, 42);
+}
+
+TEST_P(intcode_scheduler_test, clear_01)
+{
+    int64_t memory[]          = {3, 9, 1002, 9, 2, 9, 4, 9, 99, 0};
+    intcode_io_ring_t* input  = ring(2);
+    intcode_io_ring_t* output = ring(2);
+    ASSERT_TRUE(schedule_intcode(scheduler, machine(memory, 10, input, output)));
+    ASSERT_EQ(run_scheduler(scheduler), INT_CODE_BLOCKED);
+
+    /*The blocked machine is dropped and a new one is run on the same rings.*/
+    clear_scheduler(scheduler);
+    ASSERT_EQ(get_num_scheduled(scheduler), 0);
+    ASSERT_TRUE(schedule_intcode(scheduler, machine(memory, 10, input, output)));
+    int64_t value = 4;
+    io_ring_try_write(input, &value, 1);
+    ASSERT_EQ(run_scheduler(scheduler), INT_CODE_HALT);
+    ASSERT_EQ(io_ring_try_read(output, &value, 1), 1);
+    ASSERT_EQ(value, 8);
+}
+
+TEST_P(intcode_scheduler_test, closed_ring_01)
+{
+    int64_t memory[]         = {3, 9, 1002, 9, 2, 9, 4, 9, 99, 0};
+    intcode_io_ring_t* input = ring(2);
+    ASSERT_TRUE(schedule_intcode(scheduler, machine(memory, 10, input, ring(2))));
+    ASSERT_EQ(run_scheduler(scheduler), INT_CODE_BLOCKED);
+
+    close_io_ring(input);
+    ASSERT_EQ(run_scheduler(scheduler), INT_CODE_ERROR);
+}
+
+TEST_P(intcode_scheduler_test, requires_ring_io_01)
+{
+    int64_t memory[] = {99};
+    intcode_t* prog  = machine(memory, 1, NULL, NULL);
+    set_io_mode(prog, INT_CODE_MEM_IO);
+    ASSERT_FALSE(schedule_intcode(scheduler, prog));
+    ASSERT_EQ(get_num_scheduled(scheduler), 0);
+}
+
+INSTANTIATE_TEST_SUITE_P(workers, intcode_scheduler_test, ::testing::Values(0, 1, 4));